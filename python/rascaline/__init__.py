@@ -7,11 +7,13 @@ from .calculators import CalculatorBase  # noqa
 from .calculators import SoapPowerSpectrum  # noqa
 from .calculators import SortedDistances  # noqa
 from .calculators import SphericalExpansion  # noqa
+from .calculators import compute_all  # noqa
 from .descriptor import Descriptor, Indexes  # noqa
 from .log import set_logging_callback  # noqa
 from .profiling import Profiler  # noqa
 from .status import RascalError  # noqa
 from .systems import SystemBase  # noqa
+from .threads import get_num_threads, set_num_threads  # noqa
 
 
 # Get the __version__ attribute from setuptools metadata (which took it from
@@ -21,6 +21,7 @@ RASCAL_INVALID_PARAMETER_ERROR = 1
 RASCAL_JSON_ERROR = 2
 RASCAL_UTF8_ERROR = 3
 RASCAL_CHEMFILES_ERROR = 4
+RASCAL_IO_ERROR = 5
 RASCAL_SYSTEM_ERROR = 128
 RASCAL_BUFFER_SIZE_ERROR = 254
 RASCAL_INTERNAL_ERROR = 255
@@ -41,6 +42,14 @@ class rascal_indexes_kind(enum.Enum):
     RASCAL_INDEXES_GRADIENT_SAMPLES = 2
 
 
+class rascal_calculation_plan_t(ctypes.Structure):
+    pass
+
+
+class rascal_calculation_t(ctypes.Structure):
+    pass
+
+
 class rascal_calculator_t(ctypes.Structure):
     pass
 
@@ -49,6 +58,18 @@ class rascal_descriptor_t(ctypes.Structure):
     pass
 
 
+class rascal_descriptor_f32_t(ctypes.Structure):
+    pass
+
+
+class rascal_mapped_descriptor_t(ctypes.Structure):
+    pass
+
+
+class rascal_trajectory_chunks_t(ctypes.Structure):
+    pass
+
+
 class rascal_pair_t(ctypes.Structure):
     _fields_ = [
         ("first", c_uintptr_t),
@@ -58,6 +79,18 @@ class rascal_pair_t(ctypes.Structure):
     ]
 
 
+class rascal_system_data_t(ctypes.Structure):
+    _fields_ = [
+        ("generation", ctypes.c_uint64),
+        ("species", POINTER(ctypes.c_int32)),
+        ("positions", POINTER(ctypes.c_double)),
+        ("pairs", POINTER(rascal_pair_t)),
+        ("pairs_count", c_uintptr_t),
+        ("center_pairs", POINTER(rascal_pair_t)),
+        ("center_offsets", POINTER(c_uintptr_t)),
+    ]
+
+
 class rascal_system_t(ctypes.Structure):
     _fields_ = [
         ("user_data", ctypes.c_void_p),
@@ -68,6 +101,7 @@ class rascal_system_t(ctypes.Structure):
         ("compute_neighbors", CFUNCTYPE(rascal_status_t, ctypes.c_void_p, ctypes.c_double)),
         ("pairs", CFUNCTYPE(rascal_status_t, ctypes.c_void_p, POINTER(ndpointer(rascal_pair_t, flags='C_CONTIGUOUS')), POINTER(c_uintptr_t))),
         ("pairs_containing", CFUNCTYPE(rascal_status_t, ctypes.c_void_p, c_uintptr_t, POINTER(ndpointer(rascal_pair_t, flags='C_CONTIGUOUS')), POINTER(c_uintptr_t))),
+        ("data", CFUNCTYPE(rascal_status_t, ctypes.c_void_p, POINTER(rascal_system_data_t))),
     ]
 
 
@@ -93,6 +127,35 @@ class rascal_calculation_options_t(ctypes.Structure):
         ("use_native_system", ctypes.c_bool),
         ("selected_samples", rascal_indexes_t),
         ("selected_features", rascal_indexes_t),
+        ("reuse_descriptor", ctypes.c_bool),
+    ]
+
+
+rascal_chunk_callback_t = CFUNCTYPE(rascal_status_t, ctypes.c_void_p, c_uintptr_t, POINTER(rascal_descriptor_t))
+rascal_calculation_callback_t = CFUNCTYPE(None, ctypes.c_void_p, rascal_status_t)
+
+
+class rascal_profiling_metrics_t(ctypes.Structure):
+    _fields_ = [
+        ("pairs", ctypes.c_uint64),
+        ("samples", ctypes.c_uint64),
+        ("gradient_samples", ctypes.c_uint64),
+        ("descriptor_bytes", ctypes.c_uint64),
+        ("indexes_bytes", ctypes.c_uint64),
+        ("neighbors_list_builds", ctypes.c_uint64),
+        ("neighbors_list_reuses", ctypes.c_uint64),
+        ("chunks_queue_high_water", ctypes.c_uint64),
+        ("environment_cache_hits", ctypes.c_uint64),
+        ("environment_cache_misses", ctypes.c_uint64),
+        ("parallel_time_ns", ctypes.c_uint64),
+        ("threads_count", c_uintptr_t),
+    ]
+
+
+class rascal_thread_metrics_t(ctypes.Structure):
+    _fields_ = [
+        ("busy_ns", ctypes.c_uint64),
+        ("idle_ns", ctypes.c_uint64),
     ]
 
 
@@ -148,6 +211,17 @@ def setup_functions(lib):
     ]
     lib.rascal_descriptor_gradients.restype = _check_rascal_status_t
 
+    lib.rascal_descriptor_gradients_blocks.argtypes = [
+        POINTER(rascal_descriptor_t),
+        POINTER(POINTER(c_uintptr_t)),
+        POINTER(c_uintptr_t),
+        POINTER(POINTER(ctypes.c_int32)),
+        POINTER(POINTER(ctypes.c_double)),
+        POINTER(c_uintptr_t),
+        POINTER(c_uintptr_t)
+    ]
+    lib.rascal_descriptor_gradients_blocks.restype = _check_rascal_status_t
+
     lib.rascal_descriptor_indexes.argtypes = [
         POINTER(rascal_descriptor_t),
         ctypes.c_int,
@@ -175,6 +249,103 @@ def setup_functions(lib):
     ]
     lib.rascal_descriptor_densify_values.restype = _check_rascal_status_t
 
+    lib.rascal_descriptor_save.argtypes = [
+        POINTER(rascal_descriptor_t),
+        POINTER(rascal_calculator_t),
+        ctypes.c_char_p
+    ]
+    lib.rascal_descriptor_save.restype = _check_rascal_status_t
+
+    lib.rascal_mapped_descriptor_open.argtypes = [
+        ctypes.c_char_p
+    ]
+    lib.rascal_mapped_descriptor_open.restype = POINTER(rascal_mapped_descriptor_t)
+
+    lib.rascal_mapped_descriptor_free.argtypes = [
+        POINTER(rascal_mapped_descriptor_t)
+    ]
+    lib.rascal_mapped_descriptor_free.restype = _check_rascal_status_t
+
+    lib.rascal_mapped_descriptor_name.argtypes = [
+        POINTER(rascal_mapped_descriptor_t),
+        ctypes.c_char_p,
+        c_uintptr_t
+    ]
+    lib.rascal_mapped_descriptor_name.restype = _check_rascal_status_t
+
+    lib.rascal_mapped_descriptor_parameters.argtypes = [
+        POINTER(rascal_mapped_descriptor_t),
+        ctypes.c_char_p,
+        c_uintptr_t
+    ]
+    lib.rascal_mapped_descriptor_parameters.restype = _check_rascal_status_t
+
+    lib.rascal_mapped_descriptor_values.argtypes = [
+        POINTER(rascal_mapped_descriptor_t),
+        POINTER(POINTER(ctypes.c_double)),
+        POINTER(c_uintptr_t),
+        POINTER(c_uintptr_t)
+    ]
+    lib.rascal_mapped_descriptor_values.restype = _check_rascal_status_t
+
+    lib.rascal_mapped_descriptor_gradients.argtypes = [
+        POINTER(rascal_mapped_descriptor_t),
+        POINTER(POINTER(ctypes.c_double)),
+        POINTER(c_uintptr_t),
+        POINTER(c_uintptr_t)
+    ]
+    lib.rascal_mapped_descriptor_gradients.restype = _check_rascal_status_t
+
+    lib.rascal_mapped_descriptor_indexes.argtypes = [
+        POINTER(rascal_mapped_descriptor_t),
+        ctypes.c_int,
+        POINTER(rascal_indexes_t)
+    ]
+    lib.rascal_mapped_descriptor_indexes.restype = _check_rascal_status_t
+
+    lib.rascal_mapped_descriptor_densify.argtypes = [
+        POINTER(rascal_mapped_descriptor_t),
+        POINTER(ctypes.c_char_p),
+        c_uintptr_t,
+        POINTER(ctypes.c_int32),
+        c_uintptr_t,
+        POINTER(rascal_descriptor_t)
+    ]
+    lib.rascal_mapped_descriptor_densify.restype = _check_rascal_status_t
+
+    lib.rascal_descriptor_to_f32.argtypes = [
+        POINTER(rascal_descriptor_t)
+    ]
+    lib.rascal_descriptor_to_f32.restype = POINTER(rascal_descriptor_f32_t)
+
+    lib.rascal_descriptor_f32_free.argtypes = [
+        POINTER(rascal_descriptor_f32_t)
+    ]
+    lib.rascal_descriptor_f32_free.restype = _check_rascal_status_t
+
+    lib.rascal_descriptor_f32_values.argtypes = [
+        POINTER(rascal_descriptor_f32_t),
+        POINTER(POINTER(ctypes.c_float)),
+        POINTER(c_uintptr_t),
+        POINTER(c_uintptr_t)
+    ]
+    lib.rascal_descriptor_f32_values.restype = _check_rascal_status_t
+
+    lib.rascal_descriptor_f32_gradients.argtypes = [
+        POINTER(rascal_descriptor_f32_t),
+        POINTER(POINTER(ctypes.c_float)),
+        POINTER(c_uintptr_t),
+        POINTER(c_uintptr_t)
+    ]
+    lib.rascal_descriptor_f32_gradients.restype = _check_rascal_status_t
+
+    lib.rascal_descriptor_f32_indexes.argtypes = [
+        POINTER(rascal_descriptor_f32_t),
+        ctypes.c_int,
+        POINTER(rascal_indexes_t)
+    ]
+    lib.rascal_descriptor_f32_indexes.restype = _check_rascal_status_t
+
     lib.rascal_calculator.argtypes = [
         ctypes.c_char_p,
         ctypes.c_char_p
@@ -215,6 +386,96 @@ def setup_functions(lib):
     ]
     lib.rascal_calculator_compute.restype = _check_rascal_status_t
 
+    lib.rascal_calculators_compute.argtypes = [
+        POINTER(POINTER(rascal_calculator_t)),
+        POINTER(POINTER(rascal_descriptor_t)),
+        c_uintptr_t,
+        POINTER(rascal_system_t),
+        c_uintptr_t,
+        rascal_calculation_options_t
+    ]
+    lib.rascal_calculators_compute.restype = _check_rascal_status_t
+
+    lib.rascal_calculation_plan.argtypes = [
+        POINTER(rascal_calculator_t),
+        POINTER(rascal_system_t),
+        c_uintptr_t,
+        rascal_calculation_options_t
+    ]
+    lib.rascal_calculation_plan.restype = POINTER(rascal_calculation_plan_t)
+
+    lib.rascal_calculation_plan_free.argtypes = [
+        POINTER(rascal_calculation_plan_t)
+    ]
+    lib.rascal_calculation_plan_free.restype = _check_rascal_status_t
+
+    lib.rascal_calculator_compute_with_plan.argtypes = [
+        POINTER(rascal_calculator_t),
+        POINTER(rascal_descriptor_t),
+        POINTER(rascal_system_t),
+        c_uintptr_t,
+        POINTER(rascal_calculation_plan_t)
+    ]
+    lib.rascal_calculator_compute_with_plan.restype = _check_rascal_status_t
+
+    lib.rascal_calculator_compute_trajectory.argtypes = [
+        POINTER(rascal_calculator_t),
+        ctypes.c_char_p,
+        c_uintptr_t,
+        rascal_calculation_options_t,
+        rascal_chunk_callback_t,
+        ctypes.c_void_p
+    ]
+    lib.rascal_calculator_compute_trajectory.restype = _check_rascal_status_t
+
+    lib.rascal_trajectory_chunks.argtypes = [
+        ctypes.c_char_p,
+        c_uintptr_t
+    ]
+    lib.rascal_trajectory_chunks.restype = POINTER(rascal_trajectory_chunks_t)
+
+    lib.rascal_trajectory_chunks_free.argtypes = [
+        POINTER(rascal_trajectory_chunks_t)
+    ]
+    lib.rascal_trajectory_chunks_free.restype = _check_rascal_status_t
+
+    lib.rascal_trajectory_chunks_compute_next.argtypes = [
+        POINTER(rascal_trajectory_chunks_t),
+        POINTER(rascal_calculator_t),
+        POINTER(rascal_descriptor_t),
+        rascal_calculation_options_t,
+        POINTER(c_uintptr_t),
+        POINTER(ctypes.c_bool)
+    ]
+    lib.rascal_trajectory_chunks_compute_next.restype = _check_rascal_status_t
+
+    lib.rascal_calculator_compute_submit.argtypes = [
+        POINTER(rascal_calculator_t),
+        POINTER(rascal_descriptor_t),
+        POINTER(rascal_system_t),
+        c_uintptr_t,
+        rascal_calculation_options_t,
+        rascal_calculation_callback_t,
+        ctypes.c_void_p
+    ]
+    lib.rascal_calculator_compute_submit.restype = POINTER(rascal_calculation_t)
+
+    lib.rascal_calculation_poll.argtypes = [
+        POINTER(rascal_calculation_t),
+        POINTER(ctypes.c_bool)
+    ]
+    lib.rascal_calculation_poll.restype = _check_rascal_status_t
+
+    lib.rascal_calculation_wait.argtypes = [
+        POINTER(rascal_calculation_t)
+    ]
+    lib.rascal_calculation_wait.restype = _check_rascal_status_t
+
+    lib.rascal_calculation_free.argtypes = [
+        POINTER(rascal_calculation_t)
+    ]
+    lib.rascal_calculation_free.restype = _check_rascal_status_t
+
     lib.rascal_profiling_clear.argtypes = [
         
     ]
@@ -231,3 +492,21 @@ def setup_functions(lib):
         c_uintptr_t
     ]
     lib.rascal_profiling_get.restype = _check_rascal_status_t
+
+    lib.rascal_profiling_metrics.argtypes = [
+        POINTER(rascal_profiling_metrics_t),
+        POINTER(rascal_thread_metrics_t),
+        c_uintptr_t
+    ]
+    lib.rascal_profiling_metrics.restype = _check_rascal_status_t
+
+    lib.rascal_set_num_threads.argtypes = [
+        c_uintptr_t,
+        ctypes.c_bool
+    ]
+    lib.rascal_set_num_threads.restype = _check_rascal_status_t
+
+    lib.rascal_get_num_threads.argtypes = [
+        POINTER(c_uintptr_t)
+    ]
+    lib.rascal_get_num_threads.restype = _check_rascal_status_t
@@ -2,7 +2,13 @@
 import ctypes
 import json
 
-from ._rascaline import c_uintptr_t, rascal_calculation_options_t, rascal_system_t
+from ._rascaline import (
+    c_uintptr_t,
+    rascal_calculation_options_t,
+    rascal_calculator_t,
+    rascal_descriptor_t,
+    rascal_system_t,
+)
 from .clib import _get_library
 from .descriptor import Descriptor, Indexes
 from .status import _check_rascal_pointer
@@ -211,6 +217,51 @@ class CalculatorBase:
         return descriptor
 
 
+def compute_all(calculators, systems, use_native_system=True):
+    """Run the calculations of all the ``calculators`` on the same ``systems``.
+
+    This runs all calculations in a single pass, sharing the neighbors lists
+    between calculators using the same cutoff, and only computing once the
+    descriptors used as input by other calculators (for example the spherical
+    expansion used by a SOAP power spectrum with the same parameters). All
+    calculators compute their full descriptor.
+
+    :param calculators: list of calculators to run
+    :param systems: single system or list of systems on which to run the
+                    calculation, see :py:func:`CalculatorBase.compute`.
+    :param bool use_native_system: defaults to ``True``. If ``True``, copy
+        data from the ``systems`` into Rust ``SimpleSystem`` once for all
+        calculators.
+
+    :return: a list containing the descriptor computed by each calculator
+    """
+    lib = _get_library()
+    descriptors = [Descriptor() for _ in calculators]
+
+    c_calculators = (ctypes.POINTER(rascal_calculator_t) * len(calculators))(
+        *list(calculator._as_parameter_ for calculator in calculators)
+    )
+    c_descriptors = (ctypes.POINTER(rascal_descriptor_t) * len(descriptors))(
+        *list(descriptor._as_parameter_ for descriptor in descriptors)
+    )
+
+    c_systems = _convert_systems(systems)
+    c_options, _, _ = _options_to_c(
+        use_native_system=use_native_system,
+        samples=None,
+        features=None,
+    )
+    lib.rascal_calculators_compute(
+        c_calculators,
+        c_descriptors,
+        len(calculators),
+        c_systems,
+        c_systems._length_,
+        c_options,
+    )
+    return descriptors
+
+
 class DummyCalculator(CalculatorBase):
     def __init__(self, cutoff, delta, name, gradients):
         parameters = {
@@ -316,6 +367,7 @@ class SoapPowerSpectrum(CalculatorBase):
         gradients,
         cutoff_function,
         radial_scaling=None,
+        deduplicate_environments=None,
     ):
         parameters = {
             "cutoff": cutoff,
@@ -330,4 +382,7 @@ class SoapPowerSpectrum(CalculatorBase):
         if radial_scaling is not None:
             parameters["radial_scaling"] = radial_scaling
 
+        if deduplicate_environments is not None:
+            parameters["deduplicate_environments"] = deduplicate_environments
+
         super().__init__("soap_power_spectrum", parameters)
@@ -1,4 +1,7 @@
 # -*- coding: utf-8 -*-
+import ctypes
+
+from ._rascaline import rascal_profiling_metrics_t, rascal_thread_metrics_t
 from .clib import _get_library
 from .utils import _call_with_growing_buffer
 
@@ -12,7 +15,8 @@ class Profiler:
 
     The profiling code collects the total time spent inside the most important
     functions, as well as the function call graph (which function called which
-    other function).
+    other function). It also collects counters on the calculations, available
+    with :py:func:`Profiler.metrics`.
 
     .. code-block:: python
 
@@ -56,3 +60,50 @@ class Profiler:
                 "short_table".encode("utf8"), b, s
             )
         )
+
+    def as_metrics_json(self):
+        """Get the counters described in :py:func:`Profiler.metrics` as JSON."""
+        return _call_with_growing_buffer(
+            lambda b, s: self._lib.rascal_profiling_get("metrics".encode("utf8"), b, s)
+        )
+
+    def metrics(self):
+        """
+        Get the counters collected during the calculations as a dictionary.
+
+        The dictionary contains the number of ``pairs``, ``samples`` and
+        ``gradient_samples`` processed by the calculators; the memory used by
+        the descriptors data (``descriptor_bytes``) and indexes
+        (``indexes_bytes``); the number of neighbors lists created
+        (``neighbors_list_builds``) and re-used (``neighbors_list_reuses``);
+        the largest number of trajectory chunks read ahead of the calculation
+        (``chunks_queue_high_water``); the number of atomic environments copied
+        from an identical environment (``environment_cache_hits``) or computed
+        (``environment_cache_misses``) when deduplicating environments; the
+        wall time spent in parallel sections (``parallel_time_ns``) and a list
+        of ``threads``, containing the time each worker thread spent working
+        (``busy_ns``) or waiting (``idle_ns``) inside these sections.
+        """
+        metrics = rascal_profiling_metrics_t()
+        self._lib.rascal_profiling_metrics(metrics, None, 0)
+
+        threads = (rascal_thread_metrics_t * metrics.threads_count)()
+        if metrics.threads_count != 0:
+            count = metrics.threads_count
+            self._lib.rascal_profiling_metrics(
+                metrics,
+                ctypes.cast(threads, ctypes.POINTER(rascal_thread_metrics_t)),
+                count,
+            )
+            threads = threads[: min(count, metrics.threads_count)]
+
+        result = {
+            name: getattr(metrics, name)
+            for name, _ in rascal_profiling_metrics_t._fields_
+            if name != "threads_count"
+        }
+        result["threads"] = [
+            {"busy_ns": thread.busy_ns, "idle_ns": thread.idle_ns}
+            for thread in threads
+        ]
+        return result
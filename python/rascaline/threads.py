@@ -0,0 +1,27 @@
+# -*- coding: utf-8 -*-
+import ctypes
+
+from ._rascaline import c_uintptr_t
+from .clib import _get_library
+
+
+def set_num_threads(num_threads, pin_threads=False):
+    """Use ``num_threads`` threads for all the parallel calculations.
+
+    The threads are created once in this function and re-used for all
+    subsequent calculations. If ``num_threads`` is 0, the default number of
+    threads (from the ``RAYON_NUM_THREADS`` environment variable or the number
+    of CPU cores) is used.
+
+    If ``pin_threads`` is ``True``, each thread is bound to a single CPU, taken
+    from the CPUs this process is allowed to run on, in order of NUMA node.
+    Pinning threads is only supported on Linux.
+    """
+    _get_library().rascal_set_num_threads(num_threads, pin_threads)
+
+
+def get_num_threads():
+    """Get the number of threads used for the parallel calculations."""
+    num_threads = c_uintptr_t()
+    _get_library().rascal_get_num_threads(ctypes.byref(num_threads))
+    return num_threads.value
@@ -3,7 +3,7 @@ import unittest
 
 import numpy as np
 
-from rascaline import Indexes, RascalError, SortedDistances
+from rascaline import Indexes, RascalError, SortedDistances, compute_all
 from rascaline.calculators import DummyCalculator
 
 from test_systems import TestSystem
@@ -271,6 +271,21 @@ class TestDummyCalculator(unittest.TestCase):
             "of the features of this calculator",
         )
 
+    def test_compute_all(self):
+        system = TestSystem()
+        first = DummyCalculator(cutoff=3.2, delta=2, name="", gradients=True)
+        second = DummyCalculator(cutoff=3.2, delta=5, name="", gradients=False)
+
+        descriptors = compute_all([first, second], system, use_native_system=False)
+        self.assertEqual(len(descriptors), 2)
+
+        expected = first.compute(system, use_native_system=False)
+        self.assertTrue(np.all(descriptors[0].values == expected.values))
+        self.assertTrue(np.all(descriptors[0].gradients == expected.gradients))
+
+        expected = second.compute(system, use_native_system=False)
+        self.assertTrue(np.all(descriptors[1].values == expected.values))
+
     def test_features_count(self):
         calculator = DummyCalculator(cutoff=3.2, delta=2, name="", gradients=True)
         self.assertEqual(calculator.features_count(), 2)
@@ -16,3 +16,12 @@ class TestCMakePrefixPath(unittest.TestCase):
         self.assertTrue(
             os.path.isfile(os.path.join(cmake, "rascaline-config-version.cmake"))
         )
+
+
+class TestThreads(unittest.TestCase):
+    def test_set_num_threads(self):
+        rascaline.set_num_threads(2)
+        self.assertEqual(rascaline.get_num_threads(), 2)
+
+        rascaline.set_num_threads(0)
+        self.assertGreater(rascaline.get_num_threads(), 0)
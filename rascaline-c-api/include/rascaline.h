@@ -38,6 +38,11 @@
  */
 #define RASCAL_CHEMFILES_ERROR 4
 
+/**
+ * Status code used for error while reading or writing files
+ */
+#define RASCAL_IO_ERROR 5
+
 /**
  * Status code used for errors coming from the system implementation if we
  * don't have a more specific status
@@ -106,6 +111,17 @@ typedef enum rascal_indexes_kind {
   RASCAL_INDEXES_GRADIENT_SAMPLES = 2,
 } rascal_indexes_kind;
 
+/**
+ * Opaque type representing a `CalculationPlan`
+ */
+typedef struct rascal_calculation_plan_t rascal_calculation_plan_t;
+
+/**
+ * Opaque type representing a calculation running in the background, created
+ * with `rascal_calculator_compute_submit`.
+ */
+typedef struct rascal_calculation_t rascal_calculation_t;
+
 /**
  * Opaque type representing a `Calculator`
  */
@@ -116,6 +132,24 @@ typedef struct rascal_calculator_t rascal_calculator_t;
  */
 typedef struct rascal_descriptor_t rascal_descriptor_t;
 
+/**
+ * Opaque type representing a `DescriptorF32`, i.e. a descriptor with values
+ * and gradients stored in single precision.
+ */
+typedef struct rascal_descriptor_f32_t rascal_descriptor_f32_t;
+
+/**
+ * Opaque type representing a `MappedDescriptor`, i.e. a read-only descriptor
+ * stored in a memory-mapped file.
+ */
+typedef struct rascal_mapped_descriptor_t rascal_mapped_descriptor_t;
+
+/**
+ * Opaque type representing a trajectory being read in chunks, see
+ * `rascal_trajectory_chunks`.
+ */
+typedef struct rascal_trajectory_chunks_t rascal_trajectory_chunks_t;
+
 /**
  * Status type returned by all functions in the C API.
  *
@@ -160,6 +194,62 @@ typedef struct rascal_pair_t {
   double vector[3];
 } rascal_pair_t;
 
+/**
+ * Borrowed pointers to the data of a `rascal_system_t`, stored in contiguous
+ * arrays. This allows rascaline to access the data of a system directly,
+ * without going through the function pointers in `rascal_system_t` for each
+ * access.
+ *
+ * All the pointers are optional, and can be set to `NULL` to let rascaline
+ * use the corresponding function in `rascal_system_t` instead. The data
+ * should stay valid and unchanged until the next call to
+ * `rascal_system_t::compute_neighbors`, or the end of the calculation.
+ */
+typedef struct rascal_system_data_t {
+  /**
+   * Generation counter for the data. This must change every time the
+   * content or location in memory of any of the arrays below changes.
+   * rascaline uses this value to know when it can re-use data it already
+   * validated.
+   */
+  uint64_t generation;
+  /**
+   * Pointer to the first element of a contiguous array containing the
+   * atomic species, with `rascal_system_t::size()` elements.
+   */
+  const int32_t *species;
+  /**
+   * Pointer to the first element of a contiguous array containing the
+   * atomic cartesian coordinates, with `3 x rascal_system_t::size()`
+   * elements.
+   */
+  const double *positions;
+  /**
+   * Pointer to the first element of a contiguous array containing all
+   * pairs in this system, following the same rules as
+   * `rascal_system_t::pairs`.
+   */
+  const struct rascal_pair_t *pairs;
+  /**
+   * Number of pairs in `pairs`
+   */
+  uintptr_t pairs_count;
+  /**
+   * Pointer to the first element of a contiguous array containing the
+   * pairs classified by center, following the same rules as
+   * `rascal_system_t::pairs_containing`. The pairs containing the atom
+   * `center` are given by `center_pairs[center_offsets[center]]` up to
+   * `center_pairs[center_offsets[center + 1]]` (excluded).
+   */
+  const struct rascal_pair_t *center_pairs;
+  /**
+   * Pointer to the first element of a contiguous array containing the
+   * offsets of the pairs for each center in `center_pairs`, with
+   * `rascal_system_t::size() + 1` elements.
+   */
+  const uintptr_t *center_offsets;
+} rascal_system_data_t;
+
 /**
  * A `rascal_system_t` deals with the storage of atoms and related information,
  * as well as the computation of neighbor lists.
@@ -241,6 +331,14 @@ typedef struct rascal_system_t {
    * `pairs_containing(j)`.
    */
   rascal_status_t (*pairs_containing)(const void *user_data, uintptr_t center, const struct rascal_pair_t **pairs, uintptr_t *count);
+  /**
+   * This function is optional and can be `NULL`. If set, it should fill
+   * `*data` with borrowed pointers to the data of this system, which
+   * rascaline will then use instead of calling the functions above. This
+   * function is called once at the beginning of a calculation, and again
+   * after each call to `compute_neighbors`.
+   */
+  rascal_status_t (*data)(const void *user_data, struct rascal_system_data_t *data);
 } rascal_system_t;
 
 /**
@@ -314,8 +412,129 @@ typedef struct rascal_calculation_options_t {
    * features.
    */
   struct rascal_indexes_t selected_features;
+  /**
+   * Re-use the samples, gradients samples and features already stored in
+   * the descriptor if they were created by a previous call to
+   * `rascal_calculator_compute` with the same calculator, the same selected
+   * samples and features, and systems with the same atoms and neighbors
+   * pairs. The values and gradients are then set to zero in place instead of
+   * being re-allocated.
+   */
+  bool reuse_descriptor;
 } rascal_calculation_options_t;
 
+/**
+ * Callback function type used by `rascal_calculator_compute_trajectory`,
+ * called after the calculation of each chunk of a trajectory.
+ *
+ * The first argument is the `user_data` pointer given to
+ * `rascal_calculator_compute_trajectory`, the second argument is the index of
+ * the first structure of this chunk in the trajectory, and the third argument
+ * is the descriptor containing the data for this chunk. The descriptor is
+ * re-used for the next chunk, and should not be freed or stored by the
+ * callback.
+ *
+ * The callback should return `RASCAL_SUCCESS` to continue the calculation,
+ * or any other value to stop it. In the latter case, the value is returned by
+ * `rascal_calculator_compute_trajectory`.
+ */
+typedef rascal_status_t (*rascal_chunk_callback_t)(void *user_data,
+                                                   uintptr_t first_structure,
+                                                   struct rascal_descriptor_t *descriptor);
+
+/**
+ * Callback function type used by `rascal_calculator_compute_submit`, called
+ * from one of rascaline's threads once an asynchronous calculation is
+ * finished.
+ *
+ * The first argument is the `user_data` pointer given to
+ * `rascal_calculator_compute_submit`, and the second argument is the status
+ * of the calculation. If the status is not `RASCAL_SUCCESS`, the callback can
+ * use `rascal_last_error()` to get the full error message. The calculator and
+ * the descriptor given to `rascal_calculator_compute_submit` can be used
+ * again (including freed) from the callback.
+ */
+typedef void (*rascal_calculation_callback_t)(void *user_data, rascal_status_t status);
+
+/**
+ * Counters collected during the calculations when profiling is enabled, see
+ * `rascal_profiling_metrics`.
+ */
+typedef struct rascal_profiling_metrics_t {
+  /**
+   * Number of pairs processed by the spherical expansion. Each pair is
+   * counted once for each of the two atoms in the pair.
+   */
+  uint64_t pairs;
+  /**
+   * Number of samples (i.e. rows in the values array) computed by the
+   * calculators, including intermediary calculators
+   */
+  uint64_t samples;
+  /**
+   * Number of gradients samples (i.e. rows in the gradients array) computed
+   * by the calculators, including intermediary calculators
+   */
+  uint64_t gradient_samples;
+  /**
+   * Memory used by the values and gradients arrays of descriptors, in bytes
+   */
+  uint64_t descriptor_bytes;
+  /**
+   * Memory used by the samples, gradients samples and features indexes of
+   * descriptors, in bytes
+   */
+  uint64_t indexes_bytes;
+  /**
+   * Number of neighbors lists created from scratch
+   */
+  uint64_t neighbors_list_builds;
+  /**
+   * Number of times an existing neighbors list was re-used
+   */
+  uint64_t neighbors_list_reuses;
+  /**
+   * Largest number of chunks read ahead of the calculation when streaming
+   * trajectories
+   */
+  uint64_t chunks_queue_high_water;
+  /**
+   * Number of atomic environments for which the power spectrum was copied
+   * from an identical environment, when deduplicating environments
+   */
+  uint64_t environment_cache_hits;
+  /**
+   * Number of atomic environments for which the power spectrum was
+   * computed, when deduplicating environments
+   */
+  uint64_t environment_cache_misses;
+  /**
+   * Total wall time spent in the parallel sections of the calculators, in
+   * nanoseconds
+   */
+  uint64_t parallel_time_ns;
+  /**
+   * Number of worker threads in the thread pool, with busy/idle time data
+   */
+  uintptr_t threads_count;
+} rascal_profiling_metrics_t;
+
+/**
+ * Busy and idle time of a single worker thread, see
+ * `rascal_profiling_metrics`.
+ */
+typedef struct rascal_thread_metrics_t {
+  /**
+   * Time spent working on parallel tasks, in nanoseconds
+   */
+  uint64_t busy_ns;
+  /**
+   * Time spent inside parallel sections without working on a task, in
+   * nanoseconds
+   */
+  uint64_t idle_ns;
+} rascal_thread_metrics_t;
+
 #ifdef __cplusplus
 extern "C" {
 #endif // __cplusplus
@@ -459,6 +678,52 @@ rascal_status_t rascal_descriptor_gradients(struct rascal_descriptor_t *descript
                                             uintptr_t *gradient_samples,
                                             uintptr_t *features);
 
+/**
+ * Get a block-sparse view of the gradients stored inside this descriptor
+ * after a call to `rascal_calculator_compute`, if any.
+ *
+ * The gradients are organized in blocks of 3 x `features` values (one row for
+ * each of the x/y/z cartesian components), each block containing the
+ * gradients of a given sample with respect to the position of a given atom.
+ * The blocks for sample `i` are `(*offsets)[i]` to `(*offsets)[i + 1]`
+ * (excluded), and the gradients in block `b` are taken with respect to the
+ * position of atom `(*atoms)[b]`. `*data` points to the first element of a
+ * row-major 3D array of shape `*blocks` x 3 x `*features` containing the
+ * gradients. This array shares memory with the one given by
+ * `rascal_descriptor_gradients`.
+ *
+ * `*offsets` and `*atoms` are only valid until the next call to this function
+ * or to `rascal_calculator_compute` with the same `descriptor`.
+ *
+ * If this descriptor does not contain gradient data, all pointers are set to
+ * `NULL` and all sizes to 0.
+ *
+ * @param descriptor pointer to an existing descriptor
+ * @param offsets pointer to a pointer to an integer, will be set to the
+ *                address of an array containing `*samples + 1` offsets
+ * @param samples pointer to a single integer, will be set to the number of
+ *                samples in this descriptor
+ * @param atoms pointer to a pointer to a 32-bit integer, will be set to the
+ *              address of an array containing `*blocks` atomic indexes
+ * @param data pointer to a pointer to a double, will be set to the address of
+ *             the first element in the gradients array
+ * @param blocks pointer to a single integer, will be set to the total number
+ *               of blocks
+ * @param features pointer to a single integer, will be set to the number of
+ *                 features
+ *
+ * @returns The status code of this operation. If the status is not
+ *          `RASCAL_SUCCESS`, you can use `rascal_last_error()` to get the full
+ *          error message.
+ */
+rascal_status_t rascal_descriptor_gradients_blocks(struct rascal_descriptor_t *descriptor,
+                                                   const uintptr_t **offsets,
+                                                   uintptr_t *samples,
+                                                   const int32_t **atoms,
+                                                   double **data,
+                                                   uintptr_t *blocks,
+                                                   uintptr_t *features);
+
 /**
  * Get the values associated with one of the `indexes` in the given
  * `descriptor`.
@@ -579,6 +844,308 @@ rascal_status_t rascal_descriptor_densify_values(struct rascal_descriptor_t *des
                                                  struct rascal_densified_position_t **densified_positions,
                                                  uintptr_t *densified_positions_count);
 
+/**
+ * Save the given `descriptor` to the file at `path`, in rascaline's own
+ * binary format. The name and parameters of the `calculator` used to create
+ * the descriptor are stored alongside the values, gradients and indexes.
+ *
+ * The file can then be opened with `rascal_mapped_descriptor_open`.
+ *
+ * @param descriptor pointer to an existing descriptor
+ * @param calculator pointer to the calculator used to create the descriptor
+ * @param path path of the file to write to in the local filesystem, as a
+ *             NULL-terminated string
+ *
+ * @returns The status code of this operation. If the status is not
+ *          `RASCAL_SUCCESS`, you can use `rascal_last_error()` to get the full
+ *          error message.
+ */
+rascal_status_t rascal_descriptor_save(const struct rascal_descriptor_t *descriptor,
+                                       const struct rascal_calculator_t *calculator,
+                                       const char *path);
+
+/**
+ * Open the descriptor file at `path` (created by `rascal_descriptor_save`) as
+ * a read-only memory map. The values and gradients are read directly from
+ * the file when needed instead of being copied in memory.
+ *
+ * All memory allocated by this function can be released using
+ * `rascal_mapped_descriptor_free`.
+ *
+ * @param path path of the file to read from in the local filesystem, as a
+ *             NULL-terminated string
+ *
+ * @returns A pointer to the newly allocated mapped descriptor, or a `NULL`
+ *          pointer in case of error. In case of error, you can use
+ *          `rascal_last_error()` to get the error message.
+ */
+struct rascal_mapped_descriptor_t *rascal_mapped_descriptor_open(const char *path);
+
+/**
+ * Free the memory associated with a `descriptor` previously created with
+ * `rascal_mapped_descriptor_open`, and close the corresponding file.
+ *
+ * If `descriptor` is `NULL`, this function does nothing.
+ *
+ * @param descriptor pointer to an existing mapped descriptor, or `NULL`
+ *
+ * @returns The status code of this operation. If the status is not
+ *          `RASCAL_SUCCESS`, you can use `rascal_last_error()` to get the
+ *          full error message.
+ */
+rascal_status_t rascal_mapped_descriptor_free(struct rascal_mapped_descriptor_t *descriptor);
+
+/**
+ * Get a copy of the name of the calculator used to create this `descriptor`
+ * in the `name` buffer of size `bufflen`.
+ *
+ * `name` will be NULL-terminated by this function. If the buffer is too small
+ * to fit the whole name, this function will return
+ * `RASCAL_BUFFER_SIZE_ERROR`
+ *
+ * @param descriptor pointer to an existing mapped descriptor
+ * @param name string buffer to fill with the calculator name
+ * @param bufflen number of characters available in the buffer
+ *
+ * @returns The status code of this operation. If the status is not
+ *          `RASCAL_SUCCESS`, you can use `rascal_last_error()` to get the full
+ *          error message.
+ */
+rascal_status_t rascal_mapped_descriptor_name(const struct rascal_mapped_descriptor_t *descriptor,
+                                              char *name,
+                                              uintptr_t bufflen);
+
+/**
+ * Get a copy of the parameters of the calculator used to create this
+ * `descriptor` in the `parameters` buffer of size `bufflen`.
+ *
+ * `parameters` will be NULL-terminated by this function. If the buffer is too
+ * small to fit the whole parameters, this function will return
+ * `RASCAL_BUFFER_SIZE_ERROR`.
+ *
+ * @param descriptor pointer to an existing mapped descriptor
+ * @param parameters string buffer to fill with the calculator parameters
+ * @param bufflen number of characters available in the buffer
+ *
+ * @returns The status code of this operation. If the status is not
+ *          `RASCAL_SUCCESS`, you can use `rascal_last_error()` to get the full
+ *          error message.
+ */
+rascal_status_t rascal_mapped_descriptor_parameters(const struct rascal_mapped_descriptor_t *descriptor,
+                                                    char *parameters,
+                                                    uintptr_t bufflen);
+
+/**
+ * Get the values stored inside this mapped `descriptor`.
+ *
+ * This function sets `*data` to a pointer containing the address of first
+ * element of the **read only** 2D array containing the values, `*samples` to
+ * the size of the first axis of this array and `*features` to the size of the
+ * second axis of the array. The array is stored using a row-major layout.
+ *
+ * @param descriptor pointer to an existing mapped descriptor
+ * @param data pointer to a pointer to a double, will be set to the address of
+ *             the first element in the values array
+ * @param samples pointer to a single integer, will be set to the first
+ *                dimension of the values array
+ * @param features pointer to a single integer, will be set to the second
+ *                 dimension of the values array
+ *
+ * @returns The status code of this operation. If the status is not
+ *          `RASCAL_SUCCESS`, you can use `rascal_last_error()` to get the full
+ *          error message.
+ */
+rascal_status_t rascal_mapped_descriptor_values(const struct rascal_mapped_descriptor_t *descriptor,
+                                                const double **data,
+                                                uintptr_t *samples,
+                                                uintptr_t *features);
+
+/**
+ * Get the gradients stored inside this mapped `descriptor`, if any.
+ *
+ * This function sets `*data` to to a pointer containing the address of the
+ * first element of the **read only** 2D array containing the gradients,
+ * `*gradient_samples` to the size of the first axis of this array and
+ * `*features` to the size of the second axis of the array. The array is
+ * stored using a row-major layout.
+ *
+ * If this descriptor does not contain gradient data, `*data` is set to `NULL`,
+ * while `*gradient_samples` and `*features` are set to 0.
+ *
+ * @param descriptor pointer to an existing mapped descriptor
+ * @param data pointer to a pointer to a double, will be set to the address of
+ *             the first element in the gradients array
+ * @param gradient_samples pointer to a single integer, will be set to the first
+ *                         dimension of the gradients array
+ * @param features pointer to a single integer, will be set to the second
+ *                 dimension of the gradients array
+ *
+ * @returns The status code of this operation. If the status is not
+ *          `RASCAL_SUCCESS`, you can use `rascal_last_error()` to get the full
+ *          error message.
+ */
+rascal_status_t rascal_mapped_descriptor_gradients(const struct rascal_mapped_descriptor_t *descriptor,
+                                                   const double **data,
+                                                   uintptr_t *gradient_samples,
+                                                   uintptr_t *features);
+
+/**
+ * Get the values associated with one of the `indexes` in the given mapped
+ * `descriptor`.
+ *
+ * This function behaves like `rascal_descriptor_indexes`, please refer to its
+ * documentation for more information.
+ *
+ * @param descriptor pointer to an existing mapped descriptor
+ * @param kind type of indexes requested
+ * @param indexes pointer to `rascal_indexes_t` that will be filled by this function
+ *
+ * @returns The status code of this operation. If the status is not
+ *          `RASCAL_SUCCESS`, you can use `rascal_last_error()` to get the full
+ *          error message.
+ */
+rascal_status_t rascal_mapped_descriptor_indexes(const struct rascal_mapped_descriptor_t *descriptor,
+                                                 enum rascal_indexes_kind kind,
+                                                 struct rascal_indexes_t *indexes);
+
+/**
+ * Store the data in the mapped `descriptor`, made dense along the given
+ * `variables`, inside the `output` descriptor. The data is read directly from
+ * the file, without creating an intermediary copy of the sparse descriptor.
+ *
+ * This function behaves like `rascal_descriptor_densify`, please refer to its
+ * documentation for more information on the `variables` and `requested`
+ * parameters. If `variables_count` is 0, `output` will contain a copy of the
+ * data in the mapped descriptor.
+ *
+ * @param descriptor pointer to an existing mapped descriptor
+ * @param variables array of NULL-terminated strings containing the names of
+ *                  the variables to make dense
+ * @param variables_count number of elements in the `variables` array
+ * @param requested set of values taken by the variables to use as new
+ *                  features, or `NULL`
+ * @param requested_size number of rows in `requested`
+ * @param output pointer to an existing descriptor, which will be overwritten
+ *               with the new data
+ *
+ * @returns The status code of this operation. If the status is not
+ *          `RASCAL_SUCCESS`, you can use `rascal_last_error()` to get the full
+ *          error message.
+ */
+rascal_status_t rascal_mapped_descriptor_densify(const struct rascal_mapped_descriptor_t *descriptor,
+                                                 const char *const *variables,
+                                                 uintptr_t variables_count,
+                                                 const int32_t *requested,
+                                                 uintptr_t requested_size,
+                                                 struct rascal_descriptor_t *output);
+
+/**
+ * Convert the data in `descriptor` to single precision, creating a new
+ * `rascal_descriptor_f32_t`.
+ *
+ * The data is moved out of `descriptor` and not copied, so `descriptor` will
+ * be empty after a call to this function. It can still be used in another
+ * call to `rascal_calculator_compute`.
+ *
+ * All memory allocated by this function can be released using
+ * `rascal_descriptor_f32_free`.
+ *
+ * @param descriptor pointer to an existing descriptor
+ *
+ * @returns A pointer to the newly allocated single precision descriptor, or
+ *          a `NULL` pointer in case of error. In case of error, you can use
+ *          `rascal_last_error()` to get the error message.
+ */
+struct rascal_descriptor_f32_t *rascal_descriptor_to_f32(struct rascal_descriptor_t *descriptor);
+
+/**
+ * Free the memory associated with a `descriptor` previously created with
+ * `rascal_descriptor_to_f32`.
+ *
+ * If `descriptor` is `NULL`, this function does nothing.
+ *
+ * @param descriptor pointer to an existing single precision descriptor, or
+ *                   `NULL`
+ *
+ * @returns The status code of this operation. If the status is not
+ *          `RASCAL_SUCCESS`, you can use `rascal_last_error()` to get the
+ *          full error message.
+ */
+rascal_status_t rascal_descriptor_f32_free(struct rascal_descriptor_f32_t *descriptor);
+
+/**
+ * Get the single precision values stored inside this `descriptor`.
+ *
+ * This function sets `*data` to a pointer containing the address of first
+ * element of the **read only** 2D array containing the values, `*samples` to
+ * the size of the first axis of this array and `*features` to the size of the
+ * second axis of the array. The array is stored using a row-major layout.
+ *
+ * @param descriptor pointer to an existing single precision descriptor
+ * @param data pointer to a pointer to a float, will be set to the address of
+ *             the first element in the values array
+ * @param samples pointer to a single integer, will be set to the first
+ *                dimension of the values array
+ * @param features pointer to a single integer, will be set to the second
+ *                 dimension of the values array
+ *
+ * @returns The status code of this operation. If the status is not
+ *          `RASCAL_SUCCESS`, you can use `rascal_last_error()` to get the full
+ *          error message.
+ */
+rascal_status_t rascal_descriptor_f32_values(const struct rascal_descriptor_f32_t *descriptor,
+                                             const float **data,
+                                             uintptr_t *samples,
+                                             uintptr_t *features);
+
+/**
+ * Get the single precision gradients stored inside this `descriptor`, if any.
+ *
+ * This function sets `*data` to to a pointer containing the address of the
+ * first element of the **read only** 2D array containing the gradients,
+ * `*gradient_samples` to the size of the first axis of this array and
+ * `*features` to the size of the second axis of the array. The array is
+ * stored using a row-major layout.
+ *
+ * If this descriptor does not contain gradient data, `*data` is set to `NULL`,
+ * while `*gradient_samples` and `*features` are set to 0.
+ *
+ * @param descriptor pointer to an existing single precision descriptor
+ * @param data pointer to a pointer to a float, will be set to the address of
+ *             the first element in the gradients array
+ * @param gradient_samples pointer to a single integer, will be set to the first
+ *                         dimension of the gradients array
+ * @param features pointer to a single integer, will be set to the second
+ *                 dimension of the gradients array
+ *
+ * @returns The status code of this operation. If the status is not
+ *          `RASCAL_SUCCESS`, you can use `rascal_last_error()` to get the full
+ *          error message.
+ */
+rascal_status_t rascal_descriptor_f32_gradients(const struct rascal_descriptor_f32_t *descriptor,
+                                                const float **data,
+                                                uintptr_t *gradient_samples,
+                                                uintptr_t *features);
+
+/**
+ * Get the values associated with one of the `indexes` in the given single
+ * precision `descriptor`.
+ *
+ * This function behaves like `rascal_descriptor_indexes`, please refer to its
+ * documentation for more information.
+ *
+ * @param descriptor pointer to an existing single precision descriptor
+ * @param kind type of indexes requested
+ * @param indexes pointer to `rascal_indexes_t` that will be filled by this function
+ *
+ * @returns The status code of this operation. If the status is not
+ *          `RASCAL_SUCCESS`, you can use `rascal_last_error()` to get the full
+ *          error message.
+ */
+rascal_status_t rascal_descriptor_f32_indexes(const struct rascal_descriptor_f32_t *descriptor,
+                                              enum rascal_indexes_kind kind,
+                                              struct rascal_indexes_t *indexes);
+
 /**
  * Create a new calculator with the given `name` and `parameters`.
  *
@@ -697,7 +1264,292 @@ rascal_status_t rascal_calculator_compute(struct rascal_calculator_t *calculator
                                           struct rascal_calculation_options_t options);
 
 /**
- * Clear all collected profiling data
+ * Run the calculations of all the `calculators` on the same `systems` in a
+ * single pass, storing the data computed by `calculators[i]` in
+ * `descriptors[i]`.
+ *
+ * This shares the copy to native systems and the neighbors lists between
+ * calculators using the same cutoff. If one of the calculators computes a
+ * descriptor used as input by another one (for example a spherical expansion
+ * with the same parameters as a SOAP power spectrum), this descriptor is
+ * only computed once.
+ *
+ * All calculators compute their full descriptor, so `options.selected_samples`
+ * and `options.selected_features` must have their `names` set to `NULL`.
+ *
+ * @param calculators array of pointers to existing, different calculators
+ * @param descriptors array of pointers to existing, different descriptors for
+ *                    data storage, with one descriptor for each calculator
+ * @param count number of calculators and descriptors
+ * @param systems pointer to an array of systems implementation
+ * @param systems_count number of systems in `systems`
+ * @param options options for these calculations
+ *
+ * @returns The status code of this operation. If the status is not
+ *          `RASCAL_SUCCESS`, you can use `rascal_last_error()` to get the full
+ *          error message.
+ */
+rascal_status_t rascal_calculators_compute(struct rascal_calculator_t *const *calculators,
+                                           struct rascal_descriptor_t *const *descriptors,
+                                           uintptr_t count,
+                                           struct rascal_system_t *systems,
+                                           uintptr_t systems_count,
+                                           struct rascal_calculation_options_t options);
+
+/**
+ * Create a new calculation plan for the given `calculator`, `systems` and
+ * `options`.
+ *
+ * The plan contains the samples, gradients samples and features used by the
+ * calculation, and can be used with `rascal_calculator_compute_with_plan` to
+ * run the same calculation multiple times on systems with the same atoms and
+ * neighbors pairs (only the positions of the atoms are allowed to change),
+ * without re-creating these indexes every time.
+ *
+ * All memory allocated by this function can be released using
+ * `rascal_calculation_plan_free`.
+ *
+ * @param calculator pointer to an existing calculator
+ * @param systems pointer to an array of systems implementation
+ * @param systems_count number of systems in `systems`
+ * @param options options for the calculation
+ *
+ * @returns A pointer to the newly allocated plan, or a `NULL` pointer in case
+ *          of error. In case of error, you can use `rascal_last_error()` to
+ *          get the error message.
+ */
+struct rascal_calculation_plan_t *rascal_calculation_plan(struct rascal_calculator_t *calculator,
+                                                          struct rascal_system_t *systems,
+                                                          uintptr_t systems_count,
+                                                          struct rascal_calculation_options_t options);
+
+/**
+ * Free the memory associated with a `plan` previously created with
+ * `rascal_calculation_plan`.
+ *
+ * If `plan` is `NULL`, this function does nothing.
+ *
+ * @param plan pointer to an existing calculation plan, or `NULL`
+ *
+ * @returns The status code of this operation. If the status is not
+ *          `RASCAL_SUCCESS`, you can use `rascal_last_error()` to get the
+ *          full error message.
+ */
+rascal_status_t rascal_calculation_plan_free(struct rascal_calculation_plan_t *plan);
+
+/**
+ * Run a calculation with the given `calculator` on the given `systems`,
+ * storing the resulting data in the `descriptor`, and using the samples,
+ * gradients samples and features from `plan`.
+ *
+ * The systems must contain the same atoms and neighbors pairs as the systems
+ * used to create the plan.
+ *
+ * @param calculator pointer to an existing calculator, the same one used to
+ *                   create the `plan`
+ * @param descriptor pointer to an existing descriptor for data storage
+ * @param systems pointer to an array of systems implementation
+ * @param systems_count number of systems in `systems`
+ * @param plan pointer to an existing calculation plan
+ *
+ * @returns The status code of this operation. If the status is not
+ *          `RASCAL_SUCCESS`, you can use `rascal_last_error()` to get the full
+ *          error message.
+ */
+rascal_status_t rascal_calculator_compute_with_plan(struct rascal_calculator_t *calculator,
+                                                    struct rascal_descriptor_t *descriptor,
+                                                    struct rascal_system_t *systems,
+                                                    uintptr_t systems_count,
+                                                    const struct rascal_calculation_plan_t *plan);
+
+/**
+ * Run a calculation with the given `calculator` on all the structures in the
+ * trajectory file at `path`, reading and computing at most `chunk_size`
+ * structures at a time.
+ *
+ * The file is read with chemfiles in a background thread while the previous
+ * chunk is being computed, and only two chunks are kept in memory at the same
+ * time. After the calculation of each chunk, `callback` is called with the
+ * `user_data`, the index of the first structure of the chunk in the
+ * trajectory and the descriptor for this chunk. The `structure` samples in
+ * the descriptor are relative to the chunk.
+ *
+ * @param calculator pointer to an existing calculator
+ * @param path path of the file to read from in the local filesystem, as a
+ *             NULL-terminated string
+ * @param chunk_size maximal number of structures in each chunk
+ * @param options options for the calculation of each chunk
+ * @param callback function called after the calculation of each chunk
+ * @param user_data pointer passed as the first argument to `callback`
+ *
+ * @returns The status code of this operation. If the status is not
+ *          `RASCAL_SUCCESS`, you can use `rascal_last_error()` to get the full
+ *          error message.
+ */
+rascal_status_t rascal_calculator_compute_trajectory(struct rascal_calculator_t *calculator,
+                                                     const char *path,
+                                                     uintptr_t chunk_size,
+                                                     struct rascal_calculation_options_t options,
+                                                     rascal_chunk_callback_t callback,
+                                                     void *user_data);
+
+/**
+ * Start reading the trajectory file at `path` in chunks of at most
+ * `chunk_size` structures, to be used with
+ * `rascal_trajectory_chunks_compute_next`.
+ *
+ * The file is read with chemfiles in a background thread, which reads the
+ * next chunk while the current one is being computed.
+ *
+ * All memory allocated by this function can be released using
+ * `rascal_trajectory_chunks_free`.
+ *
+ * @param path path of the file to read from in the local filesystem, as a
+ *             NULL-terminated string
+ * @param chunk_size maximal number of structures in each chunk
+ *
+ * @returns A pointer to the newly allocated trajectory chunks, or a `NULL`
+ *          pointer in case of error. In case of error, you can use
+ *          `rascal_last_error()` to get the error message.
+ */
+struct rascal_trajectory_chunks_t *rascal_trajectory_chunks(const char *path, uintptr_t chunk_size);
+
+/**
+ * Free the memory associated with `chunks` previously created with
+ * `rascal_trajectory_chunks`, and stop reading the corresponding file.
+ *
+ * If `chunks` is `NULL`, this function does nothing.
+ *
+ * @param chunks pointer to existing trajectory chunks, or `NULL`
+ *
+ * @returns The status code of this operation. If the status is not
+ *          `RASCAL_SUCCESS`, you can use `rascal_last_error()` to get the
+ *          full error message.
+ */
+rascal_status_t rascal_trajectory_chunks_free(struct rascal_trajectory_chunks_t *chunks);
+
+/**
+ * Run a calculation with the given `calculator` on the next chunk of
+ * structures in `chunks`, storing the resulting data in `descriptor`.
+ *
+ * If there are no more structures in the trajectory, `*done` is set to `true`
+ * and `descriptor` is not modified. Otherwise, `*done` is set to `false` and
+ * `*first_structure` to the index of the first structure of this chunk in
+ * the trajectory. The `structure` samples in the descriptor are relative to
+ * the chunk.
+ *
+ * @param chunks pointer to existing trajectory chunks
+ * @param calculator pointer to an existing calculator
+ * @param descriptor pointer to an existing descriptor for data storage
+ * @param options options for this calculation
+ * @param first_structure pointer to a single integer, will be set to the index
+ *                        of the first structure in this chunk
+ * @param done pointer to a single boolean, will be set to `true` if there
+ *             are no more structures in the trajectory
+ *
+ * @returns The status code of this operation. If the status is not
+ *          `RASCAL_SUCCESS`, you can use `rascal_last_error()` to get the full
+ *          error message.
+ */
+rascal_status_t rascal_trajectory_chunks_compute_next(struct rascal_trajectory_chunks_t *chunks,
+                                                      struct rascal_calculator_t *calculator,
+                                                      struct rascal_descriptor_t *descriptor,
+                                                      struct rascal_calculation_options_t options,
+                                                      uintptr_t *first_structure,
+                                                      bool *done);
+
+/**
+ * Start a calculation with the given `calculator` on the given `systems` in
+ * the background, storing the resulting data in the `descriptor`. The
+ * calculation runs on rascaline's thread pool (see `rascal_set_num_threads`).
+ *
+ * The data from the `systems` is copied before this function returns, so the
+ * systems can be modified or freed as soon as this function returns. This
+ * means `options.use_native_system` is always treated as `true`. The
+ * `calculator` and the `descriptor` are used until the calculation is
+ * finished, and must not be used, modified or freed by the caller before then.
+ *
+ * The calculation is finished once `rascal_calculation_wait` returns,
+ * `rascal_calculation_poll` sets `done` to `true`, or `callback` is called.
+ * The `callback` is optional and can be `NULL`.
+ *
+ * All memory allocated by this function can be released using
+ * `rascal_calculation_free`.
+ *
+ * @param calculator pointer to an existing calculator
+ * @param descriptor pointer to an existing descriptor for data storage
+ * @param systems pointer to an array of systems implementation
+ * @param systems_count number of systems in `systems`
+ * @param options options for this calculation
+ * @param callback function called once the calculation is finished, or
+ *                 `NULL`
+ * @param user_data pointer passed as the first argument to `callback`
+ *
+ * @returns A pointer to the newly allocated calculation handle, or a `NULL`
+ *          pointer in case of error. In case of error, you can use
+ *          `rascal_last_error()` to get the error message.
+ */
+struct rascal_calculation_t *rascal_calculator_compute_submit(struct rascal_calculator_t *calculator,
+                                                              struct rascal_descriptor_t *descriptor,
+                                                              struct rascal_system_t *systems,
+                                                              uintptr_t systems_count,
+                                                              struct rascal_calculation_options_t options,
+                                                              rascal_calculation_callback_t callback,
+                                                              void *user_data);
+
+/**
+ * Check if the given asynchronous `calculation` is finished, without
+ * blocking.
+ *
+ * @param calculation pointer to an existing calculation handle
+ * @param done pointer to a single boolean, will be set to `true` if the
+ *             calculation is finished
+ *
+ * @returns The status code of this operation. If the status is not
+ *          `RASCAL_SUCCESS`, you can use `rascal_last_error()` to get the full
+ *          error message.
+ */
+rascal_status_t rascal_calculation_poll(const struct rascal_calculation_t *calculation, bool *done);
+
+/**
+ * Wait for the given asynchronous `calculation` to finish.
+ *
+ * This function returns the status of the calculation: if the calculation
+ * failed, this function returns the corresponding error status, and
+ * `rascal_last_error()` gives the full error message. This function can be
+ * called multiple times, and always returns the same status.
+ *
+ * @param calculation pointer to an existing calculation handle
+ *
+ * @returns The status code of the calculation. If the status is not
+ *          `RASCAL_SUCCESS`, you can use `rascal_last_error()` to get the full
+ *          error message.
+ */
+rascal_status_t rascal_calculation_wait(const struct rascal_calculation_t *calculation);
+
+/**
+ * Free the memory associated with an asynchronous `calculation` previously
+ * created with `rascal_calculator_compute_submit`.
+ *
+ * This does not stop or wait for the calculation: if it is still running, it
+ * will continue in the background, and the calculator and descriptor must
+ * stay alive until it is finished. In this case, the `callback` given to
+ * `rascal_calculator_compute_submit` is the only way to know when the
+ * calculation is finished.
+ *
+ * If `calculation` is `NULL`, this function does nothing.
+ *
+ * @param calculation pointer to an existing calculation handle, or `NULL`
+ *
+ * @returns The status code of this operation. If the status is not
+ *          `RASCAL_SUCCESS`, you can use `rascal_last_error()` to get the
+ *          full error message.
+ */
+rascal_status_t rascal_calculation_free(struct rascal_calculation_t *calculation);
+
+/**
+ * Clear all collected profiling data, including the metrics returned by
+ * `rascal_profiling_metrics`
  *
  * See also `rascal_profiling_enable` and `rascal_profiling_get`.
  *
@@ -714,7 +1566,10 @@ rascal_status_t rascal_profiling_clear(void);
  * Rascaline uses the [`time_graph`](https://docs.rs/time-graph/) to collect
  * timing information on the calculations. This profiling code collects the
  * total time spent inside the most important functions, as well as the
- * function call graph (which function called which other function).
+ * function call graph (which function called which other function). It also
+ * collects counters (number of pairs and samples processed, memory used by
+ * descriptors, busy/idle time of the threads, *etc.*), see
+ * `rascal_profiling_metrics`.
  *
  * You can use `rascal_profiling_clear` to reset profiling data to an empty
  * state, and `rascal_profiling_get` to extract the profiling data.
@@ -733,7 +1588,9 @@ rascal_status_t rascal_profiling_enable(bool enabled);
  * See also `rascal_profiling_enable` and `rascal_profiling_clear`.
  *
  * @param format in which format should the data be provided. `"table"`,
- *              `"short_table"` and `"json"` are currently supported
+ *              `"short_table"` and `"json"` are currently supported for
+ *              timing data, and `"metrics"` gives the counters described in
+ *              `rascal_profiling_metrics_t` as JSON
  * @param buffer pre-allocated buffer in which profiling data will be copied.
  *               If the buffer is too small, this function will return
  *               `RASCAL_BUFFER_SIZE_ERROR`
@@ -745,6 +1602,68 @@ rascal_status_t rascal_profiling_enable(bool enabled);
  */
 rascal_status_t rascal_profiling_get(const char *format, char *buffer, uintptr_t bufflen);
 
+/**
+ * Get the counters collected during the calculations since profiling was
+ * enabled with `rascal_profiling_enable` or cleared with
+ * `rascal_profiling_clear`.
+ *
+ * The busy/idle time of the worker threads is written to `threads`, up to
+ * `threads_count` entries. `metrics->threads_count` is set to the number of
+ * threads with data, which can be used to allocate a large enough `threads`
+ * array before calling this function again. `threads` can be `NULL` if
+ * `threads_count` is 0.
+ *
+ * @param metrics pointer to a `rascal_profiling_metrics_t` that will be
+ *                filled by this function
+ * @param threads array of `rascal_thread_metrics_t` with space for
+ *                `threads_count` entries, or `NULL`
+ * @param threads_count number of entries in `threads`
+ *
+ * @returns The status code of this operation. If the status is not
+ *          `RASCAL_SUCCESS`, you can use `rascal_last_error()` to get the full
+ *          error message.
+ */
+rascal_status_t rascal_profiling_metrics(struct rascal_profiling_metrics_t *metrics,
+                                         struct rascal_thread_metrics_t *threads,
+                                         uintptr_t threads_count);
+
+/**
+ * Use `num_threads` threads for all the parallel calculations. By default,
+ * rascaline uses as many threads as there are CPU cores, or the value of the
+ * `RAYON_NUM_THREADS` environment variable if it is set.
+ *
+ * The threads are created once in this function and re-used for all
+ * subsequent calculations. The calls to the functions in `rascal_system_t`
+ * always happen on the thread which started the calculation.
+ *
+ * If `num_threads` is 0, the default number of threads is used. If
+ * `pin_threads` is `true`, each thread is bound to a single CPU, taken from
+ * the CPUs this process is allowed to run on (as set by `taskset`, `numactl`
+ * or the MPI launcher), in order of NUMA node. Pinning threads is only
+ * supported on Linux.
+ *
+ * @param num_threads number of threads to use, or 0 to use the default
+ * @param pin_threads whether each thread should be bound to a single CPU
+ *
+ * @returns The status code of this operation. If the status is not
+ *          `RASCAL_SUCCESS`, you can use `rascal_last_error()` to get the full
+ *          error message.
+ */
+rascal_status_t rascal_set_num_threads(uintptr_t num_threads, bool pin_threads);
+
+/**
+ * Get the number of threads used for the parallel calculations, see
+ * `rascal_set_num_threads`.
+ *
+ * @param num_threads pointer to a single integer, will be set to the number of
+ *                    threads
+ *
+ * @returns The status code of this operation. If the status is not
+ *          `RASCAL_SUCCESS`, you can use `rascal_last_error()` to get the full
+ *          error message.
+ */
+rascal_status_t rascal_get_num_threads(uintptr_t *num_threads);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif // __cplusplus
@@ -2,16 +2,20 @@
 #define RASCALINE_HPP
 
 #include <cassert>
+#include <algorithm>
 #include <cstring>
 #include <cstdlib>
+#include <cstddef>
 
 #include <new>
 #include <limits>
 #include <array>
 #include <string>
 #include <vector>
+#include <future>
 #include <mutex>
 #include <utility>
+#include <iterator>
 #include <stdexcept>
 #include <exception>
 #include <type_traits>
@@ -217,6 +221,22 @@ public:
     /// `System::pairs_containing(j)`.
     virtual const std::vector<rascal_pair_t>& pairs_containing(uintptr_t center) const = 0;
 
+    /// Get borrowed pointers to the data of this system, stored in contiguous
+    /// arrays. rascaline uses these arrays directly instead of calling the
+    /// other functions of this class for each access, which can be much faster
+    /// when the data already lives in contiguous arrays.
+    ///
+    /// The default implementation sets all pointers to `nullptr`, in which case
+    /// rascaline calls the other functions instead. Implementations overriding
+    /// this function must change `rascal_system_data_t::generation` every time
+    /// any of the arrays changes. This function is called at the beginning of
+    /// every calculation and after every call to `System::compute_neighbors`.
+    virtual rascal_system_data_t data() const {
+        auto data = rascal_system_data_t();
+        std::memset(&data, 0, sizeof(rascal_system_data_t));
+        return data;
+    }
+
     /// Convert a child instance of the `System` class to a `rascal_system_t` to
     /// be passed to the rascaline functions.
     ///
@@ -272,6 +292,12 @@ public:
                     *pairs = cpp_pairs.data();
                     *size = cpp_pairs.size();
                 );
+            },
+            // data
+            [](const void* self, rascal_system_data_t* data) {
+                RASCAL_SYSTEM_CATCH_EXCEPTIONS(
+                    *data = reinterpret_cast<const System*>(self)->data();
+                );
             }
         };
     }
@@ -425,9 +451,9 @@ private:
     /// The `is_const` parameter controls whether this class should allow
     /// non-const access to the data.
     ArrayView(const T* data, std::array<size_t, 2> shape, bool is_const):
+        is_const_(is_const),
         data_(const_cast<T*>(data)),
-        shape_(shape),
-        is_const_(is_const)
+        shape_(shape)
     {
         if (shape_[0] != 0 && shape_[1] != 0) {
             if (data_ == nullptr) {
@@ -596,6 +622,30 @@ private:
     std::vector<std::string> names_;
 };
 
+namespace details {
+    /// Get the set of `Indexes` of the given `kind` from a `descriptor`,
+    /// using the corresponding C API `function` (e.g.
+    /// `rascal_descriptor_indexes`). The returned `Indexes` point inside the
+    /// descriptor.
+    template <typename T>
+    inline Indexes get_indexes(
+        rascal_status_t (*function)(const T*, rascal_indexes_kind, rascal_indexes_t*),
+        const T* descriptor,
+        rascal_indexes_kind kind
+    ) {
+        rascal_indexes_t indexes = {};
+        check_status(function(descriptor, kind, &indexes));
+
+        auto array = ArrayView<int32_t>(indexes.values, {indexes.count, indexes.size});
+        auto names = std::vector<std::string>(
+            indexes.names,
+            indexes.names + indexes.size
+        );
+
+        return Indexes(std::move(names), std::move(array));
+    }
+}
+
 /// Small wrapper around `malloc`'ed array, taking ownership of this array and
 /// `free`ing it on destruction
 template<typename T>
@@ -661,6 +711,74 @@ private:
     size_t size_ = 0;
 };
 
+/// Block-sparse view of the gradients in a `Descriptor`, created by
+/// `Descriptor::gradients_blocks`.
+///
+/// Each block contains the gradients of one sample with respect to the
+/// position of one atom, as a 3 x features array (one row for each of the
+/// x/y/z cartesian components). Like `ArrayView`, this class does not own its
+/// memory, and is invalidated by calls to `Calculator::compute` or
+/// `Descriptor::gradients_blocks` with the same descriptor.
+class GradientsBlocks {
+public:
+    /// Create an empty set of gradients blocks
+    GradientsBlocks() = default;
+
+    /// Create gradients blocks from the data returned by
+    /// `rascal_descriptor_gradients_blocks`.
+    ///
+    /// This is an advanced function that most users don't need to call
+    /// directly.
+    GradientsBlocks(const uintptr_t* offsets, size_t samples, const int32_t* atoms, const double* data, size_t blocks, size_t features):
+        offsets_(offsets), samples_(samples), atoms_(atoms), data_(data), blocks_(blocks), features_(features) {}
+
+    /// Get the number of samples in these gradients
+    size_t samples() const {
+        return samples_;
+    }
+
+    /// Get the total number of blocks, for all samples
+    size_t blocks() const {
+        return blocks_;
+    }
+
+    /// Get the index of the first block for the given `sample`
+    size_t sample_start(size_t sample) const {
+        assert(sample < samples_);
+        return offsets_[sample];
+    }
+
+    /// Get the index after the last block for the given `sample`
+    size_t sample_stop(size_t sample) const {
+        assert(sample < samples_);
+        return offsets_[sample + 1];
+    }
+
+    /// Get the atom with respect to which the gradients in the given `block`
+    /// are computed
+    int32_t atom(size_t block) const {
+        assert(block < blocks_);
+        return atoms_[block];
+    }
+
+    /// Get the gradients in the given `block`, as a **read only** 3 x features
+    /// array
+    ArrayView<double> block(size_t block) const {
+        assert(block < blocks_);
+        return ArrayView<double>(data_ + block * 3 * features_, {3, features_});
+    }
+
+private:
+    const uintptr_t* offsets_ = nullptr;
+    size_t samples_ = 0;
+    const int32_t* atoms_ = nullptr;
+    const double* data_ = nullptr;
+    size_t blocks_ = 0;
+    size_t features_ = 0;
+};
+
+class Calculator;
+
 /// Descriptors store the result of a single calculation on a set of systems.
 ///
 /// They contains the values produced by the calculation; as well as metdata to
@@ -734,11 +852,30 @@ public:
         return ArrayView<double>(data, {samples, features});
     }
 
+    /// Get a block-sparse view of the gradients stored inside this descriptor
+    /// after a call to `Calculator::compute`, if any.
+    ///
+    /// If this descriptor does not contain gradient data, an empty
+    /// `GradientsBlocks` is returned.
+    GradientsBlocks gradients_blocks() const {
+        const uintptr_t* offsets = nullptr;
+        uintptr_t samples = 0;
+        const int32_t* atoms = nullptr;
+        double* data = nullptr;
+        uintptr_t blocks = 0;
+        uintptr_t features = 0;
+        details::check_status(rascal_descriptor_gradients_blocks(
+            descriptor_, &offsets, &samples, &atoms, &data, &blocks, &features
+        ));
+
+        return GradientsBlocks(offsets, samples, atoms, data, blocks, features);
+    }
+
     /// Get metdata describing the samples/rows in `Descriptor::values`.
     ///
     /// This is stored as a **read only** 2D array, where each column is named.
     Indexes samples() const {
-        return this->indexes(RASCAL_INDEXES_SAMPLES);
+        return details::get_indexes(rascal_descriptor_indexes, descriptor_, RASCAL_INDEXES_SAMPLES);
     }
 
     /// Get metdata describing the features/columns in `Descriptor::values` and
@@ -746,14 +883,14 @@ public:
     ///
     /// This is stored as a **read only** 2D array, where each column is named.
     Indexes features() const {
-        return this->indexes(RASCAL_INDEXES_FEATURES);
+        return details::get_indexes(rascal_descriptor_indexes, descriptor_, RASCAL_INDEXES_FEATURES);
     }
 
     /// Get metdata describing the gradients rows in `Descriptor::gradients`.
     ///
     /// This is stored as a **read only** 2D array, where each column is named.
     Indexes gradients_samples() const {
-        return this->indexes(RASCAL_INDEXES_GRADIENT_SAMPLES);
+        return details::get_indexes(rascal_descriptor_indexes, descriptor_, RASCAL_INDEXES_GRADIENT_SAMPLES);
     }
 
 
@@ -877,6 +1014,13 @@ public:
         );
     }
 
+    /// Save this descriptor to the file at `path`, in rascaline's own binary
+    /// format. The name and parameters of the `calculator` used to create this
+    /// descriptor are stored alongside the values, gradients and indexes.
+    ///
+    /// The file can then be opened with `MappedDescriptor`.
+    void save(const std::string& path, const Calculator& calculator) const;
+
     /// Get the underlying pointer to a `rascal_descriptor_t`.
     ///
     /// This is an advanced function that most users don't need to call
@@ -894,21 +1038,270 @@ public:
     }
 
 private:
-    /// Generic function to get a set of `Indexes` out of this descriptor.
-    Indexes indexes(rascal_indexes_kind kind) const {
-        rascal_indexes_t indexes = {0};
-        details::check_status(rascal_descriptor_indexes(descriptor_, kind, &indexes));
+    rascal_descriptor_t* descriptor_ = nullptr;
+};
 
-        auto array = ArrayView<int32_t>(indexes.values, {indexes.count, indexes.size});
-        auto names = std::vector<std::string>(
-            indexes.names,
-            indexes.names + indexes.size
+
+/// A `MappedDescriptor` is a read-only descriptor stored in a file created by
+/// `Descriptor::save`, and opened as a memory map. The values and gradients
+/// are read directly from the file when needed instead of being copied in
+/// memory, which allows to work with descriptors larger than the available
+/// memory.
+class MappedDescriptor final {
+public:
+    /// Open the descriptor file at `path`
+    explicit MappedDescriptor(const std::string& path): descriptor_(rascal_mapped_descriptor_open(path.c_str())) {
+        if (this->descriptor_ == nullptr) {
+            throw RascalError(rascal_last_error());
+        }
+    }
+
+    ~MappedDescriptor() {
+        details::check_status(rascal_mapped_descriptor_free(this->descriptor_));
+    }
+
+    /// MappedDescriptor is **NOT** copy-constructible
+    MappedDescriptor(const MappedDescriptor&) = delete;
+    /// MappedDescriptor can **NOT** be copy-assigned
+    MappedDescriptor& operator=(const MappedDescriptor&) = delete;
+
+    /// MappedDescriptor is move-constructible
+    MappedDescriptor(MappedDescriptor&& other) {
+        *this = std::move(other);
+    }
+
+    /// MappedDescriptor can be move-assigned
+    MappedDescriptor& operator=(MappedDescriptor&& other) {
+        this->~MappedDescriptor();
+        this->descriptor_ = nullptr;
+
+        std::swap(this->descriptor_, other.descriptor_);
+
+        return *this;
+    }
+
+    /// Get the name of the calculator used to create this descriptor
+    std::string name() const {
+        auto buffer = std::vector<char>(32, '\0');
+        while (true) {
+            auto status = rascal_mapped_descriptor_name(
+                descriptor_, &buffer[0], buffer.size()
+            );
+
+            if (status != RASCAL_BUFFER_SIZE_ERROR) {
+                details::check_status(status);
+                return std::string(buffer.data());
+            }
+
+            // grow the buffer and retry
+            buffer.resize(buffer.size() * 2, '\0');
+        }
+    }
+
+    /// Get the parameters of the calculator used to create this descriptor
+    std::string parameters() const {
+        auto buffer = std::vector<char>(256, '\0');
+        while (true) {
+            auto status = rascal_mapped_descriptor_parameters(
+                descriptor_, &buffer[0], buffer.size()
+            );
+
+            if (status != RASCAL_BUFFER_SIZE_ERROR) {
+                details::check_status(status);
+                return std::string(buffer.data());
+            }
+
+            // grow the buffer and retry
+            buffer.resize(buffer.size() * 2, '\0');
+        }
+    }
+
+    /// Get the values stored inside this descriptor, as a **read only** array
+    ArrayView<double> values() const {
+        const double* data = nullptr;
+        uintptr_t samples = 0;
+        uintptr_t features = 0;
+        details::check_status(rascal_mapped_descriptor_values(
+            descriptor_, &data, &samples, &features
+        ));
+
+        return ArrayView<double>(data, {samples, features});
+    }
+
+    /// Get the gradients stored inside this descriptor, as a **read only**
+    /// array.
+    ///
+    /// If this descriptor does not contain gradient data, an empty array is
+    /// returned.
+    ArrayView<double> gradients() const {
+        const double* data = nullptr;
+        uintptr_t samples = 0;
+        uintptr_t features = 0;
+        details::check_status(rascal_mapped_descriptor_gradients(
+            descriptor_, &data, &samples, &features
+        ));
+
+        return ArrayView<double>(data, {samples, features});
+    }
+
+    /// Get metdata describing the samples/rows in `MappedDescriptor::values`.
+    Indexes samples() const {
+        return details::get_indexes(rascal_mapped_descriptor_indexes, descriptor_, RASCAL_INDEXES_SAMPLES);
+    }
+
+    /// Get metdata describing the features/columns in
+    /// `MappedDescriptor::values` and `MappedDescriptor::gradients`.
+    Indexes features() const {
+        return details::get_indexes(rascal_mapped_descriptor_indexes, descriptor_, RASCAL_INDEXES_FEATURES);
+    }
+
+    /// Get metdata describing the gradients rows in
+    /// `MappedDescriptor::gradients`.
+    Indexes gradients_samples() const {
+        return details::get_indexes(rascal_mapped_descriptor_indexes, descriptor_, RASCAL_INDEXES_GRADIENT_SAMPLES);
+    }
+
+    /// Create a new `Descriptor` containing the data in this mapped descriptor,
+    /// made dense along the given `variables`. The data is read directly from
+    /// the file, without creating an intermediary copy of the sparse
+    /// descriptor.
+    ///
+    /// This function behaves like `Descriptor::densify`, please refer to its
+    /// documentation for more information. If `variables` is empty, this
+    /// returns a copy of the data in this mapped descriptor.
+    Descriptor densify(
+        std::vector<std::string> variables,
+        const ArrayView<int32_t>& requested = ArrayView<int32_t>(static_cast<const int32_t*>(nullptr), {0, 0})
+    ) const {
+        auto c_variables = std::vector<const char*>(variables.size());
+        for (size_t i=0; i<variables.size(); i++) {
+            c_variables[i] = variables[i].data();
+        }
+
+        auto descriptor = Descriptor();
+        details::check_status(
+            rascal_mapped_descriptor_densify(
+                descriptor_,
+                c_variables.data(),
+                variables.size(),
+                requested.data(),
+                requested.shape()[0],
+                descriptor.as_rascal_descriptor_t()
+            )
         );
 
-        return Indexes(std::move(names), std::move(array));
+        return descriptor;
     }
 
-    rascal_descriptor_t* descriptor_ = nullptr;
+    /// Get the underlying const pointer to a `rascal_mapped_descriptor_t`.
+    ///
+    /// This is an advanced function that most users don't need to call
+    /// directly.
+    const rascal_mapped_descriptor_t* as_rascal_mapped_descriptor_t() const {
+        return descriptor_;
+    }
+
+private:
+    rascal_mapped_descriptor_t* descriptor_ = nullptr;
+};
+
+
+/// A `DescriptorF32` contains the same data as a `Descriptor`, with the values
+/// and gradients stored in single precision (`float`). This halves the memory
+/// used by the descriptor data, and can be used directly by single precision
+/// models.
+class DescriptorF32 final {
+public:
+    /// Convert the given `descriptor` to single precision. The data is moved
+    /// out of `descriptor`, which will be empty after this call.
+    explicit DescriptorF32(Descriptor& descriptor):
+        descriptor_(rascal_descriptor_to_f32(descriptor.as_rascal_descriptor_t()))
+    {
+        if (this->descriptor_ == nullptr) {
+            throw RascalError(rascal_last_error());
+        }
+    }
+
+    ~DescriptorF32() {
+        details::check_status(rascal_descriptor_f32_free(this->descriptor_));
+    }
+
+    /// DescriptorF32 is **NOT** copy-constructible
+    DescriptorF32(const DescriptorF32&) = delete;
+    /// DescriptorF32 can **NOT** be copy-assigned
+    DescriptorF32& operator=(const DescriptorF32&) = delete;
+
+    /// DescriptorF32 is move-constructible
+    DescriptorF32(DescriptorF32&& other) {
+        *this = std::move(other);
+    }
+
+    /// DescriptorF32 can be move-assigned
+    DescriptorF32& operator=(DescriptorF32&& other) {
+        this->~DescriptorF32();
+        this->descriptor_ = nullptr;
+
+        std::swap(this->descriptor_, other.descriptor_);
+
+        return *this;
+    }
+
+    /// Get the single precision values stored inside this descriptor, as a
+    /// **read only** array
+    ArrayView<float> values() const {
+        const float* data = nullptr;
+        uintptr_t samples = 0;
+        uintptr_t features = 0;
+        details::check_status(rascal_descriptor_f32_values(
+            descriptor_, &data, &samples, &features
+        ));
+
+        return ArrayView<float>(data, {samples, features});
+    }
+
+    /// Get the single precision gradients stored inside this descriptor, as a
+    /// **read only** array.
+    ///
+    /// If this descriptor does not contain gradient data, an empty array is
+    /// returned.
+    ArrayView<float> gradients() const {
+        const float* data = nullptr;
+        uintptr_t samples = 0;
+        uintptr_t features = 0;
+        details::check_status(rascal_descriptor_f32_gradients(
+            descriptor_, &data, &samples, &features
+        ));
+
+        return ArrayView<float>(data, {samples, features});
+    }
+
+    /// Get metdata describing the samples/rows in `DescriptorF32::values`.
+    Indexes samples() const {
+        return details::get_indexes(rascal_descriptor_f32_indexes, descriptor_, RASCAL_INDEXES_SAMPLES);
+    }
+
+    /// Get metdata describing the features/columns in `DescriptorF32::values`
+    /// and `DescriptorF32::gradients`.
+    Indexes features() const {
+        return details::get_indexes(rascal_descriptor_f32_indexes, descriptor_, RASCAL_INDEXES_FEATURES);
+    }
+
+    /// Get metdata describing the gradients rows in
+    /// `DescriptorF32::gradients`.
+    Indexes gradients_samples() const {
+        return details::get_indexes(rascal_descriptor_f32_indexes, descriptor_, RASCAL_INDEXES_GRADIENT_SAMPLES);
+    }
+
+    /// Get the underlying const pointer to a `rascal_descriptor_f32_t`.
+    ///
+    /// This is an advanced function that most users don't need to call
+    /// directly.
+    const rascal_descriptor_f32_t* as_rascal_descriptor_f32_t() const {
+        return descriptor_;
+    }
+
+private:
+    rascal_descriptor_f32_t* descriptor_ = nullptr;
 };
 
 
@@ -928,6 +1321,13 @@ public:
     /// run the calculation on all features.
     SelectedIndexes selected_features = SelectedIndexes();
 
+    /// Re-use the samples, gradients samples and features already stored in
+    /// the descriptor if they were created by a previous call to `compute`
+    /// with the same calculator, the same selected samples and features, and
+    /// systems with the same atoms and neighbors pairs. The values and
+    /// gradients are then set to zero in place instead of being re-allocated.
+    bool reuse_descriptor = false;
+
     /// Convert this instance of `CalculationOptions` to a
     /// `rascal_calculation_options_t`.
     ///
@@ -955,14 +1355,98 @@ public:
             options.selected_features.size = this->selected_features.size();
         }
 
+        options.reuse_descriptor = this->reuse_descriptor;
+
         return options;
     }
 };
 
 
+/// A `CalculationPlan` contains the samples, gradients samples and features
+/// used by a `Calculator` for a given set of systems and options. Plans are
+/// created with `Calculator::plan`, and can be used to run the same calculation
+/// many times on systems with the same atoms and neighbors pairs (only the
+/// positions of the atoms are allowed to change), without re-creating these
+/// indexes every time.
+class CalculationPlan {
+public:
+    /// Create a `CalculationPlan` taking ownership of the given `plan`. If
+    /// `plan` is `nullptr`, this throws the last error from rascaline.
+    ///
+    /// This is an advanced function that most users don't need to call
+    /// directly, see `Calculator::plan` instead.
+    explicit CalculationPlan(rascal_calculation_plan_t* plan): plan_(plan) {
+        if (this->plan_ == nullptr) {
+            throw RascalError(rascal_last_error());
+        }
+    }
+
+    ~CalculationPlan() {
+        details::check_status(rascal_calculation_plan_free(this->plan_));
+    }
+
+    /// CalculationPlan is **NOT** copy-constructible
+    CalculationPlan(const CalculationPlan&) = delete;
+    /// CalculationPlan can **NOT** be copy-assigned
+    CalculationPlan& operator=(const CalculationPlan&) = delete;
+
+    /// CalculationPlan is move-constructible
+    CalculationPlan(CalculationPlan&& other) {
+        *this = std::move(other);
+    }
+
+    /// CalculationPlan can be move-assigned
+    CalculationPlan& operator=(CalculationPlan&& other) {
+        this->~CalculationPlan();
+        this->plan_ = nullptr;
+
+        std::swap(this->plan_, other.plan_);
+
+        return *this;
+    }
+
+    /// Get the underlying const pointer to a `rascal_calculation_plan_t`.
+    ///
+    /// This is an advanced function that most users don't need to call
+    /// directly.
+    const rascal_calculation_plan_t* as_rascal_calculation_plan_t() const {
+        return plan_;
+    }
+
+private:
+    rascal_calculation_plan_t* plan_ = nullptr;
+};
+
+
 /// The `Calculator` class implements the calculation of a given atomic scale
 /// representation. Specific implementation are registered globally, and
 /// requested at construction.
+namespace details {
+    /// State shared between `Calculator::compute_async` and the callback
+    /// called by rascaline once the calculation is finished
+    struct AsyncCalculation {
+        Descriptor descriptor;
+        std::promise<Descriptor> promise;
+
+        static void callback(void* user_data, rascal_status_t status) {
+            auto state = static_cast<AsyncCalculation*>(user_data);
+            // exceptions can not cross the C API
+            try {
+                if (status == RASCAL_SUCCESS) {
+                    state->promise.set_value(std::move(state->descriptor));
+                } else {
+                    state->promise.set_exception(std::make_exception_ptr(
+                        RascalError(rascal_last_error())
+                    ));
+                }
+            } catch (...) {
+                state->promise.set_exception(std::current_exception());
+            }
+            delete state;
+        }
+    };
+}
+
 class Calculator {
 public:
     /// Create a new calculator with the given `name` and `parameters`.
@@ -1108,6 +1592,135 @@ public:
         return descriptor;
     }
 
+    /// Start a calculation with this `calculator` on the given `systems` in
+    /// the background, using rascaline's thread pool. Options for this
+    /// calculation can be passed in `options`.
+    ///
+    /// The data from the `systems` is copied before this function returns, so
+    /// the systems can be modified or destroyed right away. This calculator
+    /// is used until the calculation is finished, and must not be used by
+    /// other calculations or destroyed before the returned future is ready.
+    ///
+    /// @returns a future which will contain the resulting data once the
+    ///          calculation is finished, or a `RascalError` if the calculation
+    ///          failed
+    std::future<Descriptor> compute_async(std::vector<System*> systems, CalculationOptions options = CalculationOptions()) const {
+        auto rascal_systems = std::vector<rascal_system_t>();
+        for (auto& system: systems) {
+            assert(system != nullptr);
+            rascal_systems.push_back(system->as_rascal_system_t());
+        }
+
+        auto state = new details::AsyncCalculation();
+        auto future = state->promise.get_future();
+
+        auto calculation = rascal_calculator_compute_submit(
+            calculator_,
+            state->descriptor.as_rascal_descriptor_t(),
+            rascal_systems.data(),
+            rascal_systems.size(),
+            options.as_rascal_calculation_options_t(),
+            details::AsyncCalculation::callback,
+            state
+        );
+
+        if (calculation == nullptr) {
+            delete state;
+            throw RascalError(rascal_last_error());
+        }
+
+        // the callback signals the end of the calculation, so we don't need
+        // to keep the handle around
+        details::check_status(rascal_calculation_free(calculation));
+
+        return future;
+    }
+
+    /// Run the calculations of all the `calculators` on the same `systems` in
+    /// a single pass, sharing the neighbors lists between calculators using
+    /// the same cutoff, and computing intermediate descriptors (such as the
+    /// spherical expansion used by a SOAP power spectrum) only once.
+    ///
+    /// All calculators compute their full descriptor, `options` can not
+    /// contain selected samples or features.
+    ///
+    /// @returns a vector containing the descriptor computed by each calculator
+    static std::vector<Descriptor> compute_all(std::vector<const Calculator*> calculators, std::vector<System*> systems, CalculationOptions options = CalculationOptions()) {
+        auto rascal_systems = std::vector<rascal_system_t>();
+        for (auto& system: systems) {
+            assert(system != nullptr);
+            rascal_systems.push_back(system->as_rascal_system_t());
+        }
+
+        auto descriptors = std::vector<Descriptor>(calculators.size());
+        auto rascal_calculators = std::vector<rascal_calculator_t*>();
+        auto rascal_descriptors = std::vector<rascal_descriptor_t*>();
+        for (size_t i = 0; i < calculators.size(); i++) {
+            assert(calculators[i] != nullptr);
+            rascal_calculators.push_back(calculators[i]->calculator_);
+            rascal_descriptors.push_back(descriptors[i].as_rascal_descriptor_t());
+        }
+
+        details::check_status(rascal_calculators_compute(
+            rascal_calculators.data(),
+            rascal_descriptors.data(),
+            calculators.size(),
+            rascal_systems.data(),
+            rascal_systems.size(),
+            options.as_rascal_calculation_options_t()
+        ));
+
+        return descriptors;
+    }
+
+    /// Create a `CalculationPlan` for this `calculator`, the given `systems`
+    /// and `options`. The plan can then be used with `Calculator::compute` to
+    /// run the same calculation multiple times on systems with the same atoms
+    /// and neighbors pairs, without re-creating the samples and features every
+    /// time.
+    CalculationPlan plan(std::vector<System*> systems, CalculationOptions options = CalculationOptions()) const {
+        auto rascal_systems = std::vector<rascal_system_t>();
+        for (auto& system: systems) {
+            assert(system != nullptr);
+            rascal_systems.push_back(system->as_rascal_system_t());
+        }
+
+        return CalculationPlan(rascal_calculation_plan(
+            calculator_,
+            rascal_systems.data(),
+            rascal_systems.size(),
+            options.as_rascal_calculation_options_t()
+        ));
+    }
+
+    /// Run a calculation with this `calculator` on the given `systems`, storing
+    /// the resulting data in the `descriptor`. The samples, gradients samples
+    /// and features are taken from the `plan`, which must have been created
+    /// by this calculator for systems with the same atoms and neighbors pairs.
+    void compute(std::vector<System*> systems, Descriptor& descriptor, const CalculationPlan& plan) const {
+        auto rascal_systems = std::vector<rascal_system_t>();
+        for (auto& system: systems) {
+            assert(system != nullptr);
+            rascal_systems.push_back(system->as_rascal_system_t());
+        }
+
+        details::check_status(rascal_calculator_compute_with_plan(
+            calculator_,
+            descriptor.as_rascal_descriptor_t(),
+            rascal_systems.data(),
+            rascal_systems.size(),
+            plan.as_rascal_calculation_plan_t()
+        ));
+    }
+
+    /// Run a calculation with this `calculator` on the given `systems` using
+    /// the given `plan`, and return the resulting data in a new `Descriptor`.
+    Descriptor compute(std::vector<System*> systems, const CalculationPlan& plan) const {
+        auto descriptor = Descriptor();
+        this->compute(std::move(systems), descriptor, plan);
+        return descriptor;
+    }
+
     /// Get the underlying pointer to a `rascal_calculator_t`.
     ///
     /// This is an advanced function that most users don't need to call
@@ -1128,6 +1741,184 @@ private:
     rascal_calculator_t* calculator_ = nullptr;
 };
 
+inline void Descriptor::save(const std::string& path, const Calculator& calculator) const {
+    details::check_status(rascal_descriptor_save(
+        descriptor_, calculator.as_rascal_calculator_t(), path.c_str()
+    ));
+}
+
+
+/// `TrajectoryChunks` runs a calculation on all the structures in a trajectory
+/// file, reading and computing them in chunks of at most `chunk_size`
+/// structures. Only two chunks are kept in memory at the same time: the one
+/// being computed and the next one, which is read in the background.
+///
+/// This class is a range of `Descriptor`, one for each chunk. The `structure`
+/// samples in each descriptor are relative to the chunk, and
+/// `TrajectoryChunks::first_structure` gives the index of the first structure
+/// of the current chunk in the trajectory:
+///
+/// ```cpp
+/// auto chunks = rascaline::TrajectoryChunks(calculator, "trajectory.xyz", 100);
+/// for (const auto& descriptor: chunks) {
+///     auto first = chunks.first_structure();
+///     // use descriptor here
+/// }
+/// ```
+///
+/// The descriptor is re-used for all chunks, and only valid until the next
+/// chunk is computed.
+class TrajectoryChunks {
+public:
+    /// Input iterator over the chunks of a trajectory
+    class iterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = Descriptor;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const Descriptor*;
+        using reference = const Descriptor&;
+
+        /// Get the descriptor for the current chunk
+        const Descriptor& operator*() const {
+            assert(chunks_ != nullptr);
+            return chunks_->descriptor_;
+        }
+
+        /// Get the descriptor for the current chunk
+        const Descriptor* operator->() const {
+            return &(**this);
+        }
+
+        /// Compute the next chunk in the trajectory
+        iterator& operator++() {
+            assert(chunks_ != nullptr);
+            chunks_->compute_next();
+            if (chunks_->done_) {
+                chunks_ = nullptr;
+            }
+            return *this;
+        }
+
+        bool operator==(const iterator& other) const {
+            return chunks_ == other.chunks_;
+        }
+
+        bool operator!=(const iterator& other) const {
+            return !(*this == other);
+        }
+
+    private:
+        explicit iterator(TrajectoryChunks* chunks): chunks_(chunks) {}
+
+        TrajectoryChunks* chunks_;
+        friend class TrajectoryChunks;
+    };
+
+    /// Start reading the trajectory at `path` in chunks of at most
+    /// `chunk_size` structures, to compute them with the given `calculator`
+    /// and `options`. The `calculator` must outlive this object.
+    TrajectoryChunks(Calculator& calculator, const std::string& path, size_t chunk_size, CalculationOptions options = CalculationOptions()):
+        calculator_(calculator.as_rascal_calculator_t()),
+        chunks_(rascal_trajectory_chunks(path.c_str(), chunk_size)),
+        options_(std::move(options))
+    {
+        if (this->chunks_ == nullptr) {
+            throw RascalError(rascal_last_error());
+        }
+    }
+
+    ~TrajectoryChunks() {
+        details::check_status(rascal_trajectory_chunks_free(this->chunks_));
+    }
+
+    /// TrajectoryChunks is **NOT** copy-constructible
+    TrajectoryChunks(const TrajectoryChunks&) = delete;
+    /// TrajectoryChunks can **NOT** be copy-assigned
+    TrajectoryChunks& operator=(const TrajectoryChunks&) = delete;
+
+    /// TrajectoryChunks is **NOT** move-constructible, since iterators keep a
+    /// pointer to it
+    TrajectoryChunks(TrajectoryChunks&&) = delete;
+    /// TrajectoryChunks can **NOT** be move-assigned
+    TrajectoryChunks& operator=(TrajectoryChunks&&) = delete;
+
+    /// Compute the first chunk (if it was not computed yet) and get an
+    /// iterator to it
+    iterator begin() {
+        if (!started_) {
+            this->compute_next();
+        }
+
+        if (done_) {
+            return this->end();
+        }
+        return iterator(this);
+    }
+
+    /// Get the past-the-end iterator
+    iterator end() {
+        return iterator(nullptr);
+    }
+
+    /// Get the index in the trajectory of the first structure of the current
+    /// chunk
+    size_t first_structure() const {
+        return first_structure_;
+    }
+
+private:
+    void compute_next() {
+        started_ = true;
+        uintptr_t first_structure = 0;
+        details::check_status(rascal_trajectory_chunks_compute_next(
+            chunks_,
+            calculator_,
+            descriptor_.as_rascal_descriptor_t(),
+            options_.as_rascal_calculation_options_t(),
+            &first_structure,
+            &done_
+        ));
+        first_structure_ = static_cast<size_t>(first_structure);
+    }
+
+    rascal_calculator_t* calculator_;
+    rascal_trajectory_chunks_t* chunks_;
+    CalculationOptions options_;
+    Descriptor descriptor_;
+    size_t first_structure_ = 0;
+    bool started_ = false;
+    bool done_ = false;
+};
+
+/// Counters collected during the calculations when profiling is enabled, see
+/// `Profiler::metrics`.
+struct ProfilingMetrics {
+    /// Number of pairs processed by the spherical expansion
+    uint64_t pairs = 0;
+    /// Number of samples computed by the calculators
+    uint64_t samples = 0;
+    /// Number of gradients samples computed by the calculators
+    uint64_t gradient_samples = 0;
+    /// Memory used by the values and gradients of descriptors, in bytes
+    uint64_t descriptor_bytes = 0;
+    /// Memory used by the indexes of descriptors, in bytes
+    uint64_t indexes_bytes = 0;
+    /// Number of neighbors lists created from scratch
+    uint64_t neighbors_list_builds = 0;
+    /// Number of times an existing neighbors list was re-used
+    uint64_t neighbors_list_reuses = 0;
+    /// Largest number of chunks read ahead when streaming trajectories
+    uint64_t chunks_queue_high_water = 0;
+    /// Number of environments copied from an identical environment
+    uint64_t environment_cache_hits = 0;
+    /// Number of environments computed when deduplicating environments
+    uint64_t environment_cache_misses = 0;
+    /// Total wall time spent in parallel sections, in nanoseconds
+    uint64_t parallel_time_ns = 0;
+    /// Busy and idle time of each worker thread, in nanoseconds
+    std::vector<rascal_thread_metrics_t> threads;
+};
 
 /// Rascaline uses the [`time_graph`](https://docs.rs/time-graph/) to collect
 /// timing information on the calculations. The `Profiler` static class provides
@@ -1161,7 +1952,9 @@ public:
     /// See also `Profiler::enable` and `Profiler::clear`.
     ///
     /// @param format in which format should the data be provided. `"table"`,
-    ///              `"short_table"` and `"json"` are currently supported
+    ///              `"short_table"` and `"json"` are currently supported for
+    ///              timing data, and `"metrics"` gives the counters from
+    ///              `Profiler::metrics` as JSON
     /// @returns the current profiling data, in the requested format
     static std::string get(std::string format) {
         auto buffer = std::vector<char>(1024, '\0');
@@ -1180,12 +1973,68 @@ public:
         }
     }
 
+    /// Get the counters collected during the calculations since profiling
+    /// was enabled or cleared.
+    ///
+    /// See also `Profiler::enable` and `Profiler::clear`.
+    static ProfilingMetrics metrics() {
+        rascal_profiling_metrics_t raw;
+        details::check_status(rascal_profiling_metrics(&raw, nullptr, 0));
+
+        auto metrics = ProfilingMetrics();
+        metrics.threads.resize(raw.threads_count);
+        if (!metrics.threads.empty()) {
+            details::check_status(rascal_profiling_metrics(
+                &raw, metrics.threads.data(), metrics.threads.size()
+            ));
+            // new threads could have been registered between the two calls
+            metrics.threads.resize(std::min(metrics.threads.size(), raw.threads_count));
+        }
+
+        metrics.pairs = raw.pairs;
+        metrics.samples = raw.samples;
+        metrics.gradient_samples = raw.gradient_samples;
+        metrics.descriptor_bytes = raw.descriptor_bytes;
+        metrics.indexes_bytes = raw.indexes_bytes;
+        metrics.neighbors_list_builds = raw.neighbors_list_builds;
+        metrics.neighbors_list_reuses = raw.neighbors_list_reuses;
+        metrics.chunks_queue_high_water = raw.chunks_queue_high_water;
+        metrics.environment_cache_hits = raw.environment_cache_hits;
+        metrics.environment_cache_misses = raw.environment_cache_misses;
+        metrics.parallel_time_ns = raw.parallel_time_ns;
+
+        return metrics;
+    }
+
 private:
     // make the constructor private and undefined since this class only offers
     // static functions.
     Profiler();
 };
 
+/// Use `num_threads` threads for all the parallel calculations. The threads
+/// are created once in this function and re-used for all subsequent
+/// calculations.
+///
+/// If `num_threads` is 0, the default number of threads (from the
+/// `RAYON_NUM_THREADS` environment variable or the number of CPU cores) is
+/// used. If `pin_threads` is `true`, each thread is bound to a single CPU,
+/// in order of NUMA node. Pinning threads is only supported on Linux.
+///
+/// @param num_threads number of threads to use, or 0 to use the default
+/// @param pin_threads whether each thread should be bound to a single CPU
+inline void set_num_threads(size_t num_threads, bool pin_threads = false) {
+    details::check_status(rascal_set_num_threads(num_threads, pin_threads));
+}
+
+/// Get the number of threads used for the parallel calculations, see
+/// `rascaline::set_num_threads`.
+inline size_t num_threads() {
+    size_t count = 0;
+    details::check_status(rascal_get_num_threads(&count));
+    return count;
+}
+
 }
 
 #endif
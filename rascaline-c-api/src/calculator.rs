@@ -1,15 +1,19 @@
-use std::os::raw::c_char;
-use std::ffi::CStr;
+use std::os::raw::{c_char, c_void};
+use std::ffi::{CStr, CString};
 use std::ops::{Deref, DerefMut};
+use std::convert::TryFrom;
+use std::sync::{Arc, Condvar, Mutex};
 
-use rascaline::{Calculator, System, Error, CalculationOptions, SelectedIndexes};
+use rascaline::{Calculator, CalculatorGroup, CalculationPlan, System, Error, CalculationOptions, SelectedIndexes};
+use rascaline::systems::{SimpleSystem, TrajectoryChunks};
 use rascaline::descriptor::IndexesBuilder;
 
 use super::utils::copy_str_to_c;
 use super::{catch_unwind, rascal_status_t};
+use super::status::LAST_ERROR_MESSAGE;
 
 use super::descriptor::{rascal_descriptor_t, rascal_indexes_t};
-use super::system::rascal_system_t;
+use super::system::{rascal_system_t, BorrowedSystem};
 
 /// Opaque type representing a `Calculator`
 #[allow(non_camel_case_types)]
@@ -188,6 +192,13 @@ pub struct rascal_calculation_options_t {
     /// `selected_features.names` to `NULL` to run the calculation on all
     /// features.
     selected_features: rascal_indexes_t,
+    /// Re-use the samples, gradients samples and features already stored in
+    /// the descriptor if they were created by a previous call to
+    /// `rascal_calculator_compute` with the same calculator, the same selected
+    /// samples and features, and systems with the same atoms and neighbors
+    /// pairs. The values and gradients are then set to zero in place instead of
+    /// being re-allocated.
+    reuse_descriptor: bool,
 }
 
 fn selected_indexes(selected: &rascal_indexes_t) -> Result<SelectedIndexes, Error> {
@@ -223,6 +234,25 @@ fn selected_indexes(selected: &rascal_indexes_t) -> Result<SelectedIndexes, Erro
     return Ok(SelectedIndexes::Subset(builder.finish()));
 }
 
+/// Create a Vec<Box<dyn System>> from the `systems` passed to the C API
+unsafe fn borrowed_systems(systems: *mut rascal_system_t, systems_count: usize) -> Result<Vec<Box<dyn System>>, Error> {
+    let c_systems = std::slice::from_raw_parts_mut(systems, systems_count);
+    let mut systems = Vec::with_capacity(c_systems.len());
+    for system in c_systems {
+        systems.push(Box::new(BorrowedSystem::new(system)?) as Box<dyn System>);
+    }
+    return Ok(systems);
+}
+
+fn convert_options(options: &rascal_calculation_options_t) -> Result<CalculationOptions, Error> {
+    return Ok(CalculationOptions {
+        use_native_system: options.use_native_system,
+        selected_samples: selected_indexes(&options.selected_samples)?,
+        selected_features: selected_indexes(&options.selected_features)?,
+        reuse_descriptor: options.reuse_descriptor,
+    });
+}
+
 #[allow(clippy::doc_markdown)]
 /// Run a calculation with the given `calculator` on the given `systems`,
 /// storing the resulting data in the `descriptor`.
@@ -251,19 +281,624 @@ pub unsafe extern fn rascal_calculator_compute(
         }
         check_pointers!(calculator, descriptor, systems);
 
-        // Create a Vec<Box<dyn System>> from the passed systems
-        let c_systems = std::slice::from_raw_parts_mut(systems, systems_count);
-        let mut systems = Vec::with_capacity(c_systems.len());
-        for system in c_systems {
-            systems.push(Box::new(system) as Box<dyn System>);
+        let mut systems = borrowed_systems(systems, systems_count)?;
+        let options = convert_options(&options)?;
+        (*calculator).compute(&mut systems, &mut *descriptor, options)
+    })
+}
+
+#[allow(clippy::doc_markdown)]
+/// Run the calculations of all the `calculators` on the same `systems` in a
+/// single pass, storing the data computed by `calculators[i]` in
+/// `descriptors[i]`.
+///
+/// This shares the copy to native systems and the neighbors lists between
+/// calculators using the same cutoff. If one of the calculators computes a
+/// descriptor used as input by another one (for example a spherical expansion
+/// with the same parameters as a SOAP power spectrum), this descriptor is
+/// only computed once.
+///
+/// All calculators compute their full descriptor, so `options.selected_samples`
+/// and `options.selected_features` must have their `names` set to `NULL`.
+///
+/// @param calculators array of pointers to existing, different calculators
+/// @param descriptors array of pointers to existing, different descriptors for
+///                    data storage, with one descriptor for each calculator
+/// @param count number of calculators and descriptors
+/// @param systems pointer to an array of systems implementation
+/// @param systems_count number of systems in `systems`
+/// @param options options for these calculations
+///
+/// @returns The status code of this operation. If the status is not
+///          `RASCAL_SUCCESS`, you can use `rascal_last_error()` to get the full
+///          error message.
+#[no_mangle]
+pub unsafe extern fn rascal_calculators_compute(
+    calculators: *const *mut rascal_calculator_t,
+    descriptors: *const *mut rascal_descriptor_t,
+    count: usize,
+    systems: *mut rascal_system_t,
+    systems_count: usize,
+    options: rascal_calculation_options_t,
+) -> rascal_status_t {
+    catch_unwind(|| {
+        if systems_count == 0 || count == 0 {
+            log::warn!("0 systems or calculators given to rascal_calculators_compute, we will do nothing");
+            return Ok(());
+        }
+        check_pointers!(calculators, descriptors, systems);
+
+        let mut group_calculators = Vec::with_capacity(count);
+        let mut group_descriptors = Vec::with_capacity(count);
+        for i in 0..count {
+            let calculator = *calculators.add(i);
+            let descriptor = *descriptors.add(i);
+            check_pointers!(calculator, descriptor);
+            group_calculators.push(&mut **calculator);
+            group_descriptors.push(&mut **descriptor);
         }
 
-        let options = CalculationOptions {
-            use_native_system: options.use_native_system,
-            selected_samples: selected_indexes(&options.selected_samples)?,
-            selected_features: selected_indexes(&options.selected_features)?,
-        };
+        let mut systems = borrowed_systems(systems, systems_count)?;
+        let options = convert_options(&options)?;
+        let mut group = CalculatorGroup::new(group_calculators);
+        group.compute(&mut systems, &mut group_descriptors, options)
+    })
+}
 
-        (*calculator).compute(&mut systems, &mut *descriptor, options)
+/// Opaque type representing a `CalculationPlan`
+#[allow(non_camel_case_types)]
+pub struct rascal_calculation_plan_t(CalculationPlan);
+
+impl Deref for rascal_calculation_plan_t {
+    type Target = CalculationPlan;
+    fn deref(&self) -> &Self::Target {
+        &self.0
+    }
+}
+
+#[allow(clippy::doc_markdown)]
+/// Create a new calculation plan for the given `calculator`, `systems` and
+/// `options`.
+///
+/// The plan contains the samples, gradients samples and features used by the
+/// calculation, and can be used with `rascal_calculator_compute_with_plan` to
+/// run the same calculation multiple times on systems with the same atoms and
+/// neighbors pairs (only the positions of the atoms are allowed to change),
+/// without re-creating these indexes every time.
+///
+/// All memory allocated by this function can be released using
+/// `rascal_calculation_plan_free`.
+///
+/// @param calculator pointer to an existing calculator
+/// @param systems pointer to an array of systems implementation
+/// @param systems_count number of systems in `systems`
+/// @param options options for the calculation
+///
+/// @returns A pointer to the newly allocated plan, or a `NULL` pointer in case
+///          of error. In case of error, you can use `rascal_last_error()` to
+///          get the error message.
+#[no_mangle]
+pub unsafe extern fn rascal_calculation_plan(
+    calculator: *mut rascal_calculator_t,
+    systems: *mut rascal_system_t,
+    systems_count: usize,
+    options: rascal_calculation_options_t,
+) -> *mut rascal_calculation_plan_t {
+    let mut raw = std::ptr::null_mut();
+    let unwind_wrapper = std::panic::AssertUnwindSafe(&mut raw);
+    let status = catch_unwind(move || {
+        check_pointers!(calculator, systems);
+
+        let mut systems = borrowed_systems(systems, systems_count)?;
+        let options = convert_options(&options)?;
+
+        let plan = (*calculator).plan(&mut systems, options)?;
+        let boxed = Box::new(rascal_calculation_plan_t(plan));
+
+        *unwind_wrapper.0 = Box::into_raw(boxed);
+        Ok(())
+    });
+
+    if !status.is_success() {
+        return std::ptr::null_mut();
+    }
+
+    return raw;
+}
+
+/// Free the memory associated with a `plan` previously created with
+/// `rascal_calculation_plan`.
+///
+/// If `plan` is `NULL`, this function does nothing.
+///
+/// @param plan pointer to an existing calculation plan, or `NULL`
+///
+/// @returns The status code of this operation. If the status is not
+///          `RASCAL_SUCCESS`, you can use `rascal_last_error()` to get the
+///          full error message.
+#[no_mangle]
+pub unsafe extern fn rascal_calculation_plan_free(plan: *mut rascal_calculation_plan_t) -> rascal_status_t {
+    catch_unwind(|| {
+        if !plan.is_null() {
+            let boxed = Box::from_raw(plan);
+            std::mem::drop(boxed);
+        }
+
+        Ok(())
+    })
+}
+
+#[allow(clippy::doc_markdown)]
+/// Run a calculation with the given `calculator` on the given `systems`,
+/// storing the resulting data in the `descriptor`, and using the samples,
+/// gradients samples and features from `plan`.
+///
+/// The systems must contain the same atoms and neighbors pairs as the systems
+/// used to create the plan.
+///
+/// @param calculator pointer to an existing calculator, the same one used to
+///                   create the `plan`
+/// @param descriptor pointer to an existing descriptor for data storage
+/// @param systems pointer to an array of systems implementation
+/// @param systems_count number of systems in `systems`
+/// @param plan pointer to an existing calculation plan
+///
+/// @returns The status code of this operation. If the status is not
+///          `RASCAL_SUCCESS`, you can use `rascal_last_error()` to get the full
+///          error message.
+#[no_mangle]
+pub unsafe extern fn rascal_calculator_compute_with_plan(
+    calculator: *mut rascal_calculator_t,
+    descriptor: *mut rascal_descriptor_t,
+    systems: *mut rascal_system_t,
+    systems_count: usize,
+    plan: *const rascal_calculation_plan_t,
+) -> rascal_status_t {
+    catch_unwind(|| {
+        check_pointers!(calculator, descriptor, systems, plan);
+
+        let mut systems = borrowed_systems(systems, systems_count)?;
+        (*calculator).compute_with_plan(&mut systems, &mut *descriptor, &*plan)
+    })
+}
+
+/// Callback function type used by `rascal_calculator_compute_trajectory`,
+/// called after the calculation of each chunk of a trajectory.
+///
+/// The first argument is the `user_data` pointer given to
+/// `rascal_calculator_compute_trajectory`, the second argument is the index of
+/// the first structure of this chunk in the trajectory, and the third argument
+/// is the descriptor containing the data for this chunk. The descriptor is
+/// re-used for the next chunk, and should not be freed or stored by the
+/// callback.
+///
+/// The callback should return `RASCAL_SUCCESS` to continue the calculation,
+/// or any other value to stop it. In the latter case, the value is returned by
+/// `rascal_calculator_compute_trajectory`.
+#[allow(non_camel_case_types)]
+pub type rascal_chunk_callback_t = Option<unsafe extern fn(
+    user_data: *mut c_void,
+    first_structure: usize,
+    descriptor: *mut rascal_descriptor_t,
+) -> rascal_status_t>;
+
+#[allow(clippy::doc_markdown)]
+/// Run a calculation with the given `calculator` on all the structures in the
+/// trajectory file at `path`, reading and computing at most `chunk_size`
+/// structures at a time.
+///
+/// The file is read with chemfiles in a background thread while the previous
+/// chunk is being computed, and only two chunks are kept in memory at the same
+/// time. After the calculation of each chunk, `callback` is called with the
+/// `user_data`, the index of the first structure of the chunk in the
+/// trajectory and the descriptor for this chunk. The `structure` samples in
+/// the descriptor are relative to the chunk.
+///
+/// @param calculator pointer to an existing calculator
+/// @param path path of the file to read from in the local filesystem, as a
+///             NULL-terminated string
+/// @param chunk_size maximal number of structures in each chunk
+/// @param options options for the calculation of each chunk
+/// @param callback function called after the calculation of each chunk
+/// @param user_data pointer passed as the first argument to `callback`
+///
+/// @returns The status code of this operation. If the status is not
+///          `RASCAL_SUCCESS`, you can use `rascal_last_error()` to get the full
+///          error message.
+#[no_mangle]
+pub unsafe extern fn rascal_calculator_compute_trajectory(
+    calculator: *mut rascal_calculator_t,
+    path: *const c_char,
+    chunk_size: usize,
+    options: rascal_calculation_options_t,
+    callback: rascal_chunk_callback_t,
+    user_data: *mut c_void,
+) -> rascal_status_t {
+    catch_unwind(|| {
+        check_pointers!(calculator, path);
+        let callback = callback.ok_or_else(|| Error::InvalidParameter(
+            "got invalid NULL pointer for callback".into()
+        ))?;
+
+        let path = CStr::from_ptr(path).to_str()?;
+        let options = convert_options(&options)?;
+
+        let descriptor = super::descriptor::rascal_descriptor();
+        let descriptor = scopeguard::guard(descriptor, |descriptor| {
+            super::descriptor::rascal_descriptor_free(descriptor);
+        });
+
+        let mut first_structure = 0;
+        for chunk in TrajectoryChunks::open(path, chunk_size)? {
+            let n_structures = (*calculator).compute_chunk(chunk?, &mut **descriptor, options.clone())?;
+
+            let status = callback(user_data, first_structure, *descriptor);
+            if !status.is_success() {
+                return Err(Error::External {
+                    status: status.as_i32(),
+                    message: "call to rascal_calculator_compute_trajectory callback failed".into(),
+                });
+            }
+
+            first_structure += n_structures;
+        }
+
+        Ok(())
+    })
+}
+
+/// Opaque type representing a trajectory being read in chunks, see
+/// `rascal_trajectory_chunks`.
+#[allow(non_camel_case_types)]
+pub struct rascal_trajectory_chunks_t {
+    chunks: TrajectoryChunks,
+    /// index of the first structure in the next chunk
+    next_structure: usize,
+}
+
+/// Start reading the trajectory file at `path` in chunks of at most
+/// `chunk_size` structures, to be used with
+/// `rascal_trajectory_chunks_compute_next`.
+///
+/// The file is read with chemfiles in a background thread, which reads the
+/// next chunk while the current one is being computed.
+///
+/// All memory allocated by this function can be released using
+/// `rascal_trajectory_chunks_free`.
+///
+/// @param path path of the file to read from in the local filesystem, as a
+///             NULL-terminated string
+/// @param chunk_size maximal number of structures in each chunk
+///
+/// @returns A pointer to the newly allocated trajectory chunks, or a `NULL`
+///          pointer in case of error. In case of error, you can use
+///          `rascal_last_error()` to get the error message.
+#[no_mangle]
+pub unsafe extern fn rascal_trajectory_chunks(path: *const c_char, chunk_size: usize) -> *mut rascal_trajectory_chunks_t {
+    let mut raw = std::ptr::null_mut();
+    let unwind_wrapper = std::panic::AssertUnwindSafe(&mut raw);
+    let status = catch_unwind(move || {
+        check_pointers!(path);
+        let path = CStr::from_ptr(path).to_str()?;
+        let chunks = TrajectoryChunks::open(path, chunk_size)?;
+        let boxed = Box::new(rascal_trajectory_chunks_t {
+            chunks: chunks,
+            next_structure: 0,
+        });
+
+        *unwind_wrapper.0 = Box::into_raw(boxed);
+        Ok(())
+    });
+
+    if !status.is_success() {
+        return std::ptr::null_mut();
+    }
+
+    return raw;
+}
+
+/// Free the memory associated with `chunks` previously created with
+/// `rascal_trajectory_chunks`, and stop reading the corresponding file.
+///
+/// If `chunks` is `NULL`, this function does nothing.
+///
+/// @param chunks pointer to existing trajectory chunks, or `NULL`
+///
+/// @returns The status code of this operation. If the status is not
+///          `RASCAL_SUCCESS`, you can use `rascal_last_error()` to get the
+///          full error message.
+#[no_mangle]
+pub unsafe extern fn rascal_trajectory_chunks_free(chunks: *mut rascal_trajectory_chunks_t) -> rascal_status_t {
+    catch_unwind(|| {
+        if !chunks.is_null() {
+            let boxed = Box::from_raw(chunks);
+            std::mem::drop(boxed);
+        }
+
+        Ok(())
+    })
+}
+
+#[allow(clippy::doc_markdown)]
+/// Run a calculation with the given `calculator` on the next chunk of
+/// structures in `chunks`, storing the resulting data in `descriptor`.
+///
+/// If there are no more structures in the trajectory, `*done` is set to `true`
+/// and `descriptor` is not modified. Otherwise, `*done` is set to `false` and
+/// `*first_structure` to the index of the first structure of this chunk in
+/// the trajectory. The `structure` samples in the descriptor are relative to
+/// the chunk.
+///
+/// @param chunks pointer to existing trajectory chunks
+/// @param calculator pointer to an existing calculator
+/// @param descriptor pointer to an existing descriptor for data storage
+/// @param options options for this calculation
+/// @param first_structure pointer to a single integer, will be set to the index
+///                        of the first structure in this chunk
+/// @param done pointer to a single boolean, will be set to `true` if there
+///             are no more structures in the trajectory
+///
+/// @returns The status code of this operation. If the status is not
+///          `RASCAL_SUCCESS`, you can use `rascal_last_error()` to get the full
+///          error message.
+#[no_mangle]
+pub unsafe extern fn rascal_trajectory_chunks_compute_next(
+    chunks: *mut rascal_trajectory_chunks_t,
+    calculator: *mut rascal_calculator_t,
+    descriptor: *mut rascal_descriptor_t,
+    options: rascal_calculation_options_t,
+    first_structure: *mut usize,
+    done: *mut bool,
+) -> rascal_status_t {
+    catch_unwind(|| {
+        check_pointers!(chunks, calculator, descriptor, first_structure, done);
+
+        let chunks = &mut *chunks;
+        match chunks.chunks.next() {
+            Some(chunk) => {
+                let options = convert_options(&options)?;
+                let n_structures = (*calculator).compute_chunk(chunk?, &mut *descriptor, options)?;
+
+                *first_structure = chunks.next_structure;
+                *done = false;
+                chunks.next_structure += n_structures;
+            }
+            None => {
+                *first_structure = chunks.next_structure;
+                *done = true;
+            }
+        }
+
+        Ok(())
+    })
+}
+
+/// Callback function type used by `rascal_calculator_compute_submit`, called
+/// from one of rascaline's threads once an asynchronous calculation is
+/// finished.
+///
+/// The first argument is the `user_data` pointer given to
+/// `rascal_calculator_compute_submit`, and the second argument is the status
+/// of the calculation. If the status is not `RASCAL_SUCCESS`, the callback can
+/// use `rascal_last_error()` to get the full error message. The calculator and
+/// the descriptor given to `rascal_calculator_compute_submit` can be used
+/// again (including freed) from the callback.
+#[allow(non_camel_case_types)]
+pub type rascal_calculation_callback_t = Option<unsafe extern fn(
+    user_data: *mut c_void,
+    status: rascal_status_t,
+)>;
+
+/// Shared state between an asynchronous calculation and the corresponding
+/// `rascal_calculation_t` handle
+struct CalculationState {
+    /// status and error message of the calculation, set once it is finished
+    result: Mutex<Option<(rascal_status_t, CString)>>,
+    finished: Condvar,
+}
+
+/// Pointers given to `rascal_calculator_compute_submit`, used from the thread
+/// running the calculation
+struct SubmittedPointers {
+    calculator: *mut rascal_calculator_t,
+    descriptor: *mut rascal_descriptor_t,
+    callback: rascal_calculation_callback_t,
+    user_data: *mut c_void,
+}
+
+// SAFETY: the caller of `rascal_calculator_compute_submit` guarantees that the
+// calculator and descriptor are not used by other threads until the
+// calculation is finished, and both `Calculator` and `Descriptor` are `Send`.
+// The callback and `user_data` must be thread safe by contract.
+unsafe impl Send for SubmittedPointers {}
+
+/// Opaque type representing a calculation running in the background, created
+/// with `rascal_calculator_compute_submit`.
+#[allow(non_camel_case_types)]
+pub struct rascal_calculation_t(Arc<CalculationState>);
+
+#[allow(clippy::doc_markdown)]
+/// Start a calculation with the given `calculator` on the given `systems` in
+/// the background, storing the resulting data in the `descriptor`. The
+/// calculation runs on rascaline's thread pool (see `rascal_set_num_threads`).
+///
+/// The data from the `systems` is copied before this function returns, so the
+/// systems can be modified or freed as soon as this function returns. This
+/// means `options.use_native_system` is always treated as `true`. The
+/// `calculator` and the `descriptor` are used until the calculation is
+/// finished, and must not be used, modified or freed by the caller before then.
+///
+/// The calculation is finished once `rascal_calculation_wait` returns,
+/// `rascal_calculation_poll` sets `done` to `true`, or `callback` is called.
+/// The `callback` is optional and can be `NULL`.
+///
+/// All memory allocated by this function can be released using
+/// `rascal_calculation_free`.
+///
+/// @param calculator pointer to an existing calculator
+/// @param descriptor pointer to an existing descriptor for data storage
+/// @param systems pointer to an array of systems implementation
+/// @param systems_count number of systems in `systems`
+/// @param options options for this calculation
+/// @param callback function called once the calculation is finished, or
+///                 `NULL`
+/// @param user_data pointer passed as the first argument to `callback`
+///
+/// @returns A pointer to the newly allocated calculation handle, or a `NULL`
+///          pointer in case of error. In case of error, you can use
+///          `rascal_last_error()` to get the error message.
+#[no_mangle]
+pub unsafe extern fn rascal_calculator_compute_submit(
+    calculator: *mut rascal_calculator_t,
+    descriptor: *mut rascal_descriptor_t,
+    systems: *mut rascal_system_t,
+    systems_count: usize,
+    options: rascal_calculation_options_t,
+    callback: rascal_calculation_callback_t,
+    user_data: *mut c_void,
+) -> *mut rascal_calculation_t {
+    let mut raw = std::ptr::null_mut();
+    let unwind_wrapper = std::panic::AssertUnwindSafe(&mut raw);
+    let status = catch_unwind(move || {
+        check_pointers!(calculator, descriptor);
+
+        // copy the data out of the systems on the calling thread, since
+        // `rascal_system_t` functions can not be called from other threads
+        let mut native_systems = Vec::with_capacity(systems_count);
+        if systems_count != 0 {
+            check_pointers!(systems);
+            for system in borrowed_systems(systems, systems_count)? {
+                native_systems.push(SimpleSystem::try_from(&*system)?);
+            }
+        }
+        let options = convert_options(&options)?;
+
+        let state = Arc::new(CalculationState {
+            result: Mutex::new(None),
+            finished: Condvar::new(),
+        });
+
+        let pointers = SubmittedPointers { calculator, descriptor, callback, user_data };
+        let task_state = Arc::clone(&state);
+        rascaline::threads::spawn(move || {
+            let status = catch_unwind(std::panic::AssertUnwindSafe(|| {
+                (*pointers.calculator).compute_chunk(native_systems, &mut *pointers.descriptor, options)?;
+                Ok(())
+            }));
+
+            let message = if status.is_success() {
+                CString::default()
+            } else {
+                LAST_ERROR_MESSAGE.with(|message| message.borrow().clone())
+            };
+
+            {
+                let mut result = task_state.result.lock().expect("mutex was poisoned");
+                *result = Some((status, message));
+                task_state.finished.notify_all();
+            }
+
+            if let Some(callback) = pointers.callback {
+                // the error message is still set on this thread
+                callback(pointers.user_data, status);
+            }
+        });
+
+        *unwind_wrapper.0 = Box::into_raw(Box::new(rascal_calculation_t(state)));
+        Ok(())
+    });
+
+    if !status.is_success() {
+        return std::ptr::null_mut();
+    }
+
+    return raw;
+}
+
+/// Check if the given asynchronous `calculation` is finished, without
+/// blocking.
+///
+/// @param calculation pointer to an existing calculation handle
+/// @param done pointer to a single boolean, will be set to `true` if the
+///             calculation is finished
+///
+/// @returns The status code of this operation. If the status is not
+///          `RASCAL_SUCCESS`, you can use `rascal_last_error()` to get the full
+///          error message.
+#[no_mangle]
+pub unsafe extern fn rascal_calculation_poll(
+    calculation: *const rascal_calculation_t,
+    done: *mut bool,
+) -> rascal_status_t {
+    catch_unwind(|| {
+        check_pointers!(calculation, done);
+        let result = (*calculation).0.result.lock().expect("mutex was poisoned");
+        *done = result.is_some();
+        Ok(())
+    })
+}
+
+/// Wait for the given asynchronous `calculation` to finish.
+///
+/// This function returns the status of the calculation: if the calculation
+/// failed, this function returns the corresponding error status, and
+/// `rascal_last_error()` gives the full error message. This function can be
+/// called multiple times, and always returns the same status.
+///
+/// @param calculation pointer to an existing calculation handle
+///
+/// @returns The status code of the calculation. If the status is not
+///          `RASCAL_SUCCESS`, you can use `rascal_last_error()` to get the full
+///          error message.
+#[no_mangle]
+pub unsafe extern fn rascal_calculation_wait(calculation: *const rascal_calculation_t) -> rascal_status_t {
+    let mut calculation_status = None;
+    let wrapper = std::panic::AssertUnwindSafe(&mut calculation_status);
+    let status = catch_unwind(move || {
+        check_pointers!(calculation);
+        let state = &(*calculation).0;
+        let mut result = state.result.lock().expect("mutex was poisoned");
+        while result.is_none() {
+            result = state.finished.wait(result).expect("mutex was poisoned");
+        }
+
+        let (status, message) = result.as_ref().expect("missing calculation result");
+        if !status.is_success() {
+            LAST_ERROR_MESSAGE.with(|last_message| {
+                *last_message.borrow_mut() = message.clone();
+            });
+        }
+
+        *wrapper.0 = Some(*status);
+        Ok(())
+    });
+
+    return calculation_status.unwrap_or(status);
+}
+
+/// Free the memory associated with an asynchronous `calculation` previously
+/// created with `rascal_calculator_compute_submit`.
+///
+/// This does not stop or wait for the calculation: if it is still running, it
+/// will continue in the background, and the calculator and descriptor must
+/// stay alive until it is finished. In this case, the `callback` given to
+/// `rascal_calculator_compute_submit` is the only way to know when the
+/// calculation is finished.
+///
+/// If `calculation` is `NULL`, this function does nothing.
+///
+/// @param calculation pointer to an existing calculation handle, or `NULL`
+///
+/// @returns The status code of this operation. If the status is not
+///          `RASCAL_SUCCESS`, you can use `rascal_last_error()` to get the
+///          full error message.
+#[no_mangle]
+pub unsafe extern fn rascal_calculation_free(calculation: *mut rascal_calculation_t) -> rascal_status_t {
+    catch_unwind(|| {
+        if !calculation.is_null() {
+            let boxed = Box::from_raw(calculation);
+            std::mem::drop(boxed);
+        }
+        Ok(())
     })
 }
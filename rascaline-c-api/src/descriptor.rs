@@ -2,13 +2,22 @@ use std::ops::{Deref, DerefMut};
 use std::os::raw::c_char;
 use std::ffi::CStr;
 
-use rascaline::descriptor::{Descriptor, IndexValue};
+use rascaline::descriptor::{Descriptor, Indexes, IndexValue};
 use rascaline::Error;
 use super::{catch_unwind, rascal_status_t};
 
 /// Opaque type representing a `Descriptor`.
 #[allow(non_camel_case_types)]
-pub struct rascal_descriptor_t(Descriptor);
+pub struct rascal_descriptor_t(Descriptor, GradientsBlocksStorage);
+
+/// Storage for the offsets and atoms returned by
+/// `rascal_descriptor_gradients_blocks`, which need to outlive the call to
+/// this function.
+#[derive(Default)]
+pub struct GradientsBlocksStorage {
+    offsets: Vec<usize>,
+    atoms: Vec<i32>,
+}
 
 impl Deref for rascal_descriptor_t {
     type Target = Descriptor;
@@ -34,7 +43,7 @@ impl DerefMut for rascal_descriptor_t {
 #[no_mangle]
 #[allow(clippy::module_name_repetitions)]
 pub unsafe extern fn rascal_descriptor() -> *mut rascal_descriptor_t {
-    let descriptor = Box::new(rascal_descriptor_t(Descriptor::new()));
+    let descriptor = Box::new(rascal_descriptor_t(Descriptor::new(), GradientsBlocksStorage::default()));
     return Box::into_raw(descriptor);
 }
 
@@ -151,6 +160,84 @@ pub unsafe extern fn rascal_descriptor_gradients(
     })
 }
 
+#[allow(clippy::doc_markdown)]
+/// Get a block-sparse view of the gradients stored inside this descriptor
+/// after a call to `rascal_calculator_compute`, if any.
+///
+/// The gradients are organized in blocks of 3 x `features` values (one row for
+/// each of the x/y/z cartesian components), each block containing the
+/// gradients of a given sample with respect to the position of a given atom.
+/// The blocks for sample `i` are `(*offsets)[i]` to `(*offsets)[i + 1]`
+/// (excluded), and the gradients in block `b` are taken with respect to the
+/// position of atom `(*atoms)[b]`. `*data` points to the first element of a
+/// row-major 3D array of shape `*blocks` x 3 x `*features` containing the
+/// gradients. This array shares memory with the one given by
+/// `rascal_descriptor_gradients`.
+///
+/// `*offsets` and `*atoms` are only valid until the next call to this function
+/// or to `rascal_calculator_compute` with the same `descriptor`.
+///
+/// If this descriptor does not contain gradient data, all pointers are set to
+/// `NULL` and all sizes to 0.
+///
+/// @param descriptor pointer to an existing descriptor
+/// @param offsets pointer to a pointer to an integer, will be set to the
+///                address of an array containing `*samples + 1` offsets
+/// @param samples pointer to a single integer, will be set to the number of
+///                samples in this descriptor
+/// @param atoms pointer to a pointer to a 32-bit integer, will be set to the
+///              address of an array containing `*blocks` atomic indexes
+/// @param data pointer to a pointer to a double, will be set to the address of
+///             the first element in the gradients array
+/// @param blocks pointer to a single integer, will be set to the total number
+///               of blocks
+/// @param features pointer to a single integer, will be set to the number of
+///                 features
+///
+/// @returns The status code of this operation. If the status is not
+///          `RASCAL_SUCCESS`, you can use `rascal_last_error()` to get the full
+///          error message.
+#[no_mangle]
+#[allow(clippy::too_many_arguments)]
+pub unsafe extern fn rascal_descriptor_gradients_blocks(
+    descriptor: *mut rascal_descriptor_t,
+    offsets: *mut *const usize,
+    samples: *mut usize,
+    atoms: *mut *const i32,
+    data: *mut *mut f64,
+    blocks: *mut usize,
+    features: *mut usize,
+) -> rascal_status_t {
+    catch_unwind(|| {
+        check_pointers!(descriptor, offsets, samples, atoms, data, blocks, features);
+
+        let rascal_descriptor_t(descriptor, storage) = &mut *descriptor;
+        let gradients_blocks = descriptor.gradients_blocks()?;
+        if let Some(gradients_blocks) = gradients_blocks {
+            let shape = gradients_blocks.values.shape();
+            *samples = descriptor.samples.count();
+            *blocks = shape[0];
+            *features = shape[2];
+
+            storage.offsets = gradients_blocks.offsets;
+            storage.atoms = gradients_blocks.atoms;
+
+            *offsets = storage.offsets.as_ptr();
+            *atoms = storage.atoms.as_ptr();
+            *data = descriptor.gradients.as_mut().expect("missing gradients").as_mut_ptr();
+        } else {
+            *offsets = std::ptr::null();
+            *samples = 0;
+            *atoms = std::ptr::null();
+            *data = std::ptr::null_mut();
+            *blocks = 0;
+            *features = 0;
+        }
+
+        Ok(())
+    })
+}
+
 #[repr(C)]
 #[allow(non_camel_case_types)]
 /// The different kinds of indexes that can exist on a `rascal_descriptor_t`
@@ -212,40 +299,46 @@ pub unsafe extern fn rascal_descriptor_indexes(
         check_pointers!(descriptor, indexes);
 
         let rust_indexes = match kind {
-            rascal_indexes_kind::RASCAL_INDEXES_FEATURES => &(*descriptor).features,
-            rascal_indexes_kind::RASCAL_INDEXES_SAMPLES => &(*descriptor).samples,
-            rascal_indexes_kind::RASCAL_INDEXES_GRADIENT_SAMPLES => {
-                if let Some(indexes) = &(*descriptor).gradients_samples {
-                    indexes
-                } else {
-                    (*indexes).values = std::ptr::null();
-                    (*indexes).names = std::ptr::null();
-                    (*indexes).size = 0;
-                    (*indexes).count = 0;
-                    return Ok(());
-                }
-            }
+            rascal_indexes_kind::RASCAL_INDEXES_FEATURES => Some(&(*descriptor).features),
+            rascal_indexes_kind::RASCAL_INDEXES_SAMPLES => Some(&(*descriptor).samples),
+            rascal_indexes_kind::RASCAL_INDEXES_GRADIENT_SAMPLES => (*descriptor).gradients_samples.as_ref(),
         };
 
-        (*indexes).size = rust_indexes.size();
-        (*indexes).count = rust_indexes.count();
-
-        if rust_indexes.count() == 0 {
-            (*indexes).values = std::ptr::null();
-        } else {
-            (*indexes).values = (&rust_indexes[0][0] as *const IndexValue).cast();
-        }
-
-        if rust_indexes.size() == 0 {
-            (*indexes).names = std::ptr::null();
-        } else {
-            (*indexes).names = rust_indexes.c_names().as_ptr().cast();
-        }
+        set_indexes(rust_indexes, &mut *indexes);
 
         Ok(())
     })
 }
 
+/// Set the fields of the C `indexes` to point inside `rust_indexes`, or to
+/// `NULL`/0 if `rust_indexes` is `None`.
+pub(crate) fn set_indexes(rust_indexes: Option<&Indexes>, indexes: &mut rascal_indexes_t) {
+    let rust_indexes = if let Some(rust_indexes) = rust_indexes {
+        rust_indexes
+    } else {
+        indexes.values = std::ptr::null();
+        indexes.names = std::ptr::null();
+        indexes.size = 0;
+        indexes.count = 0;
+        return;
+    };
+
+    indexes.size = rust_indexes.size();
+    indexes.count = rust_indexes.count();
+
+    if rust_indexes.count() == 0 {
+        indexes.values = std::ptr::null();
+    } else {
+        indexes.values = (&rust_indexes[0][0] as *const IndexValue).cast();
+    }
+
+    if rust_indexes.size() == 0 {
+        indexes.names = std::ptr::null();
+    } else {
+        indexes.names = rust_indexes.c_names().as_ptr().cast();
+    }
+}
+
 /// Make the given `descriptor` dense along the given `variables`.
 ///
 /// The `variable` array should contain the name of the variables as
@@ -0,0 +1,199 @@
+use std::ops::Deref;
+
+use rascaline::descriptor::{Descriptor, DescriptorF32};
+
+use super::{catch_unwind, rascal_status_t};
+use super::descriptor::{rascal_descriptor_t, rascal_indexes_t, rascal_indexes_kind, set_indexes};
+
+/// Opaque type representing a `DescriptorF32`, i.e. a descriptor with values
+/// and gradients stored in single precision.
+#[allow(non_camel_case_types)]
+pub struct rascal_descriptor_f32_t(DescriptorF32);
+
+impl Deref for rascal_descriptor_f32_t {
+    type Target = DescriptorF32;
+    fn deref(&self) -> &Self::Target {
+        &self.0
+    }
+}
+
+/// Convert the data in `descriptor` to single precision, creating a new
+/// `rascal_descriptor_f32_t`.
+///
+/// The data is moved out of `descriptor` and not copied, so `descriptor` will
+/// be empty after a call to this function. It can still be used in another
+/// call to `rascal_calculator_compute`.
+///
+/// All memory allocated by this function can be released using
+/// `rascal_descriptor_f32_free`.
+///
+/// @param descriptor pointer to an existing descriptor
+///
+/// @returns A pointer to the newly allocated single precision descriptor, or
+///          a `NULL` pointer in case of error. In case of error, you can use
+///          `rascal_last_error()` to get the error message.
+#[no_mangle]
+pub unsafe extern fn rascal_descriptor_to_f32(descriptor: *mut rascal_descriptor_t) -> *mut rascal_descriptor_f32_t {
+    let mut raw = std::ptr::null_mut();
+    let unwind_wrapper = std::panic::AssertUnwindSafe(&mut raw);
+    let status = catch_unwind(move || {
+        check_pointers!(descriptor);
+        let descriptor = std::mem::replace(&mut **descriptor, Descriptor::new());
+        let boxed = Box::new(rascal_descriptor_f32_t(descriptor.into_f32()));
+
+        *unwind_wrapper.0 = Box::into_raw(boxed);
+        Ok(())
+    });
+
+    if !status.is_success() {
+        return std::ptr::null_mut();
+    }
+
+    return raw;
+}
+
+/// Free the memory associated with a `descriptor` previously created with
+/// `rascal_descriptor_to_f32`.
+///
+/// If `descriptor` is `NULL`, this function does nothing.
+///
+/// @param descriptor pointer to an existing single precision descriptor, or
+///                   `NULL`
+///
+/// @returns The status code of this operation. If the status is not
+///          `RASCAL_SUCCESS`, you can use `rascal_last_error()` to get the
+///          full error message.
+#[no_mangle]
+pub unsafe extern fn rascal_descriptor_f32_free(descriptor: *mut rascal_descriptor_f32_t) -> rascal_status_t {
+    catch_unwind(|| {
+        if !descriptor.is_null() {
+            let boxed = Box::from_raw(descriptor);
+            std::mem::drop(boxed);
+        }
+        Ok(())
+    })
+}
+
+/// Get the single precision values stored inside this `descriptor`.
+///
+/// This function sets `*data` to a pointer containing the address of first
+/// element of the **read only** 2D array containing the values, `*samples` to
+/// the size of the first axis of this array and `*features` to the size of the
+/// second axis of the array. The array is stored using a row-major layout.
+///
+/// @param descriptor pointer to an existing single precision descriptor
+/// @param data pointer to a pointer to a float, will be set to the address of
+///             the first element in the values array
+/// @param samples pointer to a single integer, will be set to the first
+///                dimension of the values array
+/// @param features pointer to a single integer, will be set to the second
+///                 dimension of the values array
+///
+/// @returns The status code of this operation. If the status is not
+///          `RASCAL_SUCCESS`, you can use `rascal_last_error()` to get the full
+///          error message.
+#[no_mangle]
+pub unsafe extern fn rascal_descriptor_f32_values(
+    descriptor: *const rascal_descriptor_f32_t,
+    data: *mut *const f32,
+    samples: *mut usize,
+    features: *mut usize
+) -> rascal_status_t {
+    catch_unwind(|| {
+        check_pointers!(descriptor, data, samples, features);
+
+        let array = &(*descriptor).values;
+        if array.is_empty() {
+            *data = std::ptr::null();
+        } else {
+            *data = array.as_ptr();
+        }
+
+        let shape = array.shape();
+        *samples = shape[0];
+        *features = shape[1];
+
+        Ok(())
+    })
+}
+
+/// Get the single precision gradients stored inside this `descriptor`, if any.
+///
+/// This function sets `*data` to to a pointer containing the address of the
+/// first element of the **read only** 2D array containing the gradients,
+/// `*gradient_samples` to the size of the first axis of this array and
+/// `*features` to the size of the second axis of the array. The array is
+/// stored using a row-major layout.
+///
+/// If this descriptor does not contain gradient data, `*data` is set to `NULL`,
+/// while `*gradient_samples` and `*features` are set to 0.
+///
+/// @param descriptor pointer to an existing single precision descriptor
+/// @param data pointer to a pointer to a float, will be set to the address of
+///             the first element in the gradients array
+/// @param gradient_samples pointer to a single integer, will be set to the first
+///                         dimension of the gradients array
+/// @param features pointer to a single integer, will be set to the second
+///                 dimension of the gradients array
+///
+/// @returns The status code of this operation. If the status is not
+///          `RASCAL_SUCCESS`, you can use `rascal_last_error()` to get the full
+///          error message.
+#[no_mangle]
+pub unsafe extern fn rascal_descriptor_f32_gradients(
+    descriptor: *const rascal_descriptor_f32_t,
+    data: *mut *const f32,
+    gradient_samples: *mut usize,
+    features: *mut usize
+) -> rascal_status_t {
+    catch_unwind(|| {
+        check_pointers!(descriptor, data, gradient_samples, features);
+
+        if let Some(ref array) = (*descriptor).gradients {
+            *data = array.as_ptr();
+            let shape = array.shape();
+            *gradient_samples = shape[0];
+            *features = shape[1];
+        } else {
+            *data = std::ptr::null();
+            *gradient_samples = 0;
+            *features = 0;
+        }
+
+        Ok(())
+    })
+}
+
+/// Get the values associated with one of the `indexes` in the given single
+/// precision `descriptor`.
+///
+/// This function behaves like `rascal_descriptor_indexes`, please refer to its
+/// documentation for more information.
+///
+/// @param descriptor pointer to an existing single precision descriptor
+/// @param kind type of indexes requested
+/// @param indexes pointer to `rascal_indexes_t` that will be filled by this function
+///
+/// @returns The status code of this operation. If the status is not
+///          `RASCAL_SUCCESS`, you can use `rascal_last_error()` to get the full
+///          error message.
+#[no_mangle]
+pub unsafe extern fn rascal_descriptor_f32_indexes(
+    descriptor: *const rascal_descriptor_f32_t,
+    kind: rascal_indexes_kind,
+    indexes: *mut rascal_indexes_t,
+) -> rascal_status_t {
+    catch_unwind(|| {
+        check_pointers!(descriptor, indexes);
+
+        let rust_indexes = match kind {
+            rascal_indexes_kind::RASCAL_INDEXES_FEATURES => Some(&(*descriptor).features),
+            rascal_indexes_kind::RASCAL_INDEXES_SAMPLES => Some(&(*descriptor).samples),
+            rascal_indexes_kind::RASCAL_INDEXES_GRADIENT_SAMPLES => (*descriptor).gradients_samples.as_ref(),
+        };
+
+        set_indexes(rust_indexes, &mut *indexes);
+
+        Ok(())
+    })
+}
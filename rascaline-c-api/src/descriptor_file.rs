@@ -0,0 +1,341 @@
+use std::ops::Deref;
+use std::os::raw::c_char;
+use std::ffi::CStr;
+
+use rascaline::descriptor::{MappedDescriptor, IndexValue};
+
+use super::utils::copy_str_to_c;
+use super::{catch_unwind, rascal_status_t};
+
+use super::calculator::rascal_calculator_t;
+use super::descriptor::{rascal_descriptor_t, rascal_indexes_t, rascal_indexes_kind, set_indexes};
+
+/// Save the given `descriptor` to the file at `path`, in rascaline's own
+/// binary format. The name and parameters of the `calculator` used to create
+/// the descriptor are stored alongside the values, gradients and indexes.
+///
+/// The file can then be opened with `rascal_mapped_descriptor_open`.
+///
+/// @param descriptor pointer to an existing descriptor
+/// @param calculator pointer to the calculator used to create the descriptor
+/// @param path path of the file to write to in the local filesystem, as a
+///             NULL-terminated string
+///
+/// @returns The status code of this operation. If the status is not
+///          `RASCAL_SUCCESS`, you can use `rascal_last_error()` to get the full
+///          error message.
+#[no_mangle]
+pub unsafe extern fn rascal_descriptor_save(
+    descriptor: *const rascal_descriptor_t,
+    calculator: *const rascal_calculator_t,
+    path: *const c_char,
+) -> rascal_status_t {
+    catch_unwind(|| {
+        check_pointers!(descriptor, calculator, path);
+        let path = CStr::from_ptr(path).to_str()?;
+        (*descriptor).save(path, &*calculator)?;
+        Ok(())
+    })
+}
+
+/// Opaque type representing a `MappedDescriptor`, i.e. a read-only descriptor
+/// stored in a memory-mapped file.
+#[allow(non_camel_case_types)]
+pub struct rascal_mapped_descriptor_t(MappedDescriptor);
+
+impl Deref for rascal_mapped_descriptor_t {
+    type Target = MappedDescriptor;
+    fn deref(&self) -> &Self::Target {
+        &self.0
+    }
+}
+
+/// Open the descriptor file at `path` (created by `rascal_descriptor_save`) as
+/// a read-only memory map. The values and gradients are read directly from
+/// the file when needed instead of being copied in memory.
+///
+/// All memory allocated by this function can be released using
+/// `rascal_mapped_descriptor_free`.
+///
+/// @param path path of the file to read from in the local filesystem, as a
+///             NULL-terminated string
+///
+/// @returns A pointer to the newly allocated mapped descriptor, or a `NULL`
+///          pointer in case of error. In case of error, you can use
+///          `rascal_last_error()` to get the error message.
+#[no_mangle]
+pub unsafe extern fn rascal_mapped_descriptor_open(path: *const c_char) -> *mut rascal_mapped_descriptor_t {
+    let mut raw = std::ptr::null_mut();
+    let unwind_wrapper = std::panic::AssertUnwindSafe(&mut raw);
+    let status = catch_unwind(move || {
+        check_pointers!(path);
+        let path = CStr::from_ptr(path).to_str()?;
+        let descriptor = MappedDescriptor::open(path)?;
+        let boxed = Box::new(rascal_mapped_descriptor_t(descriptor));
+
+        *unwind_wrapper.0 = Box::into_raw(boxed);
+        Ok(())
+    });
+
+    if !status.is_success() {
+        return std::ptr::null_mut();
+    }
+
+    return raw;
+}
+
+/// Free the memory associated with a `descriptor` previously created with
+/// `rascal_mapped_descriptor_open`, and close the corresponding file.
+///
+/// If `descriptor` is `NULL`, this function does nothing.
+///
+/// @param descriptor pointer to an existing mapped descriptor, or `NULL`
+///
+/// @returns The status code of this operation. If the status is not
+///          `RASCAL_SUCCESS`, you can use `rascal_last_error()` to get the
+///          full error message.
+#[no_mangle]
+pub unsafe extern fn rascal_mapped_descriptor_free(descriptor: *mut rascal_mapped_descriptor_t) -> rascal_status_t {
+    catch_unwind(|| {
+        if !descriptor.is_null() {
+            let boxed = Box::from_raw(descriptor);
+            std::mem::drop(boxed);
+        }
+        Ok(())
+    })
+}
+
+/// Get a copy of the name of the calculator used to create this `descriptor`
+/// in the `name` buffer of size `bufflen`.
+///
+/// `name` will be NULL-terminated by this function. If the buffer is too small
+/// to fit the whole name, this function will return
+/// `RASCAL_BUFFER_SIZE_ERROR`
+///
+/// @param descriptor pointer to an existing mapped descriptor
+/// @param name string buffer to fill with the calculator name
+/// @param bufflen number of characters available in the buffer
+///
+/// @returns The status code of this operation. If the status is not
+///          `RASCAL_SUCCESS`, you can use `rascal_last_error()` to get the full
+///          error message.
+#[no_mangle]
+pub unsafe extern fn rascal_mapped_descriptor_name(
+    descriptor: *const rascal_mapped_descriptor_t,
+    name: *mut c_char,
+    bufflen: usize
+) -> rascal_status_t {
+    catch_unwind(|| {
+        check_pointers!(descriptor, name);
+        copy_str_to_c((*descriptor).name(), name, bufflen)?;
+        Ok(())
+    })
+}
+
+/// Get a copy of the parameters of the calculator used to create this
+/// `descriptor` in the `parameters` buffer of size `bufflen`.
+///
+/// `parameters` will be NULL-terminated by this function. If the buffer is too
+/// small to fit the whole parameters, this function will return
+/// `RASCAL_BUFFER_SIZE_ERROR`.
+///
+/// @param descriptor pointer to an existing mapped descriptor
+/// @param parameters string buffer to fill with the calculator parameters
+/// @param bufflen number of characters available in the buffer
+///
+/// @returns The status code of this operation. If the status is not
+///          `RASCAL_SUCCESS`, you can use `rascal_last_error()` to get the full
+///          error message.
+#[no_mangle]
+pub unsafe extern fn rascal_mapped_descriptor_parameters(
+    descriptor: *const rascal_mapped_descriptor_t,
+    parameters: *mut c_char,
+    bufflen: usize
+) -> rascal_status_t {
+    catch_unwind(|| {
+        check_pointers!(descriptor, parameters);
+        copy_str_to_c((*descriptor).parameters(), parameters, bufflen)?;
+        Ok(())
+    })
+}
+
+/// Get the values stored inside this mapped `descriptor`.
+///
+/// This function sets `*data` to a pointer containing the address of first
+/// element of the **read only** 2D array containing the values, `*samples` to
+/// the size of the first axis of this array and `*features` to the size of the
+/// second axis of the array. The array is stored using a row-major layout.
+///
+/// @param descriptor pointer to an existing mapped descriptor
+/// @param data pointer to a pointer to a double, will be set to the address of
+///             the first element in the values array
+/// @param samples pointer to a single integer, will be set to the first
+///                dimension of the values array
+/// @param features pointer to a single integer, will be set to the second
+///                 dimension of the values array
+///
+/// @returns The status code of this operation. If the status is not
+///          `RASCAL_SUCCESS`, you can use `rascal_last_error()` to get the full
+///          error message.
+#[no_mangle]
+pub unsafe extern fn rascal_mapped_descriptor_values(
+    descriptor: *const rascal_mapped_descriptor_t,
+    data: *mut *const f64,
+    samples: *mut usize,
+    features: *mut usize
+) -> rascal_status_t {
+    catch_unwind(|| {
+        check_pointers!(descriptor, data, samples, features);
+
+        let array = (*descriptor).values();
+        if array.is_empty() {
+            *data = std::ptr::null();
+        } else {
+            *data = array.as_ptr();
+        }
+
+        let shape = array.shape();
+        *samples = shape[0];
+        *features = shape[1];
+
+        Ok(())
+    })
+}
+
+/// Get the gradients stored inside this mapped `descriptor`, if any.
+///
+/// This function sets `*data` to to a pointer containing the address of the
+/// first element of the **read only** 2D array containing the gradients,
+/// `*gradient_samples` to the size of the first axis of this array and
+/// `*features` to the size of the second axis of the array. The array is
+/// stored using a row-major layout.
+///
+/// If this descriptor does not contain gradient data, `*data` is set to `NULL`,
+/// while `*gradient_samples` and `*features` are set to 0.
+///
+/// @param descriptor pointer to an existing mapped descriptor
+/// @param data pointer to a pointer to a double, will be set to the address of
+///             the first element in the gradients array
+/// @param gradient_samples pointer to a single integer, will be set to the first
+///                         dimension of the gradients array
+/// @param features pointer to a single integer, will be set to the second
+///                 dimension of the gradients array
+///
+/// @returns The status code of this operation. If the status is not
+///          `RASCAL_SUCCESS`, you can use `rascal_last_error()` to get the full
+///          error message.
+#[no_mangle]
+pub unsafe extern fn rascal_mapped_descriptor_gradients(
+    descriptor: *const rascal_mapped_descriptor_t,
+    data: *mut *const f64,
+    gradient_samples: *mut usize,
+    features: *mut usize
+) -> rascal_status_t {
+    catch_unwind(|| {
+        check_pointers!(descriptor, data, gradient_samples, features);
+
+        if let Some(array) = (*descriptor).gradients() {
+            *data = array.as_ptr();
+            let shape = array.shape();
+            *gradient_samples = shape[0];
+            *features = shape[1];
+        } else {
+            *data = std::ptr::null();
+            *gradient_samples = 0;
+            *features = 0;
+        }
+
+        Ok(())
+    })
+}
+
+/// Get the values associated with one of the `indexes` in the given mapped
+/// `descriptor`.
+///
+/// This function behaves like `rascal_descriptor_indexes`, please refer to its
+/// documentation for more information.
+///
+/// @param descriptor pointer to an existing mapped descriptor
+/// @param kind type of indexes requested
+/// @param indexes pointer to `rascal_indexes_t` that will be filled by this function
+///
+/// @returns The status code of this operation. If the status is not
+///          `RASCAL_SUCCESS`, you can use `rascal_last_error()` to get the full
+///          error message.
+#[no_mangle]
+pub unsafe extern fn rascal_mapped_descriptor_indexes(
+    descriptor: *const rascal_mapped_descriptor_t,
+    kind: rascal_indexes_kind,
+    indexes: *mut rascal_indexes_t,
+) -> rascal_status_t {
+    catch_unwind(|| {
+        check_pointers!(descriptor, indexes);
+
+        let rust_indexes = match kind {
+            rascal_indexes_kind::RASCAL_INDEXES_FEATURES => Some((*descriptor).features()),
+            rascal_indexes_kind::RASCAL_INDEXES_SAMPLES => Some((*descriptor).samples()),
+            rascal_indexes_kind::RASCAL_INDEXES_GRADIENT_SAMPLES => (*descriptor).gradients_samples(),
+        };
+
+        set_indexes(rust_indexes, &mut *indexes);
+
+        Ok(())
+    })
+}
+
+/// Store the data in the mapped `descriptor`, made dense along the given
+/// `variables`, inside the `output` descriptor. The data is read directly from
+/// the file, without creating an intermediary copy of the sparse descriptor.
+///
+/// This function behaves like `rascal_descriptor_densify`, please refer to its
+/// documentation for more information on the `variables` and `requested`
+/// parameters. If `variables_count` is 0, `output` will contain a copy of the
+/// data in the mapped descriptor.
+///
+/// @param descriptor pointer to an existing mapped descriptor
+/// @param variables array of NULL-terminated strings containing the names of
+///                  the variables to make dense
+/// @param variables_count number of elements in the `variables` array
+/// @param requested set of values taken by the variables to use as new
+///                  features, or `NULL`
+/// @param requested_size number of rows in `requested`
+/// @param output pointer to an existing descriptor, which will be overwritten
+///               with the new data
+///
+/// @returns The status code of this operation. If the status is not
+///          `RASCAL_SUCCESS`, you can use `rascal_last_error()` to get the full
+///          error message.
+#[no_mangle]
+pub unsafe extern fn rascal_mapped_descriptor_densify(
+    descriptor: *const rascal_mapped_descriptor_t,
+    variables: *const *const c_char,
+    variables_count: usize,
+    requested: *const i32,
+    requested_size: usize,
+    output: *mut rascal_descriptor_t,
+) -> rascal_status_t {
+    catch_unwind(|| {
+        check_pointers!(descriptor, output);
+        let mut rust_variables = Vec::new();
+        if variables_count != 0 {
+            check_pointers!(variables);
+            for &variable in std::slice::from_raw_parts(variables, variables_count) {
+                check_pointers!(variable);
+                let variable = CStr::from_ptr(variable).to_str()?;
+                rust_variables.push(variable);
+            }
+        }
+
+        let requested = if requested.is_null() {
+            None
+        } else {
+            Some(ndarray::ArrayView2::from_shape_ptr(
+                [requested_size, variables_count], requested.cast::<IndexValue>()
+            ))
+        };
+
+        **output = (*descriptor).densify(&rust_variables, requested)?;
+
+        Ok(())
+    })
+}
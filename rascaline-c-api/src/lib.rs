@@ -11,7 +11,7 @@ mod status;
 pub use self::status::{catch_unwind, rascal_status_t};
 pub use self::status::{RASCAL_SUCCESS, RASCAL_INVALID_PARAMETER_ERROR, RASCAL_JSON_ERROR};
 pub use self::status::{RASCAL_UTF8_ERROR, RASCAL_CHEMFILES_ERROR, RASCAL_SYSTEM_ERROR};
-pub use self::status::{RASCAL_BUFFER_SIZE_ERROR, RASCAL_INTERNAL_ERROR};
+pub use self::status::{RASCAL_IO_ERROR, RASCAL_BUFFER_SIZE_ERROR, RASCAL_INTERNAL_ERROR};
 
 mod logging;
 pub use self::logging::{RASCAL_LOG_LEVEL_ERROR, RASCAL_LOG_LEVEL_WARN, RASCAL_LOG_LEVEL_INFO};
@@ -20,6 +20,9 @@ pub use self::logging::{rascal_logging_callback_t, rascal_set_logging_callback};
 
 pub mod system;
 pub mod descriptor;
+pub mod descriptor_file;
+pub mod descriptor_f32;
 pub mod calculator;
 
 pub mod profiling;
+pub mod threads;
@@ -2,11 +2,13 @@ use std::os::raw::c_char;
 use std::ffi::CStr;
 
 use rascaline::Error;
+use rascaline::metrics;
 
 use crate::{catch_unwind, rascal_status_t};
 use crate::utils::copy_str_to_c;
 
-/// Clear all collected profiling data
+/// Clear all collected profiling data, including the metrics returned by
+/// `rascal_profiling_metrics`
 ///
 /// See also `rascal_profiling_enable` and `rascal_profiling_get`.
 ///
@@ -17,6 +19,7 @@ use crate::utils::copy_str_to_c;
 pub unsafe extern fn rascal_profiling_clear() -> rascal_status_t {
     catch_unwind(|| {
         time_graph::clear_collected_data();
+        metrics::clear();
         Ok(())
     })
 }
@@ -28,7 +31,10 @@ pub unsafe extern fn rascal_profiling_clear() -> rascal_status_t {
 /// Rascaline uses the [`time_graph`](https://docs.rs/time-graph/) to collect
 /// timing information on the calculations. This profiling code collects the
 /// total time spent inside the most important functions, as well as the
-/// function call graph (which function called which other function).
+/// function call graph (which function called which other function). It also
+/// collects counters (number of pairs and samples processed, memory used by
+/// descriptors, busy/idle time of the threads, *etc.*), see
+/// `rascal_profiling_metrics`.
 ///
 /// You can use `rascal_profiling_clear` to reset profiling data to an empty
 /// state, and `rascal_profiling_get` to extract the profiling data.
@@ -42,6 +48,7 @@ pub unsafe extern fn rascal_profiling_clear() -> rascal_status_t {
 pub unsafe extern fn rascal_profiling_enable(enabled: bool) -> rascal_status_t {
     catch_unwind(|| {
         time_graph::enable_data_collection(enabled);
+        metrics::enable(enabled);
         Ok(())
     })
 }
@@ -51,7 +58,9 @@ pub unsafe extern fn rascal_profiling_enable(enabled: bool) -> rascal_status_t {
 /// See also `rascal_profiling_enable` and `rascal_profiling_clear`.
 ///
 /// @param format in which format should the data be provided. `"table"`,
-///              `"short_table"` and `"json"` are currently supported
+///              `"short_table"` and `"json"` are currently supported for
+///              timing data, and `"metrics"` gives the counters described in
+///              `rascal_profiling_metrics_t` as JSON
 /// @param buffer pre-allocated buffer in which profiling data will be copied.
 ///               If the buffer is too small, this function will return
 ///               `RASCAL_BUFFER_SIZE_ERROR`
@@ -79,8 +88,11 @@ pub unsafe extern fn rascal_profiling_get(
             "json" => {
                 time_graph::get_full_graph().as_json()
             },
+            "metrics" => {
+                metrics::get().as_json()
+            },
             format => return Err(Error::InvalidParameter(format!(
-                "invalid data format in rascal_profiling_get: {}, expected 'table', 'short_table' or 'json'",
+                "invalid data format in rascal_profiling_get: {}, expected 'table', 'short_table', 'json' or 'metrics'",
                 format
             )))
         };
@@ -89,3 +101,115 @@ pub unsafe extern fn rascal_profiling_get(
         Ok(())
     })
 }
+
+/// Counters collected during the calculations when profiling is enabled, see
+/// `rascal_profiling_metrics`.
+#[repr(C)]
+#[allow(non_camel_case_types)]
+pub struct rascal_profiling_metrics_t {
+    /// Number of pairs processed by the spherical expansion. Each pair is
+    /// counted once for each of the two atoms in the pair.
+    pub pairs: u64,
+    /// Number of samples (i.e. rows in the values array) computed by the
+    /// calculators, including intermediary calculators
+    pub samples: u64,
+    /// Number of gradients samples (i.e. rows in the gradients array) computed
+    /// by the calculators, including intermediary calculators
+    pub gradient_samples: u64,
+    /// Memory used by the values and gradients arrays of descriptors, in bytes
+    pub descriptor_bytes: u64,
+    /// Memory used by the samples, gradients samples and features indexes of
+    /// descriptors, in bytes
+    pub indexes_bytes: u64,
+    /// Number of neighbors lists created from scratch
+    pub neighbors_list_builds: u64,
+    /// Number of times an existing neighbors list was re-used
+    pub neighbors_list_reuses: u64,
+    /// Largest number of chunks read ahead of the calculation when streaming
+    /// trajectories
+    pub chunks_queue_high_water: u64,
+    /// Number of atomic environments for which the power spectrum was copied
+    /// from an identical environment, when deduplicating environments
+    pub environment_cache_hits: u64,
+    /// Number of atomic environments for which the power spectrum was
+    /// computed, when deduplicating environments
+    pub environment_cache_misses: u64,
+    /// Total wall time spent in the parallel sections of the calculators, in
+    /// nanoseconds
+    pub parallel_time_ns: u64,
+    /// Number of worker threads in the thread pool, with busy/idle time data
+    pub threads_count: usize,
+}
+
+/// Busy and idle time of a single worker thread, see
+/// `rascal_profiling_metrics`.
+#[repr(C)]
+#[allow(non_camel_case_types)]
+pub struct rascal_thread_metrics_t {
+    /// Time spent working on parallel tasks, in nanoseconds
+    pub busy_ns: u64,
+    /// Time spent inside parallel sections without working on a task, in
+    /// nanoseconds
+    pub idle_ns: u64,
+}
+
+/// Get the counters collected during the calculations since profiling was
+/// enabled with `rascal_profiling_enable` or cleared with
+/// `rascal_profiling_clear`.
+///
+/// The busy/idle time of the worker threads is written to `threads`, up to
+/// `threads_count` entries. `metrics->threads_count` is set to the number of
+/// threads with data, which can be used to allocate a large enough `threads`
+/// array before calling this function again. `threads` can be `NULL` if
+/// `threads_count` is 0.
+///
+/// @param metrics pointer to a `rascal_profiling_metrics_t` that will be
+///                filled by this function
+/// @param threads array of `rascal_thread_metrics_t` with space for
+///                `threads_count` entries, or `NULL`
+/// @param threads_count number of entries in `threads`
+///
+/// @returns The status code of this operation. If the status is not
+///          `RASCAL_SUCCESS`, you can use `rascal_last_error()` to get the full
+///          error message.
+#[no_mangle]
+pub unsafe extern fn rascal_profiling_metrics(
+    metrics: *mut rascal_profiling_metrics_t,
+    threads: *mut rascal_thread_metrics_t,
+    threads_count: usize,
+) -> rascal_status_t {
+    catch_unwind(|| {
+        check_pointers!(metrics);
+        if threads_count != 0 {
+            check_pointers!(threads);
+        }
+
+        let rust_metrics = metrics::get();
+        *metrics = rascal_profiling_metrics_t {
+            pairs: rust_metrics.pairs,
+            samples: rust_metrics.samples,
+            gradient_samples: rust_metrics.gradient_samples,
+            descriptor_bytes: rust_metrics.descriptor_bytes,
+            indexes_bytes: rust_metrics.indexes_bytes,
+            neighbors_list_builds: rust_metrics.neighbors_list_builds,
+            neighbors_list_reuses: rust_metrics.neighbors_list_reuses,
+            chunks_queue_high_water: rust_metrics.chunks_queue_high_water,
+            environment_cache_hits: rust_metrics.environment_cache_hits,
+            environment_cache_misses: rust_metrics.environment_cache_misses,
+            parallel_time_ns: rust_metrics.parallel_time_ns,
+            threads_count: rust_metrics.threads.len(),
+        };
+
+        if threads_count != 0 {
+            let threads = std::slice::from_raw_parts_mut(threads, threads_count);
+            for (output, thread) in threads.iter_mut().zip(&rust_metrics.threads) {
+                *output = rascal_thread_metrics_t {
+                    busy_ns: thread.busy_ns,
+                    idle_ns: thread.idle_ns,
+                };
+            }
+        }
+
+        Ok(())
+    })
+}
@@ -45,6 +45,8 @@ pub const RASCAL_JSON_ERROR: i32 = 2;
 pub const RASCAL_UTF8_ERROR: i32 = 3;
 /// Status code used for error related to reading files with chemfiles
 pub const RASCAL_CHEMFILES_ERROR: i32 = 4;
+/// Status code used for error while reading or writing files
+pub const RASCAL_IO_ERROR: i32 = 5;
 /// Status code used for errors coming from the system implementation if we
 /// don't have a more specific status
 pub const RASCAL_SYSTEM_ERROR: i32 = 128;
@@ -66,6 +68,7 @@ impl From<Error> for rascal_status_t {
             Error::Json(_) => rascal_status_t(RASCAL_JSON_ERROR),
             Error::Utf8(_) => rascal_status_t(RASCAL_UTF8_ERROR),
             Error::Chemfiles(_) => rascal_status_t(RASCAL_CHEMFILES_ERROR),
+            Error::Io(_) => rascal_status_t(RASCAL_IO_ERROR),
             Error::BufferSize(_) => rascal_status_t(RASCAL_BUFFER_SIZE_ERROR),
             Error::External{status, ..} => {
                 if status < 0 {
@@ -1,8 +1,9 @@
 use std::os::raw::{c_char, c_void};
+use std::cell::RefCell;
 use std::ffi::CStr;
 
 use rascaline::types::{Vector3D, Matrix3};
-use rascaline::systems::{SimpleSystem, Pair, UnitCell};
+use rascaline::systems::{SimpleSystem, Pair, CenterPairs, UnitCell};
 use rascaline::{Error, System};
 
 use crate::RASCAL_SYSTEM_ERROR;
@@ -23,6 +24,66 @@ pub struct rascal_pair_t {
     pub vector: [f64; 3],
 }
 
+/// Borrowed pointers to the data of a `rascal_system_t`, stored in contiguous
+/// arrays. This allows rascaline to access the data of a system directly,
+/// without going through the function pointers in `rascal_system_t` for each
+/// access.
+///
+/// All the pointers are optional, and can be set to `NULL` to let rascaline
+/// use the corresponding function in `rascal_system_t` instead. The data
+/// should stay valid and unchanged until the next call to
+/// `rascal_system_t::compute_neighbors`, or the end of the calculation.
+#[repr(C)]
+#[derive(Clone, Copy)]
+pub struct rascal_system_data_t {
+    /// Generation counter for the data. This must change every time the
+    /// content or location in memory of any of the arrays below changes.
+    /// rascaline uses this value to know when it can re-use data it already
+    /// validated.
+    pub generation: u64,
+    /// Pointer to the first element of a contiguous array containing the
+    /// atomic species, with `rascal_system_t::size()` elements.
+    pub species: *const i32,
+    /// Pointer to the first element of a contiguous array containing the
+    /// atomic cartesian coordinates, with `3 x rascal_system_t::size()`
+    /// elements.
+    pub positions: *const f64,
+    /// Pointer to the first element of a contiguous array containing all
+    /// pairs in this system, following the same rules as
+    /// `rascal_system_t::pairs`.
+    pub pairs: *const rascal_pair_t,
+    /// Number of pairs in `pairs`
+    pub pairs_count: usize,
+    /// Pointer to the first element of a contiguous array containing the
+    /// pairs classified by center, following the same rules as
+    /// `rascal_system_t::pairs_containing`. The pairs containing the atom
+    /// `center` are given by `center_pairs[center_offsets[center]]` up to
+    /// `center_pairs[center_offsets[center + 1]]` (excluded).
+    pub center_pairs: *const rascal_pair_t,
+    /// Pointer to the first element of a contiguous array containing the
+    /// offsets of the pairs for each center in `center_pairs`, with
+    /// `rascal_system_t::size() + 1` elements.
+    pub center_offsets: *const usize,
+}
+
+impl rascal_system_data_t {
+    fn null() -> rascal_system_data_t {
+        rascal_system_data_t {
+            generation: 0,
+            species: std::ptr::null(),
+            positions: std::ptr::null(),
+            pairs: std::ptr::null(),
+            pairs_count: 0,
+            center_pairs: std::ptr::null(),
+            center_offsets: std::ptr::null(),
+        }
+    }
+
+    fn is_null(&self) -> bool {
+        self.species.is_null() && self.positions.is_null() && self.pairs.is_null() && self.center_offsets.is_null()
+    }
+}
+
 /// A `rascal_system_t` deals with the storage of atoms and related information,
 /// as well as the computation of neighbor lists.
 ///
@@ -94,6 +155,12 @@ pub struct rascal_system_t {
     /// included both in the return of `pairs_containing(i)` and
     /// `pairs_containing(j)`.
     pairs_containing: Option<unsafe extern fn(user_data: *const c_void, center: usize, pairs: *mut *const rascal_pair_t, count: *mut usize) -> rascal_status_t>,
+    /// This function is optional and can be `NULL`. If set, it should fill
+    /// `*data` with borrowed pointers to the data of this system, which
+    /// rascaline will then use instead of calling the functions above. This
+    /// function is called once at the beginning of a calculation, and again
+    /// after each call to `compute_neighbors`.
+    data: Option<unsafe extern fn(user_data: *const c_void, data: *mut rascal_system_data_t) -> rascal_status_t>,
 }
 
 impl<'a> System for &'a mut rascal_system_t {
@@ -253,7 +320,7 @@ impl<'a> System for &'a mut rascal_system_t {
         }
     }
 
-    fn pairs_containing(&self, center: usize) -> Result<&[Pair], Error> {
+    fn pairs_containing(&self, center: usize) -> Result<CenterPairs<'_>, Error> {
         let function = self.pairs_containing.ok_or_else(|| Error::External {
             status: RASCAL_SYSTEM_ERROR,
             message: "rascal_system_t.pairs_containing function is NULL".into(),
@@ -280,38 +347,200 @@ impl<'a> System for &'a mut rascal_system_t {
         }
         unsafe {
             // SAFETY: ptr is non null, and Pair / rascal_pair_t have the same layout
-            return Ok(std::slice::from_raw_parts(ptr.cast(), count));
+            return Ok(CenterPairs::Pairs(std::slice::from_raw_parts(ptr.cast(), count)));
         }
     }
 }
 
+/// Implementation of `System` for `rascal_system_t`, using the borrowed data
+/// from `rascal_system_t::data` when available, and the other function
+/// pointers otherwise.
+pub struct BorrowedSystem<'a> {
+    system: &'a mut rascal_system_t,
+    /// number of atoms in the system
+    size: usize,
+    /// data from the last call to `rascal_system_t::data`, already validated
+    data: Option<rascal_system_data_t>,
+}
+
+impl<'a> BorrowedSystem<'a> {
+    pub fn new(system: &'a mut rascal_system_t) -> Result<BorrowedSystem<'a>, Error> {
+        let size = System::size(&system)?;
+        let mut borrowed = BorrowedSystem { system, size, data: None };
+        borrowed.update_data()?;
+        return Ok(borrowed);
+    }
+
+    /// Get the data from `rascal_system_t::data` if this function is set, and
+    /// validate it if the generation changed since the last call.
+    fn update_data(&mut self) -> Result<(), Error> {
+        let function = match self.system.data {
+            Some(function) => function,
+            None => return Ok(()),
+        };
+
+        let mut data = rascal_system_data_t::null();
+        let status = unsafe {
+            function(self.system.user_data, &mut data)
+        };
+
+        if !status.is_success() {
+            return Err(Error::External {
+                status: status.as_i32(),
+                message: "call to rascal_system_t.data failed".into(),
+            });
+        }
+
+        if data.is_null() {
+            self.data = None;
+            return Ok(());
+        }
+
+        if let Some(ref previous) = self.data {
+            if previous.generation == data.generation {
+                return Ok(());
+            }
+        }
+
+        if data.pairs.is_null() && data.pairs_count != 0 {
+            return Err(Error::External {
+                status: RASCAL_SYSTEM_ERROR,
+                message: "rascal_system_t.data returned NULL pairs with non zero count".into(),
+            });
+        }
+
+        if !data.center_offsets.is_null() {
+            let offsets = unsafe {
+                std::slice::from_raw_parts(data.center_offsets, self.size + 1)
+            };
+
+            if offsets[0] != 0 || offsets.windows(2).any(|w| w[0] > w[1]) {
+                return Err(Error::External {
+                    status: RASCAL_SYSTEM_ERROR,
+                    message: "rascal_system_t.data returned invalid center_offsets, they must start at 0 and be increasing".into(),
+                });
+            }
+
+            if data.center_pairs.is_null() && offsets[self.size] != 0 {
+                return Err(Error::External {
+                    status: RASCAL_SYSTEM_ERROR,
+                    message: "rascal_system_t.data returned NULL center_pairs with non zero center_offsets".into(),
+                });
+            }
+        }
+
+        self.data = Some(data);
+        return Ok(());
+    }
+}
+
+impl<'a> System for BorrowedSystem<'a> {
+    fn size(&self) -> Result<usize, Error> {
+        Ok(self.size)
+    }
+
+    fn species(&self) -> Result<&[i32], Error> {
+        match self.data {
+            Some(ref data) if !data.species.is_null() => unsafe {
+                Ok(std::slice::from_raw_parts(data.species, self.size))
+            },
+            _ => System::species(&self.system),
+        }
+    }
+
+    fn positions(&self) -> Result<&[Vector3D], Error> {
+        match self.data {
+            Some(ref data) if !data.positions.is_null() => unsafe {
+                Ok(std::slice::from_raw_parts(data.positions.cast(), self.size))
+            },
+            _ => System::positions(&self.system),
+        }
+    }
+
+    fn cell(&self) -> Result<UnitCell, Error> {
+        System::cell(&self.system)
+    }
+
+    fn compute_neighbors(&mut self, cutoff: f64) -> Result<(), Error> {
+        System::compute_neighbors(&mut self.system, cutoff)?;
+        return self.update_data();
+    }
+
+    fn pairs(&self) -> Result<&[Pair], Error> {
+        match self.data {
+            Some(ref data) if !data.pairs.is_null() => unsafe {
+                // SAFETY: Pair / rascal_pair_t have the same layout
+                Ok(std::slice::from_raw_parts(data.pairs.cast(), data.pairs_count))
+            },
+            _ => System::pairs(&self.system),
+        }
+    }
+
+    fn pairs_containing(&self, center: usize) -> Result<CenterPairs<'_>, Error> {
+        match self.data {
+            Some(ref data) if !data.center_offsets.is_null() => {
+                if center >= self.size {
+                    return Err(Error::InvalidParameter(format!(
+                        "center {} is out of bounds for a system with {} atoms", center, self.size
+                    )));
+                }
+
+                unsafe {
+                    let start = *data.center_offsets.add(center);
+                    let stop = *data.center_offsets.add(center + 1);
+                    if start == stop {
+                        return Ok(CenterPairs::Pairs(&[]));
+                    }
+                    // SAFETY: Pair / rascal_pair_t have the same layout
+                    let pairs = std::slice::from_raw_parts(data.center_pairs.add(start).cast(), stop - start);
+                    Ok(CenterPairs::Pairs(pairs))
+                }
+            },
+            _ => System::pairs_containing(&self.system, center),
+        }
+    }
+}
+
+/// `SimpleSystem` exported as a `rascal_system_t`.
+///
+/// `SimpleSystem` stores the pairs containing each center as indexes into the
+/// full list of pairs, while `rascal_system_t::pairs_containing` must return a
+/// contiguous array of pairs. The pairs classified by center are copied here
+/// on the first call to `pairs_containing` after `compute_neighbors`, and stay
+/// valid until the next call to `compute_neighbors`.
+struct ExportedSystem {
+    system: SimpleSystem,
+    /// pairs containing each center, and offsets of the pairs for each center
+    center_pairs: RefCell<Option<(Vec<Pair>, Vec<usize>)>>,
+}
+
 /// Convert a Simple System to a `rascal_system_t`
 impl From<SimpleSystem> for rascal_system_t {
     fn from(system: SimpleSystem) -> rascal_system_t {
         unsafe extern fn size(this: *const c_void, size: *mut usize) -> rascal_status_t {
             catch_unwind(|| {
-                *size = (*this.cast::<SimpleSystem>()).size()?;
+                *size = (*this.cast::<ExportedSystem>()).system.size()?;
                 Ok(())
             })
         }
 
         unsafe extern fn species(this: *const c_void, species: *mut *const i32) -> rascal_status_t {
             catch_unwind(|| {
-                *species = (*this.cast::<SimpleSystem>()).species()?.as_ptr();
+                *species = (*this.cast::<ExportedSystem>()).system.species()?.as_ptr();
                 Ok(())
             })
         }
 
         unsafe extern fn positions(this: *const c_void, positions: *mut *const f64) -> rascal_status_t {
             catch_unwind(|| {
-                *positions = (*this.cast::<SimpleSystem>()).positions()?.as_ptr().cast();
+                *positions = (*this.cast::<ExportedSystem>()).system.positions()?.as_ptr().cast();
                 Ok(())
             })
         }
 
         unsafe extern fn cell(this: *const c_void, cell: *mut f64) -> rascal_status_t {
             catch_unwind(|| {
-                let matrix = (*this.cast::<SimpleSystem>()).cell()?.matrix();
+                let matrix = (*this.cast::<ExportedSystem>()).system.cell()?.matrix();
                 cell.add(0).write(matrix[0][0]);
                 cell.add(1).write(matrix[0][1]);
                 cell.add(2).write(matrix[0][2]);
@@ -330,7 +559,9 @@ impl From<SimpleSystem> for rascal_system_t {
 
         unsafe extern fn compute_neighbors(this: *mut c_void, cutoff: f64) -> rascal_status_t {
             catch_unwind(|| {
-                (*this.cast::<SimpleSystem>()).compute_neighbors(cutoff)?;
+                let exported = &mut *this.cast::<ExportedSystem>();
+                exported.system.compute_neighbors(cutoff)?;
+                *exported.center_pairs.get_mut() = None;
 
                 Ok(())
             })
@@ -342,7 +573,7 @@ impl From<SimpleSystem> for rascal_system_t {
             count: *mut usize,
         ) -> rascal_status_t {
             catch_unwind(|| {
-                let all_pairs = (*this.cast::<SimpleSystem>()).pairs()?;
+                let all_pairs = (*this.cast::<ExportedSystem>()).system.pairs()?;
                 *pairs = all_pairs.as_ptr().cast();
                 *count = all_pairs.len();
 
@@ -357,16 +588,40 @@ impl From<SimpleSystem> for rascal_system_t {
             count: *mut usize,
         ) -> rascal_status_t {
             catch_unwind(|| {
-                let all_pairs = (*this.cast::<SimpleSystem>()).pairs_containing(center)?;
-                *pairs = all_pairs.as_ptr().cast();
-                *count = all_pairs.len();
+                let exported = &*this.cast::<ExportedSystem>();
+                let size = exported.system.size()?;
+                if center >= size {
+                    return Err(Error::InvalidParameter(format!(
+                        "center {} is out of bounds for a system with {} atoms", center, size
+                    )));
+                }
+
+                let mut center_pairs = exported.center_pairs.borrow_mut();
+                if center_pairs.is_none() {
+                    let mut all_pairs = Vec::with_capacity(2 * exported.system.pairs()?.len());
+                    let mut offsets = Vec::with_capacity(size + 1);
+                    offsets.push(0);
+                    for atom in 0..size {
+                        all_pairs.extend(exported.system.pairs_containing(atom)?);
+                        offsets.push(all_pairs.len());
+                    }
+                    *center_pairs = Some((all_pairs, offsets));
+                }
+
+                let (all_pairs, offsets) = center_pairs.as_ref().expect("missing pairs by center");
+                let start = offsets[center];
+                *pairs = all_pairs[start..].as_ptr().cast();
+                *count = offsets[center + 1] - start;
 
                 Ok(())
             })
         }
 
         rascal_system_t {
-            user_data: Box::into_raw(Box::new(system)).cast(),
+            user_data: Box::into_raw(Box::new(ExportedSystem {
+                system: system,
+                center_pairs: RefCell::new(None),
+            })).cast(),
             size: Some(size),
             species: Some(species),
             positions: Some(positions),
@@ -374,6 +629,7 @@ impl From<SimpleSystem> for rascal_system_t {
             compute_neighbors: Some(compute_neighbors),
             pairs: Some(pairs),
             pairs_containing: Some(pairs_containing),
+            data: None,
         }
     }
 }
@@ -446,7 +702,7 @@ pub unsafe extern fn rascal_basic_systems_free(systems: *mut rascal_system_t, co
         if !systems.is_null() {
             let vec = Vec::from_raw_parts(systems, count, count);
             for element in vec {
-                let boxed = Box::from_raw(element.user_data.cast::<SimpleSystem>());
+                let boxed = Box::from_raw(element.user_data.cast::<ExportedSystem>());
                 std::mem::drop(boxed);
             }
         }
@@ -0,0 +1,47 @@
+use crate::{catch_unwind, rascal_status_t};
+
+/// Use `num_threads` threads for all the parallel calculations. By default,
+/// rascaline uses as many threads as there are CPU cores, or the value of the
+/// `RAYON_NUM_THREADS` environment variable if it is set.
+///
+/// The threads are created once in this function and re-used for all
+/// subsequent calculations. The calls to the functions in `rascal_system_t`
+/// always happen on the thread which started the calculation.
+///
+/// If `num_threads` is 0, the default number of threads is used. If
+/// `pin_threads` is `true`, each thread is bound to a single CPU, taken from
+/// the CPUs this process is allowed to run on (as set by `taskset`, `numactl`
+/// or the MPI launcher), in order of NUMA node. Pinning threads is only
+/// supported on Linux.
+///
+/// @param num_threads number of threads to use, or 0 to use the default
+/// @param pin_threads whether each thread should be bound to a single CPU
+///
+/// @returns The status code of this operation. If the status is not
+///          `RASCAL_SUCCESS`, you can use `rascal_last_error()` to get the full
+///          error message.
+#[no_mangle]
+pub unsafe extern fn rascal_set_num_threads(num_threads: usize, pin_threads: bool) -> rascal_status_t {
+    catch_unwind(|| {
+        rascaline::threads::set_num_threads(num_threads, pin_threads)?;
+        Ok(())
+    })
+}
+
+/// Get the number of threads used for the parallel calculations, see
+/// `rascal_set_num_threads`.
+///
+/// @param num_threads pointer to a single integer, will be set to the number of
+///                    threads
+///
+/// @returns The status code of this operation. If the status is not
+///          `RASCAL_SUCCESS`, you can use `rascal_last_error()` to get the full
+///          error message.
+#[no_mangle]
+pub unsafe extern fn rascal_get_num_threads(num_threads: *mut usize) -> rascal_status_t {
+    catch_unwind(|| {
+        check_pointers!(num_threads);
+        *num_threads = rascaline::threads::num_threads();
+        Ok(())
+    })
+}
@@ -209,6 +209,52 @@ TEST_CASE("Compute descriptor") {
         }
     }
 
+    SECTION("Asynchronous compute") {
+        auto system = simple_system();
+
+        rascal_calculation_options_t options = {0};
+        auto calculation = rascal_calculator_compute_submit(
+            calculator, descriptor, &system, 1, options, nullptr, nullptr
+        );
+        REQUIRE(calculation != nullptr);
+
+        CHECK_SUCCESS(rascal_calculation_wait(calculation));
+        bool done = false;
+        CHECK_SUCCESS(rascal_calculation_poll(calculation, &done));
+        CHECK(done);
+        CHECK_SUCCESS(rascal_calculation_free(calculation));
+
+        double* data = nullptr;
+        uintptr_t shape[2] = {0};
+        CHECK_SUCCESS(rascal_descriptor_values(descriptor, &data, &shape[0], &shape[1]));
+        CHECK(shape[0] == 4);
+        CHECK(shape[1] == 2);
+        auto expected_data = std::vector<double>{
+            4, 3, /**/ 5, 9, /**/ 6, 18, /**/ 7, 15,
+        };
+        for (size_t i=0; i<shape[0]; i++) {
+            for (size_t j=0; j<shape[1]; j++) {
+                CHECK(data[i * shape[1] + j] == expected_data[i * shape[1] + j]);
+            }
+        }
+
+        // errors during the calculation are reported by rascal_calculation_wait
+        auto features = std::vector<int32_t>{0};
+        auto names = std::vector<const char*> {"foo"};
+        options.selected_features.names = names.data();
+        options.selected_features.size = 1;
+        options.selected_features.values = features.data();
+        options.selected_features.count = 1;
+        calculation = rascal_calculator_compute_submit(
+            calculator, descriptor, &system, 1, options, nullptr, nullptr
+        );
+        REQUIRE(calculation != nullptr);
+
+        CHECK(rascal_calculation_wait(calculation) == RASCAL_INVALID_PARAMETER_ERROR);
+        CHECK(std::string(rascal_last_error()) == "invalid parameter: 'foo' in requested features is not part of the features of this calculator");
+        CHECK_SUCCESS(rascal_calculation_free(calculation));
+    }
+
     SECTION("Partial compute -- samples") {
         auto system = simple_system();
 
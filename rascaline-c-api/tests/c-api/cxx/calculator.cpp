@@ -158,6 +158,172 @@ TEST_CASE("Compute descriptor") {
         }
     }
 
+    SECTION("Full compute -- borrowed system data") {
+        auto system_with_data = TestSystemWithData();
+        auto systems_with_data = std::vector<rascaline::System*>();
+        systems_with_data.push_back(&system_with_data);
+
+        auto descriptor = calculator.compute(systems);
+        auto descriptor_with_data = calculator.compute(systems_with_data);
+
+        auto values = descriptor.values();
+        auto values_with_data = descriptor_with_data.values();
+        REQUIRE(values.shape() == values_with_data.shape());
+        for (size_t i=0; i<values.shape()[0]; i++) {
+            for (size_t j=0; j<values.shape()[1]; j++) {
+                CHECK(values(i, j) == values_with_data(i, j));
+            }
+        }
+
+        auto gradients = descriptor.gradients();
+        auto gradients_with_data = descriptor_with_data.gradients();
+        REQUIRE(gradients.shape() == gradients_with_data.shape());
+        for (size_t i=0; i<gradients.shape()[0]; i++) {
+            for (size_t j=0; j<gradients.shape()[1]; j++) {
+                CHECK(gradients(i, j) == gradients_with_data(i, j));
+            }
+        }
+    }
+
+    SECTION("Full compute -- reuse descriptor") {
+        auto expected = calculator.compute(systems);
+
+        auto reuse_options = []() {
+            auto options = rascaline::CalculationOptions();
+            options.reuse_descriptor = true;
+            return options;
+        };
+
+        auto descriptor = rascaline::Descriptor();
+        calculator.compute(systems, descriptor, reuse_options());
+        const auto first_values = descriptor.values();
+        calculator.compute(systems, descriptor, reuse_options());
+
+        const auto values = descriptor.values();
+        // the memory is re-used between calls
+        CHECK(values.data() == first_values.data());
+
+        auto expected_values = expected.values();
+        REQUIRE(values.shape() == expected_values.shape());
+        for (size_t i=0; i<values.shape()[0]; i++) {
+            for (size_t j=0; j<values.shape()[1]; j++) {
+                CHECK(values(i, j) == expected_values(i, j));
+            }
+        }
+
+        auto gradients = descriptor.gradients();
+        auto expected_gradients = expected.gradients();
+        REQUIRE(gradients.shape() == expected_gradients.shape());
+        for (size_t i=0; i<gradients.shape()[0]; i++) {
+            for (size_t j=0; j<gradients.shape()[1]; j++) {
+                CHECK(gradients(i, j) == expected_gradients(i, j));
+            }
+        }
+    }
+
+    SECTION("Full compute -- calculation plan") {
+        auto expected = calculator.compute(systems);
+
+        auto plan = calculator.plan(systems);
+        auto descriptor = rascaline::Descriptor();
+        for (size_t iteration=0; iteration<2; iteration++) {
+            calculator.compute(systems, descriptor, plan);
+
+            auto values = descriptor.values();
+            auto expected_values = expected.values();
+            REQUIRE(values.shape() == expected_values.shape());
+            for (size_t i=0; i<values.shape()[0]; i++) {
+                for (size_t j=0; j<values.shape()[1]; j++) {
+                    CHECK(values(i, j) == expected_values(i, j));
+                }
+            }
+
+            auto gradients = descriptor.gradients();
+            auto expected_gradients = expected.gradients();
+            REQUIRE(gradients.shape() == expected_gradients.shape());
+            for (size_t i=0; i<gradients.shape()[0]; i++) {
+                for (size_t j=0; j<gradients.shape()[1]; j++) {
+                    CHECK(gradients(i, j) == expected_gradients(i, j));
+                }
+            }
+        }
+
+        auto other = rascaline::Calculator("dummy_calculator", R"({
+            "cutoff": 3.0,
+            "delta": 2,
+            "name": "",
+            "gradients": true
+        })");
+        CHECK_THROWS_WITH(
+            other.compute(systems, descriptor, plan),
+            "invalid parameter: this calculation plan was created by a different calculator"
+        );
+    }
+
+    SECTION("Asynchronous compute") {
+        auto future = calculator.compute_async(systems);
+        auto descriptor = future.get();
+
+        auto values = descriptor.values();
+        CHECK(values.shape() == std::array<size_t, 2>{4, 2});
+        auto expected_data = std::vector<double>{
+            4, 3, /**/ 5, 9, /**/ 6, 18, /**/ 7, 15,
+        };
+        for (size_t i=0; i<values.shape()[0]; i++) {
+            for (size_t j=0; j<values.shape()[1]; j++) {
+                CHECK(values(i, j) == expected_data[i * values.shape()[1] + j]);
+            }
+        }
+        CHECK(descriptor.gradients().shape() == std::array<size_t, 2>{18, 2});
+
+        auto options = rascaline::CalculationOptions();
+        options.selected_features = rascaline::SelectedIndexes({"foo"});
+        options.selected_features.add({0});
+        future = calculator.compute_async(systems, std::move(options));
+        CHECK_THROWS_WITH(
+            future.get(),
+            "invalid parameter: 'foo' in requested features is not part of the features of this calculator"
+        );
+    }
+
+    SECTION("Compute all") {
+        const char* OTHER_HYPERS_JSON = R"({
+            "cutoff": 3.0,
+            "delta": 9,
+            "name": "",
+            "gradients": false
+        })";
+        auto other = rascaline::Calculator("dummy_calculator", OTHER_HYPERS_JSON);
+
+        auto calculators = std::vector<const rascaline::Calculator*>{&calculator, &other};
+        auto descriptors = rascaline::Calculator::compute_all(calculators, systems);
+        REQUIRE(descriptors.size() == 2);
+
+        auto expected = std::vector<rascaline::Descriptor>();
+        expected.emplace_back(calculator.compute(systems));
+        expected.emplace_back(other.compute(systems));
+
+        for (size_t d=0; d<2; d++) {
+            auto values = descriptors[d].values();
+            auto expected_values = expected[d].values();
+            CHECK(values.shape() == expected_values.shape());
+            for (size_t i=0; i<values.shape()[0]; i++) {
+                for (size_t j=0; j<values.shape()[1]; j++) {
+                    CHECK(values(i, j) == expected_values(i, j));
+                }
+            }
+        }
+        CHECK(descriptors[0].gradients().shape() == std::array<size_t, 2>{18, 2});
+
+        auto options = rascaline::CalculationOptions();
+        options.selected_features = rascaline::SelectedIndexes({"index_delta"});
+        options.selected_features.add({0});
+        CHECK_THROWS_WITH(
+            rascaline::Calculator::compute_all(calculators, systems, std::move(options)),
+            "invalid parameter: selected samples or features can not be used with a group of calculators"
+        );
+    }
+
     SECTION("Partial compute -- samples") {
         auto options = rascaline::CalculationOptions();
         options.selected_samples = rascaline::SelectedIndexes({"structure", "center"});
@@ -311,3 +477,96 @@ static void check_indexes(
         }
     }
 }
+
+TEST_CASE("Profiling metrics") {
+    const char* HYPERS_JSON = R"({
+        "cutoff": 3.0,
+        "delta": 4,
+        "name": "",
+        "gradients": true
+    })";
+
+    auto system = TestSystem();
+    auto systems = std::vector<rascaline::System*>();
+    systems.push_back(&system);
+    auto calculator = rascaline::Calculator("dummy_calculator", HYPERS_JSON);
+
+    rascaline::Profiler::enable(true);
+    rascaline::Profiler::clear();
+    auto descriptor = calculator.compute(systems);
+    rascaline::Profiler::enable(false);
+
+    auto metrics = rascaline::Profiler::metrics();
+    // 4x2 values and 18x2 gradients
+    CHECK(metrics.descriptor_bytes == (4 * 2 + 18 * 2) * sizeof(double));
+    CHECK(metrics.indexes_bytes != 0);
+
+    auto json = rascaline::Profiler::get("metrics");
+    CHECK(json.find("\"descriptor_bytes\"") != std::string::npos);
+
+    rascaline::Profiler::clear();
+    metrics = rascaline::Profiler::metrics();
+    CHECK(metrics.descriptor_bytes == 0);
+    CHECK(!metrics.threads.empty());
+    for (const auto& thread: metrics.threads) {
+        CHECK(thread.busy_ns == 0);
+    }
+}
+
+TEST_CASE("Threads") {
+    rascaline::set_num_threads(2);
+    CHECK(rascaline::num_threads() == 2);
+
+    const char* HYPERS_JSON = R"({
+        "cutoff": 3.0,
+        "delta": 4,
+        "name": "",
+        "gradients": true
+    })";
+
+    auto system = TestSystem();
+    auto systems = std::vector<rascaline::System*>();
+    systems.push_back(&system);
+    auto calculator = rascaline::Calculator("dummy_calculator", HYPERS_JSON);
+    auto descriptor = calculator.compute(systems);
+    CHECK(descriptor.values().shape() == std::array<size_t, 2>{4, 2});
+
+    // go back to the default thread pool
+    rascaline::set_num_threads(0);
+    CHECK(rascaline::num_threads() != 0);
+}
+
+TEST_CASE("Trajectory chunks") {
+    const char* HYPERS_JSON = R"({
+        "cutoff": 3.0,
+        "delta": 4,
+        "name": "",
+        "gradients": false
+    })";
+    auto calculator = rascaline::Calculator("dummy_calculator", HYPERS_JSON);
+
+    SECTION("iterate over chunks") {
+        // TrajectoryChunks is not movable, so it has to be constructed in
+        // place
+        rascaline::TrajectoryChunks chunks(
+            calculator, "../../../../rascaline/benches/data/silicon_bulk.xyz", 8
+        );
+
+        auto first_structures = std::vector<size_t>();
+        auto n_samples = std::vector<size_t>();
+        for (const auto& descriptor: chunks) {
+            first_structures.push_back(chunks.first_structure());
+            n_samples.push_back(descriptor.values().shape()[0]);
+        }
+
+        CHECK(first_structures == std::vector<size_t>{0, 8, 16, 24});
+        CHECK(n_samples == std::vector<size_t>{8 * 54, 8 * 54, 8 * 54, 6 * 54});
+    }
+
+    SECTION("errors") {
+        CHECK_THROWS_WITH(
+            rascaline::TrajectoryChunks(calculator, "not-there.xyz", 0),
+            "invalid parameter: chunk size must be at least 1 to read a trajectory"
+        );
+    }
+}
@@ -136,6 +136,37 @@ TEST_CASE("Descriptor") {
         }
     }
 
+    SECTION("gradients blocks") {
+        auto descriptor = rascaline::Descriptor();
+
+        auto blocks = descriptor.gradients_blocks();
+        CHECK(blocks.samples() == 0);
+        CHECK(blocks.blocks() == 0);
+
+        compute_descriptor(descriptor);
+        blocks = descriptor.gradients_blocks();
+        CHECK(blocks.samples() == 4);
+        CHECK(blocks.blocks() == 6);
+
+        auto expected_offsets = std::vector<size_t>{0, 1, 3, 5, 6};
+        for (size_t sample=0; sample<blocks.samples(); sample++) {
+            CHECK(blocks.sample_start(sample) == expected_offsets[sample]);
+            CHECK(blocks.sample_stop(sample) == expected_offsets[sample + 1]);
+        }
+
+        auto expected_atoms = std::vector<int32_t>{1, 0, 2, 1, 3, 2};
+        for (size_t i=0; i<blocks.blocks(); i++) {
+            CHECK(blocks.atom(i) == expected_atoms[i]);
+
+            auto block = blocks.block(i);
+            CHECK(block.shape() == std::array<size_t, 2>{3, 2});
+            for (size_t spatial=0; spatial<3; spatial++) {
+                CHECK(block(spatial, 0) == 0);
+                CHECK(block(spatial, 1) == 1);
+            }
+        }
+    }
+
     SECTION("densify") {
         auto descriptor = rascaline::Descriptor();
         compute_descriptor(descriptor);
@@ -183,4 +214,81 @@ TEST_CASE("Descriptor") {
         CHECK(densified_positions[3].new_sample == 0);
         CHECK(densified_positions[3].feature_block == 3);
     }
+
+    SECTION("save and memory-map") {
+        auto calculator = rascaline::Calculator("dummy_calculator", HYPERS_JSON);
+        auto system = TestSystem();
+        auto systems = std::vector<rascaline::System*>();
+        systems.push_back(&system);
+        auto descriptor = calculator.compute(systems);
+
+        descriptor.save("cxx-descriptor-save.desc", calculator);
+        auto mapped = rascaline::MappedDescriptor("cxx-descriptor-save.desc");
+
+        CHECK(mapped.name() == calculator.name());
+        CHECK(mapped.parameters() == calculator.parameters());
+
+        CHECK(mapped.samples().names() == descriptor.samples().names());
+        CHECK(mapped.samples().shape() == descriptor.samples().shape());
+        CHECK(mapped.features().names() == descriptor.features().names());
+        CHECK(mapped.gradients_samples().shape() == descriptor.gradients_samples().shape());
+
+        const auto values = mapped.values();
+        const auto expected = descriptor.values();
+        CHECK(values.shape() == expected.shape());
+        for (size_t i=0; i<values.shape()[0]; i++) {
+            for (size_t j=0; j<values.shape()[1]; j++) {
+                CHECK(values(i, j) == expected(i, j));
+            }
+        }
+        CHECK(mapped.gradients().shape() == std::array<size_t, 2>{18, 2});
+
+        auto densified = mapped.densify({"center"});
+        CHECK(densified.values().shape() == std::array<size_t, 2>{1, 8});
+        CHECK(densified.gradients().shape() == std::array<size_t, 2>{12, 8});
+        // the mapped descriptor is not modified
+        CHECK(mapped.values().shape() == std::array<size_t, 2>{4, 2});
+
+        CHECK_THROWS_WITH(
+            rascaline::MappedDescriptor("not-there.desc"),
+            Catch::Matchers::StartsWith("io error: ")
+        );
+    }
+
+    SECTION("single precision") {
+        auto descriptor = rascaline::Descriptor();
+        compute_descriptor(descriptor);
+
+        auto expected_values = std::vector<double>(
+            descriptor.values().data(),
+            descriptor.values().data() + 4 * 2
+        );
+
+        auto single = rascaline::DescriptorF32(descriptor);
+        // the data was moved out of the descriptor
+        CHECK(descriptor.values().is_empty());
+
+        CHECK(single.samples().shape() == std::array<size_t, 2>{4, 2});
+        CHECK(single.features().names()[0] == "index_delta");
+        CHECK(single.gradients_samples().shape() == std::array<size_t, 2>{18, 3});
+
+        auto values = single.values();
+        CHECK(values.shape() == std::array<size_t, 2>{4, 2});
+        for (size_t i=0; i<values.shape()[0]; i++) {
+            for (size_t j=0; j<values.shape()[1]; j++) {
+                CHECK(values(i, j) == static_cast<float>(expected_values[i * 2 + j]));
+            }
+        }
+
+        auto gradients = single.gradients();
+        CHECK(gradients.shape() == std::array<size_t, 2>{18, 2});
+        for (size_t i=0; i<gradients.shape()[0]; i++) {
+            CHECK(gradients(i, 0) == 0.0f);
+            CHECK(gradients(i, 1) == 1.0f);
+        }
+
+        // the descriptor can still be used for other calculations
+        compute_descriptor(descriptor);
+        CHECK(descriptor.values().shape() == std::array<size_t, 2>{4, 2});
+    }
 }
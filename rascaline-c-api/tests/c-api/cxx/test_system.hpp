@@ -80,6 +80,46 @@ class TestSystem: public rascaline::System {
     }
 };
 
+/// Same as `TestSystem`, giving access to all the data through
+/// `System::data`
+class TestSystemWithData: public TestSystem {
+    rascal_system_data_t data() const override {
+        static int32_t SPECIES[4] = {6, 1, 1, 1};
+        static double POSITIONS[4][3] = {
+            {0, 0, 0},
+            {1, 1, 1},
+            {2, 2, 2},
+            {3, 3, 3},
+        };
+
+        static rascal_pair_t PAIRS[] = {
+            {0, 1, SQRT_3, {1, 1, 1}},
+            {1, 2, SQRT_3, {1, 1, 1}},
+            {2, 3, SQRT_3, {1, 1, 1}},
+        };
+
+        static rascal_pair_t CENTER_PAIRS[] = {
+            {0, 1, SQRT_3, {1, 1, 1}},
+            {0, 1, SQRT_3, {1, 1, 1}},
+            {1, 2, SQRT_3, {1, 1, 1}},
+            {1, 2, SQRT_3, {1, 1, 1}},
+            {2, 3, SQRT_3, {1, 1, 1}},
+            {2, 3, SQRT_3, {1, 1, 1}},
+        };
+        static uintptr_t CENTER_OFFSETS[] = {0, 1, 3, 5, 6};
+
+        auto data = rascal_system_data_t();
+        data.generation = 1;
+        data.species = SPECIES;
+        data.positions = &POSITIONS[0][0];
+        data.pairs = PAIRS;
+        data.pairs_count = 3;
+        data.center_pairs = CENTER_PAIRS;
+        data.center_offsets = CENTER_OFFSETS;
+        return data;
+    }
+};
+
 #undef SQRT_3
 
 #endif
@@ -0,0 +1,125 @@
+#![allow(clippy::needless_return)]
+
+use std::time::{Duration, Instant};
+
+use rascaline::{Calculator, Descriptor, System};
+use rascaline::descriptor::{SamplesBuilder, AtomSamples};
+use rascaline::descriptor::{TwoBodiesSpeciesSamples, ThreeBodiesSpeciesSamples};
+
+use criterion::{BenchmarkGroup, Criterion, measurement::WallTime, SamplingMode};
+use criterion::{black_box, criterion_group, criterion_main};
+
+mod utils;
+use utils::{generated_system, test_mode};
+
+fn systems(n_atoms: usize, cutoff: f64) -> Vec<Box<dyn System>> {
+    let mut system = generated_system(n_atoms, true);
+    system.compute_neighbors(cutoff).unwrap();
+    return vec![Box::new(system) as Box<dyn System>];
+}
+
+fn run_samples(mut group: BenchmarkGroup<WallTime>, n_atoms: usize, gradients: bool) {
+    let cutoff = 4.0;
+    let mut systems = systems(n_atoms, cutoff);
+
+    let builders: Vec<(&str, Box<dyn SamplesBuilder>)> = vec![
+        ("atoms", Box::new(AtomSamples::new(cutoff))),
+        ("two bodies species", Box::new(TwoBodiesSpeciesSamples::new(cutoff))),
+        ("three bodies species", Box::new(ThreeBodiesSpeciesSamples::new(cutoff))),
+    ];
+
+    for (name, builder) in builders {
+        group.bench_function(name, |b| b.iter_custom(|repeat| {
+            let start = Instant::now();
+            for _ in 0..repeat {
+                if gradients {
+                    black_box(builder.with_gradients(&mut systems).unwrap());
+                } else {
+                    black_box(builder.samples(&mut systems).unwrap());
+                }
+            }
+            start.elapsed() / n_atoms as u32
+        }));
+    }
+}
+
+fn samples(c: &mut Criterion) {
+    let n_atoms = if test_mode() { 100 } else { 10_000 };
+
+    let mut group = c.benchmark_group(format!("Samples (per atom)/{} atoms", n_atoms));
+    group.noise_threshold(0.05);
+    group.sampling_mode(SamplingMode::Flat);
+    group.sample_size(10);
+
+    run_samples(group, n_atoms, false);
+
+    let mut group = c.benchmark_group(format!("Samples (per atom) with gradients/{} atoms", n_atoms));
+    group.noise_threshold(0.05);
+    group.sampling_mode(SamplingMode::Flat);
+    group.sample_size(10);
+
+    run_samples(group, n_atoms, true);
+}
+
+fn run_densify(mut group: BenchmarkGroup<WallTime>, n_atoms: usize, gradients: bool) {
+    let cutoff = 4.0;
+    let mut systems = systems(n_atoms, cutoff);
+
+    let parameters = format!(r#"{{
+        "cutoff": {},
+        "max_radial": 6,
+        "max_angular": 6,
+        "atomic_gaussian_width": 0.3,
+        "gradients": {},
+        "radial_basis": {{"Gto": {{}}}},
+        "cutoff_function": {{"ShiftedCosine": {{"width": 0.5}}}}
+    }}"#, cutoff, gradients);
+
+    let mut calculator = Calculator::new("spherical_expansion", parameters).unwrap();
+    let mut descriptor = Descriptor::new();
+    calculator.compute(&mut systems, &mut descriptor, Default::default()).unwrap();
+
+    group.bench_function("species_neighbor", |b| b.iter_custom(|repeat| {
+        let mut elapsed = Duration::new(0, 0);
+        for _ in 0..repeat {
+            // only measure the time spent in densify, not the copy
+            let mut descriptor = descriptor.clone();
+            let start = Instant::now();
+            descriptor.densify(&["species_neighbor"], None).unwrap();
+            elapsed += start.elapsed();
+        }
+        elapsed / n_atoms as u32
+    }));
+
+    group.bench_function("species_center, species_neighbor", |b| b.iter_custom(|repeat| {
+        let mut elapsed = Duration::new(0, 0);
+        for _ in 0..repeat {
+            let mut descriptor = descriptor.clone();
+            let start = Instant::now();
+            descriptor.densify(&["species_center", "species_neighbor"], None).unwrap();
+            elapsed += start.elapsed();
+        }
+        elapsed / n_atoms as u32
+    }));
+}
+
+fn densify(c: &mut Criterion) {
+    let n_atoms = if test_mode() { 100 } else { 5_000 };
+
+    let mut group = c.benchmark_group(format!("Densify spherical expansion (per atom)/{} atoms", n_atoms));
+    group.noise_threshold(0.05);
+    group.sampling_mode(SamplingMode::Flat);
+    group.sample_size(10);
+
+    run_densify(group, n_atoms, false);
+
+    let mut group = c.benchmark_group(format!("Densify spherical expansion (per atom) with gradients/{} atoms", n_atoms));
+    group.noise_threshold(0.05);
+    group.sampling_mode(SamplingMode::Flat);
+    group.sample_size(10);
+
+    run_densify(group, n_atoms, true);
+}
+
+criterion_group!(all, samples, densify);
+criterion_main!(all);
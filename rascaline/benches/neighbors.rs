@@ -0,0 +1,45 @@
+#![allow(clippy::needless_return)]
+
+use rascaline::System;
+use rascaline::systems::NeighborsList;
+
+use criterion::{Criterion, SamplingMode};
+use criterion::{black_box, criterion_group, criterion_main};
+
+mod utils;
+use utils::{generated_system, test_mode};
+
+fn neighbors_list(c: &mut Criterion) {
+    let sizes: &[usize] = if test_mode() {
+        &[1_000]
+    } else {
+        &[1_000, 10_000, 100_000, 1_000_000]
+    };
+
+    for &periodic in &[true, false] {
+        let name = if periodic { "periodic" } else { "non-periodic" };
+        let mut group = c.benchmark_group(format!("Neighbors list (per atom)/{}", name));
+        group.noise_threshold(0.05);
+        group.sampling_mode(SamplingMode::Flat);
+        group.sample_size(10);
+
+        for &n_atoms in sizes {
+            let system = generated_system(n_atoms, periodic);
+            let positions = system.positions().unwrap().to_vec();
+            let cell = system.cell().unwrap();
+
+            for &cutoff in black_box(&[3.0, 6.0]) {
+                group.bench_function(&format!("{} atoms, cutoff = {}", n_atoms, cutoff), |b| b.iter_custom(|repeat| {
+                    let start = std::time::Instant::now();
+                    for _ in 0..repeat {
+                        black_box(NeighborsList::new(&positions, cell, cutoff));
+                    }
+                    start.elapsed() / n_atoms as u32
+                }));
+            }
+        }
+    }
+}
+
+criterion_group!(all, neighbors_list);
+criterion_main!(all);
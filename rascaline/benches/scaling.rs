@@ -0,0 +1,148 @@
+#![allow(clippy::needless_return)]
+
+use std::time::Instant;
+
+use rascaline::{Calculator, CalculationOptions, Descriptor, System};
+
+use criterion::{BenchmarkGroup, Criterion, measurement::WallTime, SamplingMode};
+use criterion::{criterion_group, criterion_main};
+
+mod utils;
+use utils::{generated_system, test_mode, CallbackSystem};
+
+const CUTOFF: f64 = 4.0;
+
+fn power_spectrum(gradients: bool) -> Calculator {
+    let parameters = format!(r#"{{
+        "cutoff": {},
+        "max_radial": 6,
+        "max_angular": 4,
+        "atomic_gaussian_width": 0.3,
+        "gradients": {},
+        "radial_basis": {{"Gto": {{}}}},
+        "cutoff_function": {{"ShiftedCosine": {{"width": 0.5}}}}
+    }}"#, CUTOFF, gradients);
+
+    return Calculator::new("soap_power_spectrum", parameters).unwrap();
+}
+
+/// Get the number of threads to use for the scaling benchmarks: powers of two
+/// up to the number of threads in the default rayon thread pool.
+fn threads_counts() -> Vec<usize> {
+    let max_threads = rayon::current_num_threads();
+    let mut counts = Vec::new();
+    let mut n_threads = 1;
+    while n_threads < max_threads {
+        counts.push(n_threads);
+        n_threads *= 2;
+    }
+    counts.push(max_threads);
+    return counts;
+}
+
+/// Run the SOAP power spectrum calculation with different number of threads.
+/// If `atoms_per_thread` is false, the size of the system is fixed to `n_atoms`
+/// (strong scaling), otherwise the system contains `n_atoms` for each thread
+/// (weak scaling).
+fn run_scaling(mut group: BenchmarkGroup<WallTime>, n_atoms: usize, atoms_per_thread: bool) {
+    let mut calculator = power_spectrum(false);
+
+    for n_threads in threads_counts() {
+        let n_atoms = if atoms_per_thread { n_atoms * n_threads } else { n_atoms };
+        let mut system = generated_system(n_atoms, true);
+        system.compute_neighbors(CUTOFF).unwrap();
+        let mut systems = vec![Box::new(system) as Box<dyn System>];
+
+        let pool = rayon::ThreadPoolBuilder::new()
+            .num_threads(n_threads)
+            .build()
+            .expect("failed to create thread pool");
+
+        let mut descriptor = Descriptor::new();
+        let name = format!("{} threads, {} atoms", n_threads, n_atoms);
+        group.bench_function(&name, |b| b.iter_custom(|repeat| {
+            pool.install(|| {
+                let start = Instant::now();
+                for _ in 0..repeat {
+                    calculator.compute(&mut systems, &mut descriptor, Default::default()).unwrap();
+                }
+                start.elapsed() / n_atoms as u32
+            })
+        }));
+    }
+}
+
+fn threads_scaling(c: &mut Criterion) {
+    let n_atoms = if test_mode() { 50 } else { 4_000 };
+
+    let mut group = c.benchmark_group("SOAP power spectrum (per atom)/strong scaling");
+    group.noise_threshold(0.05);
+    group.sampling_mode(SamplingMode::Flat);
+    group.sample_size(10);
+
+    run_scaling(group, n_atoms, false);
+
+    let n_atoms = if test_mode() { 50 } else { 1_000 };
+
+    let mut group = c.benchmark_group("SOAP power spectrum (per atom)/weak scaling");
+    group.noise_threshold(0.05);
+    group.sampling_mode(SamplingMode::Flat);
+    group.sample_size(10);
+
+    run_scaling(group, n_atoms, true);
+}
+
+/// Compare running calculations directly on the user-provided systems (which
+/// go through the C API for users of the other languages, emulated here with
+/// `CallbackSystem`) and on copies of these systems as native `SimpleSystem`
+/// (`use_native_system`).
+fn run_native_systems(mut group: BenchmarkGroup<WallTime>, gradients: bool) {
+    let sizes: &[usize] = if test_mode() { &[100] } else { &[1_000, 10_000] };
+
+    let mut calculator = power_spectrum(gradients);
+    for &n_atoms in sizes {
+        for &periodic in &[true, false] {
+            let system = CallbackSystem::new(generated_system(n_atoms, periodic));
+            let mut systems = vec![Box::new(system) as Box<dyn System>];
+
+            for &use_native_system in &[false, true] {
+                let mut descriptor = Descriptor::new();
+                let name = format!(
+                    "{} atoms{}, use_native_system = {}",
+                    n_atoms, if periodic { "" } else { " (non-periodic)" }, use_native_system
+                );
+
+                group.bench_function(&name, |b| b.iter_custom(|repeat| {
+                    let start = Instant::now();
+                    for _ in 0..repeat {
+                        let options = CalculationOptions {
+                            use_native_system: use_native_system,
+                            ..Default::default()
+                        };
+                        calculator.compute(&mut systems, &mut descriptor, options).unwrap();
+                    }
+                    start.elapsed() / n_atoms as u32
+                }));
+            }
+        }
+    }
+}
+
+fn native_systems(c: &mut Criterion) {
+    let mut group = c.benchmark_group("SOAP power spectrum (per atom)/native systems");
+    group.noise_threshold(0.05);
+    group.sampling_mode(SamplingMode::Flat);
+    group.sample_size(10);
+
+    run_native_systems(group, false);
+
+    let mut group = c.benchmark_group("SOAP power spectrum (per atom) with gradients/native systems");
+    group.noise_threshold(0.05);
+    group.sampling_mode(SamplingMode::Flat);
+    group.sample_size(10);
+
+    run_native_systems(group, true);
+}
+
+criterion_group!(all, threads_scaling, native_systems);
+criterion_main!(all);
@@ -0,0 +1,80 @@
+#![allow(clippy::needless_return)]
+
+use rascaline::{Calculator, CalculationOptions, SelectedIndexes, System};
+use rascaline::descriptor::{IndexesBuilder, IndexValue};
+
+use criterion::{BenchmarkGroup, Criterion, measurement::WallTime, SamplingMode};
+use criterion::{black_box, criterion_group, criterion_main};
+
+fn load_systems(path: &str) -> Vec<Box<dyn System>> {
+    let systems = rascaline::systems::read_from_file(&format!("benches/data/{}", path))
+        .expect("failed to read file");
+
+    return systems.into_iter()
+        .map(|s| Box::new(s) as Box<dyn System>)
+        .collect()
+}
+
+fn run_selected_samples(mut group: BenchmarkGroup<WallTime>, path: &str, test_mode: bool) {
+    let mut systems = load_systems(path);
+
+    if test_mode {
+        systems.truncate(1);
+    }
+
+    let mut max_size = 0;
+    for system in &systems {
+        max_size = usize::max(max_size, system.size().unwrap());
+    }
+
+    let parameters = r#"{
+        "cutoff": 3.0,
+        "delta": 0,
+        "name": "",
+        "gradients": false
+    }"#;
+    let mut calculator = Calculator::new("dummy_calculator", parameters.into()).unwrap();
+
+    for &stride in black_box(&[1, 10, 100]) {
+        // select every `stride` center, in all structures
+        let mut selected = IndexesBuilder::new(vec!["center"]);
+        for center in (0..max_size).step_by(stride) {
+            selected.add(&[IndexValue::from(center)]);
+        }
+        let selected = selected.finish();
+        let n_selected = usize::max(selected.count(), 1);
+
+        group.bench_function(&format!("centers stride = {}", stride), |b| b.iter_custom(|repeat| {
+            let start = std::time::Instant::now();
+            for _ in 0..repeat {
+                let options = CalculationOptions {
+                    selected_samples: SelectedIndexes::Subset(selected.clone()),
+                    ..Default::default()
+                };
+                calculator.plan(&mut systems, options).unwrap();
+            }
+            start.elapsed() / n_selected as u32
+        }));
+    }
+}
+
+fn selected_samples(c: &mut Criterion) {
+    let test_mode = std::env::args().any(|arg| arg == "--test");
+
+    let mut group = c.benchmark_group("Partial samples selection (per selected center)/Bulk Silicon");
+    group.noise_threshold(0.05);
+    group.sampling_mode(SamplingMode::Flat);
+    group.sample_size(10);
+
+    run_selected_samples(group, "silicon_bulk.xyz", test_mode);
+
+    let mut group = c.benchmark_group("Partial samples selection (per selected center)/Molecular crystals");
+    group.noise_threshold(0.05);
+    group.sampling_mode(SamplingMode::Flat);
+    group.sample_size(10);
+
+    run_selected_samples(group, "molecular_crystals.xyz", test_mode);
+}
+
+criterion_group!(all, selected_samples);
+criterion_main!(all);
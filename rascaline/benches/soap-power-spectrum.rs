@@ -51,6 +51,7 @@ fn run_soap_power_spectrum(
                 radial_basis: RadialBasis::Gto {},
                 cutoff_function: CutoffFunction::ShiftedCosine{ width: 0.5 },
                 radial_scaling: RadialScaling::None {},
+                deduplicate_environments: None,
             };
             let mut calculator = SoapPowerSpectrum::new(parameters).unwrap();
 
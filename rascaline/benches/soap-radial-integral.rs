@@ -4,7 +4,7 @@ use rascaline::calculators::soap::RadialIntegral;
 use rascaline::calculators::soap::{GtoParameters, GtoRadialIntegral};
 use rascaline::calculators::soap::{SplinedRadialIntegral, SplinedRIParameters};
 
-use ndarray::Array2;
+use ndarray::{Array2, Array3};
 
 use criterion::{Criterion, black_box, criterion_group, criterion_main};
 use criterion::{BenchmarkGroup, measurement::WallTime};
@@ -12,6 +12,7 @@ use criterion::{BenchmarkGroup, measurement::WallTime};
 fn benchmark_radial_integral(
     mut group: BenchmarkGroup<'_, WallTime>,
     benchmark_gradients: bool,
+    batch: bool,
     create_radial_integral: impl Fn(usize, usize) -> Box<dyn RadialIntegral>,
 ) {
     for &max_radial in black_box(&[2, 8, 14]) {
@@ -27,9 +28,22 @@ fn benchmark_radial_integral(
                 2.109, 2.266, 2.852, 2.942, 3.021, 3.247, 3.859, 4.462,
             ];
 
+            let batch_shape = (distances.len(), max_radial, max_angular + 1);
+            let mut batch_values = Array3::from_elem(batch_shape, 0.0);
+            let mut batch_gradients = Array3::from_elem(batch_shape, 0.0);
+
             group.bench_function(&format!("n_max = {}, l_max = {}", max_radial, max_angular), |b| b.iter_custom(|repeat| {
                 let start = std::time::Instant::now();
                 for _ in 0..repeat {
+                    if batch {
+                        if benchmark_gradients {
+                            ri.compute_batch(&distances, batch_values.view_mut(), Some(batch_gradients.view_mut()))
+                        } else {
+                            ri.compute_batch(&distances, batch_values.view_mut(), None)
+                        }
+                        continue;
+                    }
+
                     for &distance in &distances {
                         if benchmark_gradients {
                             ri.compute(distance, values.view_mut(), Some(gradients.view_mut()))
@@ -57,11 +71,19 @@ fn gto_radial_integral(c: &mut Criterion) {
 
     let mut group = c.benchmark_group("GTO (per neighbor)");
     group.noise_threshold(0.05);
-    benchmark_radial_integral(group, false, create_radial_integral);
+    benchmark_radial_integral(group, false, false, create_radial_integral);
 
     let mut group = c.benchmark_group("GTO with gradients (per neighbor)");
     group.noise_threshold(0.05);
-    benchmark_radial_integral(group, true, create_radial_integral);
+    benchmark_radial_integral(group, true, false, create_radial_integral);
+
+    let mut group = c.benchmark_group("GTO batch (per neighbor)");
+    group.noise_threshold(0.05);
+    benchmark_radial_integral(group, false, true, create_radial_integral);
+
+    let mut group = c.benchmark_group("GTO batch with gradients (per neighbor)");
+    group.noise_threshold(0.05);
+    benchmark_radial_integral(group, true, true, create_radial_integral);
 }
 
 fn splined_gto_radial_integral(c: &mut Criterion) {
@@ -86,11 +108,11 @@ fn splined_gto_radial_integral(c: &mut Criterion) {
 
     let mut group = c.benchmark_group("Splined GTO (per neighbor)");
     group.noise_threshold(0.05);
-    benchmark_radial_integral(group, false, create_radial_integral);
+    benchmark_radial_integral(group, false, false, create_radial_integral);
 
     let mut group = c.benchmark_group("Splined GTO with gradients (per neighbor)");
     group.noise_threshold(0.05);
-    benchmark_radial_integral(group, true, create_radial_integral);
+    benchmark_radial_integral(group, true, false, create_radial_integral);
 }
 
 criterion_group!(gto, gto_radial_integral, splined_gto_radial_integral);
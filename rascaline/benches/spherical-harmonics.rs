@@ -1,6 +1,8 @@
 use rascaline::Vector3D;
 use rascaline::calculators::soap::{SphericalHarmonics, SphericalHarmonicsArray};
 
+use ndarray::{Array2, Array3};
+
 use criterion::{Criterion, black_box, criterion_group, criterion_main};
 
 fn spherical_harmonics(c: &mut Criterion) {
@@ -90,5 +92,39 @@ fn spherical_harmonics_with_gradients(c: &mut Criterion) {
     }
 }
 
-criterion_group!(benches, spherical_harmonics, spherical_harmonics_with_gradients);
+fn spherical_harmonics_batch(c: &mut Criterion) {
+    let mut group = c.benchmark_group("spherical harmonics with gradients (batch of 1024 neighbors, per neighbor)");
+    group.noise_threshold(0.05);
+
+    let n_directions = 1024;
+    let mut x = Vec::with_capacity(n_directions);
+    let mut y = Vec::with_capacity(n_directions);
+    let mut z = Vec::with_capacity(n_directions);
+    for i in 0..n_directions {
+        // points on a spiral covering the whole sphere
+        let cos_theta = 1.0 - 2.0 * (i as f64 + 0.5) / n_directions as f64;
+        let sin_theta = f64::sqrt(1.0 - cos_theta * cos_theta);
+        let phi = 2.399963229728653 * i as f64;
+        x.push(sin_theta * f64::cos(phi));
+        y.push(sin_theta * f64::sin(phi));
+        z.push(cos_theta);
+    }
+
+    for &max_angular in black_box(&[1, 3, 5, 7, 13, 17, 21, 25]) {
+        let size = (max_angular + 1) * (max_angular + 1);
+        let mut values = Array2::from_elem((n_directions, size), 0.0);
+        let mut gradients = Array3::from_elem((n_directions, 3, size), 0.0);
+        let mut sph = SphericalHarmonics::new(max_angular);
+
+        group.bench_function(&format!("l_max = {}", max_angular), |b| b.iter_custom(|repeat| {
+            let start = std::time::Instant::now();
+            for _ in 0..repeat {
+                sph.compute_batch(&x, &y, &z, values.view_mut(), Some(gradients.view_mut()));
+            }
+            start.elapsed() / n_directions as u32
+        }));
+    }
+}
+
+criterion_group!(benches, spherical_harmonics, spherical_harmonics_with_gradients, spherical_harmonics_batch);
 criterion_main!(benches);
@@ -0,0 +1,270 @@
+use std::os::raw::c_void;
+
+use rascaline::{Error, Matrix3, SimpleSystem, System, Vector3D};
+use rascaline::systems::{CenterPairs, Pair, UnitCell};
+
+/// Distance between atoms in generated systems, giving a density close to the
+/// one of bulk silicon
+const LATTICE_SPACING: f64 = 2.7;
+
+/// Are we running the benchmarks in test mode (`cargo bench -- --test`)? This
+/// is used to reduce the time/RAM required to test the benchmarks code in CI.
+#[allow(dead_code)]
+pub fn test_mode() -> bool {
+    std::env::args().any(|arg| arg == "--test")
+}
+
+/// Load all the systems in the file at `benches/data/<path>`
+#[allow(dead_code)]
+pub fn load_systems(path: &str) -> Vec<Box<dyn System>> {
+    let systems = rascaline::systems::read_from_file(&format!("benches/data/{}", path))
+        .expect("failed to read file");
+
+    return systems.into_iter()
+        .map(|s| Box::new(s) as Box<dyn System>)
+        .collect()
+}
+
+/// Generate a system with `n_atoms` atoms of three different species, placed
+/// on a randomly perturbed cubic lattice. If `periodic` is true, the system is
+/// placed in a cubic unit cell matching the lattice, otherwise it uses an
+/// infinite unit cell.
+///
+/// The same system is generated every time for a given `n_atoms`.
+#[allow(dead_code)]
+pub fn generated_system(n_atoms: usize, periodic: bool) -> SimpleSystem {
+    let n_side = (n_atoms as f64).cbrt().ceil() as usize;
+    let cell = if periodic {
+        UnitCell::cubic(n_side as f64 * LATTICE_SPACING)
+    } else {
+        UnitCell::infinite()
+    };
+
+    // simple linear congruential generator, we don't need high quality random
+    // numbers here, only reproducible ones
+    let mut state = 0x853c_49e6_748f_ea9b_u64;
+    let mut random = move || {
+        state = state.wrapping_mul(6364136223846793005).wrapping_add(1442695040888963407);
+        ((state >> 11) as f64) / ((1_u64 << 53) as f64) - 0.5
+    };
+
+    let mut system = SimpleSystem::new(cell);
+    'outer: for i in 0..n_side {
+        for j in 0..n_side {
+            for k in 0..n_side {
+                let index = (i * n_side + j) * n_side + k;
+                if index == n_atoms {
+                    break 'outer;
+                }
+
+                let position = Vector3D::new(
+                    (i as f64 + 0.3 * random()) * LATTICE_SPACING,
+                    (j as f64 + 0.3 * random()) * LATTICE_SPACING,
+                    (k as f64 + 0.3 * random()) * LATTICE_SPACING,
+                );
+                system.add_atom([1, 6, 8][index % 3], position);
+            }
+        }
+    }
+
+    return system;
+}
+
+/// User data for `CallbackSystem`, with a contiguous copy of the pairs
+/// containing each center, as a system implemented in another language would
+/// provide them
+struct CallbackData {
+    system: SimpleSystem,
+    center_pairs: Vec<Pair>,
+    center_offsets: Vec<usize>,
+}
+
+/// Implementation of `System` going through C function pointers for all
+/// accesses to the data, with the same callbacks as `rascal_system_t` in the
+/// C API. This is used to measure the overhead of systems defined in other
+/// languages compared to native systems.
+#[allow(dead_code)]
+pub struct CallbackSystem {
+    user_data: *mut c_void,
+    size: unsafe extern fn(*const c_void, *mut usize) -> i32,
+    species: unsafe extern fn(*const c_void, *mut *const i32) -> i32,
+    positions: unsafe extern fn(*const c_void, *mut *const f64) -> i32,
+    cell: unsafe extern fn(*const c_void, *mut f64) -> i32,
+    compute_neighbors: unsafe extern fn(*mut c_void, f64) -> i32,
+    pairs: unsafe extern fn(*const c_void, *mut *const Pair, *mut usize) -> i32,
+    pairs_containing: unsafe extern fn(*const c_void, usize, *mut *const Pair, *mut usize) -> i32,
+}
+
+fn callback_status(function: impl FnOnce() -> Result<(), Error>) -> i32 {
+    match function() {
+        Ok(()) => 0,
+        Err(_) => -1,
+    }
+}
+
+fn check_status(status: i32, function: &str) -> Result<(), Error> {
+    if status == 0 {
+        Ok(())
+    } else {
+        Err(Error::External {
+            status: status,
+            message: format!("call to CallbackSystem.{} failed", function),
+        })
+    }
+}
+
+#[allow(dead_code)]
+impl CallbackSystem {
+    pub fn new(system: SimpleSystem) -> CallbackSystem {
+        unsafe extern fn size(this: *const c_void, size: *mut usize) -> i32 {
+            callback_status(|| {
+                *size = (*this.cast::<CallbackData>()).system.size()?;
+                Ok(())
+            })
+        }
+
+        unsafe extern fn species(this: *const c_void, species: *mut *const i32) -> i32 {
+            callback_status(|| {
+                *species = (*this.cast::<CallbackData>()).system.species()?.as_ptr();
+                Ok(())
+            })
+        }
+
+        unsafe extern fn positions(this: *const c_void, positions: *mut *const f64) -> i32 {
+            callback_status(|| {
+                *positions = (*this.cast::<CallbackData>()).system.positions()?.as_ptr().cast();
+                Ok(())
+            })
+        }
+
+        unsafe extern fn cell(this: *const c_void, cell: *mut f64) -> i32 {
+            callback_status(|| {
+                let matrix = (*this.cast::<CallbackData>()).system.cell()?.matrix();
+                for i in 0..3 {
+                    for j in 0..3 {
+                        cell.add(3 * i + j).write(matrix[i][j]);
+                    }
+                }
+                Ok(())
+            })
+        }
+
+        unsafe extern fn compute_neighbors(this: *mut c_void, cutoff: f64) -> i32 {
+            callback_status(|| {
+                let data = &mut *this.cast::<CallbackData>();
+                data.system.compute_neighbors(cutoff)?;
+
+                data.center_pairs.clear();
+                data.center_offsets.clear();
+                data.center_offsets.push(0);
+                for center in 0..data.system.size()? {
+                    data.center_pairs.extend(data.system.pairs_containing(center)?);
+                    data.center_offsets.push(data.center_pairs.len());
+                }
+                Ok(())
+            })
+        }
+
+        unsafe extern fn pairs(this: *const c_void, pairs: *mut *const Pair, count: *mut usize) -> i32 {
+            callback_status(|| {
+                let all_pairs = (*this.cast::<CallbackData>()).system.pairs()?;
+                *pairs = all_pairs.as_ptr();
+                *count = all_pairs.len();
+                Ok(())
+            })
+        }
+
+        unsafe extern fn pairs_containing(this: *const c_void, center: usize, pairs: *mut *const Pair, count: *mut usize) -> i32 {
+            callback_status(|| {
+                let data = &*this.cast::<CallbackData>();
+                let start = data.center_offsets[center];
+                *pairs = data.center_pairs[start..].as_ptr();
+                *count = data.center_offsets[center + 1] - start;
+                Ok(())
+            })
+        }
+
+        let data = CallbackData {
+            system: system,
+            center_pairs: Vec::new(),
+            center_offsets: Vec::new(),
+        };
+
+        CallbackSystem {
+            user_data: Box::into_raw(Box::new(data)).cast(),
+            size: size,
+            species: species,
+            positions: positions,
+            cell: cell,
+            compute_neighbors: compute_neighbors,
+            pairs: pairs,
+            pairs_containing: pairs_containing,
+        }
+    }
+}
+
+impl Drop for CallbackSystem {
+    fn drop(&mut self) {
+        unsafe {
+            std::mem::drop(Box::from_raw(self.user_data.cast::<CallbackData>()));
+        }
+    }
+}
+
+impl System for CallbackSystem {
+    fn size(&self) -> Result<usize, Error> {
+        let mut value = 0;
+        check_status(unsafe { (self.size)(self.user_data, &mut value) }, "size")?;
+        return Ok(value);
+    }
+
+    fn species(&self) -> Result<&[i32], Error> {
+        let mut ptr = std::ptr::null();
+        check_status(unsafe { (self.species)(self.user_data, &mut ptr) }, "species")?;
+        unsafe {
+            return Ok(std::slice::from_raw_parts(ptr, self.size()?));
+        }
+    }
+
+    fn positions(&self) -> Result<&[Vector3D], Error> {
+        let mut ptr = std::ptr::null();
+        check_status(unsafe { (self.positions)(self.user_data, &mut ptr) }, "positions")?;
+        unsafe {
+            return Ok(std::slice::from_raw_parts(ptr.cast(), self.size()?));
+        }
+    }
+
+    fn cell(&self) -> Result<UnitCell, Error> {
+        let mut value = [[0.0; 3]; 3];
+        check_status(unsafe { (self.cell)(self.user_data, &mut value[0][0]) }, "cell")?;
+
+        let matrix = Matrix3::from(value);
+        if matrix == Matrix3::zero() {
+            Ok(UnitCell::infinite())
+        } else {
+            Ok(UnitCell::from(matrix))
+        }
+    }
+
+    fn compute_neighbors(&mut self, cutoff: f64) -> Result<(), Error> {
+        check_status(unsafe { (self.compute_neighbors)(self.user_data, cutoff) }, "compute_neighbors")
+    }
+
+    fn pairs(&self) -> Result<&[Pair], Error> {
+        let mut ptr = std::ptr::null();
+        let mut count = 0;
+        check_status(unsafe { (self.pairs)(self.user_data, &mut ptr, &mut count) }, "pairs")?;
+        unsafe {
+            return Ok(std::slice::from_raw_parts(ptr, count));
+        }
+    }
+
+    fn pairs_containing(&self, center: usize) -> Result<CenterPairs<'_>, Error> {
+        let mut ptr = std::ptr::null();
+        let mut count = 0;
+        check_status(unsafe { (self.pairs_containing)(self.user_data, center, &mut ptr, &mut count) }, "pairs_containing")?;
+        unsafe {
+            return Ok(CenterPairs::Pairs(std::slice::from_raw_parts(ptr, count)));
+        }
+    }
+}
@@ -1,7 +1,14 @@
-use std::{collections::BTreeMap, convert::TryFrom};
+use std::collections::{BTreeMap, HashMap};
+use std::convert::TryFrom;
+use std::path::Path;
+use std::hash::{BuildHasherDefault, Hash, Hasher};
 
-use crate::{SimpleSystem, descriptor::{Descriptor, Indexes, IndexesBuilder}};
-use crate::systems::System;
+use twox_hash::XxHash64;
+
+use rayon::prelude::*;
+
+use crate::{SimpleSystem, descriptor::{Descriptor, Indexes, IndexesBuilder, IndexValue}};
+use crate::systems::{System, TrajectoryChunks};
 use crate::Error;
 
 use crate::calculators::CalculatorBase;
@@ -35,39 +42,7 @@ impl SelectedIndexes {
                     calculator.check_features(&indexes)?;
                     indexes
                 } else {
-                    let mut variables_to_match = Vec::new();
-                    for variable in indexes.names() {
-                        let i = match default_features.names().iter().position(|&v| v == variable) {
-                            Some(index) => index,
-                            None => {
-                                return Err(Error::InvalidParameter(format!(
-                                    "'{}' in requested features is not part of the features of this calculator",
-                                    variable
-                                )))
-                            }
-                        };
-                        variables_to_match.push(i);
-                    }
-
-                    let mut filtered = IndexesBuilder::new(default_features.names());
-                    for selected in indexes.iter() {
-                        for features in default_features.iter() {
-                            // only take the features if they match
-                            let mut matches = true;
-                            for (i, &v) in variables_to_match.iter().enumerate() {
-                                if selected[i] != features[v] {
-                                    matches = false;
-                                    break;
-                                }
-                            }
-
-                            if matches {
-                                filtered.add(features);
-                            }
-                        }
-                    }
-
-                    filtered.finish()
+                    select_matching(&indexes, &default_features, "features")?
                 }
             },
         };
@@ -92,56 +67,118 @@ impl SelectedIndexes {
                     calculator.check_samples(&indexes, systems)?;
                     indexes
                 } else {
-                    let mut variables_to_match = Vec::new();
-                    for variable in indexes.names() {
-                        let i = match default_samples.names().iter().position(|&v| v == variable) {
-                            Some(index) => index,
-                            None => {
-                                return Err(Error::InvalidParameter(format!(
-                                    "'{}' in requested samples is not part of the samples of this calculator",
-                                    variable
-                                )))
-                            }
-                        };
-                        variables_to_match.push(i);
-                    }
-
-                    let mut filtered = IndexesBuilder::new(default_samples.names());
-                    for selected in indexes.iter() {
-                        for sample in default_samples.iter() {
-                            // only take the samples if they match
-                            let mut matches = true;
-                            for (i, &v) in variables_to_match.iter().enumerate() {
-                                if selected[i] != sample[v] {
-                                    matches = false;
-                                    break;
-                                }
-                            }
-
-                            if matches {
-                                filtered.add(sample);
-                            }
-                        }
-                    }
-
-                    filtered.finish()
+                    select_matching(&indexes, &default_samples, "samples")?
                 }
             },
         };
 
         return Ok(indexes);
     }
+
+    /// Feed the content of these selected indexes to the given `hasher`
+    fn hash_into(&self, hasher: &mut impl Hasher) {
+        match self {
+            SelectedIndexes::All => 0_u8.hash(hasher),
+            SelectedIndexes::Subset(indexes) => {
+                1_u8.hash(hasher);
+                indexes.names().hash(hasher);
+                indexes.count().hash(hasher);
+                for index in indexes.iter() {
+                    index.hash(hasher);
+                }
+            }
+        }
+    }
+}
+
+/// Get all entries in `all` matching one of the entries in `selected`, where
+/// `selected` only contains a subset of the variables in `all`. The entries
+/// are ordered following `selected`, and then following `all` for entries
+/// matching the same selected entry.
+///
+/// This uses a hash map from the values taken by the selected variables to
+/// the corresponding positions in `all`, making the cost of the selection
+/// linear in the size of both `selected` and `all`.
+#[time_graph::instrument(name = "SelectedIndexes::select_matching")]
+fn select_matching(selected: &Indexes, all: &Indexes, kind: &str) -> Result<Indexes, Error> {
+    let mut variables_to_match = Vec::new();
+    for variable in selected.names() {
+        let i = match all.names().iter().position(|&v| v == variable) {
+            Some(index) => index,
+            None => {
+                return Err(Error::InvalidParameter(format!(
+                    "'{}' in requested {} is not part of the {} of this calculator",
+                    variable, kind, kind
+                )))
+            }
+        };
+        variables_to_match.push(i);
+    }
+
+    let mut positions: HashMap<Vec<IndexValue>, Vec<usize>, BuildHasherDefault<XxHash64>> = Default::default();
+    for (position, entry) in all.iter().enumerate() {
+        let projection = variables_to_match.iter().map(|&v| entry[v]).collect::<Vec<_>>();
+        positions.entry(projection).or_default().push(position);
+    }
+
+    let mut filtered = IndexesBuilder::new(all.names());
+    for entry in selected.iter() {
+        if let Some(positions) = positions.get(entry) {
+            for &position in positions {
+                filtered.add(&all[position]);
+            }
+        }
+    }
+
+    return Ok(filtered.finish());
+}
+
+/// Copy the data from `systems` into `SimpleSystem`, and compute the neighbors
+/// lists of all systems in parallel with the given `cutoff`, if any.
+fn to_native_systems(systems: &mut [Box<dyn System>], cutoff: Option<f64>) -> Result<Vec<Box<dyn System>>, Error> {
+    let mut simple_systems = Vec::with_capacity(systems.len());
+    for system in systems {
+        simple_systems.push(SimpleSystem::try_from(&**system)?);
+    }
+
+    // `SimpleSystem` can be sent across threads, so we compute all the
+    // neighbors lists in parallel. This is especially useful when working
+    // with a lot of small systems, where parallelizing inside a single system
+    // would not use all the available threads.
+    if let Some(cutoff) = cutoff {
+        time_graph::spanned!("Calculator::neighbors", {
+            crate::threads::install(|| {
+                simple_systems.par_iter_mut().try_for_each(|system| system.compute_neighbors(cutoff))
+            })?;
+        });
+    }
+
+    let native_systems = simple_systems.into_iter()
+        .map(|system| Box::new(system) as Box<dyn System>)
+        .collect::<Vec<_>>();
+
+    return Ok(native_systems);
 }
 
 /// Parameters specific to a single call to `compute`
+#[derive(Clone)]
 pub struct CalculationOptions {
     /// Copy the data from systems into native `SimpleSystem`. This can be
-    /// faster than having to cross the FFI boundary too often.
+    /// faster than having to cross the FFI boundary too often, and allows
+    /// computing the neighbors lists of all systems in parallel.
     pub use_native_system: bool,
     /// List of selected samples on which to run the computation
     pub selected_samples: SelectedIndexes,
     /// List of selected features on which to run the computation
     pub selected_features: SelectedIndexes,
+    /// Re-use the samples, gradients samples and features already stored in
+    /// the descriptor if they were created by a previous call to `compute`
+    /// with the same calculator, the same selected samples and features, and
+    /// systems with the same atoms and neighbors pairs. In this case, the
+    /// values and gradients arrays are set to zero in place instead of being
+    /// re-allocated. This is useful when computing the representation of the
+    /// same system again and again, for example in molecular dynamics.
+    pub reuse_descriptor: bool,
 }
 
 impl Default for CalculationOptions {
@@ -150,10 +187,58 @@ impl Default for CalculationOptions {
             use_native_system: false,
             selected_samples: SelectedIndexes::All,
             selected_features: SelectedIndexes::All,
+            reuse_descriptor: false,
         }
     }
 }
 
+/// A `CalculationPlan` contains the samples, gradients samples and features
+/// used by a [`Calculator`] for a given set of systems and selected indexes.
+///
+/// Plans are created with [`Calculator::plan`], and can then be used with
+/// [`Calculator::compute_with_plan`] to run the same calculation many times
+/// without re-creating the indexes, as long as the systems keep the same atoms
+/// and neighbors pairs.
+#[derive(Clone, Debug)]
+pub struct CalculationPlan {
+    /// name of the calculator which created this plan
+    name: String,
+    /// parameters of the calculator which created this plan
+    parameters: String,
+    /// should we copy the systems into `SimpleSystem` before the calculation
+    use_native_system: bool,
+    /// number of atoms in each of the systems used to create this plan
+    systems_sizes: Vec<usize>,
+    samples: Indexes,
+    gradients_samples: Option<Indexes>,
+    features: Indexes,
+    /// selected samples and features used to create this plan, kept to
+    /// re-compute the fingerprint with new systems
+    selected_samples: SelectedIndexes,
+    selected_features: SelectedIndexes,
+    /// hash of the inputs used to create the indexes, see
+    /// `Calculator::fingerprint`
+    fingerprint: Option<u64>,
+}
+
+impl CalculationPlan {
+    /// Get the samples that will be used by calculations using this plan
+    pub fn samples(&self) -> &Indexes {
+        &self.samples
+    }
+
+    /// Get the gradients samples that will be used by calculations using this
+    /// plan, if the calculator computes gradients
+    pub fn gradients_samples(&self) -> Option<&Indexes> {
+        self.gradients_samples.as_ref()
+    }
+
+    /// Get the features that will be used by calculations using this plan
+    pub fn features(&self) -> &Indexes {
+        &self.features
+    }
+}
+
 impl From<Box<dyn CalculatorBase>> for Calculator {
     fn from(implementation: Box<dyn CalculatorBase>) -> Calculator {
         let parameters = implementation.get_parameters();
@@ -225,33 +310,441 @@ impl Calculator {
     ) -> Result<(), Error> {
         let mut native_systems;
         let systems = if options.use_native_system {
-            native_systems = Vec::with_capacity(systems.len());
-            for system in systems {
-                native_systems.push(Box::new(SimpleSystem::try_from(&**system)?) as Box<dyn System>);
+            native_systems = to_native_systems(systems, self.implementation.neighbors_cutoff())?;
+            &mut native_systems
+        } else {
+            systems
+        };
+
+        self.prepare(systems, descriptor, options)?;
+        self.implementation.compute(systems, descriptor)?;
+        return Ok(());
+    }
+
+    /// Set the samples, gradients samples and features of `descriptor` for a
+    /// calculation on `systems` with the given `options`, re-using the ones
+    /// already in `descriptor` if possible. `options.use_native_system` is
+    /// ignored, the systems should already be converted if needed.
+    fn prepare(
+        &self,
+        systems: &mut [Box<dyn System>],
+        descriptor: &mut Descriptor,
+        options: CalculationOptions,
+    ) -> Result<(), Error> {
+        let fingerprint = if options.reuse_descriptor {
+            self.fingerprint(systems, &options.selected_samples, &options.selected_features)?
+        } else {
+            None
+        };
+
+        if fingerprint.is_some() && descriptor.fingerprint == fingerprint && descriptor.has_consistent_shape() {
+            time_graph::spanned!("Calculator::reset", {
+                descriptor.reset();
+            });
+        } else {
+            let (samples, gradients_samples, features) = self.indexes(
+                systems, options.selected_samples, options.selected_features
+            )?;
+
+            match gradients_samples {
+                Some(gradients_samples) => descriptor.prepare_gradients(samples, gradients_samples, features),
+                None => descriptor.prepare(samples, features),
+            }
+
+            descriptor.fingerprint = fingerprint;
+        }
+
+        return Ok(());
+    }
+
+    /// Create a [`CalculationPlan`] for the given `systems` and `options`,
+    /// containing all the indexes required to run the calculation. The plan
+    /// can then be used with [`Calculator::compute_with_plan`] to run the same
+    /// calculation multiple times, on systems with the same atoms and
+    /// neighbors pairs (only the positions of the atoms are allowed to change)
+    /// without having to re-create the indexes every time.
+    ///
+    /// `options.reuse_descriptor` is ignored, since plans always re-use
+    /// descriptors when possible.
+    #[time_graph::instrument(name = "Calculator::plan")]
+    pub fn plan(
+        &mut self,
+        systems: &mut [Box<dyn System>],
+        options: CalculationOptions,
+    ) -> Result<CalculationPlan, Error> {
+        let mut native_systems;
+        let systems = if options.use_native_system {
+            native_systems = to_native_systems(systems, self.implementation.neighbors_cutoff())?;
+            &mut native_systems
+        } else {
+            systems
+        };
+
+        let fingerprint = self.fingerprint(systems, &options.selected_samples, &options.selected_features)?;
+
+        let mut systems_sizes = Vec::with_capacity(systems.len());
+        for system in systems.iter() {
+            systems_sizes.push(system.size()?);
+        }
+
+        let selected_samples = options.selected_samples.clone();
+        let selected_features = options.selected_features.clone();
+        let (samples, gradients_samples, features) = self.indexes(
+            systems, options.selected_samples, options.selected_features
+        )?;
+
+        return Ok(CalculationPlan {
+            name: self.name(),
+            parameters: self.parameters.clone(),
+            use_native_system: options.use_native_system,
+            systems_sizes: systems_sizes,
+            samples: samples,
+            gradients_samples: gradients_samples,
+            features: features,
+            selected_samples: selected_samples,
+            selected_features: selected_features,
+            fingerprint: fingerprint,
+        });
+    }
+
+    /// Compute the descriptor for all the given `systems` and store it in
+    /// `descriptor`, using the samples, gradients samples and features from
+    /// the given `plan`.
+    ///
+    /// The systems must contain the same atoms and neighbors pairs as the
+    /// systems used to create the plan, and this function returns an error if
+    /// they do not.
+    #[time_graph::instrument(name = "Calculator::compute_with_plan")]
+    pub fn compute_with_plan(
+        &mut self,
+        systems: &mut [Box<dyn System>],
+        descriptor: &mut Descriptor,
+        plan: &CalculationPlan,
+    ) -> Result<(), Error> {
+        if plan.name != self.name() || plan.parameters != self.parameters {
+            return Err(Error::InvalidParameter(
+                "this calculation plan was created by a different calculator".into()
+            ));
+        }
+
+        if systems.len() != plan.systems_sizes.len() {
+            return Err(Error::InvalidParameter(format!(
+                "this calculation plan was created for {} systems, but we got {} systems",
+                plan.systems_sizes.len(), systems.len()
+            )));
+        }
+
+        for (i, (system, &size)) in systems.iter().zip(&plan.systems_sizes).enumerate() {
+            if system.size()? != size {
+                return Err(Error::InvalidParameter(format!(
+                    "system {} has {} atoms, but the calculation plan was created for {} atoms",
+                    i, system.size()?, size
+                )));
             }
+        }
+
+        let mut native_systems;
+        let systems = if plan.use_native_system {
+            native_systems = to_native_systems(systems, self.implementation.neighbors_cutoff())?;
             &mut native_systems
         } else {
             systems
         };
 
-        let features = options.selected_features.into_features(&*self.implementation)?;
-        let samples = options.selected_samples.into_samples(&*self.implementation, systems)?;
+        let fingerprint = self.fingerprint(systems, &plan.selected_samples, &plan.selected_features)?;
+        if fingerprint != plan.fingerprint {
+            return Err(Error::InvalidParameter(
+                "the atoms or neighbors pairs in the systems changed since this calculation plan was created".into()
+            ));
+        }
 
-        time_graph::spanned!("Calculator::prepare", {
-            let builder = self.implementation.samples_builder();
-            if self.implementation.compute_gradients() {
-                let gradients = builder
+        if plan.fingerprint.is_some() && descriptor.fingerprint == plan.fingerprint && descriptor.has_consistent_shape() {
+            time_graph::spanned!("Calculator::reset", {
+                descriptor.reset();
+            });
+        } else {
+            let samples = plan.samples.clone();
+            let features = plan.features.clone();
+            match &plan.gradients_samples {
+                Some(gradients_samples) => descriptor.prepare_gradients(samples, gradients_samples.clone(), features),
+                None => descriptor.prepare(samples, features),
+            }
+
+            descriptor.fingerprint = plan.fingerprint;
+        }
+
+        self.implementation.compute(systems, descriptor)?;
+        return Ok(());
+    }
+
+    /// Compute the descriptor for all the structures in the trajectory file at
+    /// `path`, reading and computing at most `chunk_size` structures at a time.
+    ///
+    /// The file is read with chemfiles in a background thread while the
+    /// previous chunk is being computed, and only two chunks are kept in
+    /// memory at the same time. After the calculation of each chunk, `callback`
+    /// is called with the index of the first structure of the chunk in the
+    /// trajectory and the corresponding descriptor. The `structure` samples in
+    /// the descriptor are relative to the chunk. The memory of the descriptor
+    /// is re-used for all chunks, so any data must be copied out of it by the
+    /// callback.
+    ///
+    /// The same `options` are used for all chunks.
+    #[time_graph::instrument(name = "Calculator::compute_trajectory")]
+    pub fn compute_trajectory<F>(
+        &mut self,
+        path: impl AsRef<Path>,
+        chunk_size: usize,
+        options: CalculationOptions,
+        mut callback: F,
+    ) -> Result<(), Error> where F: FnMut(usize, &Descriptor) -> Result<(), Error> {
+        let mut descriptor = Descriptor::new();
+        let mut first_structure = 0;
+        for chunk in TrajectoryChunks::open(path, chunk_size)? {
+            let n_structures = self.compute_chunk(chunk?, &mut descriptor, options.clone())?;
+            callback(first_structure, &descriptor)?;
+            first_structure += n_structures;
+        }
+
+        return Ok(());
+    }
+
+    /// Compute the descriptor for a single chunk of systems obtained from
+    /// [`TrajectoryChunks`], returning the number of systems in the chunk.
+    ///
+    /// This is used to implement [`Calculator::compute_trajectory`], and is
+    /// only public to allow re-implementing it in the C API.
+    pub fn compute_chunk(
+        &mut self,
+        mut systems: Vec<SimpleSystem>,
+        descriptor: &mut Descriptor,
+        options: CalculationOptions,
+    ) -> Result<usize, Error> {
+        // the systems are already native systems, compute all the neighbors
+        // lists in parallel
+        if let Some(cutoff) = self.implementation.neighbors_cutoff() {
+            time_graph::spanned!("Calculator::neighbors", {
+                crate::threads::install(|| {
+                    systems.par_iter_mut().try_for_each(|system| system.compute_neighbors(cutoff))
+                })?;
+            });
+        }
+
+        let n_systems = systems.len();
+        let mut systems = systems.into_iter()
+            .map(|system| Box::new(system) as Box<dyn System>)
+            .collect::<Vec<_>>();
+
+        let options = CalculationOptions {
+            use_native_system: false,
+            ..options
+        };
+        self.compute(&mut systems, descriptor, options)?;
+
+        return Ok(n_systems);
+    }
+
+    /// Get the samples, gradients samples (if this calculator computes
+    /// gradients) and features corresponding to the given selection and
+    /// systems.
+    #[allow(clippy::type_complexity)]
+    fn indexes(
+        &self,
+        systems: &mut [Box<dyn System>],
+        selected_samples: SelectedIndexes,
+        selected_features: SelectedIndexes,
+    ) -> Result<(Indexes, Option<Indexes>, Indexes), Error> {
+        let features = selected_features.into_features(&*self.implementation)?;
+        let samples = selected_samples.into_samples(&*self.implementation, systems)?;
+
+        let mut gradients_samples = None;
+        if self.implementation.compute_gradients() {
+            time_graph::spanned!("Calculator::gradients_samples", {
+                let gradients = self.implementation.samples_builder()
                     .gradients_for(systems, &samples)?
                     .expect("this samples definition do not support gradients");
-                descriptor.prepare_gradients(samples, gradients, features);
-            } else {
-                descriptor.prepare(samples, features);
+                gradients_samples = Some(gradients);
+            });
+        }
+
+        return Ok((samples, gradients_samples, features));
+    }
+
+    /// Compute a hash of everything the samples, gradients samples and
+    /// features of a calculation can depend on: the calculator parameters, the
+    /// selected indexes, and the atoms & neighbors pairs in all systems.
+    ///
+    /// This returns `None` for calculators which do not use a neighbors list,
+    /// since we can not know what their samples depend on.
+    #[time_graph::instrument(name = "Calculator::fingerprint")]
+    fn fingerprint(
+        &self,
+        systems: &mut [Box<dyn System>],
+        selected_samples: &SelectedIndexes,
+        selected_features: &SelectedIndexes,
+    ) -> Result<Option<u64>, Error> {
+        let cutoff = match self.implementation.neighbors_cutoff() {
+            Some(cutoff) => cutoff,
+            None => return Ok(None),
+        };
+
+        let mut hasher = XxHash64::default();
+        self.implementation.name().hash(&mut hasher);
+        self.parameters.hash(&mut hasher);
+        selected_samples.hash_into(&mut hasher);
+        selected_features.hash_into(&mut hasher);
+
+        systems.len().hash(&mut hasher);
+        for system in systems {
+            system.compute_neighbors(cutoff)?;
+            system.size()?.hash(&mut hasher);
+            system.species()?.hash(&mut hasher);
+
+            let pairs = system.pairs()?;
+            pairs.len().hash(&mut hasher);
+            for pair in pairs {
+                pair.first.hash(&mut hasher);
+                pair.second.hash(&mut hasher);
             }
-        });
+        }
+
+        return Ok(Some(hasher.finish()));
+    }
+}
+
+
+/// A `CalculatorGroup` computes the descriptors of multiple calculators for the
+/// same systems in a single pass.
+///
+/// When using native systems, the systems are only copied once for the whole
+/// group. Calculators using the same cutoff are computed one after the other,
+/// sharing the corresponding neighbors lists. If one calculator in the group
+/// computes a descriptor which can be used as input by another calculator
+/// (for example a spherical expansion with the same parameters as the one used
+/// internally by a SOAP power spectrum, see
+/// [`CalculatorBase::input_calculator`]), this descriptor is computed once and
+/// re-used.
+pub struct CalculatorGroup<'a> {
+    calculators: Vec<&'a mut Calculator>,
+}
+
+impl<'a> CalculatorGroup<'a> {
+    /// Create a new group containing the given `calculators`
+    pub fn new(calculators: Vec<&'a mut Calculator>) -> CalculatorGroup<'a> {
+        CalculatorGroup {
+            calculators: calculators,
+        }
+    }
+
+    /// Compute the descriptors of all the calculators in this group for the
+    /// given `systems`, storing the descriptor of the i-th calculator in
+    /// `descriptors[i]`.
+    ///
+    /// All calculators compute their full descriptor: selected samples and
+    /// features are not supported, and `options.selected_samples` and
+    /// `options.selected_features` must be `SelectedIndexes::All`.
+    #[time_graph::instrument(name = "CalculatorGroup::compute")]
+    pub fn compute(
+        &mut self,
+        systems: &mut [Box<dyn System>],
+        descriptors: &mut [&mut Descriptor],
+        options: CalculationOptions,
+    ) -> Result<(), Error> {
+        if descriptors.len() != self.calculators.len() {
+            return Err(Error::InvalidParameter(format!(
+                "expected {} descriptors for this group of calculators, got {}",
+                self.calculators.len(), descriptors.len()
+            )));
+        }
+
+        if !matches!(options.selected_samples, SelectedIndexes::All) || !matches!(options.selected_features, SelectedIndexes::All) {
+            return Err(Error::InvalidParameter(
+                "selected samples or features can not be used with a group of calculators".into()
+            ));
+        }
+
+        let inputs = self.inputs();
+        let order = self.order(&inputs);
+
+        let mut native_systems;
+        let systems = if options.use_native_system {
+            // the neighbors lists of the first cutoff are computed in parallel
+            // here, the others are computed by the calculators
+            let cutoff = order.first().and_then(|&i| self.calculators[i].implementation.neighbors_cutoff());
+            native_systems = to_native_systems(systems, cutoff)?;
+            &mut native_systems
+        } else {
+            systems
+        };
+
+        for &i in &order {
+            let calculator = &mut *self.calculators[i];
+            let options = CalculationOptions {
+                use_native_system: false,
+                selected_samples: SelectedIndexes::All,
+                selected_features: SelectedIndexes::All,
+                reuse_descriptor: options.reuse_descriptor,
+            };
+
+            match inputs[i] {
+                Some(input) => {
+                    let (descriptor, input) = split_descriptors(descriptors, i, input);
+                    calculator.prepare(systems, descriptor, options)?;
+                    calculator.implementation.compute_with_input(systems, descriptor, input)?;
+                }
+                None => {
+                    calculator.compute(systems, &mut *descriptors[i], options)?;
+                }
+            }
+        }
 
-        self.implementation.compute(systems, descriptor)?;
         return Ok(());
     }
+
+    /// Find the calculator in this group computing the input of each
+    /// calculator, if any
+    fn inputs(&self) -> Vec<Option<usize>> {
+        return self.calculators.iter().enumerate().map(|(i, calculator)| {
+            let (name, parameters) = calculator.implementation.input_calculator()?;
+            self.calculators.iter().enumerate().position(|(j, other)| {
+                j != i && other.implementation.name() == name && other.implementation.get_parameters() == parameters
+            })
+        }).collect();
+    }
+
+    /// Get the order in which the calculators should run: calculators are
+    /// grouped by cutoff to compute each neighbors list only once, and
+    /// calculators using another calculator's descriptor as input run after
+    /// it.
+    fn order(&self, inputs: &[Option<usize>]) -> Vec<usize> {
+        let cutoffs = self.calculators.iter()
+            .map(|calculator| calculator.implementation.neighbors_cutoff())
+            .collect::<Vec<_>>();
+
+        // use the first calculator with a given cutoff to identify groups
+        let cutoff_group = |i: usize| cutoffs.iter().position(|&cutoff| cutoff == cutoffs[i]).expect("missing cutoff");
+
+        let mut order = (0..self.calculators.len()).collect::<Vec<_>>();
+        order.sort_by_key(|&i| match inputs[i] {
+            Some(input) => (cutoff_group(input), true),
+            None => (cutoff_group(i), false),
+        });
+
+        return order;
+    }
+}
+
+/// Get a mutable reference to `descriptors[i]` and a shared reference to
+/// `descriptors[j]` at the same time
+fn split_descriptors<'d>(descriptors: &'d mut [&mut Descriptor], i: usize, j: usize) -> (&'d mut Descriptor, &'d Descriptor) {
+    assert_ne!(i, j);
+    if i < j {
+        let (first, second) = descriptors.split_at_mut(j);
+        return (&mut *first[i], &*second[0]);
+    } else {
+        let (first, second) = descriptors.split_at_mut(i);
+        return (&mut *second[0], &*first[j]);
+    }
 }
 
 
@@ -294,7 +787,8 @@ lazy_static::lazy_static!{
 
 #[cfg(test)]
 mod tests {
-    use super::SelectedIndexes;
+    use super::{Calculator, CalculatorGroup, CalculationOptions, SelectedIndexes};
+    use crate::Descriptor;
 
     use crate::calculators::{CalculatorBase, DummyCalculator};
     use crate::descriptor::{IndexesBuilder, IndexValue};
@@ -359,4 +853,232 @@ mod tests {
         let indexes = selected.into_samples(&calculator, &mut systems).unwrap();
         assert_eq!(indexes, expected);
     }
+
+    #[test]
+    fn native_systems() {
+        let parameters = r#"{
+            "cutoff": 3.5,
+            "max_radial": 4,
+            "max_angular": 4,
+            "atomic_gaussian_width": 0.3,
+            "gradients": true,
+            "radial_basis": {"Gto": {}},
+            "cutoff_function": {"ShiftedCosine": {"width": 0.5}}
+        }"#;
+        let mut calculator = Calculator::new("spherical_expansion", parameters.into()).unwrap();
+
+        let mut systems = crate::systems::test_utils::test_systems(&["water", "methane", "CH"]);
+        let mut descriptor = Descriptor::new();
+        calculator.compute(&mut systems, &mut descriptor, Default::default()).unwrap();
+
+        let mut native = Descriptor::new();
+        let options = CalculationOptions {
+            use_native_system: true,
+            ..Default::default()
+        };
+        calculator.compute(&mut systems, &mut native, options).unwrap();
+
+        assert_eq!(descriptor.samples, native.samples);
+        assert_eq!(descriptor.gradients_samples, native.gradients_samples);
+        assert_eq!(descriptor.values, native.values);
+        assert_eq!(descriptor.gradients, native.gradients);
+    }
+
+    #[test]
+    fn reuse_descriptor() {
+        let parameters = r#"{
+            "cutoff": 3.5,
+            "max_radial": 4,
+            "max_angular": 4,
+            "atomic_gaussian_width": 0.3,
+            "gradients": true,
+            "radial_basis": {"Gto": {}},
+            "cutoff_function": {"ShiftedCosine": {"width": 0.5}}
+        }"#;
+        let mut calculator = Calculator::new("spherical_expansion", parameters.into()).unwrap();
+
+        let mut systems = crate::systems::test_utils::test_systems(&["water", "methane"]);
+        let mut expected = Descriptor::new();
+        calculator.compute(&mut systems, &mut expected, Default::default()).unwrap();
+
+        let options = || CalculationOptions {
+            reuse_descriptor: true,
+            ..Default::default()
+        };
+
+        let mut descriptor = Descriptor::new();
+        calculator.compute(&mut systems, &mut descriptor, options()).unwrap();
+        assert!(descriptor.fingerprint.is_some());
+        let fingerprint = descriptor.fingerprint;
+        let values_ptr = descriptor.values.as_ptr();
+
+        // same systems, the memory and indexes are re-used
+        calculator.compute(&mut systems, &mut descriptor, options()).unwrap();
+        assert_eq!(descriptor.fingerprint, fingerprint);
+        assert_eq!(descriptor.values.as_ptr(), values_ptr);
+        assert_eq!(descriptor.samples, expected.samples);
+        assert_eq!(descriptor.gradients_samples, expected.gradients_samples);
+        assert_eq!(descriptor.values, expected.values);
+        assert_eq!(descriptor.gradients, expected.gradients);
+
+        // different systems, the indexes are re-computed
+        let mut systems = crate::systems::test_utils::test_systems(&["water"]);
+        calculator.compute(&mut systems, &mut descriptor, options()).unwrap();
+        assert_ne!(descriptor.fingerprint, fingerprint);
+
+        let mut expected = Descriptor::new();
+        calculator.compute(&mut systems, &mut expected, Default::default()).unwrap();
+        assert_eq!(descriptor.samples, expected.samples);
+        assert_eq!(descriptor.gradients_samples, expected.gradients_samples);
+        assert_eq!(descriptor.values, expected.values);
+    }
+
+    #[test]
+    #[cfg(feature = "chemfiles")]
+    fn compute_trajectory() {
+        let parameters = r#"{
+            "cutoff": 3.0,
+            "delta": 2,
+            "name": "",
+            "gradients": false
+        }"#;
+        let mut calculator = Calculator::new("dummy_calculator", parameters.into()).unwrap();
+
+        let path = concat!(env!("CARGO_MANIFEST_DIR"), "/benches/data/silicon_bulk.xyz");
+        let mut systems = crate::systems::read_from_file(path).unwrap()
+            .into_iter()
+            .map(|system| Box::new(system) as Box<dyn crate::System>)
+            .collect::<Vec<_>>();
+
+        let mut expected = Descriptor::new();
+        calculator.compute(&mut systems, &mut expected, Default::default()).unwrap();
+
+        let mut first_structures = Vec::new();
+        let mut values = Vec::new();
+        calculator.compute_trajectory(path, 8, Default::default(), |first_structure, descriptor| {
+            first_structures.push(first_structure);
+            values.extend(descriptor.values.iter().copied());
+            Ok(())
+        }).unwrap();
+
+        assert_eq!(first_structures, [0, 8, 16, 24]);
+        assert_eq!(values, expected.values.iter().copied().collect::<Vec<_>>());
+    }
+
+    #[test]
+    fn calculation_plan() {
+        let parameters = r#"{
+            "cutoff": 3.5,
+            "max_radial": 4,
+            "max_angular": 4,
+            "atomic_gaussian_width": 0.3,
+            "gradients": true,
+            "radial_basis": {"Gto": {}},
+            "cutoff_function": {"ShiftedCosine": {"width": 0.5}}
+        }"#;
+        let mut calculator = Calculator::new("spherical_expansion", parameters.into()).unwrap();
+
+        let mut systems = crate::systems::test_utils::test_systems(&["water", "methane"]);
+        let mut expected = Descriptor::new();
+        calculator.compute(&mut systems, &mut expected, Default::default()).unwrap();
+
+        let plan = calculator.plan(&mut systems, Default::default()).unwrap();
+        assert_eq!(plan.samples(), &expected.samples);
+        assert_eq!(plan.gradients_samples(), expected.gradients_samples.as_ref());
+        assert_eq!(plan.features(), &expected.features);
+
+        let mut descriptor = Descriptor::new();
+        for _ in 0..2 {
+            calculator.compute_with_plan(&mut systems, &mut descriptor, &plan).unwrap();
+            assert_eq!(descriptor.samples, expected.samples);
+            assert_eq!(descriptor.gradients_samples, expected.gradients_samples);
+            assert_eq!(descriptor.values, expected.values);
+            assert_eq!(descriptor.gradients, expected.gradients);
+        }
+
+        let mut systems = crate::systems::test_utils::test_systems(&["water"]);
+        let error = calculator.compute_with_plan(&mut systems, &mut descriptor, &plan).unwrap_err();
+        assert_eq!(
+            error.to_string(),
+            "invalid parameter: this calculation plan was created for 2 systems, but we got 1 systems"
+        );
+
+        // move one of the hydrogen atoms outside of the cutoff
+        let mut systems = crate::systems::test_utils::test_systems(&["water"]);
+        let plan = calculator.plan(&mut systems, Default::default()).unwrap();
+
+        let mut system = crate::systems::test_utils::test_system("water");
+        system.positions_mut()[1] = crate::Vector3D::new(10.0, 0.0, 0.0);
+        let mut systems = vec![Box::new(system) as Box<dyn crate::System>];
+        let error = calculator.compute_with_plan(&mut systems, &mut descriptor, &plan).unwrap_err();
+        assert_eq!(
+            error.to_string(),
+            "invalid parameter: the atoms or neighbors pairs in the systems changed since this calculation plan was created"
+        );
+    }
+
+    #[test]
+    fn calculator_group() {
+        let soap_parameters = r#"{
+            "cutoff": 3.5,
+            "max_radial": 4,
+            "max_angular": 4,
+            "atomic_gaussian_width": 0.3,
+            "gradients": true,
+            "radial_basis": {"Gto": {}},
+            "cutoff_function": {"ShiftedCosine": {"width": 0.5}}
+        }"#;
+        let mut power_spectrum = Calculator::new("soap_power_spectrum", soap_parameters.into()).unwrap();
+        let mut distances = Calculator::new("sorted_distances", r#"{"cutoff": 3.5, "max_neighbors": 5}"#.into()).unwrap();
+        let mut spherical_expansion = Calculator::new("spherical_expansion", soap_parameters.into()).unwrap();
+        let mut dummy = Calculator::new("dummy_calculator", r#"{
+            "cutoff": 3.0,
+            "delta": 2,
+            "name": "",
+            "gradients": true
+        }"#.into()).unwrap();
+
+        let mut systems = crate::systems::test_utils::test_systems(&["water", "methane"]);
+        let mut expected = vec![Descriptor::new(), Descriptor::new(), Descriptor::new(), Descriptor::new()];
+        power_spectrum.compute(&mut systems, &mut expected[0], Default::default()).unwrap();
+        distances.compute(&mut systems, &mut expected[1], Default::default()).unwrap();
+        spherical_expansion.compute(&mut systems, &mut expected[2], Default::default()).unwrap();
+        dummy.compute(&mut systems, &mut expected[3], Default::default()).unwrap();
+
+        let mut group = CalculatorGroup::new(vec![
+            &mut power_spectrum, &mut distances, &mut spherical_expansion, &mut dummy
+        ]);
+
+        // the power spectrum uses the spherical expansion as input, and runs
+        // after it
+        let inputs = group.inputs();
+        assert_eq!(inputs, [Some(2), None, None, None]);
+        assert_eq!(group.order(&inputs), [1, 2, 0, 3]);
+
+        for &use_native_system in &[false, true] {
+            let mut descriptors = vec![Descriptor::new(), Descriptor::new(), Descriptor::new(), Descriptor::new()];
+            let options = CalculationOptions {
+                use_native_system: use_native_system,
+                ..Default::default()
+            };
+            group.compute(&mut systems, &mut descriptors.iter_mut().collect::<Vec<_>>(), options).unwrap();
+
+            for (descriptor, expected) in descriptors.iter().zip(&expected) {
+                assert_eq!(descriptor.samples, expected.samples);
+                assert_eq!(descriptor.features, expected.features);
+                assert_eq!(descriptor.gradients_samples, expected.gradients_samples);
+                approx::assert_relative_eq!(descriptor.values, expected.values, max_relative=1e-12);
+                if let Some(ref gradients) = descriptor.gradients {
+                    approx::assert_relative_eq!(gradients, expected.gradients.as_ref().unwrap(), max_relative=1e-12);
+                }
+            }
+        }
+
+        let mut descriptor = Descriptor::new();
+        let error = group.compute(&mut systems, &mut [&mut descriptor], Default::default()).unwrap_err();
+        assert_eq!(
+            error.to_string(),
+            "invalid parameter: expected 4 descriptors for this group of calculators, got 1"
+        );
+    }
 }
@@ -55,6 +55,10 @@ impl CalculatorBase for DummyCalculator {
         self.gradients
     }
 
+    fn neighbors_cutoff(&self) -> Option<f64> {
+        Some(self.cutoff)
+    }
+
     fn check_features(&self, indexes: &Indexes) -> Result<(), Error> {
         assert_eq!(indexes.names(), self.features_names());
         let first = [IndexValue::from(1), IndexValue::from(0)];
@@ -0,0 +1,172 @@
+use std::collections::HashMap;
+
+use rayon::prelude::*;
+
+use crate::{Error, System, Vector3D};
+
+/// Fingerprint of an atomic environment, invariant under rotations,
+/// reflections and permutations of the neighbors.
+///
+/// The fingerprint contains the `(species_i, species_j, r_i, r_j, r_ij)`
+/// triplets for all pairs of neighbors `i, j` (including `i == j`), where
+/// `r_i` is the distance between the center and neighbor `i`, and `r_ij` the
+/// distance between the two neighbors. The power spectrum is a sum over these
+/// triplets, so environments with the same fingerprint have the same power
+/// spectrum.
+///
+/// All distances are rounded to the nearest multiple of the tolerance.
+#[derive(Debug, Clone, PartialEq, Eq, Hash)]
+struct EnvironmentKey {
+    species_center: i32,
+    /// `(species_i, species_j, r_i, r_j, r_ij)` with rounded distances for
+    /// all pairs of neighbors, with `(species_i, r_i) <= (species_j, r_j)`,
+    /// sorted
+    triplets: Vec<(i32, i32, i64, i64, i64)>,
+}
+
+impl EnvironmentKey {
+    fn new(species_center: i32, neighbors: &[(i32, Vector3D)], tolerance: f64) -> EnvironmentKey {
+        let round = |distance: f64| (distance / tolerance).round() as i64;
+
+        let distances = neighbors.iter()
+            .map(|&(_, vector)| round(vector.norm()))
+            .collect::<Vec<_>>();
+
+        let mut triplets = Vec::with_capacity(neighbors.len() * (neighbors.len() + 1) / 2);
+        for (i, &(species_i, vector_i)) in neighbors.iter().enumerate() {
+            for (j, &(species_j, vector_j)) in neighbors.iter().enumerate().skip(i) {
+                let first = (species_i, distances[i]);
+                let second = (species_j, distances[j]);
+                let ((species_1, r_1), (species_2, r_2)) = if first <= second {
+                    (first, second)
+                } else {
+                    (second, first)
+                };
+
+                let r_ij = round((vector_j - vector_i).norm());
+                triplets.push((species_1, species_2, r_1, r_2, r_ij));
+            }
+        }
+        triplets.sort_unstable();
+
+        return EnvironmentKey {
+            species_center: species_center,
+            triplets: triplets,
+        };
+    }
+}
+
+/// Find groups of identical atomic environments in `centers`, given as a list
+/// of `(structure, center)`. Two environments are considered identical if
+/// the central atoms have the same species and the same set of
+/// `(species_i, species_j, r_i, r_j, r_ij)` triplets for all pairs of
+/// neighbors, with all distances rounded to the nearest multiple of
+/// `tolerance`.
+///
+/// This returns, for each entry in `centers`, the index of the first entry in
+/// `centers` with an identical environment. Unique environments are their
+/// own representative.
+///
+/// The power spectrum only depends on these triplets, so it is the same (up
+/// to the tolerance) for all environments in a group, even when the
+/// environments are not related by a rotation or a reflection. Since
+/// distances are rounded to buckets of size `tolerance`, two distances closer
+/// than `tolerance` but on different sides of a bucket boundary are not
+/// considered equal, and some identical environments might not be detected.
+/// This only reduces the number of environments which are deduplicated.
+pub(crate) fn deduplicate_environments(
+    systems: &mut [Box<dyn System>],
+    centers: &[(usize, usize)],
+    cutoff: f64,
+    tolerance: f64,
+) -> Result<Vec<usize>, Error> {
+    // gather the neighbors of all centers on the calling thread, since
+    // systems can not be shared between threads
+    let mut environments = Vec::with_capacity(centers.len());
+    let mut previous_structure = None;
+    for &(structure, center) in centers {
+        let system = &mut *systems[structure];
+        if previous_structure != Some(structure) {
+            system.compute_neighbors(cutoff)?;
+            previous_structure = Some(structure);
+        }
+        let species = system.species()?;
+
+        let mut neighbors = Vec::new();
+        for pair in system.pairs_containing(center)? {
+            if pair.first == center {
+                neighbors.push((species[pair.second], pair.vector));
+            } else {
+                neighbors.push((species[pair.first], -pair.vector));
+            }
+        }
+
+        environments.push((species[center], neighbors));
+    }
+
+    let keys = crate::threads::install(|| {
+        environments.par_iter()
+            .map(|(species_center, neighbors)| EnvironmentKey::new(*species_center, neighbors, tolerance))
+            .collect::<Vec<_>>()
+    });
+
+    let mut first_environment = HashMap::new();
+    let mut representatives = Vec::with_capacity(keys.len());
+    for (i, key) in keys.into_iter().enumerate() {
+        representatives.push(*first_environment.entry(key).or_insert(i));
+    }
+
+    return Ok(representatives);
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::systems::test_utils::test_systems;
+
+    #[test]
+    fn keys() {
+        let neighbors = [
+            (1, Vector3D::new(1.0, 0.0, 0.0)),
+            (8, Vector3D::new(0.0, 2.0, 0.0)),
+        ];
+        // rotated by 90° around z, and with neighbors in a different order
+        let rotated = [
+            (8, Vector3D::new(-2.0, 0.0, 0.0)),
+            (1, Vector3D::new(0.0, 1.0, 1e-9)),
+        ];
+        assert_eq!(EnvironmentKey::new(6, &neighbors, 1e-6), EnvironmentKey::new(6, &rotated, 1e-6));
+        assert_ne!(EnvironmentKey::new(6, &neighbors, 1e-6), EnvironmentKey::new(1, &rotated, 1e-6));
+
+        let different = [
+            (1, Vector3D::new(1.0, 0.0, 0.0)),
+            (8, Vector3D::new(2.0, 0.0, 0.0)),
+        ];
+        assert_ne!(EnvironmentKey::new(6, &neighbors, 1e-6), EnvironmentKey::new(6, &different, 1e-6));
+
+        // both environments have neighbors at distances 1, 2 and 2 from the
+        // center, and distances sqrt(3), 2 and sqrt(5) between neighbors, but
+        // these distances are associated differently to the neighbors
+        let sqrt_3 = f64::sqrt(3.0);
+        let first = [
+            (1, Vector3D::new(1.0, 0.0, 0.0)),
+            (1, Vector3D::new(1.0, sqrt_3, 0.0)),
+            (1, Vector3D::new(0.0, 2.0 / sqrt_3, 2.0 * f64::sqrt(2.0 / 3.0))),
+        ];
+        let second = [
+            (1, Vector3D::new(1.0, 0.0, 0.0)),
+            (1, Vector3D::new(1.0, sqrt_3, 0.0)),
+            (1, Vector3D::new(0.5, 1.0 / sqrt_3, 2.0 * f64::sqrt(41.0 / 48.0))),
+        ];
+        assert_ne!(EnvironmentKey::new(6, &first, 1e-6), EnvironmentKey::new(6, &second, 1e-6));
+    }
+
+    #[test]
+    fn water() {
+        let mut systems = test_systems(&["water"]);
+        let centers = [(0, 0), (0, 1), (0, 2)];
+        let representatives = deduplicate_environments(&mut systems, &centers, 3.0, 1e-6).unwrap();
+        // the two hydrogen atoms are equivalent by symmetry
+        assert_eq!(representatives, [0, 1, 1]);
+    }
+}
@@ -8,8 +8,9 @@ pub(crate) mod tests_utils;
 /// TODO: docs
 ///
 /// `std::panic::RefUnwindSafe` is a required super-trait to enable passing
-/// calculators across the C API.
-pub trait CalculatorBase: std::panic::RefUnwindSafe {
+/// calculators across the C API. `Send` is required to run calculations in the
+/// background with the asynchronous C API.
+pub trait CalculatorBase: std::panic::RefUnwindSafe + Send {
     /// Get the name of this Calculator
     fn name(&self) -> String;
 
@@ -26,6 +27,16 @@ pub trait CalculatorBase: std::panic::RefUnwindSafe {
     /// Does this calculator compute gradients?
     fn compute_gradients(&self) -> bool;
 
+    /// Get the spherical cutoff used by this Calculator to compute neighbors
+    /// lists, if any. When this is not `None`, the neighbors lists of native
+    /// systems are computed in parallel for all systems before starting the
+    /// calculation.
+    ///
+    /// The default implementation returns `None`.
+    fn neighbors_cutoff(&self) -> Option<f64> {
+        None
+    }
+
     /// Check that the given indexes are valid feature indexes for this
     /// Calculator. This is used by to ensure only valid features are requested
     fn check_features(&self, indexes: &Indexes) -> Result<(), Error>;
@@ -68,8 +79,30 @@ pub trait CalculatorBase: std::panic::RefUnwindSafe {
     /// `Descriptor::features()` respectively; but the user can request only a
     /// subset of them.
     fn compute(&mut self, systems: &mut [Box<dyn System>], descriptor: &mut Descriptor) -> Result<(), Error>;
+
+    /// Get the name and parameters (formatted as JSON) of another calculator
+    /// whose descriptor this calculator can use as input, instead of computing
+    /// it internally. When both calculators are part of the same
+    /// [`crate::CalculatorGroup`], the input descriptor is computed once and
+    /// passed to [`CalculatorBase::compute_with_input`].
+    ///
+    /// The default implementation returns `None`.
+    fn input_calculator(&self) -> Option<(String, String)> {
+        None
+    }
+
+    /// Same as [`CalculatorBase::compute`], using the `input` descriptor
+    /// computed for the same systems, with all samples and features, by the
+    /// calculator described by [`CalculatorBase::input_calculator`].
+    ///
+    /// The default implementation ignores `input` and calls `compute`.
+    fn compute_with_input(&mut self, systems: &mut [Box<dyn System>], descriptor: &mut Descriptor, _input: &Descriptor) -> Result<(), Error> {
+        return self.compute(systems, descriptor);
+    }
 }
 
+mod environments;
+
 mod sorted_distances;
 pub use self::sorted_distances::SortedDistances;
 
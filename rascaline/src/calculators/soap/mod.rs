@@ -3,9 +3,11 @@ pub use self::radial_integral::RadialIntegral;
 pub use self::radial_integral::{GtoRadialIntegral, GtoParameters};
 pub use self::radial_integral::{HyperGeometricSphericalExpansion, HyperGeometricParameters};
 pub use self::radial_integral::{SplinedRadialIntegral, SplinedRIParameters};
+pub use self::radial_integral::{save_splines_cache, load_splines_cache, clear_splines_cache};
 
 mod spherical_harmonics;
 pub use self::spherical_harmonics::{SphericalHarmonics, SphericalHarmonicsArray};
+pub use self::spherical_harmonics::spherical_harmonics_index;
 
 mod spherical_expansion;
 pub use self::spherical_expansion::{SphericalExpansion, SphericalExpansionParameters};
@@ -1,5 +1,7 @@
-use std::collections::BTreeSet;
+use std::collections::{BTreeSet, HashMap};
 
+use ndarray::{Array2, ArrayView1, ArrayView2, ArrayViewMut1, Axis, s};
+use ndarray::linalg::general_mat_mul;
 use ndarray::parallel::prelude::*;
 
 use crate::descriptor::{SamplesBuilder, IndexValue, Indexes, IndexesBuilder};
@@ -7,8 +9,12 @@ use crate::descriptor::{TwoBodiesSpeciesSamples, ThreeBodiesSpeciesSamples};
 
 use crate::{CalculationOptions, Calculator, SelectedIndexes};
 use crate::{Descriptor, Error, System};
+use crate::metrics::{self, Counter};
+use crate::threads;
 
 use super::{super::CalculatorBase, SphericalExpansionParameters};
+use super::super::environments::deduplicate_environments;
+use super::spherical_expansion::gradients_offsets;
 use super::{SphericalExpansion, RadialBasis, CutoffFunction, RadialScaling};
 
 
@@ -47,6 +53,15 @@ pub struct PowerSpectrumParameters {
     /// model
     #[serde(default)]
     pub radial_scaling: RadialScaling,
+    /// Compute the power spectrum only once for atomic environments which are
+    /// identical up to rotations and reflections, and copy it for the other
+    /// environments. This is useful for crystals containing many atoms
+    /// related by symmetry. Environments are compared using the triangles
+    /// formed by the center and all pairs of neighbors inside the cutoff,
+    /// with distances rounded to a multiple of the given tolerance. This can
+    /// not be used together with gradients.
+    #[serde(default, skip_serializing_if = "Option::is_none")]
+    pub deduplicate_environments: Option<f64>,
 }
 
 /// Calculator implementing the Smooth Overlap of Atomic Position (SOAP) power
@@ -59,6 +74,20 @@ pub struct SoapPowerSpectrum {
 
 impl SoapPowerSpectrum {
     pub fn new(parameters: PowerSpectrumParameters) -> Result<SoapPowerSpectrum, Error> {
+        if let Some(tolerance) = parameters.deduplicate_environments {
+            if !(tolerance > 0.0 && tolerance.is_finite()) {
+                return Err(Error::InvalidParameter(format!(
+                    "expected a positive tolerance for deduplicate_environments, got {}", tolerance
+                )));
+            }
+
+            if parameters.gradients {
+                return Err(Error::InvalidParameter(
+                    "deduplicate_environments can not be used together with gradients".into()
+                ));
+            }
+        }
+
         let expansion_parameters = SphericalExpansionParameters {
             cutoff: parameters.cutoff,
             max_radial: parameters.max_radial,
@@ -146,6 +175,305 @@ impl SoapPowerSpectrum {
 
         return (spherical_expansion_features.finish(), n_radial_values);
     }
+
+    /// Compute the power spectrum for the samples and features in
+    /// `descriptor`, computing the required spherical expansion with the
+    /// internal spherical expansion calculator
+    fn compute_environments(&mut self, systems: &mut [Box<dyn System>], descriptor: &mut Descriptor) -> Result<(), Error> {
+        // `n_different_radial` is the number of different radial indexes. This
+        // will be the size of a given lm block in spherical expansion
+        let (selected_features, n_different_radial) = self.get_expansion_features(&descriptor.features);
+
+        let options = CalculationOptions {
+            selected_samples: SelectedIndexes::Subset(self.get_expansion_samples(&descriptor.samples)),
+            selected_features: SelectedIndexes::Subset(selected_features),
+            // when computing the same systems repeatedly, the spherical
+            // expansion samples and features do not change either
+            reuse_descriptor: true,
+            ..Default::default()
+        };
+
+        self.spherical_expansion_calculator.compute(
+            systems,
+            &mut self.spherical_expansion,
+            options,
+        ).expect("failed to compute spherical expansion");
+
+        return self.compute_from_expansion(&self.spherical_expansion, n_different_radial, descriptor);
+    }
+
+    /// Compute the power spectrum for all the samples in `descriptor`, only
+    /// running the calculation once for each group of identical environments
+    /// (as found by `deduplicate_environments` with the given `tolerance`)
+    /// and copying the values to the other members of the group.
+    fn compute_deduplicated(
+        &mut self,
+        systems: &mut [Box<dyn System>],
+        descriptor: &mut Descriptor,
+        tolerance: f64,
+    ) -> Result<(), Error> {
+        // list of (structure, center) for all the environments, and the index
+        // of the environment of each sample in this list
+        let mut centers = Vec::new();
+        let mut sample_centers = Vec::with_capacity(descriptor.samples.count());
+        for sample in &descriptor.samples {
+            let center = (sample[0].usize(), sample[1].usize());
+            if centers.last() != Some(&center) {
+                centers.push(center);
+            }
+            sample_centers.push(centers.len() - 1);
+        }
+
+        let representatives = deduplicate_environments(systems, &centers, self.parameters.cutoff, tolerance)?;
+
+        let unique = representatives.iter().enumerate().filter(|&(i, &r)| i == r).count();
+        metrics::add(Counter::EnvironmentCacheMisses, unique);
+        metrics::add(Counter::EnvironmentCacheHits, centers.len() - unique);
+
+        // samples which are actually computed, and the corresponding row in
+        // the reduced descriptor for each sample in `descriptor`
+        let mut reduced_samples = IndexesBuilder::new(descriptor.samples.names());
+        let mut n_reduced = 0;
+        let mut rows = vec![0; descriptor.samples.count()];
+
+        // start with all the samples of the representative environments ...
+        let mut computed = HashMap::new();
+        for (i_sample, sample) in descriptor.samples.iter().enumerate() {
+            let i_center = sample_centers[i_sample];
+            if representatives[i_center] == i_center {
+                computed.insert((i_center, sample[3], sample[4]), n_reduced);
+                reduced_samples.add(sample);
+                rows[i_sample] = n_reduced;
+                n_reduced += 1;
+            }
+        }
+
+        // ... and only add the samples of other environments if the
+        // representative environment does not contain the same species
+        // channel, which can happen when computing a subset of the samples
+        for (i_sample, sample) in descriptor.samples.iter().enumerate() {
+            let i_center = sample_centers[i_sample];
+            let representative = representatives[i_center];
+            if representative == i_center {
+                continue;
+            }
+
+            if let Some(&row) = computed.get(&(representative, sample[3], sample[4])) {
+                rows[i_sample] = row;
+            } else {
+                reduced_samples.add(sample);
+                rows[i_sample] = n_reduced;
+                n_reduced += 1;
+            }
+        }
+
+        let mut reduced = Descriptor::new();
+        reduced.prepare(reduced_samples.finish(), descriptor.features.clone());
+        self.compute_environments(systems, &mut reduced)?;
+
+        for (i_sample, &row) in rows.iter().enumerate() {
+            descriptor.values.row_mut(i_sample).assign(&reduced.values.row(row));
+        }
+
+        return Ok(());
+    }
+
+    /// Compute the power spectrum for the samples and features in
+    /// `descriptor`, using the values (and gradients) in `spherical_expansion`.
+    ///
+    /// `spherical_expansion` must contain the features created by
+    /// `get_expansion_features`, and at least all the samples created by
+    /// `get_expansion_samples`.
+    fn compute_from_expansion(
+        &self,
+        spherical_expansion: &Descriptor,
+        n_different_radial: usize,
+        descriptor: &mut Descriptor,
+    ) -> Result<(), Error> {
+        // Find out where feature blocks of the spherical expansion are located
+        let mut feature_blocks = Vec::with_capacity(descriptor.features.count());
+        for feature in descriptor.features.iter() {
+            let n1 = feature[0];
+            let n2 = feature[1];
+            let l = feature[2].isize();
+
+            let start_n1_l = spherical_expansion.features.position(
+                &[IndexValue::from(l), IndexValue::from(-l), n1]
+            ).expect("missing feature `l, m, n1` in spherical expansion");
+            let start_n2_l = spherical_expansion.features.position(
+                &[IndexValue::from(l), IndexValue::from(-l), n2]
+            ).expect("missing feature `l, m, n2` in spherical expansion");
+
+            feature_blocks.push(FeatureBlock { l, start_n1_l, start_n2_l });
+        }
+
+        metrics::add(Counter::Samples, descriptor.samples.count());
+        if let Some(ref gradients_samples) = descriptor.gradients_samples {
+            metrics::add(Counter::GradientSamples, gradients_samples.count());
+        }
+
+        let dense = descriptor.features == self.features();
+
+        // the parallel section does not use `self` and `descriptor` directly,
+        // since they can not be sent to the threads in `threads::install`
+        let parameters = &self.parameters;
+        let samples = &descriptor.samples;
+        let values = &mut descriptor.values;
+        let gradients = &mut descriptor.gradients;
+        let gradients_samples = &descriptor.gradients_samples;
+
+        // the spherical expansion calculation records its own parallel
+        // section, so this one only starts here
+        let _parallel_section = metrics::parallel_section();
+        threads::install(|| {
+            let spherical_expansion_features = &spherical_expansion.features;
+            let spherical_expansion_values = &spherical_expansion.values;
+
+            let expansion_rows = expansion_rows(samples, &spherical_expansion.samples);
+
+            if dense {
+                dense_values(
+                    parameters,
+                    spherical_expansion_values,
+                    samples,
+                    &expansion_rows,
+                    values,
+                );
+            } else {
+                values.axis_iter_mut(ndarray::Axis(0))
+                    .into_par_iter()
+                    .enumerate()
+                    .for_each(|(sample_i, mut value)| {
+                        let _busy = metrics::busy_timer();
+                        let [neighbor_1, neighbor_2] = expansion_rows[sample_i];
+                        let sample = &samples[sample_i];
+                        let species_neighbor_1 = sample[3];
+                        let species_neighbor_2 = sample[4];
+
+                        for (feature_i, block) in feature_blocks.iter().enumerate() {
+                            let &FeatureBlock { l, start_n1_l, start_n2_l } = block;
+
+                            let mut sum = 0.0;
+                            for (index_m, m) in (-l..=l).enumerate() {
+                                let feature_1 = start_n1_l + index_m * n_different_radial;
+                                let feature_2 = start_n2_l + index_m * n_different_radial;
+                                // check that we are accessing the right value of m
+                                debug_assert_eq!(spherical_expansion_features[feature_1][1].isize(), m);
+                                debug_assert_eq!(spherical_expansion_features[feature_2][1].isize(), m);
+
+                                // unsafe is required to remove the bound checking in
+                                // release mode (`uget` still checks bounds in debug
+                                // mode)
+                                unsafe {
+                                    sum += spherical_expansion_values.uget([neighbor_1, feature_1])
+                                        * spherical_expansion_values.uget([neighbor_2, feature_2]);
+                                }
+                            }
+
+                            if species_neighbor_1 != species_neighbor_2 {
+                                // We only store values for `species_neighbor_1 <
+                                // species_neighbor_2` because the values are the same for
+                                // pairs `species_neighbor_1 <-> species_neighbor_2` and
+                                // `species_neighbor_2 <-> species_neighbor_1`. To ensure
+                                // the final kernels are correct, we have to multiply the
+                                // corresponding values.
+                                sum *= std::f64::consts::SQRT_2;
+                            }
+
+                            let normalization = f64::sqrt(2.0 * l as f64 + 1.0);
+                            value[feature_i] = sum / normalization;
+                        }
+                    });
+            }
+
+            if parameters.gradients {
+                let gradients = gradients.as_mut().expect("missing power spectrum gradients");
+                let gradient_samples = gradients_samples.as_ref().expect("missing power spectrum gradient samples");
+
+                let se_gradients_samples = spherical_expansion.gradients_samples.as_ref().expect("missing spherical expansion gradient samples");
+                let se_gradients = spherical_expansion.gradients.as_ref().expect("missing spherical expansion gradients");
+
+                let gradient_rows = expansion_gradient_rows(
+                    samples.count(),
+                    gradient_samples,
+                    &expansion_rows,
+                    spherical_expansion.samples.count(),
+                    se_gradients_samples,
+                )?;
+
+                if dense {
+                    dense_gradients(
+                        parameters,
+                        spherical_expansion_values,
+                        se_gradients,
+                        samples,
+                        gradient_samples,
+                        &expansion_rows,
+                        &gradient_rows,
+                        gradients,
+                    );
+                } else {
+                    gradients.axis_iter_mut(ndarray::Axis(0))
+                        .into_par_iter()
+                        .enumerate()
+                        .for_each(|(gradient_sample_i, mut gradient)| {
+                            let _busy = metrics::busy_timer();
+                            let sample_i = gradient_samples[gradient_sample_i][0].usize();
+                            let [sample_neighbor_1, sample_neighbor_2] = expansion_rows[sample_i];
+                            let [grad_neighbor_1, grad_neighbor_2] = gradient_rows[gradient_sample_i];
+                            if grad_neighbor_1.is_none() && grad_neighbor_2.is_none() {
+                                // the gradient is already set to zero
+                                return;
+                            }
+
+                            let sample = &samples[sample_i];
+                            let species_neighbor_1 = sample[3];
+                            let species_neighbor_2 = sample[4];
+
+                            for (feature_i, block) in feature_blocks.iter().enumerate() {
+                                let &FeatureBlock { l, start_n1_l, start_n2_l } = block;
+
+                                let mut sum = 0.0;
+                                for (index_m, m) in (-l..=l).enumerate() {
+                                    let feature_1 = start_n1_l + index_m * n_different_radial;
+                                    let feature_2 = start_n2_l + index_m * n_different_radial;
+                                    // check that we are accessing the right value of m
+                                    debug_assert_eq!(spherical_expansion_features[feature_1][1].isize(), m);
+                                    debug_assert_eq!(spherical_expansion_features[feature_2][1].isize(), m);
+
+                                    if let Some(grad_neighbor_1) = grad_neighbor_1 {
+                                        // unsafe is required to remove the bound
+                                        // checking in release mode (`uget` still checks
+                                        // bounds in debug mode)
+                                        unsafe {
+                                            sum += se_gradients.uget([grad_neighbor_1, feature_1])
+                                                 * spherical_expansion_values.uget([sample_neighbor_2, feature_2]);
+                                        }
+                                    }
+
+                                    if let Some(grad_neighbor_2) = grad_neighbor_2 {
+                                        unsafe {
+                                            sum += spherical_expansion_values.uget([sample_neighbor_1, feature_1])
+                                                 * se_gradients.uget([grad_neighbor_2, feature_2]);
+                                        }
+                                    }
+                                }
+
+                                if species_neighbor_1 != species_neighbor_2 {
+                                    // see above
+                                    sum *= std::f64::consts::SQRT_2;
+                                }
+
+                                let normalization = f64::sqrt(2.0 * l as f64 + 1.0);
+                                gradient[feature_i] = sum / normalization;
+                            }
+                        });
+                }
+            }
+
+            Ok(())
+        })
+    }
 }
 
 impl std::fmt::Debug for SoapPowerSpectrum {
@@ -170,6 +498,199 @@ struct FeatureBlock {
     start_n2_l: usize,
 }
 
+/// Find the rows of the spherical expansion `expansion_samples` containing
+/// the data for the two neighbor species of each power spectrum sample. This
+/// is computed once, so the inner loops over samples only need to index into
+/// the resulting array.
+fn expansion_rows(samples: &Indexes, expansion_samples: &Indexes) -> Vec<[usize; 2]> {
+    return (0..samples.count()).into_par_iter().map(|sample_i| {
+        let sample = &samples[sample_i];
+        let structure = sample[0];
+        let center = sample[1];
+        let species_center = sample[2];
+        let species_neighbor_1 = sample[3];
+        let species_neighbor_2 = sample[4];
+
+        let neighbor_1 = expansion_samples.position(&[
+            structure, center, species_center, species_neighbor_1
+        ]).expect("missing data for one of the neighbor species");
+        let neighbor_2 = expansion_samples.position(&[
+            structure, center, species_center, species_neighbor_2
+        ]).expect("missing data for one of the neighbor species");
+
+        [neighbor_1, neighbor_2]
+    }).collect();
+}
+
+/// Find the rows of the spherical expansion gradients containing the data for
+/// each row of the power spectrum gradients, or `None` if the corresponding
+/// spherical expansion gradient is zero.
+///
+/// Both sets of gradient samples are sorted by `(sample, atom, spatial)`, so
+/// the rows associated with a power spectrum sample and with the matching
+/// spherical expansion sample can be merged in linear time, without having to
+/// look up each `(sample, atom, spatial)` separately.
+fn expansion_gradient_rows(
+    n_samples: usize,
+    gradients_samples: &Indexes,
+    expansion_rows: &[[usize; 2]],
+    n_expansion_samples: usize,
+    expansion_gradients_samples: &Indexes,
+) -> Result<Vec<[Option<usize>; 2]>, Error> {
+    let offsets = gradients_offsets(n_samples, gradients_samples)?;
+    let expansion_offsets = gradients_offsets(n_expansion_samples, expansion_gradients_samples)?;
+
+    let mut gradient_rows = vec![[None, None]; gradients_samples.count()];
+    for (sample_i, rows) in expansion_rows.iter().enumerate() {
+        for (neighbor, &expansion_sample) in rows.iter().enumerate() {
+            let mut expansion_grad_i = expansion_offsets[expansion_sample];
+            let expansion_end = expansion_offsets[expansion_sample + 1];
+
+            for grad_i in offsets[sample_i]..offsets[sample_i + 1] {
+                // compare the (atom, spatial) part of the gradient samples
+                let atom_spatial = &gradients_samples[grad_i][1..];
+                while expansion_grad_i < expansion_end && &expansion_gradients_samples[expansion_grad_i][1..] < atom_spatial {
+                    expansion_grad_i += 1;
+                }
+
+                if expansion_grad_i < expansion_end && &expansion_gradients_samples[expansion_grad_i][1..] == atom_spatial {
+                    gradient_rows[grad_i][neighbor] = Some(expansion_grad_i);
+                }
+            }
+        }
+    }
+
+    return Ok(gradient_rows);
+}
+
+/// Get the `(2l + 1) x max_radial` block of spherical expansion coefficients
+/// for the angular channel `l` from a row of the spherical expansion computed
+/// with all features (sorted as `l, m, n`).
+fn lm_block(row: ArrayView1<'_, f64>, l: usize, max_radial: usize) -> ArrayView2<'_, f64> {
+    let start = l * l * max_radial;
+    let stop = (l + 1) * (l + 1) * max_radial;
+    return row.slice_move(s![start..stop])
+        .into_shape((2 * l + 1, max_radial))
+        .expect("spherical expansion rows should be contiguous");
+}
+
+/// Store the `max_radial x max_radial` `product` for the angular channel `l`
+/// inside the power spectrum features `row`, containing all `n1, n2, l`.
+fn store_product(row: &mut ArrayViewMut1<'_, f64>, product: &Array2<f64>, l: usize, max_angular: usize, factor: f64) {
+    let max_radial = product.shape()[0];
+    for n1 in 0..max_radial {
+        for n2 in 0..max_radial {
+            row[(n1 * max_radial + n2) * (max_angular + 1) + l] = factor * product[[n1, n2]];
+        }
+    }
+}
+
+/// Compute the power spectrum values for all `n1, n2, l` features at once.
+///
+/// For each sample and angular channel `l`, the spherical expansion
+/// coefficients of the two neighbor species are `(2l + 1) x max_radial`
+/// matrices `A` and `B`, and the corresponding power spectrum block is given by
+/// the matrix product `A^T B`. This product uses a system BLAS when the `blas`
+/// cargo feature is enabled.
+#[time_graph::instrument(name = "SoapPowerSpectrum::dense_values")]
+fn dense_values(
+    parameters: &PowerSpectrumParameters,
+    expansion_values: &Array2<f64>,
+    samples: &Indexes,
+    expansion_rows: &[[usize; 2]],
+    values: &mut Array2<f64>,
+) {
+    let max_radial = parameters.max_radial;
+    let max_angular = parameters.max_angular;
+    debug_assert_eq!(expansion_values.shape()[1], (max_angular + 1) * (max_angular + 1) * max_radial);
+
+    values.axis_iter_mut(Axis(0))
+        .into_par_iter()
+        .enumerate()
+        .for_each_init(|| Array2::zeros((max_radial, max_radial)), |product, (sample_i, mut value)| {
+            let _busy = metrics::busy_timer();
+            let [neighbor_1, neighbor_2] = expansion_rows[sample_i];
+            let sample = &samples[sample_i];
+
+            // see the comment in `SoapPowerSpectrum::compute` for the
+            // meaning of this factor
+            let species_factor = if sample[3] != sample[4] {
+                std::f64::consts::SQRT_2
+            } else {
+                1.0
+            };
+
+            for l in 0..=max_angular {
+                let block_1 = lm_block(expansion_values.row(neighbor_1), l, max_radial);
+                let block_2 = lm_block(expansion_values.row(neighbor_2), l, max_radial);
+                general_mat_mul(1.0, &block_1.t(), &block_2, 0.0, product);
+
+                let normalization = f64::sqrt(2.0 * l as f64 + 1.0);
+                store_product(&mut value, product, l, max_angular, species_factor / normalization);
+            }
+        });
+}
+
+/// Compute the power spectrum gradients for all `n1, n2, l` features at once,
+/// using the same matrix products as `dense_values`: the gradient of `A^T B`
+/// is `dA^T B + A^T dB`.
+#[allow(clippy::too_many_arguments)]
+#[time_graph::instrument(name = "SoapPowerSpectrum::dense_gradients")]
+fn dense_gradients(
+    parameters: &PowerSpectrumParameters,
+    expansion_values: &Array2<f64>,
+    expansion_gradients: &Array2<f64>,
+    samples: &Indexes,
+    gradients_samples: &Indexes,
+    expansion_rows: &[[usize; 2]],
+    gradient_rows: &[[Option<usize>; 2]],
+    gradients: &mut Array2<f64>,
+) {
+    let max_radial = parameters.max_radial;
+    let max_angular = parameters.max_angular;
+    debug_assert_eq!(expansion_gradients.shape()[1], (max_angular + 1) * (max_angular + 1) * max_radial);
+
+    gradients.axis_iter_mut(Axis(0))
+        .into_par_iter()
+        .enumerate()
+        .for_each_init(|| Array2::zeros((max_radial, max_radial)), |product, (gradient_sample_i, mut gradient)| {
+            let _busy = metrics::busy_timer();
+            let sample_i = gradients_samples[gradient_sample_i][0].usize();
+            let [sample_neighbor_1, sample_neighbor_2] = expansion_rows[sample_i];
+            let [grad_neighbor_1, grad_neighbor_2] = gradient_rows[gradient_sample_i];
+            if grad_neighbor_1.is_none() && grad_neighbor_2.is_none() {
+                // the gradient is already set to zero
+                return;
+            }
+            let sample = &samples[sample_i];
+
+            let species_factor = if sample[3] != sample[4] {
+                std::f64::consts::SQRT_2
+            } else {
+                1.0
+            };
+
+            for l in 0..=max_angular {
+                product.fill(0.0);
+
+                if let Some(grad_neighbor_1) = grad_neighbor_1 {
+                    let block_1 = lm_block(expansion_gradients.row(grad_neighbor_1), l, max_radial);
+                    let block_2 = lm_block(expansion_values.row(sample_neighbor_2), l, max_radial);
+                    general_mat_mul(1.0, &block_1.t(), &block_2, 1.0, product);
+                }
+
+                if let Some(grad_neighbor_2) = grad_neighbor_2 {
+                    let block_1 = lm_block(expansion_values.row(sample_neighbor_1), l, max_radial);
+                    let block_2 = lm_block(expansion_gradients.row(grad_neighbor_2), l, max_radial);
+                    general_mat_mul(1.0, &block_1.t(), &block_2, 1.0, product);
+                }
+
+                let normalization = f64::sqrt(2.0 * l as f64 + 1.0);
+                store_product(&mut gradient, product, l, max_angular, species_factor / normalization);
+            }
+        });
+}
+
 impl CalculatorBase for SoapPowerSpectrum {
     fn name(&self) -> String {
         "SOAP power spectrum".into()
@@ -205,6 +726,10 @@ impl CalculatorBase for SoapPowerSpectrum {
         self.parameters.gradients
     }
 
+    fn neighbors_cutoff(&self) -> Option<f64> {
+        Some(self.parameters.cutoff)
+    }
+
     fn check_features(&self, indexes: &Indexes) -> Result<(), Error> {
         assert_eq!(indexes.names(), self.features_names());
         for value in indexes {
@@ -242,186 +767,47 @@ impl CalculatorBase for SoapPowerSpectrum {
         assert_eq!(descriptor.samples.names(), self.samples_builder().names());
         assert_eq!(descriptor.features.names(), self.features_names());
 
-        // `n_different_radial` is the number of different radial indexes. This
-        // will be the size of a given lm block in spherical expansion
-        let (selected_features, n_different_radial) = self.get_expansion_features(&descriptor.features);
-
-        let options = CalculationOptions {
-            selected_samples: SelectedIndexes::Subset(self.get_expansion_samples(&descriptor.samples)),
-            selected_features: SelectedIndexes::Subset(selected_features),
-            ..Default::default()
-        };
-
-        self.spherical_expansion_calculator.compute(
-            systems,
-            &mut self.spherical_expansion,
-            options,
-        ).expect("failed to compute spherical expansion");
-
-        // Find out where feature blocks of the spherical expansion are located
-        let mut feature_blocks = Vec::with_capacity(descriptor.features.count());
-        for feature in descriptor.features.iter() {
-            let n1 = feature[0];
-            let n2 = feature[1];
-            let l = feature[2].isize();
-
-            let start_n1_l = self.spherical_expansion.features.position(
-                &[IndexValue::from(l), IndexValue::from(-l), n1]
-            ).expect("missing feature `l, m, n1` in spherical expansion");
-            let start_n2_l = self.spherical_expansion.features.position(
-                &[IndexValue::from(l), IndexValue::from(-l), n2]
-            ).expect("missing feature `l, m, n2` in spherical expansion");
-
-            feature_blocks.push(FeatureBlock { l, start_n1_l, start_n2_l });
+        if let Some(tolerance) = self.parameters.deduplicate_environments {
+            return self.compute_deduplicated(systems, descriptor, tolerance);
         }
 
-        let spherical_expansion_samples = &self.spherical_expansion.samples;
-        let spherical_expansion_features = &self.spherical_expansion.features;
-        let spherical_expansion_values = &self.spherical_expansion.values;
-
-        let samples = &descriptor.samples;
-
-        descriptor.values.axis_iter_mut(ndarray::Axis(0))
-            .into_par_iter()
-            .enumerate()
-            .for_each(|(sample_i, mut value)| {
-                let sample = &samples[sample_i];
-                let structure = sample[0];
-                let center = sample[1];
-                let species_center = sample[2];
-                let species_neighbor_1 = sample[3];
-                let species_neighbor_2 = sample[4];
-
-                let neighbor_1 = spherical_expansion_samples.position(&[
-                    structure, center, species_center, species_neighbor_1
-                ]).expect("missing data for one of the neighbor species");
-                let neighbor_2 = spherical_expansion_samples.position(&[
-                    structure, center, species_center, species_neighbor_2
-                ]).expect("missing data for one of the neighbor species");
-
-                for (feature_i, block) in feature_blocks.iter().enumerate() {
-                    let &FeatureBlock { l, start_n1_l, start_n2_l } = block;
-
-                    let mut sum = 0.0;
-                    for (index_m, m) in (-l..=l).enumerate() {
-                        let feature_1 = start_n1_l + index_m * n_different_radial;
-                        let feature_2 = start_n2_l + index_m * n_different_radial;
-                        // check that we are accessing the right value of m
-                        debug_assert_eq!(spherical_expansion_features[feature_1][1].isize(), m);
-                        debug_assert_eq!(spherical_expansion_features[feature_2][1].isize(), m);
-
-                        // unsafe is required to remove the bound checking in
-                        // release mode (`uget` still checks bounds in debug
-                        // mode)
-                        unsafe {
-                            sum += spherical_expansion_values.uget([neighbor_1, feature_1])
-                                * spherical_expansion_values.uget([neighbor_2, feature_2]);
-                        }
-                    }
-
-                    if species_neighbor_1 != species_neighbor_2 {
-                        // We only store values for `species_neighbor_1 <
-                        // species_neighbor_2` because the values are the same for
-                        // pairs `species_neighbor_1 <-> species_neighbor_2` and
-                        // `species_neighbor_2 <-> species_neighbor_1`. To ensure
-                        // the final kernels are correct, we have to multiply the
-                        // corresponding values.
-                        sum *= std::f64::consts::SQRT_2;
-                    }
-
-                    let normalization = f64::sqrt(2.0 * l as f64 + 1.0);
-                    value[feature_i] = sum / normalization;
-                }
-            });
-
-        if self.parameters.gradients {
-            let gradients = descriptor.gradients.as_mut().expect("missing power spectrum gradients");
-            let gradient_samples = descriptor.gradients_samples.as_ref().expect("missing power spectrum gradient samples");
-
-            let se_gradients_samples = self.spherical_expansion.gradients_samples.as_ref().expect("missing spherical expansion gradient samples");
-            let se_gradients = self.spherical_expansion.gradients.as_ref().expect("missing spherical expansion gradients");
-
-            gradients.axis_iter_mut(ndarray::Axis(0))
-                .into_par_iter()
-                .enumerate()
-                .for_each(|(gradient_sample_i, mut gradient)| {
-                    let gradient_sample = &gradient_samples[gradient_sample_i];
-                    let sample_i = gradient_sample[0].usize();
-                    let grad_atom = gradient_sample[1];
-                    let spatial = gradient_sample[2];
-
-                    let sample = &samples[sample_i];
-                    let structure = sample[0];
-                    let center = sample[1];
-                    let species_center = sample[2];
-                    let species_neighbor_1 = sample[3];
-                    let species_neighbor_2 = sample[4];
-
-                    let sample_neighbor_1 = spherical_expansion_samples.position(&[
-                        structure, center, species_center, species_neighbor_1
-                    ]).expect("missing data for the first neighbor");
-                    let sample_neighbor_2 = spherical_expansion_samples.position(&[
-                        structure, center, species_center, species_neighbor_2
-                    ]).expect("missing data for the second neighbor");
-
-                    let grad_neighbor_1 = se_gradients_samples.position(&[
-                        IndexValue::from(sample_neighbor_1), grad_atom, spatial
-                    ]);
-                    let grad_neighbor_2 = se_gradients_samples.position(&[
-                        IndexValue::from(sample_neighbor_2), grad_atom, spatial
-                    ]);
+        return self.compute_environments(systems, descriptor);
+    }
 
-                    for (feature_i, block) in feature_blocks.iter().enumerate() {
-                        let &FeatureBlock { l, start_n1_l, start_n2_l } = block;
-
-                        let mut sum = 0.0;
-                        for (index_m, m) in (-l..=l).enumerate() {
-                            let feature_1 = start_n1_l + index_m * n_different_radial;
-                            let feature_2 = start_n2_l + index_m * n_different_radial;
-                            // check that we are accessing the right value of m
-                            debug_assert_eq!(spherical_expansion_features[feature_1][1].isize(), m);
-                            debug_assert_eq!(spherical_expansion_features[feature_2][1].isize(), m);
-
-                            if let Some(grad_neighbor_1) = grad_neighbor_1 {
-                                // unsafe is required to remove the bound
-                                // checking in release mode (`uget` still checks
-                                // bounds in debug mode)
-                                unsafe {
-                                    sum += se_gradients.uget([grad_neighbor_1, feature_1])
-                                         * spherical_expansion_values.uget([sample_neighbor_2, feature_2]);
-                                }
-                            }
+    #[time_graph::instrument(name = "SoapPowerSpectrum::compute_with_input")]
+    fn compute_with_input(&mut self, systems: &mut [Box<dyn System>], descriptor: &mut Descriptor, input: &Descriptor) -> Result<(), Error> {
+        assert_eq!(descriptor.samples.names(), self.samples_builder().names());
+        assert_eq!(descriptor.features.names(), self.features_names());
 
-                            if let Some(grad_neighbor_2) = grad_neighbor_2 {
-                                unsafe {
-                                    sum += spherical_expansion_values.uget([sample_neighbor_1, feature_1])
-                                         * se_gradients.uget([grad_neighbor_2, feature_2]);
-                                }
-                            }
-                        }
+        let (selected_features, n_different_radial) = self.get_expansion_features(&descriptor.features);
+        if input.features != selected_features || (self.parameters.gradients && input.gradients.is_none()) {
+            // the input does not contain the spherical expansion features we
+            // need, compute them again
+            return self.compute(systems, descriptor);
+        }
 
-                        if species_neighbor_1 != species_neighbor_2 {
-                            // see above
-                            sum *= std::f64::consts::SQRT_2;
-                        }
+        return self.compute_from_expansion(input, n_different_radial, descriptor);
+    }
 
-                        let normalization = f64::sqrt(2.0 * l as f64 + 1.0);
-                        gradient[feature_i] = sum / normalization;
-                    }
-                });
+    fn input_calculator(&self) -> Option<(String, String)> {
+        if self.parameters.deduplicate_environments.is_some() {
+            // the spherical expansion is only computed for unique environments
+            return None;
         }
 
-        Ok(())
+        let calculator = &self.spherical_expansion_calculator;
+        return Some((calculator.name(), calculator.parameters().into()));
     }
 }
 
-
 #[cfg(test)]
 mod tests {
     use crate::systems::test_utils::{test_systems, test_system};
     use crate::descriptor::{IndexValue, IndexesBuilder};
     use crate::{Descriptor, Calculator};
 
+    use approx::assert_relative_eq;
+
     use super::*;
     use crate::calculators::CalculatorBase;
 
@@ -438,6 +824,7 @@ mod tests {
             max_angular: 6,
             radial_basis: RadialBasis::Gto {},
             radial_scaling: RadialScaling::None {},
+            deduplicate_environments: None,
         }
     }
 
@@ -496,6 +883,36 @@ mod tests {
         );
     }
 
+    #[test]
+    fn deduplicated() {
+        let mut systems = test_systems(&["water", "methane"]);
+
+        let mut calculator = Calculator::from(Box::new(SoapPowerSpectrum::new(
+            parameters(false)
+        ).unwrap()) as Box<dyn CalculatorBase>);
+        let mut reference = Descriptor::new();
+        calculator.compute(&mut systems, &mut reference, Default::default()).unwrap();
+
+        let mut deduplicated = parameters(false);
+        deduplicated.deduplicate_environments = Some(1e-6);
+        let mut calculator = Calculator::from(Box::new(SoapPowerSpectrum::new(
+            deduplicated
+        ).unwrap()) as Box<dyn CalculatorBase>);
+        let mut descriptor = Descriptor::new();
+        calculator.compute(&mut systems, &mut descriptor, Default::default()).unwrap();
+
+        assert_eq!(descriptor.samples, reference.samples);
+        assert_relative_eq!(descriptor.values, reference.values, epsilon=1e-12, max_relative=1e-12);
+
+        let mut with_gradients = parameters(true);
+        with_gradients.deduplicate_environments = Some(1e-6);
+        assert!(SoapPowerSpectrum::new(with_gradients).is_err());
+
+        let mut negative = parameters(false);
+        negative.deduplicate_environments = Some(-1.0);
+        assert!(SoapPowerSpectrum::new(negative).is_err());
+    }
+
     #[test]
     fn finite_differences() {
         let calculator = Calculator::from(Box::new(SoapPowerSpectrum::new(
@@ -505,4 +922,44 @@ mod tests {
         let system = test_system("water");
         crate::calculators::tests_utils::finite_difference(calculator, system);
     }
+
+    #[test]
+    fn dense_and_sparse_features() {
+        let mut calculator = Calculator::from(Box::new(SoapPowerSpectrum::new(
+            parameters(true)
+        ).unwrap()) as Box<dyn CalculatorBase>);
+
+        let mut systems = test_systems(&["water", "methane"]);
+        let mut dense = Descriptor::new();
+        calculator.compute(&mut systems, &mut dense, Default::default()).unwrap();
+
+        // requesting all features in a different order uses the sparse code
+        let mut features = IndexesBuilder::new(vec!["n1", "n2", "l"]);
+        for feature_i in (0..dense.features.count()).rev() {
+            features.add(&dense.features[feature_i]);
+        }
+        let options = CalculationOptions {
+            selected_features: SelectedIndexes::Subset(features.finish()),
+            ..Default::default()
+        };
+
+        let mut sparse = Descriptor::new();
+        calculator.compute(&mut systems, &mut sparse, options).unwrap();
+
+        let n_features = dense.features.count();
+        for feature_i in 0..n_features {
+            let reversed_i = n_features - 1 - feature_i;
+            assert_eq!(dense.features[feature_i], sparse.features[reversed_i]);
+            assert_relative_eq!(
+                dense.values.column(feature_i),
+                sparse.values.column(reversed_i),
+                epsilon=1e-14, max_relative=1e-12
+            );
+            assert_relative_eq!(
+                dense.gradients.as_ref().unwrap().column(feature_i),
+                sparse.gradients.as_ref().unwrap().column(reversed_i),
+                epsilon=1e-14, max_relative=1e-12
+            );
+        }
+    }
 }
@@ -1,6 +1,7 @@
 use std::f64;
 
-use ndarray::{Array2, ArrayViewMut2};
+use ndarray::{Array2, ArrayViewMut2, ArrayViewMut3, Axis};
+use ndarray::linalg::general_mat_mul;
 
 use nalgebra as na;
 use nalgebra::linalg::SymmetricEigen;
@@ -97,6 +98,9 @@ pub struct GtoRadialIntegral {
     atomic_gaussian_constant: f64,
     /// 1/2σ_n^2, with σ_n the GTO gaussian width, i.e. `cutoff * max(√n, 1) / n_max`
     gto_gaussian_constants: Vec<f64>,
+    /// `(1/2σ^2 + 1/2σ_n^2)^{-(n + l + 3) / 2}` for all n and l, which does
+    /// not depend on the distance and is thus computed only once
+    c_dn_powers: Array2<f64>,
     /// `n_max * n_max` matrix to orthonormalize the GTO basis
     gto_orthonormalization: Array2<f64>,
 }
@@ -174,40 +178,44 @@ impl GtoRadialIntegral {
         let hypergeometric = HyperGeometricSphericalExpansion::new(parameters.max_radial, parameters.max_angular);
 
         let sigma2 = parameters.atomic_gaussian_width * parameters.atomic_gaussian_width;
+        let atomic_gaussian_constant = 1.0 / (2.0 * sigma2);
+
+        let mut c_dn_powers = Array2::from_elem((parameters.max_radial, parameters.max_angular + 1), 0.0);
+        for n in 0..parameters.max_radial {
+            let c_dn = atomic_gaussian_constant + gto_gaussian_constants[n];
+            for l in 0..(parameters.max_angular + 1) {
+                let n_l_3_over_2 = 0.5 * (n + l) as f64 + 1.5;
+                c_dn_powers[[n, l]] = c_dn.powf(-n_l_3_over_2);
+            }
+        }
 
         return Ok(GtoRadialIntegral {
             parameters: parameters,
             hypergeometric: hypergeometric,
-            atomic_gaussian_constant: 1.0 / (2.0 * sigma2),
+            atomic_gaussian_constant: atomic_gaussian_constant,
             gto_gaussian_constants: gto_gaussian_constants,
+            c_dn_powers: c_dn_powers,
             gto_orthonormalization: gto_orthonormalization,
         })
     }
-}
 
-impl RadialIntegral for GtoRadialIntegral {
-    #[time_graph::instrument(name = "GtoRadialIntegral::compute")]
-    fn compute(
+    fn check_shape(&self, name: &str, shape: &[usize]) {
+        let expected_shape = [self.parameters.max_radial, self.parameters.max_angular + 1];
+        assert_eq!(
+            shape, expected_shape,
+            "wrong size for {} array, expected [{}, {}] but got [{}, {}]",
+            name, expected_shape[0], expected_shape[1], shape[0], shape[1]
+        );
+    }
+
+    /// Compute the radial integral for a single `distance` in the
+    /// non-orthonormalized GTO basis
+    fn compute_unnormalized(
         &self,
         distance: f64,
         mut values: ArrayViewMut2<f64>,
         mut gradients: Option<ArrayViewMut2<f64>>
     ) {
-        let expected_shape = [self.parameters.max_radial, self.parameters.max_angular + 1];
-        assert_eq!(
-            values.shape(), expected_shape,
-            "wrong size for values array, expected [{}, {}] but got [{}, {}]",
-            expected_shape[0], expected_shape[1], values.shape()[0], values.shape()[1]
-        );
-
-        if let Some(ref gradients) = gradients {
-            assert_eq!(
-                gradients.shape(), expected_shape,
-                "wrong size for gradients array, expected [{}, {}] but got [{}, {}]",
-                expected_shape[0], expected_shape[1], gradients.shape()[0], gradients.shape()[1]
-            );
-        }
-
         let hyperg_parameters = HyperGeometricParameters {
             atomic_gaussian_constant: self.atomic_gaussian_constant,
             gto_gaussian_constants: &self.gto_gaussian_constants,
@@ -218,14 +226,11 @@ impl RadialIntegral for GtoRadialIntegral {
         let c_rij = c * distance;
 
         for n in 0..self.parameters.max_radial {
-            let gto_constant = self.gto_gaussian_constants[n];
             // `(c * rij)^l`
             let mut c_rij_l = 1.0;
 
             for l in 0..(self.parameters.max_angular + 1) {
-                let n_l_3_over_2 = 0.5 * (n + l) as f64 + 1.5;
-                let c_dn = (c + gto_constant).powf(-n_l_3_over_2);
-                let factor = c_rij_l * c_dn;
+                let factor = c_rij_l * self.c_dn_powers[[n, l]];
                 c_rij_l *= c_rij;
 
                 values[[n, l]] *= factor;
@@ -246,23 +251,76 @@ impl RadialIntegral for GtoRadialIntegral {
                 if self.parameters.max_angular >= 1 {
                     let l = 1;
                     for n in 0..self.parameters.max_radial {
-                        let gto_constant = self.gto_gaussian_constants[n];
                         let a = 0.5 * (n + l) as f64 + 1.5;
                         let b = 2.5;
-                        let c_dn = (c + gto_constant).powf(-a);
-                        let factor = c * c_dn;
+                        let factor = c * self.c_dn_powers[[n, l]];
 
                         gradients[[n, l]] = gamma(a) / gamma(b) * factor;
                     }
                 }
             }
         }
+    }
+}
+
+impl RadialIntegral for GtoRadialIntegral {
+    #[time_graph::instrument(name = "GtoRadialIntegral::compute")]
+    fn compute(
+        &self,
+        distance: f64,
+        mut values: ArrayViewMut2<f64>,
+        mut gradients: Option<ArrayViewMut2<f64>>
+    ) {
+        self.check_shape("values", values.shape());
+        if let Some(ref gradients) = gradients {
+            self.check_shape("gradients", gradients.shape());
+        }
+
+        self.compute_unnormalized(distance, values.view_mut(), gradients.as_mut().map(|g| g.view_mut()));
 
         values.assign(&self.gto_orthonormalization.dot(&values));
         if let Some(ref mut gradients) = gradients {
             gradients.assign(&self.gto_orthonormalization.dot(&*gradients));
         }
     }
+
+    #[time_graph::instrument(name = "GtoRadialIntegral::compute_batch")]
+    fn compute_batch(
+        &self,
+        distances: &[f64],
+        mut values: ArrayViewMut3<f64>,
+        mut gradients: Option<ArrayViewMut3<f64>>
+    ) {
+        assert_eq!(values.shape()[0], distances.len(), "wrong size for the values array");
+        self.check_shape("values", &values.shape()[1..]);
+        if let Some(ref gradients) = gradients {
+            assert_eq!(gradients.shape()[0], distances.len(), "wrong size for the gradients array");
+            self.check_shape("gradients", &gradients.shape()[1..]);
+        }
+
+        // the same scratch arrays are used for all distances, instead of
+        // allocating new arrays for the orthonormalization of each distance
+        let shape = (self.parameters.max_radial, self.parameters.max_angular + 1);
+        let mut values_scratch = Array2::from_elem(shape, 0.0);
+        let mut gradients_scratch = gradients.as_ref().map(|_| Array2::from_elem(shape, 0.0));
+
+        for (i_distance, &distance) in distances.iter().enumerate() {
+            self.compute_unnormalized(
+                distance,
+                values_scratch.view_mut(),
+                gradients_scratch.as_mut().map(|g| g.view_mut())
+            );
+
+            let mut values = values.index_axis_mut(Axis(0), i_distance);
+            general_mat_mul(1.0, &self.gto_orthonormalization, &values_scratch, 0.0, &mut values);
+
+            if let Some(ref mut gradients) = gradients {
+                let gradients_scratch = gradients_scratch.as_ref().expect("missing gradients scratch array");
+                let mut gradients = gradients.index_axis_mut(Axis(0), i_distance);
+                general_mat_mul(1.0, &self.gto_orthonormalization, gradients_scratch, 0.0, &mut gradients);
+            }
+        }
+    }
 }
 
 #[cfg(test)]
@@ -421,4 +479,30 @@ mod tests {
             }
         }
     }
+
+    #[test]
+    fn batch() {
+        let max_radial = 6;
+        let max_angular = 5;
+        let gto = GtoRadialIntegral::new(GtoParameters {
+            max_radial: max_radial,
+            max_angular: max_angular,
+            cutoff: 5.0,
+            atomic_gaussian_width: 0.5,
+        }).unwrap();
+
+        let distances = [0.0, 0.3, 1.2, 2.5, 4.9];
+        let shape = (distances.len(), max_radial, max_angular + 1);
+        let mut batch_values = ndarray::Array3::from_elem(shape, 0.0);
+        let mut batch_gradients = ndarray::Array3::from_elem(shape, 0.0);
+        gto.compute_batch(&distances, batch_values.view_mut(), Some(batch_gradients.view_mut()));
+
+        let mut values = Array2::from_elem((max_radial, max_angular + 1), 0.0);
+        let mut gradients = Array2::from_elem((max_radial, max_angular + 1), 0.0);
+        for (i, &distance) in distances.iter().enumerate() {
+            gto.compute(distance, values.view_mut(), Some(gradients.view_mut()));
+            assert_eq!(batch_values.index_axis(ndarray::Axis(0), i), values);
+            assert_eq!(batch_gradients.index_axis(ndarray::Axis(0), i), gradients);
+        }
+    }
 }
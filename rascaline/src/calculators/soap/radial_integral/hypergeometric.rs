@@ -149,6 +149,47 @@ impl Series1F1 {
 
         return result;
     }
+
+    /// Compute both this series and the `other` series for the same input
+    /// parameter `z` in a single pass, sharing the powers of `z`. This gives
+    /// exactly the same results as calling `compute` on both series.
+    #[allow(clippy::identity_op)]
+    pub fn compute_pair(&self, other: &Series1F1, z: f64) -> (f64, f64) {
+        let series = [self, other];
+        let mut results = [1.0, 1.0];
+        let mut converged = [false, false];
+
+        let mut z_pow = z;
+        let z4 = z * z * z * z;
+        let n_coefficients = usize::min(self.coefficients.len(), other.coefficients.len());
+        for i in (0..n_coefficients).step_by(4)  {
+            for k in 0..2 {
+                if converged[k] {
+                    continue;
+                }
+
+                let coefficients = &series[k].coefficients;
+                let mut term = coefficients[i + 3];
+                term = coefficients[i + 2] + z * term;
+                term = coefficients[i + 1] + z * term;
+                term = coefficients[i + 0] + z * term;
+                term *= z_pow;
+
+                if term < HYPERGEOMETRIC_PRECISION * results[k] {
+                    converged[k] = true;
+                }
+                results[k] += term;
+            }
+
+            if converged[0] && converged[1] {
+                break;
+            }
+
+            z_pow *= z4;
+        }
+
+        return (results[0], results[1]);
+    }
 }
 
 /// Compute G using the direct sum for 1F1
@@ -198,6 +239,17 @@ impl HyperGeometricSeries {
         }
     }
 
+    /// Computes both G(z) and the derivative returned by `compute`, sharing
+    /// the evaluation of the exponential and of the series
+    pub fn compute_with_derivative(&self, z: f64, z2: f64) -> (f64, f64) {
+        let (series, series_derivative) = self.series_1f1.compute_pair(&self.series_1f1_derivative, z);
+        let exp_z2 = f64::exp(z2);
+        return (
+            self.gamma_ratio * series * exp_z2,
+            self.gamma_ratio * series_derivative * exp_z2 * self.a / self.b,
+        );
+    }
+
     /// Compute 1F1 itself to check for the best validity domain of this
     /// implementation
     pub fn compute_1f1(&self, z: f64) -> f64 {
@@ -257,6 +309,17 @@ impl HyperGeometricAsymptotic {
         return hyp2f0 * f64::exp(z + z2) * factor;
     }
 
+    /// Computes both G(z) and the derivative returned by `compute`, sharing
+    /// the evaluation of the exponential and power prefactors
+    pub fn compute_with_derivative(&self, z: f64, z2: f64) -> (f64, f64) {
+        let factor = z.powf(self.a - self.b);
+        let exp_z_z2 = f64::exp(z + z2);
+        return (
+            self.series_2f0.compute(z) * exp_z_z2 * factor,
+            self.series_2f0_derivative.compute(z) * exp_z_z2 * factor,
+        );
+    }
+
     /// Compute 1F1 itself to check for the best validity domain of this
     /// implementation
     pub fn compute_1f1(&self, z: f64) -> f64 {
@@ -391,6 +454,27 @@ impl HyperGeometric {
 
         return result;
     }
+
+    /// Compute both `self.compute(z, z2, false)` and `self.compute(z, z2,
+    /// true)`, faster than calling `compute` twice.
+    pub fn compute_with_derivative(&self, z: f64, z2: f64) -> (f64, f64) {
+        let result;
+        if self.is_exponential {
+            let value = self.gamma_ratio * f64::exp(z + z2);
+            result = (value, value);
+        } else if z > self.switching_point {
+            result = self.asymptotic.compute_with_derivative(z, z2);
+        } else {
+            result = self.series.compute_with_derivative(z, z2);
+        }
+
+        debug_assert!(
+            result.0.is_finite() && result.1.is_finite(),
+            "HyperGeometric overflowed with z={}", z
+        );
+
+        return result;
+    }
 }
 
 /// Computes the G function and its derivative for all possible values of `l <
@@ -477,21 +561,22 @@ impl HyperGeometricSphericalExpansion {
         for n in 0..self.max_radial {
             let z = alpha_rij * alpha_rij / (alpha + parameters.gto_gaussian_constants[n]);
             for l in 0..(self.max_angular + 1) {
-                values[[n, l]] = self.hypergeometric[[n, l]].compute(z, z2, false);
+                if let Some(ref mut gradients) = gradients {
+                    let (value, gradient) = self.hypergeometric[[n, l]].compute_with_derivative(z, z2);
+                    values[[n, l]] = value;
+                    gradients[[n, l]] = gradient;
+                } else {
+                    values[[n, l]] = self.hypergeometric[[n, l]].compute(z, z2, false);
+                }
             }
-        }
 
-        if let Some(ref mut gradients) = gradients {
-            for n in 0..self.max_radial {
-                let z = alpha_rij * alpha_rij / (alpha + parameters.gto_gaussian_constants[n]);
-
-                for l in 0..(self.max_angular + 1) {
-                    gradients[[n, l]] = self.hypergeometric[[n, l]].compute(z, z2, true);
-                }
+            if let Some(ref mut gradients) = gradients {
                 let mut row = gradients.index_axis_mut(Axis(0), n);
                 row *= 2.0 * z / rij;
             }
+        }
 
+        if let Some(ref mut gradients) = gradients {
             azip!((gradient in gradients, &value in &values)
                 *gradient -= 2.0 * alpha * rij * value
             );
@@ -519,19 +604,15 @@ impl HyperGeometricSphericalExpansion {
             let z = alpha_rij * alpha_rij / (alpha + parameters.gto_gaussian_constants[n]);
 
             let l = self.max_angular;
-            let mut m1p2p = self.hypergeometric[[n, l]].compute(z, z2, false);
+            let (mut m1p2p, mut m2p3p) = self.hypergeometric[[n, l]].compute_with_derivative(z, z2);
             values[[n, l]] = m1p2p;
-
-            let mut m2p3p = self.hypergeometric[[n, l]].compute(z, z2, true);
             if let Some(ref mut gradients) = gradients {
                 gradients[[n, l]] = m2p3p;
             }
 
             let l = self.max_angular - 1;
-            let mut mp1p2p = self.hypergeometric[[n, l]].compute(z, z2, false);
+            let (mut mp1p2p, mut mp2p3p) = self.hypergeometric[[n, l]].compute_with_derivative(z, z2);
             values[[n, l]] = mp1p2p;
-
-            let mut mp2p3p = self.hypergeometric[[n, l]].compute(z, z2, true);
             if let Some(ref mut gradients) = gradients {
                 gradients[[n, l]] = mp2p3p;
             }
@@ -646,4 +727,17 @@ mod tests {
             }
         }
     }
+
+    #[test]
+    fn value_and_derivative() {
+        for &(a, b) in &[(1.5, 1.5), (2.0, 1.5), (4.5, 3.5), (7.0, 5.5)] {
+            let hypergeometric = HyperGeometric::new(a, b);
+            for &z in &[0.0, 0.1, 1.3, 8.0, 25.0, 120.0] {
+                let z2 = -1.2 * z;
+                let (value, derivative) = hypergeometric.compute_with_derivative(z, z2);
+                assert_eq!(value, hypergeometric.compute(z, z2, false));
+                assert_eq!(derivative, hypergeometric.compute(z, z2, true));
+            }
+        }
+    }
 }
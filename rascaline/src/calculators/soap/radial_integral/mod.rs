@@ -1,4 +1,4 @@
-use ndarray::ArrayViewMut2;
+use ndarray::{ArrayViewMut2, ArrayViewMut3, Axis};
 
 /// A `RadialIntegral` computes the radial integral on a given radial basis.
 ///
@@ -14,6 +14,26 @@ pub trait RadialIntegral: std::panic::RefUnwindSafe + Send {
     /// array `values`. If `gradients` is `Some`, also compute and store
     /// gradients there.
     fn compute(&self, rij: f64, values: ArrayViewMut2<f64>, gradients: Option<ArrayViewMut2<f64>>);
+
+    /// Compute the radial integral for multiple `distances` at once, storing
+    /// the resulting data in the `distances.len() x max_radial x (max_angular
+    /// + 1)` array `values`. If `gradients` is `Some`, also compute and store
+    /// gradients there.
+    ///
+    /// The default implementation calls `compute` for each distance in turn,
+    /// implementations are free to provide a more efficient version.
+    fn compute_batch(&self, distances: &[f64], mut values: ArrayViewMut3<f64>, mut gradients: Option<ArrayViewMut3<f64>>) {
+        assert_eq!(values.shape()[0], distances.len(), "wrong size for the values array");
+        if let Some(ref gradients) = gradients {
+            assert_eq!(gradients.shape()[0], distances.len(), "wrong size for the gradients array");
+        }
+
+        for (i_distance, &distance) in distances.iter().enumerate() {
+            let values = values.index_axis_mut(Axis(0), i_distance);
+            let gradients = gradients.as_mut().map(|g| g.index_axis_mut(Axis(0), i_distance));
+            self.compute(distance, values, gradients);
+        }
+    }
 }
 
 mod hypergeometric;
@@ -24,3 +44,4 @@ pub use self::gto::{GtoRadialIntegral, GtoParameters};
 
 mod spline;
 pub use self::spline::{SplinedRadialIntegral, SplinedRIParameters};
+pub use self::spline::{save_splines_cache, load_splines_cache, clear_splines_cache};
@@ -1,4 +1,10 @@
-use ndarray::{Array2, ArrayViewMut2, azip};
+use std::collections::HashMap;
+use std::convert::TryFrom;
+use std::io::{BufReader, BufWriter, Read, Write};
+use std::path::Path;
+use std::sync::{Arc, Mutex};
+
+use ndarray::{Array2, Array4, ArrayView2, ArrayViewMut2, ArrayViewMut3, Axis, azip};
 use log::info;
 
 use super::RadialIntegral;
@@ -7,6 +13,14 @@ use crate::Error;
 /// Maximal number of points in the splines
 const MAX_SPLINE_SIZE: usize = 10_000;
 
+/// Maximal number of cells per spline interval in the lookup table used to
+/// find the interval containing a given position
+const MAX_LOOKUP_CELLS_PER_INTERVAL: usize = 8;
+
+/// Magic bytes at the beginning of files created by `save_splines_cache`,
+/// containing the version of the file format
+const SPLINES_CACHE_MAGIC: &[u8; 16] = b"rascaline-spl-v1";
+
 /// `SplinedRadialIntegral` allows to evaluate another radial integral
 /// implementation using [cubic Hermit spline][splines-wiki].
 ///
@@ -16,10 +30,12 @@ const MAX_SPLINE_SIZE: usize = 10_000;
 /// [splines-wiki]: https://en.wikipedia.org/wiki/Cubic_Hermite_spline
 pub struct SplinedRadialIntegral {
     parameters: SplinedRIParameters,
-    points: Vec<HermitSplinePoint>,
+    /// Control points of the spline, shared with the global splines cache
+    points: Arc<SplinePoints>,
 }
 
-/// A single control point/knot in the Hermit cubic spline
+/// A single control point/knot in the Hermit cubic spline, used while
+/// creating the spline
 #[derive(Debug, Clone)]
 struct HermitSplinePoint {
     /// Position of the point
@@ -30,6 +46,110 @@ struct HermitSplinePoint {
     derivative: Array2<f64>,
 }
 
+/// Error of a spline in the middle of one interval, used while creating the
+/// spline
+#[derive(Debug, Clone)]
+struct IntervalError {
+    /// Point in the middle of the interval, which becomes a new control point
+    /// if the interval is split
+    midpoint: HermitSplinePoint,
+    /// Maximal absolute error across all radial and angular channels
+    max_absolute: f64,
+    /// Mean absolute error across all radial and angular channels
+    mean_absolute: f64,
+    /// Mean relative error across all radial and angular channels
+    mean_relative: f64,
+}
+
+/// All the control points of a Hermit cubic spline, stored in a single
+/// contiguous buffer, together with a lookup table to find the interval
+/// containing a given position in constant time.
+#[derive(Debug, Clone)]
+struct SplinePoints {
+    /// Position of the points, sorted in increasing order
+    positions: Vec<f64>,
+    /// Values and derivatives of the function at all points, with shape
+    /// `(n_points, 2, max_radial, max_angular + 1)`. `data[k, 0]` contains the
+    /// values and `data[k, 1]` the derivatives at `positions[k]`, so both
+    /// points of an interval are next to each other in memory.
+    data: Array4<f64>,
+    /// Index of the first interval overlapping each of the uniform cells of
+    /// size `1 / cells_scale` covering the spline domain
+    lookup: Vec<usize>,
+    /// Inverse of the size of the cells in `lookup`
+    cells_scale: f64,
+}
+
+impl SplinePoints {
+    #[allow(clippy::float_cmp)]
+    fn new(positions: Vec<f64>, data: Array4<f64>) -> SplinePoints {
+        assert!(positions.len() >= 2, "we need at least two points to create a spline");
+        assert_eq!(positions.len(), data.shape()[0]);
+        assert_eq!(data.shape()[1], 2);
+        assert!(positions.windows(2).all(|w| w[0] < w[1]), "spline points must be sorted");
+        assert_eq!(positions[0], 0.0);
+
+        let n_intervals = positions.len() - 1;
+        let max_position = positions[n_intervals];
+
+        // use cells smaller than the smallest interval, so that finding the
+        // interval from the cell only takes a couple of comparisons. The
+        // number of cells is limited to avoid huge lookup tables when a few
+        // intervals are much smaller than the others.
+        let min_width = positions.windows(2)
+            .map(|w| w[1] - w[0])
+            .fold(f64::INFINITY, f64::min);
+        let n_cells = f64::ceil(max_position / min_width) as usize;
+        let n_cells = usize::max(1, usize::min(n_cells, MAX_LOOKUP_CELLS_PER_INTERVAL * n_intervals));
+        let cells_scale = n_cells as f64 / max_position;
+
+        let mut lookup = Vec::with_capacity(n_cells);
+        let mut k = 0;
+        for cell in 0..n_cells {
+            let cell_start = cell as f64 / cells_scale;
+            while k + 1 < n_intervals && positions[k + 1] <= cell_start {
+                k += 1;
+            }
+            lookup.push(k);
+        }
+
+        SplinePoints { positions, data, lookup, cells_scale }
+    }
+
+    fn from_points(points: Vec<HermitSplinePoint>, shape: (usize, usize)) -> SplinePoints {
+        let mut positions = Vec::with_capacity(points.len());
+        let mut data = Array4::from_elem((points.len(), 2, shape.0, shape.1), 0.0);
+        for (mut data, point) in data.outer_iter_mut().zip(points) {
+            positions.push(point.position);
+            data.index_axis_mut(Axis(0), 0).assign(&point.value);
+            data.index_axis_mut(Axis(0), 1).assign(&point.derivative);
+        }
+
+        return SplinePoints::new(positions, data);
+    }
+
+    /// Get the number of control points in this spline
+    fn len(&self) -> usize {
+        self.positions.len()
+    }
+
+    /// Find the index `k` of the interval containing `x`, such that
+    /// `positions[k] <= x < positions[k + 1]`.
+    #[inline]
+    fn interval(&self, x: f64) -> usize {
+        let cell = usize::min((x * self.cells_scale) as usize, self.lookup.len() - 1);
+        let mut k = self.lookup[cell];
+        // the cell start might be slightly after `x` because of rounding
+        while k > 0 && self.positions[k] > x {
+            k -= 1;
+        }
+        while k + 2 < self.positions.len() && self.positions[k + 1] <= x {
+            k += 1;
+        }
+        return k;
+    }
+}
+
 /// Parameters for computing the radial integral using Hermit cubic splines
 #[derive(Debug, Clone, Copy)]
 pub struct SplinedRIParameters {
@@ -42,31 +162,49 @@ pub struct SplinedRIParameters {
 }
 
 impl SplinedRadialIntegral {
-    #[allow(clippy::float_cmp)]
-    fn new(
+    /// Same as `SplinedRadialIntegral::with_accuracy`, but re-use the control
+    /// points of an existing spline with the same parameters if any, either
+    /// created earlier in this process or loaded with `load_splines_cache`.
+    ///
+    /// `description` must uniquely identify the splined `radial_integral` and
+    /// all its parameters, since it is used together with the spline
+    /// `parameters` and `accuracy` to look for splines in the cache.
+    pub fn with_accuracy_cached(
         parameters: SplinedRIParameters,
-        mut points: Vec<HermitSplinePoint>,
-    ) -> SplinedRadialIntegral  {
-        assert!(points.len() >= 2, "we need at least two points to create a spline");
-
-        points.sort_unstable_by(|a, b| {
-            a.position.partial_cmp(&b.position).expect("got NaN while sorting by point position")
-        });
+        accuracy: f64,
+        description: String,
+        radial_integral: impl RadialIntegral,
+    ) -> Result<SplinedRadialIntegral, Error> {
+        let key = SplineCacheKey::new(description, parameters, accuracy);
+        if let Some(points) = SPLINES_CACHE.lock().expect("mutex was poisoned").get(&key) {
+            return Ok(SplinedRadialIntegral {
+                parameters: parameters,
+                points: Arc::clone(points),
+            });
+        }
 
-        assert_eq!(points.first().unwrap().position, 0.0);
-        assert_eq!(points.last().unwrap().position, parameters.cutoff);
+        // compute the spline without holding the lock, so splines with
+        // different parameters can be created concurrently
+        let spline = SplinedRadialIntegral::with_accuracy(parameters, accuracy, radial_integral)?;
 
-        SplinedRadialIntegral {
+        let mut cache = SPLINES_CACHE.lock().expect("mutex was poisoned");
+        let points = cache.entry(key).or_insert_with(|| Arc::clone(&spline.points));
+        return Ok(SplinedRadialIntegral {
             parameters: parameters,
-            points: points,
-        }
+            points: Arc::clone(points),
+        });
     }
 
     /// Create a new `SplinedRadialIntegral` taking values from the given
     /// `radial_integral`. Points are added to the spline until the requested
-    /// accuracy is reached. We consider that the accuracy is reached when
-    /// either the mean absolute error or the mean relative error gets below the
-    /// `accuracy` threshold.
+    /// accuracy is reached.
+    ///
+    /// Starting from a uniform grid, the error of the spline is evaluated in
+    /// the middle of each interval, until either the mean absolute error or
+    /// the mean relative error (across all intervals and all radial and
+    /// angular channels) gets below the `accuracy` threshold. Only the
+    /// intervals with an error above the threshold are split in two, which
+    /// places more control points where the radial integral changes quickly.
     #[time_graph::instrument(name = "SplinedRadialIntegral::with_accuracy")]
     pub fn with_accuracy(
         parameters: SplinedRIParameters,
@@ -79,70 +217,103 @@ impl SplinedRadialIntegral {
             )));
         }
 
-        let initial_grid_size = 11;
-        let grid_step = parameters.cutoff / (initial_grid_size - 1) as f64;
-
-        let mut points = Vec::new();
         let shape = (parameters.max_radial, parameters.max_angular + 1);
-        for k in 0..initial_grid_size {
-            let position = k as f64 * grid_step;
+        let compute_point = |position| {
             let mut value = Array2::from_elem(shape, 0.0);
             let mut derivative = Array2::from_elem(shape, 0.0);
             radial_integral.compute(position, value.view_mut(), Some(derivative.view_mut()));
+            HermitSplinePoint { position, value, derivative }
+        };
 
-            points.push(HermitSplinePoint { position, value, derivative });
-        }
-
-        let mut spline = SplinedRadialIntegral::new(parameters, points);
+        let initial_grid_size = 11;
+        let grid_step = parameters.cutoff / (initial_grid_size - 1) as f64;
 
-        // add more points as required to reach the requested accuracy
+        let mut points = (0..initial_grid_size)
+            .map(|k| if k == initial_grid_size - 1 {
+                // make sure the last point is exactly at the cutoff
+                compute_point(parameters.cutoff)
+            } else {
+                compute_point(k as f64 * grid_step)
+            })
+            .collect::<Vec<_>>();
+
+        // error of the spline in the middle of each interval, `None` for the
+        // intervals which have not been evaluated yet. The error of intervals
+        // which are not split is kept from one pass to the next.
+        let mut errors: Vec<Option<IntervalError>> = vec![None; points.len() - 1];
+
+        // split intervals as required to reach the requested accuracy
+        let mut interpolated = Array2::from_elem(shape, 0.0);
         loop {
-            let mut new_points = Vec::new();
-
-            let positions = spline.positions();
-
             // evaluate the error at points in between grid points, since these
             // should have the highest error in average.
-            let mut max_absolute_error = 0.0;
-            let mut mean_absolute_error = 0.0;
-            let mut mean_relative_error = 0.0;
-            let mut error_count = 0;
-            for k in 0..(spline.len() - 1) {
-                let position = (positions[k] + positions[k + 1]) / 2.0;
-
-                let mut value = Array2::from_elem(shape, 0.0);
-                let mut derivative = Array2::from_elem(shape, 0.0);
-                radial_integral.compute(position, value.view_mut(), Some(derivative.view_mut()));
-
-                let mut interpolated = Array2::from_elem(shape, 0.0);
-                spline.compute(position, interpolated.view_mut(), None);
+            for (k, error) in errors.iter_mut().enumerate() {
+                if error.is_some() {
+                    continue;
+                }
+
+                let (point_k, point_k_1) = (&points[k], &points[k + 1]);
+                let midpoint = compute_point((point_k.position + point_k_1.position) / 2.0);
+
+                hermit_interpolation(
+                    midpoint.position,
+                    (point_k.position, point_k.value.view(), point_k.derivative.view()),
+                    (point_k_1.position, point_k_1.value.view(), point_k_1.derivative.view()),
+                    interpolated.view_mut(),
+                    None,
+                );
 
                 // get the error across all n/l values in the arrays
-                azip!((interpolated in &interpolated, value in &value) {
+                let mut max_absolute = 0.0;
+                let mut mean_absolute = 0.0;
+                let mut mean_relative = 0.0;
+                azip!((interpolated in &interpolated, value in &midpoint.value) {
                     let absolute_error = f64::abs(interpolated - value);
-                    if absolute_error > max_absolute_error {
-                        max_absolute_error = absolute_error;
+                    if absolute_error > max_absolute {
+                        max_absolute = absolute_error;
                     }
 
-                    mean_absolute_error += absolute_error;
-                    mean_relative_error += f64::abs((interpolated - value) / value);
-                    error_count += 1;
+                    mean_absolute += absolute_error;
+                    mean_relative += f64::abs((interpolated - value) / value);
                 });
+                mean_absolute /= interpolated.len() as f64;
+                mean_relative /= interpolated.len() as f64;
 
-                new_points.push(HermitSplinePoint { position, value, derivative });
+                *error = Some(IntervalError { midpoint, max_absolute, mean_absolute, mean_relative });
             }
-            mean_absolute_error /= error_count as f64;
-            mean_relative_error /= error_count as f64;
+
+            // all intervals contain the same number of values, so the mean
+            // error over all of them is the mean of the errors of each interval
+            let mut max_absolute_error = 0.0;
+            let mut mean_absolute_error = 0.0;
+            let mut mean_relative_error = 0.0;
+            for error in errors.iter().flatten() {
+                if error.max_absolute > max_absolute_error {
+                    max_absolute_error = error.max_absolute;
+                }
+                mean_absolute_error += error.mean_absolute;
+                mean_relative_error += error.mean_relative;
+            }
+            mean_absolute_error /= errors.len() as f64;
+            mean_relative_error /= errors.len() as f64;
 
             if mean_absolute_error < accuracy || mean_relative_error < accuracy {
                 info!(
                     "splined radial integral reached requested accuracy ({:.3e}) on average with {} reference points (max absolute error is {:.3e})",
-                    accuracy, spline.len(), max_absolute_error,
+                    accuracy, points.len(), max_absolute_error,
                 );
                 break;
             }
 
-            if spline.len() + new_points.len() > MAX_SPLINE_SIZE {
+            // only split the intervals where the error is above the requested
+            // accuracy. Since the mean error is above the accuracy, there is
+            // always at least one such interval.
+            let needs_split = |error: &IntervalError| {
+                !(error.mean_absolute < accuracy && error.mean_relative < accuracy)
+            };
+
+            let n_new_points = errors.iter().flatten().filter(|e| needs_split(e)).count();
+            if points.len() + n_new_points > MAX_SPLINE_SIZE {
                 return Err(Error::Internal(format!(
                     "failed to reach requested accuracy ({:e}) in spline interpolation for radial integral, \
                     the best we got was {:e}",
@@ -150,95 +321,378 @@ impl SplinedRadialIntegral {
                 )));
             }
 
-            // add more points and continue
-            for point in new_points {
-                spline.add_point(point);
+            // add the midpoints of the split intervals right after the start
+            // of their interval, the two halves will be evaluated in the next
+            // pass
+            let mut refined = Vec::with_capacity(points.len() + n_new_points);
+            let mut refined_errors = Vec::with_capacity(errors.len() + n_new_points);
+            let mut errors_iter = errors.into_iter();
+            for point in points {
+                refined.push(point);
+                match errors_iter.next().flatten() {
+                    Some(error) if needs_split(&error) => {
+                        refined.push(error.midpoint);
+                        refined_errors.push(None);
+                        refined_errors.push(None);
+                    }
+                    Some(error) => refined_errors.push(Some(error)),
+                    // the last point does not start an interval
+                    None => {}
+                }
             }
+            points = refined;
+            errors = refined_errors;
         }
 
-        return Ok(spline);
-    }
-
-    /// Add a new control points to this spline. The new point must be between
-    /// 0 and the cutoff.
-    fn add_point(&mut self, point: HermitSplinePoint) {
-        debug_assert!(point.position > 0.0 && point.position < self.parameters.cutoff );
-        match self.points.binary_search_by(
-            |v| v.position.partial_cmp(&point.position).expect("got NaN")
-        ) {
-            Ok(_) => panic!("trying to add the same point twice to the spline"),
-            Err(k) => self.points.insert(k, point)
-        }
+        return Ok(SplinedRadialIntegral {
+            parameters: parameters,
+            points: Arc::new(SplinePoints::from_points(points, shape)),
+        });
     }
 
-    /// Get the number of control points in this spline
-    fn len(&self) -> usize {
-        self.points.len()
+    /// Get the position of the control points for this spline
+    #[cfg(test)]
+    fn positions(&self) -> &[f64] {
+        &self.points.positions
     }
+}
 
-    /// Get the position of the control points for this spline
-    fn positions(&self) -> Vec<f64> {
-        self.points.iter().map(|p| p.position).collect()
+/// Evaluate the Hermit cubic spline going through the points `(x_k, p_k, m_k)`
+/// and `(x_k_1, p_k_1, m_k_1)` (position, values and derivatives) at `x`.
+#[inline]
+fn hermit_interpolation(
+    x: f64,
+    (x_k, p_k, m_k): (f64, ArrayView2<f64>, ArrayView2<f64>),
+    (x_k_1, p_k_1, m_k_1): (f64, ArrayView2<f64>, ArrayView2<f64>),
+    values: ArrayViewMut2<f64>,
+    gradients: Option<ArrayViewMut2<f64>>,
+) {
+    // notation in this function follows
+    // https://en.wikipedia.org/wiki/Cubic_Hermite_spline
+    debug_assert!(x_k <= x && x < x_k_1);
+
+    let delta = x_k_1 - x_k;
+    let t = (x - x_k) / delta;
+    let t_2 = t * t;
+    let t_3 = t_2 * t;
+
+    // Hermit base polynomials
+    let h00 = 2.0 * t_3 - 3.0 * t_2 + 1.0;
+    let h10 = t_3 - 2.0 * t_2 + t;
+    let h01 = -2.0 * t_3 + 3.0 * t_2;
+    let h11 = t_3 - t_2;
+
+    azip!((v in values, p_k in &p_k, p_k_1 in &p_k_1, m_k in &m_k, m_k_1 in &m_k_1) {
+        *v = h00 * p_k + h10 * delta * m_k + h01 * p_k_1 + h11 * delta * m_k_1;
+    });
+
+    if let Some(gradients) = gradients {
+        let d_h00_dt = 6.0 * (t_2 - t);
+        let d_h10_dt = 3.0 * t_2 - 4.0 * t + 1.0;
+        let d_h01_dt = -d_h00_dt;
+        let d_h11_dt = 3.0 * t_2 - 2.0 * t;
+
+        let dx_dt = 1.0 / delta;
+
+        azip!((g in gradients, p_k in &p_k, p_k_1 in &p_k_1, m_k in &m_k, m_k_1 in &m_k_1) {
+            *g = d_h00_dt * p_k * dx_dt + d_h10_dt * m_k + d_h01_dt * p_k_1 * dx_dt + d_h11_dt * m_k_1;
+        });
     }
 }
 
 impl RadialIntegral for SplinedRadialIntegral {
     #[time_graph::instrument(name = "SplinedRadialIntegral::compute")]
     fn compute(&self, x: f64, values: ArrayViewMut2<f64>, gradients: Option<ArrayViewMut2<f64>>) {
-        // notation in this function follows
-        // https://en.wikipedia.org/wiki/Cubic_Hermite_spline
         debug_assert!(x < self.parameters.cutoff && x >= 0.0 && x.is_finite());
 
-        let k = match self.points.binary_search_by(
-            |v| v.position.partial_cmp(&x).expect("got NaN")
-        ) {
-            Ok(k) => k,
-            Err(k) => k - 1,
-        };
+        let points = &*self.points;
+        let k = points.interval(x);
+
+        let data_k = points.data.index_axis(Axis(0), k);
+        let data_k_1 = points.data.index_axis(Axis(0), k + 1);
+
+        hermit_interpolation(
+            x,
+            (points.positions[k], data_k.index_axis(Axis(0), 0), data_k.index_axis(Axis(0), 1)),
+            (points.positions[k + 1], data_k_1.index_axis(Axis(0), 0), data_k_1.index_axis(Axis(0), 1)),
+            values,
+            gradients,
+        );
+    }
 
-        let point_k = &self.points[k];
-        let point_k_1 = &self.points[k + 1];
+    #[time_graph::instrument(name = "SplinedRadialIntegral::compute_batch")]
+    fn compute_batch(&self, distances: &[f64], mut values: ArrayViewMut3<f64>, mut gradients: Option<ArrayViewMut3<f64>>) {
+        let shape = [distances.len(), self.parameters.max_radial, self.parameters.max_angular + 1];
+        assert_eq!(values.shape(), shape, "wrong shape for the values array");
+        if let Some(ref gradients) = gradients {
+            assert_eq!(gradients.shape(), shape, "wrong shape for the gradients array");
+        }
 
-        let x_k = point_k.position;
-        let x_k_1 = point_k_1.position;
-        debug_assert!(x_k <= x && x < x_k_1);
+        let points = &*self.points;
+        // size of the data for a single point
+        let size = shape[1] * shape[2];
+        let data = points.data.as_slice().expect("spline data should be contiguous");
 
-        let delta = x_k_1 - x_k;
-        let t = (x - x_k) / delta;
-        let t_2 = t * t;
-        let t_3 = t_2 * t;
+        let values = values.as_slice_mut().expect("values array should be contiguous");
+        let mut gradients = gradients.as_mut().map(|gradients| {
+            gradients.as_slice_mut().expect("gradients array should be contiguous")
+        });
 
-        // Hermit base polynomials
-        let h00 = 2.0 * t_3 - 3.0 * t_2 + 1.0;
-        let h10 = t_3 - 2.0 * t_2 + t;
-        let h01 = -2.0 * t_3 + 3.0 * t_2;
-        let h11 = t_3 - t_2;
+        // values (for even `i`) or derivatives (for odd `i`) at point `i / 2`
+        let point_data = |i: usize| &data[(i * size)..((i + 1) * size)];
 
-        let p_k = &point_k.value;
-        let p_k_1 = &point_k_1.value;
+        for (i_distance, &x) in distances.iter().enumerate() {
+            debug_assert!(x < self.parameters.cutoff && x >= 0.0 && x.is_finite());
 
-        let m_k = &point_k.derivative;
-        let m_k_1 = &point_k_1.derivative;
+            let k = points.interval(x);
+            let x_k = points.positions[k];
+            let x_k_1 = points.positions[k + 1];
 
-        azip!((v in values, p_k in p_k, p_k_1 in p_k_1, m_k in m_k, m_k_1 in m_k_1) {
-            *v = h00 * p_k + h10 * delta * m_k + h01 * p_k_1 + h11 * delta * m_k_1;
-        });
+            let p_k = point_data(2 * k);
+            let m_k = point_data(2 * k + 1);
+            let p_k_1 = point_data(2 * k + 2);
+            let m_k_1 = point_data(2 * k + 3);
 
-        if let Some(gradients) = gradients {
-            let d_h00_dt = 6.0 * (t_2 - t);
-            let d_h10_dt = 3.0 * t_2 - 4.0 * t + 1.0;
-            let d_h01_dt = -d_h00_dt;
-            let d_h11_dt = 3.0 * t_2 - 2.0 * t;
+            // same as `hermit_interpolation`, running the inner loop over all
+            // the radial and angular channels
+            let delta = x_k_1 - x_k;
+            let t = (x - x_k) / delta;
+            let t_2 = t * t;
+            let t_3 = t_2 * t;
 
-            let dx_dt = 1.0 / delta;
+            let h00 = 2.0 * t_3 - 3.0 * t_2 + 1.0;
+            let h10_delta = (t_3 - 2.0 * t_2 + t) * delta;
+            let h01 = -2.0 * t_3 + 3.0 * t_2;
+            let h11_delta = (t_3 - t_2) * delta;
 
-            azip!((g in gradients, p_k in p_k, p_k_1 in p_k_1, m_k in m_k, m_k_1 in m_k_1) {
-                *g = d_h00_dt * p_k * dx_dt + d_h10_dt * m_k + d_h01_dt * p_k_1 * dx_dt + d_h11_dt * m_k_1;
-            });
+            let values = &mut values[(i_distance * size)..((i_distance + 1) * size)];
+            for i in 0..size {
+                values[i] = h00 * p_k[i] + h10_delta * m_k[i] + h01 * p_k_1[i] + h11_delta * m_k_1[i];
+            }
+
+            if let Some(ref mut gradients) = gradients {
+                let dx_dt = 1.0 / delta;
+                let d_h00_dx = 6.0 * (t_2 - t) * dx_dt;
+                let d_h10_dt = 3.0 * t_2 - 4.0 * t + 1.0;
+                let d_h01_dx = -d_h00_dx;
+                let d_h11_dt = 3.0 * t_2 - 2.0 * t;
+
+                let gradients = &mut gradients[(i_distance * size)..((i_distance + 1) * size)];
+                for i in 0..size {
+                    gradients[i] = d_h00_dx * p_k[i] + d_h10_dt * m_k[i] + d_h01_dx * p_k_1[i] + d_h11_dt * m_k_1[i];
+                }
+            }
         }
     }
 }
 
+/// Key used to find splines in the global splines cache
+#[derive(Debug, Clone, PartialEq, Eq, Hash)]
+struct SplineCacheKey {
+    /// Description of the radial integral and its parameters
+    description: String,
+    max_radial: usize,
+    max_angular: usize,
+    /// Bits of the cutoff, since `f64` does not implement `Hash`
+    cutoff: u64,
+    /// Bits of the accuracy, since `f64` does not implement `Hash`
+    accuracy: u64,
+}
+
+impl SplineCacheKey {
+    fn new(description: String, parameters: SplinedRIParameters, accuracy: f64) -> SplineCacheKey {
+        SplineCacheKey {
+            description: description,
+            max_radial: parameters.max_radial,
+            max_angular: parameters.max_angular,
+            cutoff: parameters.cutoff.to_bits(),
+            accuracy: accuracy.to_bits(),
+        }
+    }
+}
+
+lazy_static::lazy_static!{
+    /// Control points of all the splines created with
+    /// `SplinedRadialIntegral::with_accuracy_cached` in this process, shared
+    /// between threads and calculators.
+    static ref SPLINES_CACHE: Mutex<HashMap<SplineCacheKey, Arc<SplinePoints>>> = Mutex::new(HashMap::new());
+}
+
+/// Remove all splines from the global splines cache. Splines currently in use
+/// by calculators are not affected.
+pub fn clear_splines_cache() {
+    SPLINES_CACHE.lock().expect("mutex was poisoned").clear();
+}
+
+fn io_error(path: &Path, error: std::io::Error) -> Error {
+    Error::Io(std::io::Error::new(error.kind(), format!(
+        "failed to access splines cache file at '{}': {}", path.display(), error
+    )))
+}
+
+/// Save all the splines in the global splines cache to the file at `path`, to
+/// be loaded in another process with `load_splines_cache`.
+///
+/// The file uses a simple binary format containing the raw control points of
+/// all splines, with all values stored as little-endian.
+pub fn save_splines_cache(path: impl AsRef<Path>) -> Result<(), Error> {
+    let path = path.as_ref();
+    let file = std::fs::File::create(path).map_err(|e| io_error(path, e))?;
+    let mut writer = BufWriter::new(file);
+
+    let write_usize = |writer: &mut BufWriter<std::fs::File>, value: usize| {
+        writer.write_all(&(value as u64).to_le_bytes())
+    };
+
+    let write_f64s = |writer: &mut BufWriter<std::fs::File>, values: &[f64]| -> std::io::Result<()> {
+        for value in values {
+            writer.write_all(&value.to_le_bytes())?;
+        }
+        Ok(())
+    };
+
+    let cache = SPLINES_CACHE.lock().expect("mutex was poisoned");
+    let result = (|| -> std::io::Result<()> {
+        writer.write_all(SPLINES_CACHE_MAGIC)?;
+        write_usize(&mut writer, cache.len())?;
+        for (key, points) in cache.iter() {
+            write_usize(&mut writer, key.description.len())?;
+            writer.write_all(key.description.as_bytes())?;
+            write_usize(&mut writer, key.max_radial)?;
+            write_usize(&mut writer, key.max_angular)?;
+            writer.write_all(&key.cutoff.to_le_bytes())?;
+            writer.write_all(&key.accuracy.to_le_bytes())?;
+
+            write_usize(&mut writer, points.len())?;
+            for (&position, data) in points.positions.iter().zip(points.data.outer_iter()) {
+                write_f64s(&mut writer, &[position])?;
+                // values for this point, followed by the derivatives
+                write_f64s(&mut writer, data.as_slice().expect("spline data should be contiguous"))?;
+            }
+        }
+        writer.flush()
+    })();
+
+    return result.map_err(|e| io_error(path, e));
+}
+
+/// Load splines saved with `save_splines_cache` from the file at `path` into
+/// the global splines cache. Splines already in the cache are kept.
+pub fn load_splines_cache(path: impl AsRef<Path>) -> Result<(), Error> {
+    let path = path.as_ref();
+    let file = std::fs::File::open(path).map_err(|e| io_error(path, e))?;
+    let file_size = file.metadata().map_err(|e| io_error(path, e))?.len();
+    let mut reader = BufReader::new(file);
+
+    let mut magic = [0; 16];
+    reader.read_exact(&mut magic).map_err(|e| io_error(path, e))?;
+    if &magic != SPLINES_CACHE_MAGIC {
+        return Err(Error::InvalidParameter(format!(
+            "'{}' is not a splines cache file, or was created by a different version of rascaline",
+            path.display()
+        )));
+    }
+
+    // number of bytes left to read in the file, used to check the sizes read
+    // from the file before allocating memory for the corresponding data
+    let mut remaining = file_size.saturating_sub(SPLINES_CACHE_MAGIC.len() as u64);
+
+    let read_u64 = |reader: &mut BufReader<std::fs::File>, remaining: &mut u64| -> std::io::Result<u64> {
+        let mut buffer = [0; 8];
+        reader.read_exact(&mut buffer)?;
+        *remaining = remaining.saturating_sub(8);
+        Ok(u64::from_le_bytes(buffer))
+    };
+
+    let invalid_data = |message: &str| std::io::Error::new(std::io::ErrorKind::InvalidData, message);
+
+    // get the size in bytes of `count` elements of `element_size` bytes,
+    // checking that they fit in the remaining part of the file
+    let checked_size = |count: u64, element_size: u64, remaining: u64| -> std::io::Result<usize> {
+        count.checked_mul(element_size)
+            .filter(|&size| size <= remaining)
+            .and_then(|size| usize::try_from(size).ok())
+            .ok_or_else(|| invalid_data("the sizes in this file are larger than the file itself"))
+    };
+
+    let mut splines = Vec::new();
+    let result = (|| -> std::io::Result<()> {
+        let n_splines = read_u64(&mut reader, &mut remaining)?;
+        for _ in 0..n_splines {
+            let description_size = checked_size(read_u64(&mut reader, &mut remaining)?, 1, remaining)?;
+            let mut description = vec![0; description_size];
+            reader.read_exact(&mut description)?;
+            remaining -= description_size as u64;
+            let description = String::from_utf8(description).map_err(|e| {
+                std::io::Error::new(std::io::ErrorKind::InvalidData, e)
+            })?;
+
+            let max_radial = read_u64(&mut reader, &mut remaining)?;
+            let max_angular = read_u64(&mut reader, &mut remaining)?;
+            let key = SplineCacheKey {
+                description: description,
+                max_radial: usize::try_from(max_radial).map_err(|_| invalid_data("max_radial is too large"))?,
+                max_angular: usize::try_from(max_angular).map_err(|_| invalid_data("max_angular is too large"))?,
+                cutoff: read_u64(&mut reader, &mut remaining)?,
+                accuracy: read_u64(&mut reader, &mut remaining)?,
+            };
+
+            // number of values and derivatives for each point, across all
+            // radial and angular channels
+            let point_size = max_angular.checked_add(1)
+                .and_then(|n| n.checked_mul(max_radial))
+                .and_then(|n| n.checked_mul(2))
+                .ok_or_else(|| invalid_data("spline points are too large"))?;
+            // each point is stored as its position followed by the values and
+            // derivatives
+            let point_bytes = point_size.checked_add(1)
+                .and_then(|n| n.checked_mul(8))
+                .ok_or_else(|| invalid_data("spline points are too large"))?;
+
+            let n_points = read_u64(&mut reader, &mut remaining)?;
+            if n_points < 2 {
+                return Err(invalid_data("spline with less than two points"));
+            }
+            // this also ensures that `n_points * point_size` fits in usize
+            checked_size(n_points, point_bytes, remaining)?;
+            let n_points = n_points as usize;
+            let point_size = point_size as usize;
+
+            let mut positions = Vec::with_capacity(n_points);
+            let mut data = Vec::with_capacity(n_points * point_size);
+            for _ in 0..n_points {
+                positions.push(f64::from_bits(read_u64(&mut reader, &mut remaining)?));
+                for _ in 0..point_size {
+                    data.push(f64::from_bits(read_u64(&mut reader, &mut remaining)?));
+                }
+            }
+
+            // check the conditions asserted by `SplinePoints::new`, to return
+            // an error instead of panicking on corrupted files
+            #[allow(clippy::float_cmp)]
+            let valid_start = positions[0] == 0.0;
+            let valid_positions = positions.iter().all(|x| x.is_finite())
+                && positions.windows(2).all(|w| w[0] < w[1]);
+            if !valid_start || !valid_positions {
+                return Err(invalid_data("spline positions must be finite, sorted and start at 0"));
+            }
+
+            let shape = (n_points, 2, key.max_radial, key.max_angular + 1);
+            let data = Array4::from_shape_vec(shape, data).expect("invalid shape");
+            splines.push((key, SplinePoints::new(positions, data)));
+        }
+        Ok(())
+    })();
+    result.map_err(|e| io_error(path, e))?;
+
+    let mut cache = SPLINES_CACHE.lock().expect("mutex was poisoned");
+    for (key, points) in splines {
+        cache.entry(key).or_insert_with(|| Arc::new(points));
+    }
+
+    return Ok(());
+}
+
 #[cfg(test)]
 mod tests {
     use approx::assert_relative_eq;
@@ -292,6 +746,137 @@ mod tests {
         }
     }
 
+    #[test]
+    fn splines_cache() {
+        let parameters = SplinedRIParameters {
+            max_radial: 1,
+            max_angular: 0,
+            cutoff: 6.0,
+        };
+        let description = String::from("FalseRadialIntegral in splines_cache test");
+
+        let first = SplinedRadialIntegral::with_accuracy_cached(
+            parameters, 1e-9, description.clone(), FalseRadialIntegral
+        ).unwrap();
+        let second = SplinedRadialIntegral::with_accuracy_cached(
+            parameters, 1e-9, description.clone(), FalseRadialIntegral
+        ).unwrap();
+        assert!(Arc::ptr_eq(&first.points, &second.points));
+
+        // different accuracy should give a different spline
+        let other = SplinedRadialIntegral::with_accuracy_cached(
+            parameters, 1e-6, description.clone(), FalseRadialIntegral
+        ).unwrap();
+        assert!(!Arc::ptr_eq(&first.points, &other.points));
+
+        let path = std::env::temp_dir().join("rascaline-splines-cache-test.bin");
+        save_splines_cache(&path).unwrap();
+        clear_splines_cache();
+        load_splines_cache(&path).unwrap();
+        std::fs::remove_file(&path).unwrap();
+
+        let loaded = SplinedRadialIntegral::with_accuracy_cached(
+            parameters, 1e-9, description, FalseRadialIntegral
+        ).unwrap();
+        assert!(!Arc::ptr_eq(&first.points, &loaded.points));
+        assert_eq!(first.positions(), loaded.positions());
+        assert_eq!(first.points.data, loaded.points.data);
+    }
+
+    #[test]
+    fn corrupted_splines_cache() {
+        fn push(bytes: &mut Vec<u8>, value: u64) {
+            bytes.extend_from_slice(&value.to_le_bytes());
+        }
+
+        let description = "corrupted spline";
+        let mut bytes = SPLINES_CACHE_MAGIC.to_vec();
+        // number of splines
+        push(&mut bytes, 1);
+        push(&mut bytes, description.len() as u64);
+        bytes.extend_from_slice(description.as_bytes());
+        // max_radial, max_angular, cutoff and accuracy
+        push(&mut bytes, 1);
+        push(&mut bytes, 0);
+        push(&mut bytes, 6.0_f64.to_bits());
+        push(&mut bytes, 1e-9_f64.to_bits());
+        // two points with unsorted positions, each with one value and one
+        // derivative
+        push(&mut bytes, 2);
+        for &position in &[1.0_f64, 0.5] {
+            push(&mut bytes, position.to_bits());
+            push(&mut bytes, 0.0_f64.to_bits());
+            push(&mut bytes, 0.0_f64.to_bits());
+        }
+
+        let path = std::env::temp_dir().join("rascaline-corrupted-splines-cache-test.bin");
+        std::fs::write(&path, bytes).unwrap();
+        let result = load_splines_cache(&path);
+        std::fs::remove_file(&path).unwrap();
+
+        let error = result.unwrap_err();
+        assert!(error.to_string().contains("spline positions must be finite, sorted and start at 0"));
+
+        // sizes larger than the file should give an error instead of trying
+        // to allocate memory for them
+        let mut bytes = SPLINES_CACHE_MAGIC.to_vec();
+        push(&mut bytes, 1);
+        push(&mut bytes, u64::MAX);
+        bytes.extend_from_slice(description.as_bytes());
+
+        std::fs::write(&path, bytes).unwrap();
+        let result = load_splines_cache(&path);
+        std::fs::remove_file(&path).unwrap();
+
+        let error = result.unwrap_err();
+        assert!(error.to_string().contains("the sizes in this file are larger than the file itself"));
+    }
+
+    struct SteepRadialIntegral;
+    impl RadialIntegral for SteepRadialIntegral {
+        fn compute(&self, x: f64, mut values: ArrayViewMut2<f64>, gradients: Option<ArrayViewMut2<f64>>) {
+            values[[0, 0]] = f64::exp(-4.0 * x);
+            if let Some(mut gradients) = gradients {
+                gradients[[0, 0]] = -4.0 * f64::exp(-4.0 * x);
+            }
+        }
+    }
+
+    #[test]
+    fn adaptive_points() {
+        let cutoff = 6.0;
+        let parameters = SplinedRIParameters {
+            max_radial: 1,
+            max_angular: 0,
+            cutoff: cutoff,
+        };
+        let spline = SplinedRadialIntegral::with_accuracy(
+            parameters, 1e-9, SteepRadialIntegral
+        ).unwrap();
+
+        // more points should be used close to 0, where the function is steep
+        let positions = spline.positions();
+        let first_width = positions[1] - positions[0];
+        let last_width = positions[positions.len() - 1] - positions[positions.len() - 2];
+        assert!(first_width < last_width);
+
+        // the lookup table finds the right interval everywhere
+        for i in 0..10_000 {
+            let x = i as f64 * cutoff / 10_000.0;
+            let k = spline.points.interval(x);
+            assert!(positions[k] <= x && x < positions[k + 1]);
+        }
+
+        for &x in &[0.0, 0.01, 0.3, 1.7, 4.2, 5.99999999] {
+            let mut values = Array2::from_elem((1, 1), 0.0);
+            let mut gradients = Array2::from_elem((1, 1), 0.0);
+
+            spline.compute(x, values.view_mut(), Some(gradients.view_mut()));
+            assert_relative_eq!(values[[0, 0]], f64::exp(-4.0 * x), epsilon=1e-8, max_relative=1e-5);
+            assert_relative_eq!(gradients[[0, 0]], -4.0 * f64::exp(-4.0 * x), epsilon=1e-6, max_relative=1e-4);
+        }
+    }
+
     #[test]
     #[should_panic = "got invalid accuracy in spline (-1), it must be positive"]
     fn invalid_accuracy() {
@@ -303,6 +888,38 @@ mod tests {
         SplinedRadialIntegral::with_accuracy(parameters, -1.0, FalseRadialIntegral).unwrap();
     }
 
+    #[test]
+    fn batch() {
+        let parameters = SplinedRIParameters {
+            max_radial: 4,
+            max_angular: 3,
+            cutoff: 5.0,
+        };
+
+        let gto = GtoRadialIntegral::new(GtoParameters {
+            max_radial: parameters.max_radial,
+            max_angular: parameters.max_angular,
+            cutoff: parameters.cutoff,
+            atomic_gaussian_width: 0.5,
+        }).unwrap();
+        let spline = SplinedRadialIntegral::with_accuracy(parameters, 1e-8, gto).unwrap();
+
+        let distances = [0.0, 0.3, 1.7, 2.2, 3.9, 4.99];
+        let shape = (distances.len(), parameters.max_radial, parameters.max_angular + 1);
+        let mut batch_values = ndarray::Array3::from_elem(shape, 0.0);
+        let mut batch_gradients = ndarray::Array3::from_elem(shape, 0.0);
+        spline.compute_batch(&distances, batch_values.view_mut(), Some(batch_gradients.view_mut()));
+
+        let shape = (parameters.max_radial, parameters.max_angular + 1);
+        let mut values = Array2::from_elem(shape, 0.0);
+        let mut gradients = Array2::from_elem(shape, 0.0);
+        for (i, &x) in distances.iter().enumerate() {
+            spline.compute(x, values.view_mut(), Some(gradients.view_mut()));
+            assert_relative_eq!(batch_values.index_axis(Axis(0), i), values, epsilon=1e-14, max_relative=1e-12);
+            assert_relative_eq!(batch_gradients.index_axis(Axis(0), i), gradients, epsilon=1e-14, max_relative=1e-12);
+        }
+    }
+
     #[test]
     fn high_accuracy() {
         // Check that even with high accuracy and large domain MAX_SPLINE_SIZE
@@ -1,21 +1,21 @@
 use std::cell::RefCell;
 
 use rayon::prelude::*;
-use ndarray::{Array1, Array2, Axis};
+use ndarray::{Array2, Array3, ArrayViewMut1, ArrayViewMut2, Axis, s};
 use thread_local::ThreadLocal;
 
-use crossbeam::channel::Sender;
-
 use crate::descriptor::{IndexesBuilder, IndexValue, Indexes, SamplesBuilder, TwoBodiesSpeciesSamples};
+use crate::systems::{CenterPairs, Pair};
 use crate::{Descriptor, Error, System, Vector3D};
-use crate::types::StackVec;
+use crate::metrics::{self, Counter};
+use crate::threads;
 
 use super::super::CalculatorBase;
 use super::RadialIntegral;
 use super::{GtoRadialIntegral, GtoParameters};
 use super::{SplinedRadialIntegral, SplinedRIParameters};
 
-use super::{SphericalHarmonics, SphericalHarmonicsArray};
+use super::{SphericalHarmonics, spherical_harmonics_index};
 
 /// Specialized function to compute (-1)^l. Using this instead of
 /// `f64::powi(-1.0, l as i32)` shaves 10% of the computational time
@@ -45,6 +45,9 @@ pub enum RadialBasis {
     ///
     /// The number of control points in the spline is automatically determined
     /// to ensure the maximal absolute error is close to the requested accuracy.
+    /// Splines are shared between all calculators using the same parameters,
+    /// and can be saved to a file with `soap::save_splines_cache` to skip
+    /// their construction in other processes.
     SplinedGto {
         accuracy: f64,
     },
@@ -69,6 +72,7 @@ impl RadialBasis {
                     atomic_gaussian_width: parameters.atomic_gaussian_width,
                     cutoff: parameters.cutoff,
                 };
+                let description = format!("{:?}", parameters);
                 let gto = GtoRadialIntegral::new(parameters)?;
 
                 let parameters = SplinedRIParameters {
@@ -76,7 +80,9 @@ impl RadialBasis {
                     max_angular: parameters.max_angular,
                     cutoff: parameters.cutoff,
                 };
-                return Ok(Box::new(SplinedRadialIntegral::with_accuracy(parameters, *accuracy, gto)?));
+                return Ok(Box::new(SplinedRadialIntegral::with_accuracy_cached(
+                    parameters, *accuracy, description, gto
+                )?));
             }
         };
     }
@@ -259,19 +265,19 @@ pub struct SphericalExpansionParameters {
 struct RadialIntegralImpl {
     /// Implementation of the radial integral
     code: Box<dyn RadialIntegral>,
-    /// Cache for the radial integral values
-    values: Array2<f64>,
-    /// Cache for the radial integral gradient
-    gradients: Option<Array2<f64>>,
+    /// Cache for the radial integral values, for multiple pairs at once
+    values: Array3<f64>,
+    /// Cache for the radial integral gradient, for multiple pairs at once
+    gradients: Option<Array3<f64>>,
 }
 
 impl RadialIntegralImpl {
     fn new(parameters: &SphericalExpansionParameters) -> Result<Self, Error> {
         let code = parameters.radial_basis.construct(parameters)?;
-        let shape = (parameters.max_radial, parameters.max_angular + 1);
-        let values = Array2::from_elem(shape, 0.0);
+        let shape = (1, parameters.max_radial, parameters.max_angular + 1);
+        let values = Array3::from_elem(shape, 0.0);
         let gradients = if parameters.gradients {
-            Some(Array2::from_elem(shape, 0.0))
+            Some(Array3::from_elem(shape, 0.0))
         } else {
             None
         };
@@ -279,38 +285,54 @@ impl RadialIntegralImpl {
         return Ok(RadialIntegralImpl { code, values, gradients });
     }
 
-    fn compute(&mut self, distance: f64) {
-        self.code.compute(
-            distance,
-            self.values.view_mut(),
-            self.gradients.as_mut().map(|o| o.view_mut()),
-        );
+    /// Make sure the caches can fit data for at least `n_pairs` pairs
+    fn reserve(&mut self, n_pairs: usize) {
+        let shape = self.values.shape();
+        if shape[0] < n_pairs {
+            let shape = (n_pairs, shape[1], shape[2]);
+            self.values = Array3::from_elem(shape, 0.0);
+            if self.gradients.is_some() {
+                self.gradients = Some(Array3::from_elem(shape, 0.0));
+            }
+        }
     }
 
-    fn compute_no_gradients(&mut self, distance: f64) {
-        self.code.compute(distance, self.values.view_mut(), None);
+    /// Compute the radial integral for all the `distances`, and store the
+    /// values (and gradients if `gradients` is true) in the first
+    /// `distances.len()` entries of the caches
+    fn compute(&mut self, distances: &[f64], gradients: bool) {
+        let n_pairs = distances.len();
+        self.reserve(n_pairs);
+
+        let values = self.values.slice_mut(s![..n_pairs, .., ..]);
+        let gradients = if gradients {
+            let gradients = self.gradients.as_mut().expect("missing radial integral gradients cache");
+            Some(gradients.slice_mut(s![..n_pairs, .., ..]))
+        } else {
+            None
+        };
+
+        self.code.compute_batch(distances, values, gradients);
     }
 }
 
 struct SphericalHarmonicsImpl {
     /// Implementation of the spherical harmonics
     code: SphericalHarmonics,
-    /// Cache for the spherical harmonics values
-    values: SphericalHarmonicsArray,
-    /// Cache for the spherical harmonics gradients (one value each for x/y/z)
-    gradients: Option<[SphericalHarmonicsArray; 3]>,
+    /// Cache for the spherical harmonics values, for multiple pairs at once
+    values: Array2<f64>,
+    /// Cache for the spherical harmonics gradients (one value each for x/y/z),
+    /// for multiple pairs at once
+    gradients: Option<Array3<f64>>,
 }
 
 impl SphericalHarmonicsImpl {
     fn new(parameters: &SphericalExpansionParameters) -> SphericalHarmonicsImpl {
         let code = SphericalHarmonics::new(parameters.max_angular);
-        let values = SphericalHarmonicsArray::new(parameters.max_angular);
+        let size = (parameters.max_angular + 1) * (parameters.max_angular + 1);
+        let values = Array2::from_elem((1, size), 0.0);
         let gradients = if parameters.gradients {
-            Some([
-                SphericalHarmonicsArray::new(parameters.max_angular),
-                SphericalHarmonicsArray::new(parameters.max_angular),
-                SphericalHarmonicsArray::new(parameters.max_angular)
-            ])
+            Some(Array3::from_elem((1, 3, size), 0.0))
         } else {
             None
         };
@@ -318,100 +340,135 @@ impl SphericalHarmonicsImpl {
         return SphericalHarmonicsImpl { code, values, gradients };
     }
 
-    fn compute(&mut self, direction: Vector3D) {
-        self.code.compute(
-            direction,
-            &mut self.values,
-            self.gradients.as_mut(),
-        );
+    /// Make sure the caches can fit data for at least `n_pairs` pairs
+    fn reserve(&mut self, n_pairs: usize) {
+        let size = self.values.shape()[1];
+        if self.values.shape()[0] < n_pairs {
+            self.values = Array2::from_elem((n_pairs, size), 0.0);
+            if self.gradients.is_some() {
+                self.gradients = Some(Array3::from_elem((n_pairs, 3, size), 0.0));
+            }
+        }
     }
 
-    fn compute_no_gradients(&mut self, direction: Vector3D) {
-        self.code.compute(direction, &mut self.values, self.gradients.as_mut());
+    /// Compute the spherical harmonics for all the directions with cartesian
+    /// components `x`, `y` and `z`, and store the values (and gradients if
+    /// `gradients` is true) in the first `x.len()` entries of the caches
+    fn compute(&mut self, x: &[f64], y: &[f64], z: &[f64], gradients: bool) {
+        let n_pairs = x.len();
+        self.reserve(n_pairs);
+
+        let values = self.values.slice_mut(s![..n_pairs, ..]);
+        let gradients = if gradients {
+            let gradients = self.gradients.as_mut().expect("missing spherical harmonics gradients cache");
+            Some(gradients.slice_mut(s![..n_pairs, .., ..]))
+        } else {
+            None
+        };
+
+        self.code.compute_batch(x, y, z, values, gradients);
     }
 }
 
-/// Identify which atom in a pair we are referring to
-#[derive(Debug, Clone, Copy, PartialEq, Eq)]
-enum AtomInPair {
-    First,
-    Second,
+/// Pairs contributing to a single sample, stored as separate arrays to be
+/// passed to the batched radial integral and spherical harmonics functions.
+#[derive(Default)]
+struct SamplePairs {
+    /// distance between the center and the neighbor
+    distances: Vec<f64>,
+    /// x, y and z components of the normalized direction of the pair, from
+    /// the first to the second atom
+    directions_x: Vec<f64>,
+    directions_y: Vec<f64>,
+    directions_z: Vec<f64>,
+    /// index of the neighbor atom of the pair
+    neighbors: Vec<usize>,
+    /// whether the center is the first atom in the pair
+    center_is_first: Vec<bool>,
 }
 
-impl Default for AtomInPair {
-    fn default() -> Self {
-        AtomInPair::First
+impl SamplePairs {
+    fn clear(&mut self) {
+        self.distances.clear();
+        self.directions_x.clear();
+        self.directions_y.clear();
+        self.directions_z.clear();
+        self.neighbors.clear();
+        self.center_is_first.clear();
+    }
+
+    fn len(&self) -> usize {
+        self.distances.len()
     }
 }
 
-/// Contribution of a single pair to the spherical expansion. This will be
-/// created in a "compute" thread and send for accumulation in the main values
-/// array to a "writer" thread.
-struct PairContribution {
-    /// A PairContribution can contribute to up to 2 samples.
-    ///
-    /// For each sample, the first element in the tuple is the position in the
-    /// spherical expansion array where we want to accumulate the values (i.e.
-    /// the index of the center); and the second element in the tuple describe
-    /// whether the center is the first or second atom in the pair.
-    ///
-    /// The use of `StackVec` instead of `Vec` or `SmallVec` is a performance
-    /// optimization.
-    samples: StackVec<[(usize, AtomInPair); 2]>,
-    /// pair contribution to the spherical expansion
-    values: Array1<f64>,
+/// Neighbors data for a single system, extracted from the `System` before
+/// starting the parallel section of the calculation. This only contains shared
+/// references, and as such can be sent to other threads.
+struct SystemNeighbors<'a> {
+    /// species of all atoms in the system
+    species: &'a [i32],
+    /// pairs containing each of the atoms in the system, as returned by
+    /// `System::pairs_containing`
+    pairs_by_center: Vec<CenterPairs<'a>>,
+}
+
+/// Rows in the gradient array associated with a single sample
+struct SampleGradients<'a> {
+    /// index of the first row associated with this sample in the full gradient
+    /// array
+    start: usize,
+    /// gradient rows for the current sample
+    gradients: ArrayViewMut2<'a, f64>,
 }
 
-impl PairContribution {
-    /// Create a new pair contribution with the given feature `size`
-    fn new(size: usize) -> PairContribution {
-        PairContribution {
-            samples: StackVec::new(),
-            values: Array1::from_elem(size, 0.0),
+/// Find the range of rows in the gradient array associated with each sample.
+/// The gradient samples for a given sample are expected to be contiguous,
+/// which is the case for gradients samples created by
+/// `TwoBodiesSpeciesSamples` and `ThreeBodiesSpeciesSamples`.
+pub(super) fn gradients_offsets(n_samples: usize, gradients_samples: &Indexes) -> Result<Vec<usize>, Error> {
+    let mut offsets = vec![0; n_samples + 1];
+    let mut previous = 0;
+    for (i_grad, gradient_sample) in gradients_samples.iter().enumerate() {
+        let i_sample = gradient_sample[0].usize();
+        if i_sample < previous || i_sample >= n_samples {
+            return Err(Error::Internal(
+                "gradients samples are not grouped by sample".into()
+            ));
+        }
+
+        for offset in &mut offsets[(previous + 1)..=i_sample] {
+            *offset = i_grad;
         }
+        previous = i_sample;
     }
 
-    /// Add a sample to which this pair contribution should be accumulated into
-    fn add_sample(&mut self, index: usize, center_position_in_pair: AtomInPair) {
-        self.samples.push((index, center_position_in_pair));
+    for offset in &mut offsets[(previous + 1)..] {
+        *offset = gradients_samples.count();
     }
-}
 
-/// Contribution of a single pair to the spherical expansion gradients. This
-/// will be created in a "compute" thread and send for accumulation in the main
-/// values array to a "writer" thread.
-struct GradientsPairContribution {
-    /// A pair can contribute to up to 4 gradients entries.
-    ///
-    /// For each sample, the first element in the tuple is the position in the
-    /// gradient array of the x component of the gradient. The second and third
-    /// elements in the tuple describe whether the center/neighbor atoms are the
-    /// the first or second atom in the pair.
-    ///
-    /// The use of `StackVec` instead of `Vec` or `SmallVec` is a performance
-    /// optimization.
-    samples: StackVec<[(usize, AtomInPair, AtomInPair); 4]>,
-    /// gradient w.r.t. each of the cartesian coordinate
-    gradients: [Array1<f64>; 3],
+    return Ok(offsets);
 }
 
-impl GradientsPairContribution {
-    /// Create a new gradient pair contribution with the given feature `size`
-    fn new(size: usize) -> GradientsPairContribution {
-        GradientsPairContribution {
-            samples: StackVec::new(),
-            gradients: [
-                Array1::from_elem(size, 0.0),
-                Array1::from_elem(size, 0.0),
-                Array1::from_elem(size, 0.0),
-            ],
-        }
+/// Split the gradients array in multiple mutable views, one for each sample,
+/// using the `offsets` computed by `gradients_offsets`.
+fn split_gradients<'a>(gradients: &'a mut Array2<f64>, offsets: &[usize]) -> Vec<SampleGradients<'a>> {
+    let n_features = gradients.shape()[1];
+    let mut remaining = gradients.as_slice_mut().expect("gradients array should be contiguous");
+
+    let mut split = Vec::with_capacity(offsets.len() - 1);
+    for window in offsets.windows(2) {
+        let n_rows = window[1] - window[0];
+        let (current, rest) = std::mem::take(&mut remaining).split_at_mut(n_rows * n_features);
+        remaining = rest;
+
+        split.push(SampleGradients {
+            start: window[0],
+            gradients: ArrayViewMut2::from_shape((n_rows, n_features), current).expect("wrong shape"),
+        });
     }
 
-    /// Add a sample to which this pair contribution should be accumulated into
-    fn add_sample(&mut self, index: usize, center_position_in_pair: AtomInPair, neighbor_position_in_pair: AtomInPair) {
-        self.samples.push((index, center_position_in_pair, neighbor_position_in_pair));
-    }
+    return split;
 }
 
 /// The actual calculator used to compute SOAP spherical expansion coefficients
@@ -420,6 +477,7 @@ pub struct SphericalExpansion {
     parameters: SphericalExpansionParameters,
     radial_integral: ThreadLocal<RefCell<RadialIntegralImpl>>,
     spherical_harmonics: ThreadLocal<RefCell<SphericalHarmonicsImpl>>,
+    pairs: ThreadLocal<RefCell<SamplePairs>>,
 }
 
 impl std::fmt::Debug for SphericalExpansion {
@@ -440,6 +498,7 @@ impl SphericalExpansion {
             parameters,
             radial_integral: ThreadLocal::new(),
             spherical_harmonics: ThreadLocal::new(),
+            pairs: ThreadLocal::new(),
         });
     }
 
@@ -461,81 +520,36 @@ impl SphericalExpansion {
         return cutoff_grad * scaling + cutoff * scaling_grad;
     }
 
-    /// Compute the self contribution to spherical expansion, i.e. the
-    /// contribution of the central atom own density to the expansion around
-    /// itself.
+    /// Compute the spherical expansion (and gradients if requested) for a
+    /// single sample, accumulating data directly in the `values` row and in
+    /// the `gradient` rows associated with this sample.
     ///
-    /// The self contribution does not have contributions to the gradients
-    fn do_self_contributions(&mut self, descriptor: &mut Descriptor) {
-        // we could cache the self contribution since they only depend on the
-        // gaussian atomic width. For now, we recompute them all the time
-
-        let mut radial_integral = self.radial_integral.get_or(|| {
-            let ri = RadialIntegralImpl::new(&self.parameters).expect("invalid parameters");
-            RefCell::new(ri)
-        }).borrow_mut();
-
-        let mut spherical_harmonics = self.spherical_harmonics.get_or(|| {
-            RefCell::new(SphericalHarmonicsImpl::new(&self.parameters))
-        }).borrow_mut();
-
-        for (i_env, requested_env) in descriptor.samples.iter().enumerate() {
-            let species_center = requested_env[2];
-            let species_neighbor = requested_env[3];
-
-            if species_center == species_neighbor {
-                radial_integral.compute_no_gradients(0.0);
-                spherical_harmonics.compute_no_gradients(Vector3D::new(0.0, 0.0, 1.0));
-                let f_scaling = self.scaling_functions(0.0);
-
-                for (feature_i, feature) in descriptor.features.iter().enumerate() {
-                    let l = feature[0].usize();
-                    let m = feature[1].isize();
-                    let n = feature[2].usize();
-
-                    let n_l_m_value = f_scaling
-                        * radial_integral.values[[n, l]]
-                        * spherical_harmonics.values[[l as isize, m]];
-                    descriptor.values[[i_env, feature_i]] += n_l_m_value;
-                }
-            }
-        }
-    }
-
-    /// Accumulate the spherical expansion coefficients for the given pair.
+    /// Since only the thread working on a given sample writes to the
+    /// corresponding rows, this function can run in parallel for different
+    /// samples without any synchronization.
+    ///
+    /// If `dense` is true, `features` must be the full set of features in the
+    /// default order (as returned by `CalculatorBase::features`), and the
+    /// values and gradients are accumulated directly by (l, m) blocks.
     ///
-    /// This function passes results back to calling code though `sender`
-    fn accumulate_for_pair(
+    /// Pairs between an atom and its own periodic image are not handled here,
+    /// see [`SphericalExpansion::accumulate_self_image_pairs`].
+    #[allow(clippy::too_many_arguments, clippy::too_many_lines)]
+    fn compute_for_sample(
         &self,
-        sender: &Sender<PairContribution>,
-        samples: &Indexes,
+        i_sample: usize,
+        sample: &[IndexValue],
+        neighbors: &SystemNeighbors,
         features: &Indexes,
-        pair: &Pair
-    ) -> (Option<usize>, Option<usize>) {
-        let first_sample_i = samples.position(&[
-            IndexValue::from(pair.system),
-            IndexValue::from(pair.first),
-            IndexValue::from(pair.species_first),
-            IndexValue::from(pair.species_second),
-        ]);
-
-        let second_sample_i = if pair.first == pair.second {
-            // do not compute for the reversed pair if the pair is between an
-            // atom and its image
-            None
-        } else {
-            samples.position(&[
-                IndexValue::from(pair.system),
-                IndexValue::from(pair.second),
-                IndexValue::from(pair.species_second),
-                IndexValue::from(pair.species_first),
-            ])
-        };
-
-        if first_sample_i.is_none() && second_sample_i.is_none() {
-            // nothing to do
-            return (None, None);
-        }
+        dense: bool,
+        m_1_pow_l: &[f64],
+        gradients_samples: Option<&Indexes>,
+        mut values: ArrayViewMut1<f64>,
+        mut gradients: Option<SampleGradients>,
+    ) {
+        let center = sample[1].usize();
+        let species_center = sample[2].i32();
+        let species_neighbor = sample[3].i32();
 
         let mut radial_integral = self.radial_integral.get_or(|| {
             let ri = RadialIntegralImpl::new(&self.parameters).expect("invalid parameters");
@@ -546,176 +560,278 @@ impl SphericalExpansion {
             RefCell::new(SphericalHarmonicsImpl::new(&self.parameters))
         }).borrow_mut();
 
-        radial_integral.compute(pair.distance);
-        spherical_harmonics.compute(pair.direction);
-        let f_scaling = self.scaling_functions(pair.distance);
+        // Self contribution, i.e. the contribution of the central atom own
+        // density to the expansion around itself. The self contribution does
+        // not have contributions to the gradients.
+        if species_center == species_neighbor {
+            // we could cache the self contribution since they only depend on
+            // the gaussian atomic width. For now, we recompute them all the
+            // time
+            radial_integral.compute(&[0.0], false);
+            spherical_harmonics.compute(&[0.0], &[0.0], &[1.0], false);
+            let f_scaling = self.scaling_functions(0.0);
 
-        let mut pair_contribution = PairContribution::new(features.count());
-        if let Some(index) = first_sample_i {
-            pair_contribution.add_sample(index, AtomInPair::First);
-        }
+            for (feature_i, feature) in features.iter().enumerate() {
+                let l = feature[0].isize();
+                let m = feature[1].isize();
+                let n = feature[2].usize();
 
-        if let Some(index) = second_sample_i {
-            pair_contribution.add_sample(index, AtomInPair::Second);
+                values[feature_i] += f_scaling
+                    * radial_integral.values[[0, n, l as usize]]
+                    * spherical_harmonics.values[[0, spherical_harmonics_index(l, m)]];
+            }
         }
 
-        for (feature_i, feature) in features.iter().enumerate() {
-            let l = feature[0].usize();
-            let m = feature[1].isize();
-            let n = feature[2].usize();
+        // Collect all the pairs contributing to this sample, to evaluate the
+        // radial integral and spherical harmonics for all of them at once
+        let mut pairs = self.pairs.get_or(Default::default).borrow_mut();
+        pairs.clear();
+        for pair in neighbors.pairs_by_center[center] {
+            if pair.first == pair.second {
+                // pairs between an atom and its image are dealt with separately
+                continue;
+            }
 
-            let n_l_m_value = f_scaling
-                * radial_integral.values[[n, l]]
-                * spherical_harmonics.values[[l as isize, m]];
+            let center_is_first = pair.first == center;
+            let neighbor = if center_is_first { pair.second } else { pair.first };
+            if neighbors.species[neighbor] != species_neighbor {
+                continue;
+            }
 
-            pair_contribution.values[feature_i] = n_l_m_value;
+            // Deal with the possibility that two atoms are at the same
+            // position. While this is not usual, there is no reason to prevent
+            // the calculation of spherical expansion. The user will still get a
+            // warning about atoms being very close together when calculating
+            // the neighbor list.
+            let direction = if pair.distance < 1e-6 {
+                Vector3D::new(0.0, 0.0, 1.0)
+            } else {
+                pair.vector / pair.distance
+            };
+
+            pairs.distances.push(pair.distance);
+            pairs.directions_x.push(direction[0]);
+            pairs.directions_y.push(direction[1]);
+            pairs.directions_z.push(direction[2]);
+            pairs.neighbors.push(neighbor);
+            pairs.center_is_first.push(center_is_first);
         }
 
-        sender.send(pair_contribution).expect("receiver hanged up");
-        return (first_sample_i, second_sample_i);
-    }
-
-    /// Accumulate the spherical expansion gradients for the given pair.
-    ///
-    /// This function assumes that the radial integral and spherical harmonics
-    /// have just been computed for this pair in the current thread.
-    #[allow(clippy::needless_range_loop)]
-    fn accumulate_gradient_for_pair(
-        &self,
-        sender: &Sender<GradientsPairContribution>,
-        gradients_samples: &Indexes,
-        features: &Indexes,
-        pair: &Pair,
-        samples: (Option<usize>, Option<usize>),
-    ) {
-        debug_assert!(self.parameters.gradients);
-
-        // Check if any of the sample corresponding to the current pair
-        // actually contributes to the selected samples, or exit early
-        if samples.0.is_none() && samples.1.is_none() {
+        if pairs.len() == 0 {
             return;
         }
 
-        // get the positions in the gradients array where to store the
-        // contributions to the gradient for this specific pair, if they
-        // exist in the set of requested samples
+        radial_integral.compute(&pairs.distances, gradients.is_some());
+        spherical_harmonics.compute(&pairs.directions_x, &pairs.directions_y, &pairs.directions_z, gradients.is_some());
+
+        // Expansion coefficients are computed for the pair direction, i.e.
+        // from the first to the second atom. When the center is the second
+        // atom in the pair, we use the fact that `se[n, l, m](-r) = (-1)^l
+        // se[n, l, m](r)` where se is the spherical expansion.
+        let max_radial = self.parameters.max_radial;
+        for i_pair in 0..pairs.len() {
+            let f_scaling = self.scaling_functions(pairs.distances[i_pair]);
+            let center_is_first = pairs.center_is_first[i_pair];
+
+            if dense {
+                // all features are requested in the default order, so the
+                // features for a given (l, m) are contiguous, with n varying
+                // the fastest. We can directly iterate over these blocks
+                // instead of going through the features indexes.
+                let values = values.as_slice_mut().expect("values row should be contiguous");
+                let ri_values = radial_integral.values.index_axis(Axis(0), i_pair);
+                let sph_values = spherical_harmonics.values.index_axis(Axis(0), i_pair);
+
+                for l in 0..=self.parameters.max_angular {
+                    let sign = if center_is_first { 1.0 } else { m_1_pow(l) };
+                    let l_isize = l as isize;
+                    for m in -l_isize..=l_isize {
+                        let lm = spherical_harmonics_index(l_isize, m);
+                        let sph_value = sph_values[lm];
+
+                        let values_lm = &mut values[(lm * max_radial)..((lm + 1) * max_radial)];
+                        for (n, value) in values_lm.iter_mut().enumerate() {
+                            *value += sign * (f_scaling * ri_values[[n, l]] * sph_value);
+                        }
+                    }
+                }
+            } else {
+                for (feature_i, feature) in features.iter().enumerate() {
+                    let l = feature[0].isize();
+                    let m = feature[1].isize();
+                    let n = feature[2].usize();
 
-        // store derivative w.r.t. `second` of the environment around `first`
-        let first_grad_i = samples.0.map(|i_sample| {
-            gradients_samples.position(&[
-                IndexValue::from(i_sample), IndexValue::from(pair.second), IndexValue::from(0)
-            ]).expect("this pair should contribute to this gradient")
-        });
+                    let n_l_m_value = f_scaling
+                        * radial_integral.values[[i_pair, n, l as usize]]
+                        * spherical_harmonics.values[[i_pair, spherical_harmonics_index(l, m)]];
 
-        // store derivative w.r.t. `first` of the environment around `first`
-        let first_self_grad_i = samples.0.map(|i_sample| {
-            gradients_samples.position(&[
-                IndexValue::from(i_sample), IndexValue::from(pair.first), IndexValue::from(0)
-            ]).expect("this pair should contribute to this gradient")
-        });
+                    if center_is_first {
+                        values[feature_i] += n_l_m_value;
+                    } else {
+                        values[feature_i] += m_1_pow_l[feature_i] * n_l_m_value;
+                    }
+                }
+            }
+        }
 
-        // store derivative w.r.t. `first` of the environment around `second`
-        let second_grad_i = samples.1.map(|i_sample| {
-            gradients_samples.position(&[
-                IndexValue::from(i_sample), IndexValue::from(pair.first), IndexValue::from(0)
-            ]).expect("this pair should contribute to this gradient")
-        });
-        // store derivative w.r.t. `second` of the environment around `second`
-        let second_self_grad_i = samples.1.map(|i_sample| {
-            gradients_samples.position(&[
-                IndexValue::from(i_sample), IndexValue::from(pair.second), IndexValue::from(0)
-            ]).expect("this pair should contribute to this gradient")
-        });
+        if let Some(ref mut gradients) = gradients {
+            let gradients_samples = gradients_samples.expect("missing gradient samples");
+
+            // position of the gradient w.r.t. the central atom inside the rows
+            // of the current sample
+            let center_grad_i = gradients_samples.position(&[
+                IndexValue::from(i_sample), IndexValue::from(center), IndexValue::from(0)
+            ]).expect("missing gradient w.r.t. the center") - gradients.start;
+
+            let ri_values = &radial_integral.values;
+            let ri_gradients = radial_integral.gradients.as_ref().expect("missing radial integral gradients");
+
+            let sph_values = &spherical_harmonics.values;
+            let sph_gradients = spherical_harmonics.gradients.as_ref().expect("missing spherical harmonics gradients");
+
+            for i_pair in 0..pairs.len() {
+                let distance = pairs.distances[i_pair];
+                let direction = [
+                    pairs.directions_x[i_pair], pairs.directions_y[i_pair], pairs.directions_z[i_pair]
+                ];
+                let center_is_first = pairs.center_is_first[i_pair];
+
+                let neighbor_grad_i = gradients_samples.position(&[
+                    IndexValue::from(i_sample), IndexValue::from(pairs.neighbors[i_pair]), IndexValue::from(0)
+                ]).expect("this pair should contribute to this gradient") - gradients.start;
+
+                let f_scaling = self.scaling_functions(distance);
+                let f_scaling_grad = self.scaling_functions_gradient(distance);
+
+                for spatial in 0..3 {
+                    let dr_d_spatial = direction[spatial];
+
+                    if dense {
+                        let n_features = features.count();
+                        let neighbor_start = (neighbor_grad_i + spatial) * n_features;
+                        let center_start = (center_grad_i + spatial) * n_features;
+                        let gradients = gradients.gradients.as_slice_mut().expect("gradients should be contiguous");
+
+                        let ri_values = ri_values.index_axis(Axis(0), i_pair);
+                        let ri_gradients = ri_gradients.index_axis(Axis(0), i_pair);
+
+                        for l in 0..=self.parameters.max_angular {
+                            let sign = if center_is_first { 1.0 } else { -m_1_pow(l) };
+                            let l_isize = l as isize;
+                            for m in -l_isize..=l_isize {
+                                let lm = spherical_harmonics_index(l_isize, m);
+                                let sph_value = sph_values[[i_pair, lm]];
+                                let sph_grad = sph_gradients[[i_pair, spatial, lm]];
+
+                                let features_start = lm * max_radial;
+                                for n in 0..max_radial {
+                                    let ri_value = ri_values[[n, l]];
+                                    let ri_grad = ri_gradients[[n, l]];
+
+                                    let gradient = f_scaling_grad * dr_d_spatial * ri_value * sph_value
+                                                 + f_scaling * ri_grad * dr_d_spatial * sph_value
+                                                 + f_scaling * ri_value * sph_grad / distance;
+                                    let gradient = sign * gradient;
+
+                                    gradients[neighbor_start + features_start + n] += gradient;
+                                    gradients[center_start + features_start + n] -= gradient;
+                                }
+                            }
+                        }
 
-        debug_assert!(!(
-            first_grad_i.is_none() &&
-            first_self_grad_i.is_none() &&
-            second_grad_i.is_none() &&
-            second_self_grad_i.is_none()
-        ));
+                        continue;
+                    }
 
-        let mut pair_contribution = GradientsPairContribution::new(features.count());
-        if let Some(index) = first_grad_i {
-            pair_contribution.add_sample(index, AtomInPair::First, AtomInPair::Second);
-        }
+                    for (feature_i, feature) in features.iter().enumerate() {
+                        let l = feature[0].isize();
+                        let m = feature[1].isize();
+                        let n = feature[2].usize();
+                        let lm = spherical_harmonics_index(l, m);
 
-        if let Some(index) = first_self_grad_i {
-            pair_contribution.add_sample(index, AtomInPair::First, AtomInPair::First);
-        }
+                        let sph_value = sph_values[[i_pair, lm]];
+                        let sph_grad = sph_gradients[[i_pair, spatial, lm]];
 
-        if let Some(index) = second_grad_i {
-            pair_contribution.add_sample(index, AtomInPair::Second, AtomInPair::First);
-        }
+                        let ri_value = ri_values[[i_pair, n, l as usize]];
+                        let ri_grad = ri_gradients[[i_pair, n, l as usize]];
 
-        if let Some(index) = second_self_grad_i {
-            pair_contribution.add_sample(index, AtomInPair::Second, AtomInPair::Second);
+                        // gradient of the pair contribution w.r.t. the
+                        // position of the second atom in the pair
+                        let gradient = f_scaling_grad * dr_d_spatial * ri_value * sph_value
+                                     + f_scaling * ri_grad * dr_d_spatial * sph_value
+                                     + f_scaling * ri_value * sph_grad / distance;
+
+                        // when the center is the second atom in the pair, use
+                        // the fact that `grad_j se_i[n, l, m](r) = - (-1)^l
+                        // grad_i se_j[n, l, m](r)` where se is the spherical
+                        // expansion.
+                        let gradient = if center_is_first {
+                            gradient
+                        } else {
+                            - m_1_pow_l[feature_i] * gradient
+                        };
+
+                        gradients.gradients[[neighbor_grad_i + spatial, feature_i]] += gradient;
+                        gradients.gradients[[center_grad_i + spatial, feature_i]] -= gradient;
+                    }
+                }
+            }
         }
+    }
 
-        let radial_integral = self.radial_integral.get_or(|| {
+    /// Accumulate the contributions of pairs between an atom and its own
+    /// periodic image to the spherical expansion.
+    ///
+    /// These pairs only contribute to the values, since the gradient w.r.t.
+    /// the neighbor and the gradient w.r.t. the center exactly cancel each
+    /// other.
+    fn accumulate_self_image_pairs(
+        &self,
+        i_system: usize,
+        pairs: &[Pair],
+        species: &[i32],
+        samples: &Indexes,
+        features: &Indexes,
+        values: &mut Array2<f64>,
+    ) {
+        let mut radial_integral = self.radial_integral.get_or(|| {
             let ri = RadialIntegralImpl::new(&self.parameters).expect("invalid parameters");
             RefCell::new(ri)
-        }).borrow();
+        }).borrow_mut();
 
-        let spherical_harmonics = self.spherical_harmonics.get_or(|| {
+        let mut spherical_harmonics = self.spherical_harmonics.get_or(|| {
             RefCell::new(SphericalHarmonicsImpl::new(&self.parameters))
-        }).borrow();
-
-        let ri_values = &radial_integral.values;
-        let ri_gradients = radial_integral.gradients.as_ref().expect("missing radial integral gradients");
+        }).borrow_mut();
 
-        let sph_values = &spherical_harmonics.values;
-        let sph_gradients = spherical_harmonics.gradients.as_ref().expect("missing spherical harmonics gradients");
+        for pair in pairs.iter().filter(|pair| pair.first == pair.second) {
+            let sample_i = samples.position(&[
+                IndexValue::from(i_system),
+                IndexValue::from(pair.first),
+                IndexValue::from(species[pair.first]),
+                IndexValue::from(species[pair.first]),
+            ]);
 
-        let f_scaling = self.scaling_functions(pair.distance);
-        let f_scaling_grad = self.scaling_functions_gradient(pair.distance);
+            let sample_i = match sample_i {
+                Some(sample_i) => sample_i,
+                None => continue,
+            };
 
-        for spatial in 0..3 {
-            let dr_d_spatial = pair.direction[spatial];
-            let sph_gradient = &sph_gradients[spatial];
-            let gradients = &mut pair_contribution.gradients[spatial];
+            radial_integral.compute(&[pair.distance], false);
+            spherical_harmonics.compute(&[pair.vector / pair.distance], false);
+            let f_scaling = self.scaling_functions(pair.distance);
 
             for (feature_i, feature) in features.iter().enumerate() {
-                let l = feature[0].usize();
+                let l = feature[0].isize();
                 let m = feature[1].isize();
                 let n = feature[2].usize();
 
-                let sph_value = sph_values[[l as isize, m]];
-                let sph_grad = sph_gradient[[l as isize, m]];
-
-                let ri_value = ri_values[[n, l]];
-                let ri_grad = ri_gradients[[n, l]];
-
-                gradients[feature_i] = f_scaling_grad * dr_d_spatial * ri_value * sph_value
-                                     + f_scaling * ri_grad * dr_d_spatial * sph_value
-                                     + f_scaling * ri_value * sph_grad / pair.distance;
+                values[[sample_i, feature_i]] += f_scaling
+                    * radial_integral.values[[0, n, l as usize]]
+                    * spherical_harmonics.values[[0, spherical_harmonics_index(l, m)]];
             }
         }
-
-        sender.send(pair_contribution).expect("receiver hanged up");
     }
 }
 
-/// Pair data for spherical expansion, with a bit more data than the system
-/// pairs
-#[derive(Debug, Clone)]
-struct Pair {
-    /// index of the system this pair comes from
-    system: usize,
-    /// index of the first atom of the pair inside the system
-    first: usize,
-    /// index of the second atom of the pair inside the system
-    second: usize,
-    /// species of the first atom of the pair
-    species_first: i32,
-    /// species of the second atom of the pair
-    species_second: i32,
-    /// distance between the first and second atom in the pair
-    distance: f64,
-    /// direction vector (normalized) from the first to the second atom in the
-    /// pair
-    direction: Vector3D,
-}
-
 impl CalculatorBase for SphericalExpansion {
     fn name(&self) -> String {
         "spherical expansion".into()
@@ -751,6 +867,10 @@ impl CalculatorBase for SphericalExpansion {
         self.parameters.gradients
     }
 
+    fn neighbors_cutoff(&self) -> Option<f64> {
+        Some(self.parameters.cutoff)
+    }
+
     fn check_features(&self, indexes: &Indexes) -> Result<(), Error> {
         assert_eq!(indexes.names(), self.features_names());
         for value in indexes {
@@ -783,161 +903,97 @@ impl CalculatorBase for SphericalExpansion {
     }
 
     #[time_graph::instrument(name = "SphericalExpansion::compute")]
-    #[allow(clippy::enum_glob_use)]
     fn compute(&mut self, systems: &mut [Box<dyn System>], descriptor: &mut Descriptor) -> Result<(), Error> {
         assert_eq!(descriptor.samples.names(), &["structure", "center", "species_center", "species_neighbor"]);
         assert_eq!(descriptor.features.names(), &["l", "m", "n"]);
 
-        self.do_self_contributions(descriptor);
-
-        for (i_system, system) in systems.iter_mut().enumerate() {
+        for system in systems.iter_mut() {
             system.compute_neighbors(self.parameters.cutoff)?;
-            let species = system.species()?;
-
-            let pairs = system.pairs()?;
-
-            // Setup parallel computation.
-            //
-            // This code distribute work for computing the spherical expansion
-            // over multiple threads, iterating over pairs in parallel.
-            //
-            // To workaround the fact that each working thread would like to
-            // write data to potentially the same location as other threads
-            // (since two different pairs can produce data to be stored in the
-            // same environment), we use channels to send data two other threads
-            // (one for values, one for gradients) that only receive data and
-            // write it to the descriptor.
-            let samples = &descriptor.samples;
-            let gradient_samples = descriptor.gradients_samples.as_ref();
-            let features = &descriptor.features;
-            let values = &mut descriptor.values;
-            let gradients = descriptor.gradients.as_mut();
-
-            // use crossbeam channels instead of std::sync::mpsc::SyncChannel
-            // since crossbeam is faster in our case.
-            let (sender_values, receiver_values) = crossbeam::channel::unbounded::<PairContribution>();
-            let (sender_grad, receiver_grad) = crossbeam::channel::unbounded::<GradientsPairContribution>();
-
-            // use crossbeam scoped threads instead of rayon's, to ensure we
-            // make progress even with RAYON_NUM_THREADS=1
-            crossbeam::thread::scope(|s|{
-                // re-borrow self as an immutable reference to be passed to
-                // the first closure below
-                let this = &*self;
-
-                // Start a thread to produce values. This thread will start
-                // RAYON_NUM_THREADS more threads, actually doing the work.
-                s.spawn(move |_| {
-                    pairs.par_iter()
-                        .map(|pair| (pair, sender_values.clone(), sender_grad.clone()))
-                        .for_each(|(pair, sender_values, sender_grad)| {
-                            let mut pair = Pair {
-                                system: i_system,
-                                first: pair.first,
-                                second: pair.second,
-                                species_first: species[pair.first],
-                                species_second: species[pair.second],
-                                distance: pair.distance,
-                                direction: pair.vector / pair.distance,
-                            };
-
-                            // Deal with the possibility that two atoms are at
-                            // the same position. While this is not usual, there
-                            // is no reason to prevent the calculation of
-                            // spherical expansion. The user will still get a
-                            // warning about atoms being very close together
-                            // when calculating the neighbor list.
-                            if pair.distance < 1e-6 {
-                                pair.direction = Vector3D::new(0.0, 0.0, 1.0);
-                            }
+        }
 
-                            let samples = this.accumulate_for_pair(
-                                &sender_values,
-                                samples,
-                                features,
-                                &pair
-                            );
-
-                            if this.parameters.gradients {
-                                this.accumulate_gradient_for_pair(
-                                    &sender_grad,
-                                    gradient_samples.expect("missing gradient samples"),
-                                    features,
-                                    &pair,
-                                    samples,
-                                );
-                            }
-                        });
-                });
+        // extract all the data we need from the systems before starting the
+        // parallel section, since `System` is not required to be `Sync`
+        let mut all_neighbors = Vec::with_capacity(systems.len());
+        for system in systems.iter() {
+            let species = system.species()?;
+            let mut pairs_by_center = Vec::with_capacity(species.len());
+            for center in 0..species.len() {
+                let pairs = system.pairs_containing(center)?;
+                metrics::add(Counter::Pairs, pairs.len());
+                pairs_by_center.push(pairs);
+            }
+            all_neighbors.push(SystemNeighbors { species, pairs_by_center });
+        }
 
-                // Start a thread to receive and collect values
-                s.spawn(move |_| {
-                    let m_1_pow_l = features.iter()
-                        .map(|feature| m_1_pow(feature[0].usize()))
-                        .collect::<Array1<f64>>();
-
-                    for contribution in receiver_values {
-                        for &(index, center) in contribution.samples.iter() {
-                            let mut row = values.index_axis_mut(Axis(0), index);
-                            match center {
-                                AtomInPair::First => {
-                                    row += &contribution.values;
-                                }
-                                AtomInPair::Second => {
-                                    // Use the fact that `se[n, l, m](-r) =
-                                    // (-1)^l se[n, l, m](r)` where se is the
-                                    // spherical expansion
-                                    row += &(m_1_pow_l.clone() * &contribution.values);
-                                }
-                            }
-                        }
+        let samples = &descriptor.samples;
+        let features = &descriptor.features;
+        let gradients_samples = descriptor.gradients_samples.as_ref();
+
+        let m_1_pow_l = features.iter()
+            .map(|feature| m_1_pow(feature[0].usize()))
+            .collect::<Vec<f64>>();
+
+        // use a faster code path when computing all features
+        let dense = *features == self.features();
+
+        // Setup parallel computation.
+        //
+        // This code distribute work for computing the spherical expansion over
+        // multiple threads, iterating over samples in parallel. Each thread
+        // only writes to the rows associated with the samples it is working
+        // on, using `System::pairs_containing` to find all the pairs
+        // contributing to a given sample. This means that the radial integral
+        // and spherical harmonics are computed twice for each pair (once for
+        // each atom in the pair), but removes the need to synchronize writes to
+        // the values and gradients arrays.
+        metrics::add(Counter::Samples, samples.count());
+        let gradients = match descriptor.gradients {
+            Some(ref mut gradients) if self.parameters.gradients => {
+                let gradients_samples = gradients_samples.expect("missing gradient samples");
+                metrics::add(Counter::GradientSamples, gradients_samples.count());
+                let offsets = gradients_offsets(samples.count(), gradients_samples)?;
+                split_gradients(gradients, &offsets).into_iter().map(Some).collect()
+            }
+            _ => {
+                (0..samples.count()).map(|_| None).collect::<Vec<_>>()
+            }
+        };
 
-                    }
+        let this = &*self;
+        let values = &mut descriptor.values;
+        let parallel_section = metrics::parallel_section();
+        threads::install(|| {
+            values.axis_iter_mut(Axis(0))
+                .into_par_iter()
+                .zip_eq(gradients.into_par_iter())
+                .enumerate()
+                .for_each(|(i_sample, (values, gradients))| {
+                    let _busy = metrics::busy_timer();
+                    let sample = &samples[i_sample];
+                    this.compute_for_sample(
+                        i_sample,
+                        sample,
+                        &all_neighbors[sample[0].usize()],
+                        features,
+                        dense,
+                        &m_1_pow_l,
+                        gradients_samples,
+                        values,
+                        gradients,
+                    );
                 });
-
-                // Start a thread to receive and collect gradients
-                if self.parameters.gradients {
-                    let gradients = gradients.expect("missing storage for gradients");
-                    s.spawn(move |_| {
-                        use self::AtomInPair::*;
-
-                        let m_1_pow_l = features.iter()
-                            .map(|feature| m_1_pow(feature[0].usize()))
-                            .collect::<Array1<f64>>();
-
-                        for contribution in receiver_grad {
-                            for &(index, center, neighbor) in contribution.samples.iter() {
-                                for spatial in 0..3 {
-                                    let gradient = &contribution.gradients[spatial];
-                                    // we assume that the three spatial
-                                    // components are stored one after the other
-                                    let mut row = gradients.index_axis_mut(Axis(0), index + spatial);
-
-                                    match (center, neighbor) {
-                                        (First, Second) => {
-                                            row += gradient;
-                                        }
-                                        (First, First) => {
-                                            row -= gradient;
-                                        }
-                                        // when storing data for "reversed"
-                                        // gradients, use the fact that `grad_j
-                                        // se_i[n, l, m](r) = - (-1)^l grad_i
-                                        // se_j[n, l, m](r)` where se is the
-                                        // spherical expansion.
-                                        (Second, First) => {
-                                            row -= &(m_1_pow_l.clone() * gradient);
-                                        }
-                                        (Second, Second) => {
-                                            row += &(m_1_pow_l.clone() * gradient);
-                                        }
-                                    }
-                                }
-                            }
-                        }
-                    });
-                }
-            }).expect("one of the thread panicked");
+        });
+        std::mem::drop(parallel_section);
+
+        for (i_system, system) in systems.iter().enumerate() {
+            this.accumulate_self_image_pairs(
+                i_system,
+                system.pairs()?,
+                all_neighbors[i_system].species,
+                samples,
+                features,
+                &mut descriptor.values,
+            );
         }
 
         Ok(())
@@ -948,7 +1004,7 @@ impl CalculatorBase for SphericalExpansion {
 mod tests {
     use crate::systems::test_utils::{test_systems, test_system};
     use crate::descriptor::{IndexValue, IndexesBuilder};
-    use crate::{Descriptor, Calculator};
+    use crate::{Descriptor, Calculator, CalculationOptions, SelectedIndexes};
 
     use super::{SphericalExpansion, SphericalExpansionParameters};
     use super::{CutoffFunction, RadialBasis, RadialScaling};
@@ -1035,6 +1091,44 @@ mod tests {
         );
     }
 
+    #[test]
+    fn dense_and_sparse_features() {
+        let mut calculator = Calculator::from(Box::new(SphericalExpansion::new(
+            parameters(true)
+        ).unwrap()) as Box<dyn CalculatorBase>);
+
+        let mut systems = test_systems(&["water", "methane"]);
+        let mut dense = Descriptor::new();
+        calculator.compute(&mut systems, &mut dense, Default::default()).unwrap();
+
+        // requesting all features in a different order uses the sparse code
+        let mut features = IndexesBuilder::new(vec!["l", "m", "n"]);
+        for feature_i in (0..dense.features.count()).rev() {
+            features.add(&dense.features[feature_i]);
+        }
+        let options = CalculationOptions {
+            selected_features: SelectedIndexes::Subset(features.finish()),
+            ..Default::default()
+        };
+
+        let mut sparse = Descriptor::new();
+        calculator.compute(&mut systems, &mut sparse, options).unwrap();
+
+        let n_features = dense.features.count();
+        for feature_i in 0..n_features {
+            let reversed_i = n_features - 1 - feature_i;
+            assert_eq!(dense.features[feature_i], sparse.features[reversed_i]);
+            assert_eq!(
+                dense.values.column(feature_i),
+                sparse.values.column(reversed_i)
+            );
+            assert_eq!(
+                dense.gradients.as_ref().unwrap().column(feature_i),
+                sparse.gradients.as_ref().unwrap().column(reversed_i)
+            );
+        }
+    }
+
     mod cutoff_function {
         use super::super::CutoffFunction;
 
@@ -3,6 +3,8 @@
 use std::f64;
 use std::f64::consts::SQRT_2;
 
+use ndarray::{ArrayViewMut2, ArrayViewMut3};
+
 use crate::Vector3D;
 
 /// `\sqrt{\frac{1}{4 \pi}}`
@@ -46,7 +48,7 @@ impl LegendreArray {
     fn linear_index(&self, index: [usize; 2]) -> usize {
         let [l, m] = index;
         debug_assert!(l <= self.max_angular && m <= l);
-        return m + l * (l + 1) / 2;
+        return legendre_index(l, m);
     }
 }
 
@@ -118,14 +120,22 @@ impl SphericalHarmonicsArray {
     }
 
     #[inline]
-    #[allow(clippy::suspicious_operation_groupings)]
     fn linear_index(&self, index: [isize; 2]) -> usize {
         let [l, m] = index;
         debug_assert!(l <= self.max_angular && -l <= m && m <= l);
-        return (m + l + (l * l)) as usize;
+        return spherical_harmonics_index(l, m);
     }
 }
 
+/// Get the position of the spherical harmonic with angular indexes `l` and `m`
+/// in the linear storage used by [`SphericalHarmonicsArray`] and by the rows
+/// of the arrays used in [`SphericalHarmonics::compute_batch`].
+#[inline]
+#[allow(clippy::suspicious_operation_groupings)]
+pub fn spherical_harmonics_index(l: isize, m: isize) -> usize {
+    return (m + l + (l * l)) as usize;
+}
+
 impl std::ops::Index<[isize; 2]> for SphericalHarmonicsArray {
     type Output = f64;
     fn index(&self, index: [isize; 2]) -> &f64 {
@@ -182,6 +192,53 @@ pub struct SphericalHarmonics {
     /// coming from `1 / sin(θ)` from the poles to the equator so that we never
     /// have to deal with it.
     legendre_over_theta: LegendreArray,
+    /// Work arrays for `compute_batch`
+    batch: BatchArrays,
+}
+
+/// Work arrays used to compute the spherical harmonics for multiple
+/// directions at once. The data for a given `l, m` is stored contiguously for
+/// all directions, in blocks of size `n_directions` starting at
+/// `legendre_index(l, m) * n_directions`, so the recursions can run over all
+/// directions in the inner loop.
+#[derive(Debug, Clone, Default)]
+struct BatchArrays {
+    cos_theta: Vec<f64>,
+    sin_theta: Vec<f64>,
+    cos_phi: Vec<f64>,
+    sin_phi: Vec<f64>,
+    /// `cos(m ϕ)` and `sin(m ϕ)` for the current and previous value of `m`
+    cos_m_phi: [Vec<f64>; 2],
+    sin_m_phi: [Vec<f64>; 2],
+    /// same as `SphericalHarmonics::legendre_polynomials`
+    legendre_polynomials: Vec<f64>,
+    /// same as `SphericalHarmonics::delta_legendre_polynomials`
+    delta_legendre_polynomials: Vec<f64>,
+    /// same as `SphericalHarmonics::legendre_over_theta`
+    legendre_over_theta: Vec<f64>,
+}
+
+impl BatchArrays {
+    /// Resize all arrays to contain data for `n_directions` directions
+    fn resize(&mut self, max_angular: usize, n_directions: usize) {
+        let n_legendre = (max_angular + 1) * (max_angular + 2) / 2;
+        for array in [&mut self.cos_theta, &mut self.sin_theta, &mut self.cos_phi, &mut self.sin_phi].iter_mut() {
+            array.resize(n_directions, 0.0);
+        }
+        for array in self.cos_m_phi.iter_mut().chain(self.sin_m_phi.iter_mut()) {
+            array.resize(n_directions, 0.0);
+        }
+        for array in [&mut self.legendre_polynomials, &mut self.delta_legendre_polynomials, &mut self.legendre_over_theta].iter_mut() {
+            array.resize(n_legendre * n_directions, 0.0);
+        }
+    }
+}
+
+/// Get the position of the associated Legendre polynomial with indexes `l`
+/// and `m` in the linear storage used by [`LegendreArray`]
+#[inline]
+fn legendre_index(l: usize, m: usize) -> usize {
+    m + l * (l + 1) / 2
 }
 
 impl SphericalHarmonics {
@@ -207,6 +264,7 @@ impl SphericalHarmonics {
             legendre_over_theta: LegendreArray::new(max_angular),
             coefficient_a: coefficient_a,
             coefficient_b: coefficient_b,
+            batch: BatchArrays::default(),
         }
     }
 
@@ -293,12 +351,8 @@ impl SphericalHarmonics {
         &mut self,
         direction: Vector3D,
         values: &mut SphericalHarmonicsArray,
-        mut gradients: Option<&mut [SphericalHarmonicsArray; 3]>
+        gradients: Option<&mut [SphericalHarmonicsArray; 3]>
     ) {
-        assert!(
-            (direction.norm2() - 1.0).abs() < 1e-9,
-            "expected the direction vector to be normalized in spherical harmonics"
-        );
         assert_eq!(
             values.max_angular as usize, self.max_angular,
             "wrong size for the values array, expected max_angular to be {}, got {}",
@@ -314,6 +368,201 @@ impl SphericalHarmonics {
             }
         }
 
+        let gradients = gradients.map(|gradients| {
+            let [gradients_x, gradients_y, gradients_z] = gradients;
+            [&mut *gradients_x.data, &mut *gradients_y.data, &mut *gradients_z.data]
+        });
+
+        self.compute_single(direction, &mut values.data, gradients);
+    }
+
+    /// Evaluate all spherical harmonics for multiple directions at once. The
+    /// directions are given by their cartesian components in `x`, `y` and `z`.
+    ///
+    /// `values` should be a `n_directions x (max_angular + 1)²` array. The
+    /// spherical harmonic with angular indexes `l` and `m` for the direction
+    /// `i` is stored in `values[[i, spherical_harmonics_index(l, m)]]`. If
+    /// `gradients` is `Some`, it should be a `n_directions x 3 x (max_angular
+    /// + 1)²` array, and this function also computes cartesian gradients and
+    /// store them in `gradients`.
+    ///
+    /// This gives the same results as calling [`SphericalHarmonics::compute`]
+    /// for each direction, but runs the recursions for all directions at
+    /// once, with loops over directions that the compiler can vectorize.
+    #[time_graph::instrument(name = "SphericalHarmonics::compute_batch")]
+    pub fn compute_batch(
+        &mut self,
+        x: &[f64],
+        y: &[f64],
+        z: &[f64],
+        mut values: ArrayViewMut2<f64>,
+        mut gradients: Option<ArrayViewMut3<f64>>,
+    ) {
+        let n = x.len();
+        assert!(y.len() == n && z.len() == n, "x, y and z must have the same size");
+
+        let size = (self.max_angular + 1) * (self.max_angular + 1);
+        assert_eq!(
+            values.shape(), [n, size],
+            "wrong shape for the values array, expected [{}, {}]", n, size
+        );
+
+        if let Some(ref gradients) = gradients {
+            assert_eq!(
+                gradients.shape(), [n, 3, size],
+                "wrong shape for the gradients array, expected [{}, 3, {}]", n, size
+            );
+        }
+
+        let max_angular = self.max_angular;
+        self.batch.resize(max_angular, n);
+        let batch = &mut self.batch;
+
+        for i in 0..n {
+            assert!(
+                (x[i] * x[i] + y[i] * y[i] + z[i] * z[i] - 1.0).abs() < 1e-9,
+                "expected the direction vector to be normalized in spherical harmonics"
+            );
+
+            let sqrt_xy = f64::hypot(x[i], y[i]);
+            batch.cos_theta[i] = z[i];
+            batch.sin_theta[i] = sqrt_xy;
+            if sqrt_xy > f64::EPSILON {
+                batch.cos_phi[i] = x[i] / sqrt_xy;
+                batch.sin_phi[i] = y[i] / sqrt_xy;
+            } else {
+                batch.cos_phi[i] = 1.0;
+                batch.sin_phi[i] = 0.0;
+            }
+        }
+
+        batch_legendre_polynomials(max_angular, &self.coefficient_a, &self.coefficient_b, batch);
+        if gradients.is_some() {
+            batch_derivative_factors(max_angular, batch);
+        }
+
+        let values = values.as_slice_mut().expect("values array should be contiguous");
+        let mut gradients = gradients.as_mut().map(|gradients| {
+            gradients.as_slice_mut().expect("gradients array should be contiguous")
+        });
+
+        let cos_theta = &batch.cos_theta;
+        let sin_theta = &batch.sin_theta;
+        let cos_phi = &batch.cos_phi;
+        let sin_phi = &batch.sin_phi;
+        let p = &batch.legendre_polynomials;
+        let block = move |l: usize, m: usize| &p[(legendre_index(l, m) * n)..((legendre_index(l, m) + 1) * n)];
+
+        for l in 0..(max_angular + 1) {
+            // compute values for m = 0 first
+            let lm = spherical_harmonics_index(l as isize, 0);
+            for (i, &p_l0) in block(l, 0).iter().enumerate() {
+                values[i * size + lm] = p_l0 / SQRT_2;
+            }
+        }
+
+        if let Some(ref mut gradients) = gradients {
+            // gradients for m = 0
+            for i in 0..n {
+                gradients[3 * i * size] = 0.0;
+                gradients[(3 * i + 1) * size] = 0.0;
+                gradients[(3 * i + 2) * size] = 0.0;
+            }
+
+            for l in 1..(max_angular + 1) {
+                let lm = spherical_harmonics_index(l as isize, 0);
+                let factor = f64::sqrt(0.5 * (l * (l + 1)) as f64);
+                for (i, &p_l1) in block(l, 1).iter().enumerate() {
+                    let legendre_factor = factor * p_l1;
+                    // see `compute_single` for the expressions of the gradients
+                    gradients[3 * i * size + lm] = cos_phi[i] * cos_theta[i] * legendre_factor;
+                    gradients[(3 * i + 1) * size + lm] = sin_phi[i] * cos_theta[i] * legendre_factor;
+                    gradients[(3 * i + 2) * size + lm] = -sin_theta[i] * legendre_factor;
+                }
+            }
+        }
+
+        // recurrence relation for sin(m ϕ) and cos(m ϕ) for m ≠ 0, see
+        // `compute_single` for more information. Index 0 contains the value
+        // for `m - 1` and index 1 the value for `m - 2`.
+        let [cos_1, cos_2] = &mut batch.cos_m_phi;
+        let [sin_1, sin_2] = &mut batch.sin_m_phi;
+        for i in 0..n {
+            cos_1[i] = 1.0;
+            sin_1[i] = 0.0;
+            cos_2[i] = -cos_phi[i];
+            sin_2[i] = sin_phi[i];
+        }
+
+        for m in 1..(max_angular + 1) {
+            for i in 0..n {
+                let minus_two_cos = -2.0 * cos_phi[i];
+                let sin_m_phi = minus_two_cos * sin_1[i] - sin_2[i];
+                let cos_m_phi = minus_two_cos * cos_1[i] - cos_2[i];
+                sin_2[i] = sin_1[i];
+                sin_1[i] = sin_m_phi;
+                cos_2[i] = cos_1[i];
+                cos_1[i] = cos_m_phi;
+            }
+            let cos_m_phi = &*cos_1;
+            let sin_m_phi = &*sin_1;
+
+            for l in m..(max_angular + 1) {
+                let positive = spherical_harmonics_index(l as isize, m as isize);
+                let negative = spherical_harmonics_index(l as isize, -(m as isize));
+                for (i, &p_lm) in block(l, m).iter().enumerate() {
+                    values[i * size + positive] = p_lm * cos_m_phi[i];
+                    values[i * size + negative] = p_lm * sin_m_phi[i];
+                }
+            }
+
+            if let Some(ref mut gradients) = gradients {
+                let delta_p = &batch.delta_legendre_polynomials;
+                let over_theta = &batch.legendre_over_theta;
+                for l in m..(max_angular + 1) {
+                    let positive = spherical_harmonics_index(l as isize, m as isize);
+                    let negative = spherical_harmonics_index(l as isize, -(m as isize));
+                    let start = legendre_index(l, m) * n;
+                    for i in 0..n {
+                        let delta_p_lm = delta_p[start + i];
+                        let sin_m_phi_delta_p_lm = sin_m_phi[i] * delta_p_lm;
+                        let cos_m_phi_delta_p_lm = cos_m_phi[i] * delta_p_lm;
+                        let p_lm_over_theta = over_theta[start + i];
+
+                        let (cos_theta, sin_theta) = (cos_theta[i], sin_theta[i]);
+                        let (cos_phi, sin_phi) = (cos_phi[i], sin_phi[i]);
+
+                        let gx = 3 * i * size;
+                        gradients[gx + positive] = sin_phi * p_lm_over_theta * sin_m_phi[i] - 0.5 * cos_theta * cos_phi * cos_m_phi_delta_p_lm;
+                        gradients[gx + negative] = -sin_phi * p_lm_over_theta * cos_m_phi[i] - 0.5 * cos_theta * cos_phi * sin_m_phi_delta_p_lm;
+
+                        let gy = gx + size;
+                        gradients[gy + positive] = - cos_phi * p_lm_over_theta * sin_m_phi[i] - 0.5 * cos_theta * sin_phi * cos_m_phi_delta_p_lm;
+                        gradients[gy + negative] = cos_phi * p_lm_over_theta * cos_m_phi[i] - 0.5 * cos_theta * sin_phi * sin_m_phi_delta_p_lm;
+
+                        let gz = gy + size;
+                        gradients[gz + positive] = 0.5 * sin_theta * cos_m_phi_delta_p_lm;
+                        gradients[gz + negative] = 0.5 * sin_theta * sin_m_phi_delta_p_lm;
+                    }
+                }
+            }
+        }
+    }
+
+    /// Evaluate the spherical harmonics for a single `direction`, storing the
+    /// results in `values` and, if they are `Some`, the gradients in
+    /// `gradients`. All arrays use the layout of `spherical_harmonics_index`.
+    fn compute_single(
+        &mut self,
+        direction: Vector3D,
+        values: &mut [f64],
+        mut gradients: Option<[&mut [f64]; 3]>
+    ) {
+        assert!(
+            (direction.norm2() - 1.0).abs() < 1e-9,
+            "expected the direction vector to be normalized in spherical harmonics"
+        );
+
         let sqrt_xy = f64::hypot(direction[0], direction[1]);
         let cos_theta = direction[2];
         let sin_theta = sqrt_xy;
@@ -331,23 +580,23 @@ impl SphericalHarmonics {
 
         for l in 0..(self.max_angular + 1) {
             // compute values for m = 0 first
-            values[[l as isize, 0]] = self.legendre_polynomials[[l, 0]] / SQRT_2;
+            values[spherical_harmonics_index(l as isize, 0)] = self.legendre_polynomials[[l, 0]] / SQRT_2;
         }
 
         if let Some(ref mut gradients) = gradients {
             // gradients for m = 0
-            gradients[0][[0, 0]] = 0.0;
-            gradients[1][[0, 0]] = 0.0;
-            gradients[2][[0, 0]] = 0.0;
+            gradients[0][0] = 0.0;
+            gradients[1][0] = 0.0;
+            gradients[2][0] = 0.0;
             for l in 1..(self.max_angular + 1) {
                 let legendre_factor = f64::sqrt(0.5 * (l * (l + 1)) as f64) * self.legendre_polynomials[[l, 1]];
 
                 // d/dx: cos(ϕ) cos(θ) sqrt(l * (l + 1) / 2) * P_l^1(cos(θ))
-                gradients[0][[l as isize, 0]] = cos_phi * cos_theta * legendre_factor;
+                gradients[0][spherical_harmonics_index(l as isize, 0)] = cos_phi * cos_theta * legendre_factor;
                 // d/dy: sin(ϕ) cos(θ) sqrt(l * (l + 1) / 2) * P_l^1(cos(θ))
-                gradients[1][[l as isize, 0]] = sin_phi * cos_theta * legendre_factor;
+                gradients[1][spherical_harmonics_index(l as isize, 0)] = sin_phi * cos_theta * legendre_factor;
                 // d/dz: -sin(θ) sqrt(l * (l + 1) / 2) * P_l^1(cos(θ))
-                gradients[2][[l as isize, 0]] = -sin_theta * legendre_factor;
+                gradients[2][spherical_harmonics_index(l as isize, 0)] = -sin_theta * legendre_factor;
             }
         }
 
@@ -376,8 +625,8 @@ impl SphericalHarmonics {
 
             for l in m..(self.max_angular + 1) {
                 let p_lm = self.legendre_polynomials[[l, m]];
-                values[[l as isize, m as isize]] = p_lm * cos_m_phi;
-                values[[l as isize, -(m as isize)]] = p_lm * sin_m_phi;
+                values[spherical_harmonics_index(l as isize, m as isize)] = p_lm * cos_m_phi;
+                values[spherical_harmonics_index(l as isize, -(m as isize))] = p_lm * sin_m_phi;
             }
 
             if let Some(ref mut gradients) = gradients {
@@ -393,25 +642,135 @@ impl SphericalHarmonics {
                     let p_lm_over_theta = self.legendre_over_theta[[l, m]];
 
                     // m>0, d/dx: m sin(ϕ) / sin(θ) * sin(m ϕ) P_l^m - cos(θ) cos(ϕ) / 2 * cos(m ϕ) ∆P_l^m
-                    gradients[0][[l as isize, m as isize]] = sin_phi * p_lm_over_theta * sin_m_phi - 0.5 * cos_theta * cos_phi * cos_m_phi_delta_p_lm;
+                    gradients[0][spherical_harmonics_index(l as isize, m as isize)] = sin_phi * p_lm_over_theta * sin_m_phi - 0.5 * cos_theta * cos_phi * cos_m_phi_delta_p_lm;
                     // m<0, d/dx: -m sin(ϕ)/sin(θ) * cos(m ϕ) P_l^m - cos(θ) cos(ϕ) / 2 * sin(m ϕ) ∆P_l^m
-                    gradients[0][[l as isize, -(m as isize)]] = -sin_phi * p_lm_over_theta * cos_m_phi - 0.5 * cos_theta * cos_phi * sin_m_phi_delta_p_lm;
+                    gradients[0][spherical_harmonics_index(l as isize, -(m as isize))] = -sin_phi * p_lm_over_theta * cos_m_phi - 0.5 * cos_theta * cos_phi * sin_m_phi_delta_p_lm;
 
                     // m>0, d/dy: - m cos(ϕ) / sin(θ) * sin(m ϕ) P_l^m - cos(θ) sin(ϕ) / 2 * cos(m ϕ) ∆P_l^m
-                    gradients[1][[l as isize, m as isize]] = - cos_phi * p_lm_over_theta * sin_m_phi - 0.5 * cos_theta * sin_phi * cos_m_phi_delta_p_lm;
+                    gradients[1][spherical_harmonics_index(l as isize, m as isize)] = - cos_phi * p_lm_over_theta * sin_m_phi - 0.5 * cos_theta * sin_phi * cos_m_phi_delta_p_lm;
                     // m<0, d/dy: m cos(ϕ) / sin(θ) * cos(m ϕ) P_l^m - cos(θ) sin(ϕ) / 2 * sin(m ϕ) ∆P_l^m
-                    gradients[1][[l as isize, -(m as isize)]] = cos_phi * p_lm_over_theta * cos_m_phi - 0.5 * cos_theta * sin_phi * sin_m_phi_delta_p_lm;
+                    gradients[1][spherical_harmonics_index(l as isize, -(m as isize))] = cos_phi * p_lm_over_theta * cos_m_phi - 0.5 * cos_theta * sin_phi * sin_m_phi_delta_p_lm;
 
                     // m>0, d/dz: sin(θ) / 2 * cos(m ϕ) ∆P_l^m
-                    gradients[2][[l as isize, m as isize]] = 0.5 * sin_theta * cos_m_phi_delta_p_lm;
+                    gradients[2][spherical_harmonics_index(l as isize, m as isize)] = 0.5 * sin_theta * cos_m_phi_delta_p_lm;
                     // m<0, d/dz: sin(θ) / 2 * sin(m ϕ) ∆P_l^m
-                    gradients[2][[l as isize, -(m as isize)]] = 0.5 * sin_theta * sin_m_phi_delta_p_lm;
+                    gradients[2][spherical_harmonics_index(l as isize, -(m as isize))] = 0.5 * sin_theta * sin_m_phi_delta_p_lm;
                 }
             }
         }
     }
 }
 
+/// Evaluate the Legendre polynomials for all directions in `batch`, using
+/// the same recursion as `SphericalHarmonics::compute_legendre_polynomials`,
+/// and store them in `batch.legendre_polynomials`.
+fn batch_legendre_polynomials(
+    max_angular: usize,
+    coefficient_a: &LegendreArray,
+    coefficient_b: &LegendreArray,
+    batch: &mut BatchArrays,
+) {
+    let n = batch.cos_theta.len();
+    let cos_theta = &batch.cos_theta;
+    let sin_theta = &batch.sin_theta;
+    let p = &mut batch.legendre_polynomials;
+
+    p[..n].iter_mut().for_each(|p| *p = SQRT_1_OVER_4PI);
+    if max_angular == 0 {
+        return;
+    }
+
+    let (previous, current) = p.split_at_mut(legendre_index(1, 0) * n);
+    let p_00 = &previous[..n];
+    let (p_10, p_11) = current.split_at_mut(n);
+    for i in 0..n {
+        p_10[i] = cos_theta[i] * SQRT_3 * p_00[i];
+        p_11[i] = p_00[i] * (-SQRT_3_OVER_2 * sin_theta[i]);
+    }
+
+    for l in 2..(max_angular + 1) {
+        let (previous, current) = p.split_at_mut(legendre_index(l, 0) * n);
+        let previous = &*previous;
+        let previous_block = move |l: usize, m: usize| &previous[(legendre_index(l, m) * n)..((legendre_index(l, m) + 1) * n)];
+
+        for m in 0..(l - 1) {
+            let a = coefficient_a[[l, m]];
+            let b = coefficient_b[[l, m]];
+            let p_lm = &mut current[(m * n)..((m + 1) * n)];
+            let p_l1m = previous_block(l - 1, m);
+            let p_l2m = previous_block(l - 2, m);
+            for (((p, &cos_theta), &p_l1m), &p_l2m) in p_lm.iter_mut().zip(cos_theta).zip(p_l1m).zip(p_l2m) {
+                *p = a * (cos_theta * p_l1m + b * p_l2m);
+            }
+        }
+
+        let factor_l_l1 = f64::sqrt(2.0 * l as f64 + 1.0);
+        let factor_l_l = -f64::sqrt(1.0 + 0.5 / l as f64);
+        let p_l1l1 = previous_block(l - 1, l - 1);
+        let (p_ll1, p_ll) = current[((l - 1) * n)..((l + 1) * n)].split_at_mut(n);
+        for i in 0..n {
+            p_ll1[i] = cos_theta[i] * factor_l_l1 * p_l1l1[i];
+            p_ll[i] = p_l1l1[i] * (factor_l_l * sin_theta[i]);
+        }
+    }
+}
+
+/// Compute the factors required for the derivatives of spherical harmonics,
+/// using the same expressions as `SphericalHarmonics::compute_derivative_factors`
+/// for all the directions in `batch`.
+fn batch_derivative_factors(max_angular: usize, batch: &mut BatchArrays) {
+    let n = batch.cos_theta.len();
+    let cos_theta = &batch.cos_theta;
+    let sin_theta = &batch.sin_theta;
+    let p = &batch.legendre_polynomials;
+    let delta = &mut batch.delta_legendre_polynomials;
+    let over_theta = &mut batch.legendre_over_theta;
+
+    let block = move |l: usize, m: usize| &p[(legendre_index(l, m) * n)..((legendre_index(l, m) + 1) * n)];
+
+    delta[..n].iter_mut().for_each(|d| *d = 0.0);
+    for l in 1..(max_angular + 1) {
+        for m in 0..=l {
+            let factor_minus = f64::sqrt(((l + m) * (l - m + 1)) as f64);
+            let factor_plus = f64::sqrt(((l - m) * (l + m + 1)) as f64);
+            let start = legendre_index(l, m) * n;
+            let delta_lm = &mut delta[start..(start + n)];
+
+            if m == 0 {
+                // from P_l^{−m} = (−1)^m (l − m)!/(l + m)! P_l^m
+                let factor_m_1 = -1.0 / ((l * l + l) as f64);
+                for (d, &p_l1) in delta_lm.iter_mut().zip(block(l, 1)) {
+                    *d = factor_minus * (factor_m_1 * p_l1) - factor_plus * p_l1;
+                }
+            } else if m == l {
+                for (d, &p_lm1) in delta_lm.iter_mut().zip(block(l, m - 1)) {
+                    *d = factor_minus * p_lm1;
+                }
+            } else {
+                for ((d, &p_lm1), &p_lp1) in delta_lm.iter_mut().zip(block(l, m - 1)).zip(block(l, m + 1)) {
+                    *d = factor_minus * p_lm1 - factor_plus * p_lp1;
+                }
+            }
+        }
+    }
+
+    for l in 0..(max_angular + 1) {
+        for m in 0..=l {
+            let start = legendre_index(l, m) * n;
+            let p_lm = &p[start..(start + n)];
+            let delta_lm = &delta[start..(start + n)];
+            let over_theta_lm = &mut over_theta[start..(start + n)];
+            for i in 0..n {
+                over_theta_lm[i] = if sin_theta[i] > 0.1 {
+                    m as f64 / sin_theta[i] * p_lm[i]
+                } else {
+                    -0.5 / cos_theta[i] * delta_lm[i]
+                };
+            }
+        }
+    }
+}
+
 #[cfg(test)]
 mod tests {
     use std::collections::HashSet;
@@ -530,6 +889,56 @@ mod tests {
         }
     }
 
+    #[test]
+    fn batch() {
+        let mut directions = vec![
+            Vector3D::new(1.0, 0.0, 0.0),
+            Vector3D::new(0.0, 0.0, 1.0),
+            Vector3D::new(1.0, -3.0, 9.0),
+            Vector3D::new(-452.0, 825.0, 22.0),
+            // close to the pole, to check both expressions for the gradients
+            Vector3D::new(0.01, 0.02, -1.0),
+        ];
+
+        for d in &mut directions {
+            *d /= d.norm();
+        }
+
+        let x = directions.iter().map(|d| d[0]).collect::<Vec<_>>();
+        let y = directions.iter().map(|d| d[1]).collect::<Vec<_>>();
+        let z = directions.iter().map(|d| d[2]).collect::<Vec<_>>();
+
+        let max_angular = 12;
+        let size = (max_angular + 1) * (max_angular + 1);
+        let mut spherical_harmonics = SphericalHarmonics::new(max_angular);
+
+        let mut batch_values = ndarray::Array2::from_elem((directions.len(), size), 0.0);
+        let mut batch_gradients = ndarray::Array3::from_elem((directions.len(), 3, size), 0.0);
+        spherical_harmonics.compute_batch(&x, &y, &z, batch_values.view_mut(), Some(batch_gradients.view_mut()));
+
+        let mut values = SphericalHarmonicsArray::new(max_angular);
+        let mut gradients = [
+            SphericalHarmonicsArray::new(max_angular),
+            SphericalHarmonicsArray::new(max_angular),
+            SphericalHarmonicsArray::new(max_angular)
+        ];
+        for (i, &direction) in directions.iter().enumerate() {
+            spherical_harmonics.compute(direction, &mut values, Some(&mut gradients));
+            for l in 0..(max_angular as isize + 1) {
+                for m in -l..=l {
+                    let lm = spherical_harmonics_index(l, m);
+                    assert_relative_eq!(batch_values[[i, lm]], values[[l, m]], epsilon=1e-14, max_relative=1e-14);
+                    for spatial in 0..3 {
+                        assert_relative_eq!(
+                            batch_gradients[[i, spatial, lm]], gradients[spatial][[l, m]],
+                            epsilon=1e-14, max_relative=1e-14
+                        );
+                    }
+                }
+            }
+        }
+    }
+
     mod bad {
         use super::super::{SphericalHarmonics, SphericalHarmonicsArray};
         use crate::Vector3D;
@@ -56,6 +56,10 @@ impl CalculatorBase for SortedDistances {
         false
     }
 
+    fn neighbors_cutoff(&self) -> Option<f64> {
+        Some(self.cutoff)
+    }
+
     fn check_features(&self, indexes: &Indexes) -> Result<(), Error> {
         assert_eq!(indexes.names(), self.features_names());
         for value in indexes.iter() {
@@ -2,11 +2,13 @@ use std::collections::{BTreeSet, BTreeMap};
 use indexmap::set::IndexSet;
 
 use itertools::Itertools;
-use ndarray::{Array2, ArrayView2, s};
+use ndarray::{Array2, ArrayView2, ArrayView3, Axis, s};
+use rayon::prelude::*;
 
 use log::warn;
 
 use crate::{Error};
+use crate::metrics::{self, Counter};
 use super::{Indexes, IndexesBuilder, IndexValue};
 
 /// A Descriptor contains the representation of atomistic systems, as computed
@@ -29,6 +31,12 @@ pub struct Descriptor {
     /// Metadata describing the features (i.e. columns) in both the `values` and
     /// `gradients` array
     pub features: Indexes,
+
+    /// Hash of the inputs used by the [`crate::Calculator`] to create the
+    /// indexes above, used to re-use them in the next calculation if the
+    /// inputs did not change. This is reset to `None` whenever the indexes are
+    /// modified.
+    pub(crate) fingerprint: Option<u64>,
 }
 
 impl Default for Descriptor {
@@ -45,6 +53,7 @@ impl Descriptor {
             features: indexes,
             gradients: None,
             gradients_samples: None,
+            fingerprint: None,
         }
     }
 
@@ -148,114 +157,29 @@ impl Descriptor {
             return Ok(DensifiedPositions::new(0));
         }
 
-        // if the user provided them, extract the set of values to use for the
-        // new features.
-        let requested_features = if let Some(requested) = requested.into() {
-            let shape = requested.shape();
-            if shape[1] != variables.len() {
-                return Err(Error::InvalidParameter(format!(
-                    "provided values in Descriptor::densify must match the \
-                    variable size: expected {}, got {}", variables.len(), shape[1]
-                )));
-            }
-
-            let mut features = BTreeSet::new();
-            for value in requested.axis_iter(ndarray::Axis(0)) {
-                features.insert(value.to_vec());
-            }
+        let densified = densify_values_arrays(
+            self.values.view(), &self.samples, &self.features, variables, requested.into()
+        )?;
 
-            Some(features)
-        } else {
-            None
-        };
-
-        let updated_samples = remove_from_samples(&self.samples, variables, requested_features)?;
-        // new features, adding `variables` in the front. This transforms
-        // something like [n, l, m] to [species_neighbor, n, l, m]; and fill it
-        // with the corresponding values from `new_samples.features`,
-        // duplicating the `[n, l, m]` block as needed
-        let mut feature_names = variables.to_vec();
-        feature_names.extend(self.features.names());
-        let mut new_features = IndexesBuilder::new(feature_names);
-        for new in updated_samples.features {
-            for feature in self.features.iter() {
-                let mut new = new.clone();
-                new.extend(feature);
-                new_features.add(&new);
-            }
-        }
-        let new_features = new_features.finish();
-        let new_features_count = new_features.count();
-
-        let feature_block_size = self.features.count();
-        // copy values themselves as needed
-        let mut new_values = Array2::zeros((updated_samples.samples.count(), new_features_count));
-        for (old_sample, new_position) in updated_samples.new_positions.iter().enumerate() {
-            if let Some(new_position) = new_position {
-                let start = feature_block_size * new_position.features_block;
-                let stop = feature_block_size * (new_position.features_block + 1);
-
-                let value = self.values.slice(s![old_sample, ..]);
-                new_values.slice_mut(s![new_position.sample, start..stop]).assign(&value);
-            }
-        }
-
-        self.features = new_features;
-        self.samples = updated_samples.samples;
-        self.values = new_values;
+        // replace the values before densifying the gradients, to release the
+        // memory used by the old values as early as possible
+        self.features = densified.features;
+        self.samples = densified.samples;
+        self.values = densified.values;
+        self.fingerprint = None;
 
         if !do_gradient {
-            return Ok(updated_samples.new_positions);
+            return Ok(densified.new_positions);
         }
 
-        if let Some(ref mut gradients) = self.gradients {
+        if let Some(ref gradients) = self.gradients {
             let gradients_samples = self.gradients_samples.as_ref().expect("missing gradients samples");
-
-            // we need to use indexmap::IndexSet here to get the new positions
-            // of the sample as we go over the old samples
-            let mut new_gradient_samples = IndexSet::new();
-            for gradient_sample in gradients_samples {
-                let sample_i = gradient_sample[0].usize();
-                let atom = gradient_sample[1];
-
-                if let Some(ref position) = updated_samples.new_positions[sample_i] {
-                    new_gradient_samples.insert(
-                        (IndexValue::from(position.sample), atom)
-                    );
-                }
-            }
-
-            let mut new_gradients = Array2::zeros(
-                (3 * new_gradient_samples.len(), new_features_count)
+            let (new_gradients, new_gradients_samples) = densify_gradients_arrays(
+                gradients.view(), gradients_samples, &densified.new_positions, densified.n_blocks
             );
 
-            for (old_grad_sample_i, gradient_sample) in gradients_samples.iter().enumerate() {
-                let sample = gradient_sample[0].usize();
-                let atom = gradient_sample[1];
-                let spatial = gradient_sample[2].usize();
-
-                if let Some(ref position) = updated_samples.new_positions[sample] {
-                    let new_grad_sample_i = new_gradient_samples.get_index_of(
-                        &(IndexValue::from(position.sample), atom)
-                    ).expect("missing entry in new gradient samples");
-                    let new_grad_position = 3 * new_grad_sample_i + spatial;
-
-                    let start = feature_block_size * position.features_block;
-                    let stop = feature_block_size * (position.features_block + 1);
-
-                    let value = gradients.slice(s![old_grad_sample_i, ..]);
-                    new_gradients.slice_mut(s![new_grad_position, start..stop]).assign(&value);
-                }
-            }
-
-            let mut builder = IndexesBuilder::new(vec!["sample", "atom", "spatial"]);
-            for (sample, atom) in new_gradient_samples {
-                builder.add(&[sample, atom, IndexValue::from(0)]);
-                builder.add(&[sample, atom, IndexValue::from(1)]);
-                builder.add(&[sample, atom, IndexValue::from(2)]);
-            }
-            self.gradients_samples = Some(builder.finish());
             self.gradients = Some(new_gradients);
+            self.gradients_samples = Some(new_gradients_samples);
         }
 
         return Ok(DensifiedPositions::new(0));
@@ -269,6 +193,7 @@ impl Descriptor {
     pub fn prepare(&mut self, samples: Indexes, features: Indexes) {
         self.samples = samples;
         self.features = features;
+        self.fingerprint = None;
 
         // resize the 'values' array if needed, and set the requested initial value
         let shape = (self.samples.count(), self.features.count());
@@ -276,6 +201,8 @@ impl Descriptor {
 
         self.gradients = None;
         self.gradients_samples = None;
+
+        record_prepare_metrics(&self.values, &[&self.samples, &self.features]);
     }
 
     /// Initialize this descriptor with the given `samples`, `gradients_samples`
@@ -294,6 +221,7 @@ impl Descriptor {
 
         self.samples = samples;
         self.features = features;
+        self.fingerprint = None;
 
         // resize the 'values' array if needed, and set the requested initial value
         let shape = (self.samples.count(), self.features.count());
@@ -310,6 +238,119 @@ impl Descriptor {
             let array = Array2::from_elem(gradient_shape, 0.0);
             self.gradients = Some(array);
         }
+
+        let gradients_samples = self.gradients_samples.as_ref().expect("missing gradients samples");
+        record_prepare_metrics(&self.values, &[&self.samples, &self.features, gradients_samples]);
+        if let Some(ref gradients) = self.gradients {
+            record_prepare_metrics(gradients, &[]);
+        }
+    }
+
+    /// Get a block-sparse view of the gradients in this descriptor, or `None`
+    /// if this descriptor does not contain gradients.
+    ///
+    /// The gradients array only contains rows for the atoms that contribute to
+    /// a given sample, with three consecutive rows (x/y/z) for each pair of
+    /// sample and atom. This function exposes this structure as a list of
+    /// 3 x features blocks for each sample, without copying the gradients.
+    ///
+    /// # Errors
+    ///
+    /// This function returns an error if the gradients samples are not grouped
+    /// by sample, or do not contain the three spatial directions for each
+    /// atom, which can happen after calling [`Descriptor::densify`].
+    #[time_graph::instrument(name="Descriptor::gradients_blocks")]
+    pub fn gradients_blocks(&self) -> Result<Option<GradientsBlocks<'_>>, Error> {
+        let (gradients, gradients_samples) = match (&self.gradients, &self.gradients_samples) {
+            (Some(gradients), Some(gradients_samples)) => (gradients, gradients_samples),
+            _ => return Ok(None),
+        };
+
+        if gradients_samples.count() % 3 != 0 {
+            return Err(Error::InvalidParameter(
+                "gradients samples must contain x/y/z rows for all atoms to create gradients blocks".into()
+            ));
+        }
+
+        let n_samples = self.samples.count();
+        let n_blocks = gradients_samples.count() / 3;
+
+        let mut offsets = vec![0; n_samples + 1];
+        let mut atoms = Vec::with_capacity(n_blocks);
+        let mut previous_sample = 0;
+        for block in 0..n_blocks {
+            let first = &gradients_samples[3 * block];
+            let sample = first[0].usize();
+            let atom = first[1];
+
+            for spatial in 0..3 {
+                let row = &gradients_samples[3 * block + spatial];
+                if row[0].usize() != sample || row[1] != atom || row[2].usize() != spatial {
+                    return Err(Error::InvalidParameter(
+                        "gradients samples must contain x/y/z rows for all atoms to create gradients blocks".into()
+                    ));
+                }
+            }
+
+            if sample < previous_sample || sample >= n_samples {
+                return Err(Error::InvalidParameter(
+                    "gradients samples must be grouped by sample to create gradients blocks".into()
+                ));
+            }
+            previous_sample = sample;
+
+            offsets[sample + 1] += 1;
+            atoms.push(atom.i32());
+        }
+
+        for i in 0..n_samples {
+            offsets[i + 1] += offsets[i];
+        }
+
+        let values = gradients.view()
+            .into_shape((n_blocks, 3, self.features.count()))
+            .map_err(|_| Error::Internal("gradients array is not contiguous".into()))?;
+
+        return Ok(Some(GradientsBlocks {
+            offsets: offsets,
+            atoms: atoms,
+            values: values,
+        }));
+    }
+
+    /// Check if the `values` and `gradients` arrays still have the shape
+    /// given by the current samples, gradients samples and features.
+    pub(crate) fn has_consistent_shape(&self) -> bool {
+        if self.values.dim() != (self.samples.count(), self.features.count()) {
+            return false;
+        }
+
+        match (&self.gradients, &self.gradients_samples) {
+            (Some(gradients), Some(gradients_samples)) => {
+                gradients.dim() == (gradients_samples.count(), self.features.count())
+            }
+            (None, None) => true,
+            _ => false,
+        }
+    }
+
+    /// Set the `values` and `gradients` arrays to zero, keeping the existing
+    /// indexes and memory allocations.
+    pub(crate) fn reset(&mut self) {
+        self.values.fill(0.0);
+        if let Some(gradients) = &mut self.gradients {
+            gradients.fill(0.0);
+        }
+    }
+}
+
+/// Record the memory used by a descriptor `array` and the corresponding
+/// `indexes` in the profiling metrics
+fn record_prepare_metrics(array: &Array2<f64>, indexes: &[&Indexes]) {
+    metrics::add(Counter::DescriptorBytes, array.len() * std::mem::size_of::<f64>());
+    for indexes in indexes {
+        let size = indexes.count() * indexes.size() * std::mem::size_of::<IndexValue>();
+        metrics::add(Counter::IndexesBytes, size);
     }
 }
 
@@ -326,6 +367,24 @@ fn resize_and_reset(array: &mut Array2<f64>, shape: (usize, usize)) {
     let _replaced = std::mem::replace(array, values);
 }
 
+/// Block-sparse view of the gradients in a [`Descriptor`], created with
+/// [`Descriptor::gradients_blocks`].
+///
+/// The gradients of sample `i` are stored in the blocks
+/// `offsets[i]..offsets[i + 1]`, each block containing the gradients with
+/// respect to the positions of `atoms[block]`.
+#[derive(Debug, Clone)]
+pub struct GradientsBlocks<'a> {
+    /// Offset of the first block for each sample, with one additional entry
+    /// at the end containing the total number of blocks
+    pub offsets: Vec<usize>,
+    /// Atom with respect to which the gradients are computed, for each block
+    pub atoms: Vec<i32>,
+    /// Gradients for all the blocks, as an array of shape `(blocks, 3,
+    /// features)`
+    pub values: ArrayView3<'a, f64>,
+}
+
 /// A `DensifiedPosition` contains all the information to reconstruct the new
 /// position of the values/gradients associated with a single sample in the
 /// initial descriptor
@@ -380,6 +439,177 @@ struct RemovedSamples {
     new_positions: DensifiedPositions
 }
 
+/// Result of `densify_values_arrays`
+pub(super) struct DensifiedValues {
+    pub(super) samples: Indexes,
+    pub(super) features: Indexes,
+    pub(super) values: Array2<f64>,
+    pub(super) new_positions: DensifiedPositions,
+    /// number of feature blocks in the new features
+    pub(super) n_blocks: usize,
+}
+
+/// Marker for missing blocks in the tables used by `copy_blocks`
+const MISSING_BLOCK: usize = usize::MAX;
+
+/// Implementation of densification for the values, working on borrowed arrays
+/// & indexes. This is shared between `Descriptor` and `MappedDescriptor`, and
+/// creates a new array without modifying the existing one. `features.size()`
+/// must not be zero and `variables` must not be empty.
+pub(super) fn densify_values_arrays<'a>(
+    values: ArrayView2<'_, f64>,
+    samples: &Indexes,
+    features: &Indexes,
+    variables: &[&str],
+    requested: Option<ArrayView2<'a, IndexValue>>,
+) -> Result<DensifiedValues, Error> {
+    debug_assert!(!variables.is_empty() && features.size() != 0);
+
+    // if the user provided them, extract the set of values to use for the
+    // new features.
+    let requested_features = if let Some(requested) = requested {
+        let shape = requested.shape();
+        if shape[1] != variables.len() {
+            return Err(Error::InvalidParameter(format!(
+                "provided values in Descriptor::densify must match the \
+                variable size: expected {}, got {}", variables.len(), shape[1]
+            )));
+        }
+
+        let mut features = BTreeSet::new();
+        for value in requested.axis_iter(ndarray::Axis(0)) {
+            features.insert(value.to_vec());
+        }
+
+        Some(features)
+    } else {
+        None
+    };
+
+    let updated_samples = remove_from_samples(samples, variables, requested_features)?;
+    let n_blocks = updated_samples.features.len();
+    // new features, adding `variables` in the front. This transforms
+    // something like [n, l, m] to [species_neighbor, n, l, m]; and fill it
+    // with the corresponding values from `new_samples.features`,
+    // duplicating the `[n, l, m]` block as needed
+    let mut feature_names = variables.to_vec();
+    feature_names.extend(features.names());
+    let mut new_features = IndexesBuilder::new(feature_names);
+    for new in updated_samples.features {
+        for feature in features.iter() {
+            let mut new = new.clone();
+            new.extend(feature);
+            new_features.add(&new);
+        }
+    }
+    let new_features = new_features.finish();
+
+    // find where each block of the new values comes from
+    let new_samples_count = updated_samples.samples.count();
+    let mut sources = vec![MISSING_BLOCK; new_samples_count * n_blocks];
+    for (old_sample, new_position) in updated_samples.new_positions.iter().enumerate() {
+        if let Some(new_position) = new_position {
+            sources[new_position.sample * n_blocks + new_position.features_block] = old_sample;
+        }
+    }
+
+    let mut new_values = Array2::zeros((new_samples_count, new_features.count()));
+    copy_blocks(values, &mut new_values, &sources, n_blocks);
+
+    return Ok(DensifiedValues {
+        samples: updated_samples.samples,
+        features: new_features,
+        values: new_values,
+        new_positions: updated_samples.new_positions,
+        n_blocks: n_blocks,
+    });
+}
+
+/// Implementation of densification for the gradients, using the
+/// `new_positions` of the samples created by `densify_values_arrays`. This
+/// returns the new gradients array and gradients samples.
+pub(super) fn densify_gradients_arrays(
+    gradients: ArrayView2<'_, f64>,
+    gradients_samples: &Indexes,
+    new_positions: &DensifiedPositions,
+    n_blocks: usize,
+) -> (Array2<f64>, Indexes) {
+    // we need to use indexmap::IndexSet here to get the new positions
+    // of the sample as we go over the old samples
+    let mut new_gradient_samples = IndexSet::new();
+    for gradient_sample in gradients_samples {
+        let sample_i = gradient_sample[0].usize();
+        let atom = gradient_sample[1];
+
+        if let Some(ref position) = new_positions[sample_i] {
+            new_gradient_samples.insert(
+                (IndexValue::from(position.sample), atom)
+            );
+        }
+    }
+
+    // find where each block of the new gradients comes from
+    let new_gradients_count = 3 * new_gradient_samples.len();
+    let mut sources = vec![MISSING_BLOCK; new_gradients_count * n_blocks];
+    for (old_grad_sample_i, gradient_sample) in gradients_samples.iter().enumerate() {
+        let sample = gradient_sample[0].usize();
+        let atom = gradient_sample[1];
+        let spatial = gradient_sample[2].usize();
+
+        if let Some(ref position) = new_positions[sample] {
+            let new_grad_sample_i = new_gradient_samples.get_index_of(
+                &(IndexValue::from(position.sample), atom)
+            ).expect("missing entry in new gradient samples");
+            let new_grad_position = 3 * new_grad_sample_i + spatial;
+
+            sources[new_grad_position * n_blocks + position.features_block] = old_grad_sample_i;
+        }
+    }
+
+    let mut new_gradients = Array2::zeros((new_gradients_count, n_blocks * gradients.shape()[1]));
+    copy_blocks(gradients, &mut new_gradients, &sources, n_blocks);
+
+    let mut builder = IndexesBuilder::new(vec!["sample", "atom", "spatial"]);
+    for (sample, atom) in new_gradient_samples {
+        builder.add(&[sample, atom, IndexValue::from(0)]);
+        builder.add(&[sample, atom, IndexValue::from(1)]);
+        builder.add(&[sample, atom, IndexValue::from(2)]);
+    }
+
+    return (new_gradients, builder.finish());
+}
+
+/// Copy rows from `source` into blocks of `destination`, in parallel over the
+/// rows of `destination`. Each row of `destination` is made of `n_blocks`
+/// blocks with the same size as a row of `source`; and block `b` of row `i`
+/// is a copy of row `sources[i * n_blocks + b]` of `source`, or is left
+/// untouched if this is `MISSING_BLOCK`.
+fn copy_blocks(source: ArrayView2<'_, f64>, destination: &mut Array2<f64>, sources: &[usize], n_blocks: usize) {
+    let block_size = source.shape()[1];
+    debug_assert_eq!(destination.shape()[1], n_blocks * block_size);
+    debug_assert_eq!(sources.len(), destination.shape()[0] * n_blocks);
+    if n_blocks == 0 || block_size == 0 {
+        return;
+    }
+
+    crate::threads::install(|| {
+        destination.axis_iter_mut(Axis(0))
+            .into_par_iter()
+            .zip_eq(sources.par_chunks_exact(n_blocks))
+            .for_each(|(mut row, row_sources)| {
+                for (block, &old_row) in row_sources.iter().enumerate() {
+                    if old_row == MISSING_BLOCK {
+                        continue;
+                    }
+
+                    let start = block_size * block;
+                    let stop = block_size * (block + 1);
+                    row.slice_mut(s![start..stop]).assign(&source.row(old_row));
+                }
+            });
+    });
+}
+
 /// Remove the given `variables` from the `samples`, returning the updated
 /// `samples`, the set of all the values taken by the removed variables, and the
 /// mapping from the old position to the new position in the corresponding
@@ -406,12 +636,15 @@ fn remove_from_samples(
     // along the first index, we want to convert [[2, 3, 0], [1, 3, 0]]
     // to [[3, 0]].
     let mut new_features = BTreeSet::new();
+    // re-use the same allocation for all samples, and only copy it when
+    // finding a new feature
+    let mut new_feature = Vec::with_capacity(variables_positions.len());
     for sample in samples.iter() {
-        let mut new_feature = Vec::new();
-        for &i in &variables_positions {
-            new_feature.push(sample[i]);
+        new_feature.clear();
+        new_feature.extend(variables_positions.iter().map(|&i| sample[i]));
+        if !new_features.contains(&new_feature) {
+            new_features.insert(new_feature.clone());
         }
-        new_features.insert(new_feature);
     }
 
     // deal with the user requesting a specific set of the features
@@ -445,11 +678,10 @@ fn remove_from_samples(
     // we need to use indexmap::IndexSet here to get the new positions of the
     // sample as we go over the old samples
     let mut new_samples = IndexSet::new();
+    let mut new_sample = Vec::with_capacity(samples.size().saturating_sub(variables_positions.len()));
     for (old_sample_i, sample) in samples.iter().enumerate() {
-        let mut new_feature = Vec::new();
-        for &i in &variables_positions {
-            new_feature.push(sample[i]);
-        }
+        new_feature.clear();
+        new_feature.extend(variables_positions.iter().map(|&i| sample[i]));
 
         let features_block = if let Some(i) = features_blocks.get(&new_feature) {
             *i
@@ -459,13 +691,17 @@ fn remove_from_samples(
             continue;
         };
 
-        let mut new_sample = sample.to_vec();
-        // reverse the indexes to ensure the all the calls to `remove` are valid.
-        // this works because variables_positions is sorted by construction
-        for &i in variables_positions.iter().rev() {
-            new_sample.remove(i);
-        }
-        let (new_sample_i, _) = new_samples.insert_full(new_sample);
+        new_sample.clear();
+        new_sample.extend(sample.iter().enumerate()
+            .filter(|(i, _)| !variables_positions.contains(i))
+            .map(|(_, &value)| value)
+        );
+
+        let new_sample_i = if let Some(i) = new_samples.get_index_of(&new_sample) {
+            i
+        } else {
+            new_samples.insert_full(new_sample.clone()).0
+        };
 
         new_positions[old_sample_i] = Some(DensifiedPosition {
             sample: new_sample_i,
@@ -545,6 +781,32 @@ mod tests {
         assert_eq!(gradients.shape(), [gradients_samples.count(), descriptor.features.count()]);
     }
 
+    #[test]
+    fn gradients_blocks() {
+        let mut descriptor = Descriptor::new();
+        assert!(descriptor.gradients_blocks().unwrap().is_none());
+
+        let mut systems = test_systems(&["water"]);
+        let features = dummy_features();
+        let (samples, gradients) = TwoBodiesSpeciesSamples::new(3.0).with_gradients(&mut systems).unwrap();
+        descriptor.prepare_gradients(samples, gradients.unwrap(), features);
+
+        let gradients = descriptor.gradients.as_mut().unwrap();
+        for (i, mut row) in gradients.outer_iter_mut().enumerate() {
+            row.fill(i as f64);
+        }
+
+        let blocks = descriptor.gradients_blocks().unwrap().unwrap();
+        assert_eq!(blocks.offsets, [0, 3, 5, 7, 9, 11]);
+        assert_eq!(blocks.atoms, [0, 1, 2, 1, 2, 0, 1, 1, 2, 0, 2]);
+        assert_eq!(blocks.values.shape(), [11, 3, 3]);
+        for block in 0..11 {
+            for spatial in 0..3 {
+                assert_eq!(blocks.values[[block, spatial, 1]], (3 * block + spatial) as f64);
+            }
+        }
+    }
+
     #[test]
     fn densify() {
         let mut descriptor = Descriptor::new();
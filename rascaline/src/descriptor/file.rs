@@ -0,0 +1,597 @@
+use std::convert::TryFrom;
+use std::collections::BTreeSet;
+use std::fs::File;
+use std::io::{BufWriter, Write};
+use std::path::Path;
+
+use ndarray::{Array2, ArrayView2};
+
+use crate::{Calculator, Error};
+use super::{Descriptor, Indexes, IndexesBuilder, IndexValue, is_valid_index_name};
+use super::descriptor::{densify_values_arrays, densify_gradients_arrays};
+
+/// Magic bytes at the start of all descriptor files
+const MAGIC: &[u8; 8] = b"RASCALDS";
+/// Current version of the file format
+const VERSION: u64 = 1;
+
+// The file format is made of the following sections, with all integers and
+// floating point values stored as little-endian:
+//
+// - the magic bytes `RASCALDS` and the format version as an u64;
+// - the calculator name and parameters, as strings;
+// - the samples and features indexes;
+// - an u64 set to 1 if the file contains gradients and 0 otherwise, followed
+//   by the gradients samples if there are gradients;
+// - the values array, followed by the gradients array if there are gradients.
+//
+// Strings are stored as their length in bytes (u64) followed by the UTF-8
+// data. Indexes are stored as their size and count (u64), followed by `size`
+// strings for the names and `count x size` i32 for the values. Arrays are
+// stored as their shape (two u64) followed by the row-major f64 data, and
+// always start at an offset multiple of 8 bytes (using zero padding) to be
+// correctly aligned when memory-mapped.
+
+impl Descriptor {
+    /// Save this descriptor to the file at `path`, in rascaline's own binary
+    /// format. The name and parameters of the `calculator` used to create this
+    /// descriptor are stored alongside the values, gradients and indexes.
+    ///
+    /// The file can then be opened with [`MappedDescriptor::open`].
+    #[time_graph::instrument(name="Descriptor::save")]
+    pub fn save(&self, path: impl AsRef<Path>, calculator: &Calculator) -> Result<(), Error> {
+        let file = File::create(path)?;
+        let mut writer = CountingWriter {
+            inner: BufWriter::new(file),
+            written: 0,
+        };
+
+        writer.bytes(MAGIC)?;
+        writer.u64(VERSION)?;
+
+        writer.string(&calculator.name())?;
+        writer.string(calculator.parameters())?;
+
+        writer.indexes(&self.samples)?;
+        writer.indexes(&self.features)?;
+        if let Some(ref gradients_samples) = self.gradients_samples {
+            writer.u64(1)?;
+            writer.indexes(gradients_samples)?;
+        } else {
+            writer.u64(0)?;
+        }
+
+        writer.array(&self.values)?;
+        if let Some(ref gradients) = self.gradients {
+            writer.array(gradients)?;
+        }
+
+        writer.inner.flush()?;
+        return Ok(());
+    }
+}
+
+/// `Write` wrapper keeping track of the number of bytes written, to be able to
+/// align arrays in the file
+struct CountingWriter<W: Write> {
+    inner: W,
+    written: usize,
+}
+
+impl<W: Write> CountingWriter<W> {
+    fn bytes(&mut self, data: &[u8]) -> std::io::Result<()> {
+        self.inner.write_all(data)?;
+        self.written += data.len();
+        Ok(())
+    }
+
+    fn u64(&mut self, value: u64) -> std::io::Result<()> {
+        self.bytes(&value.to_le_bytes())
+    }
+
+    fn string(&mut self, value: &str) -> std::io::Result<()> {
+        self.u64(value.len() as u64)?;
+        self.bytes(value.as_bytes())
+    }
+
+    fn indexes(&mut self, indexes: &Indexes) -> std::io::Result<()> {
+        self.u64(indexes.size() as u64)?;
+        self.u64(indexes.count() as u64)?;
+        for name in indexes.names() {
+            self.string(name)?;
+        }
+
+        for entry in indexes {
+            for value in entry {
+                self.bytes(&value.i32().to_le_bytes())?;
+            }
+        }
+
+        Ok(())
+    }
+
+    fn array(&mut self, array: &Array2<f64>) -> std::io::Result<()> {
+        let padding = (8 - self.written % 8) % 8;
+        self.bytes(&[0; 8][..padding])?;
+
+        let shape = array.shape();
+        self.u64(shape[0] as u64)?;
+        self.u64(shape[1] as u64)?;
+
+        match array.as_slice() {
+            Some(data) if cfg!(target_endian = "little") => {
+                // write all the data at once, it is already in the right format
+                let bytes = unsafe {
+                    std::slice::from_raw_parts(
+                        data.as_ptr().cast::<u8>(),
+                        data.len() * std::mem::size_of::<f64>()
+                    )
+                };
+                self.bytes(bytes)?;
+            }
+            _ => {
+                for value in array {
+                    self.bytes(&value.to_le_bytes())?;
+                }
+            }
+        }
+
+        Ok(())
+    }
+}
+
+/// A descriptor stored in a file created by [`Descriptor::save`], opened as a
+/// read-only memory map.
+///
+/// The values and gradients are never copied into memory, and are instead read
+/// directly from the file by the operating system when needed. This allows to
+/// work with descriptors larger than the available memory. The indexes are
+/// copied when opening the file.
+pub struct MappedDescriptor {
+    mmap: memmap2::Mmap,
+    name: String,
+    parameters: String,
+    samples: Indexes,
+    features: Indexes,
+    gradients_samples: Option<Indexes>,
+    /// position of the values (in bytes from the start of the file) and shape
+    values: (usize, [usize; 2]),
+    /// position of the gradients (in bytes from the start of the file) and
+    /// shape, if any
+    gradients: Option<(usize, [usize; 2])>,
+}
+
+impl std::fmt::Debug for MappedDescriptor {
+    fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+        f.debug_struct("MappedDescriptor")
+            .field("name", &self.name)
+            .field("parameters", &self.parameters)
+            .field("samples", &self.samples)
+            .field("features", &self.features)
+            .field("gradients_samples", &self.gradients_samples)
+            .finish()
+    }
+}
+
+impl MappedDescriptor {
+    /// Open the descriptor file at `path`, created with [`Descriptor::save`].
+    #[time_graph::instrument(name="MappedDescriptor::open")]
+    pub fn open(path: impl AsRef<Path>) -> Result<MappedDescriptor, Error> {
+        if cfg!(target_endian = "big") {
+            return Err(Error::InvalidParameter(
+                "memory-mapped descriptors are only supported on little-endian platforms".into()
+            ));
+        }
+
+        let path = path.as_ref();
+        let file = File::open(path)?;
+        // Safety: the file is only accessed read-only, and the data is checked
+        // before use. Modifying the file while it is opened leads to undefined
+        // behavior, as with all memory-mapped files.
+        let mmap = unsafe { memmap2::Mmap::map(&file)? };
+
+        let mut reader = Reader {
+            data: &mmap,
+            offset: 0,
+        };
+
+        let header = reader.read_header().map_err(|e| Error::InvalidParameter(format!(
+            "invalid descriptor file at '{}': {}", path.display(), e
+        )))?;
+
+        return Ok(MappedDescriptor {
+            mmap: mmap,
+            name: header.name,
+            parameters: header.parameters,
+            samples: header.samples,
+            features: header.features,
+            gradients_samples: header.gradients_samples,
+            values: header.values,
+            gradients: header.gradients,
+        });
+    }
+
+    /// Get the name of the calculator used to create this descriptor
+    pub fn name(&self) -> &str {
+        &self.name
+    }
+
+    /// Get the parameters of the calculator used to create this descriptor
+    pub fn parameters(&self) -> &str {
+        &self.parameters
+    }
+
+    /// Metadata describing the samples (i.e. rows) in the `values` array
+    pub fn samples(&self) -> &Indexes {
+        &self.samples
+    }
+
+    /// Metadata describing the features (i.e. columns) in both the `values` and
+    /// `gradients` array
+    pub fn features(&self) -> &Indexes {
+        &self.features
+    }
+
+    /// Metadata describing the samples (i.e. rows) in the `gradients` array
+    pub fn gradients_samples(&self) -> Option<&Indexes> {
+        self.gradients_samples.as_ref()
+    }
+
+    /// Get a view inside the values of this descriptor
+    pub fn values(&self) -> ArrayView2<'_, f64> {
+        let (offset, shape) = self.values;
+        return self.array(offset, shape);
+    }
+
+    /// Get a view inside the gradients of this descriptor, if any
+    pub fn gradients(&self) -> Option<ArrayView2<'_, f64>> {
+        self.gradients.map(|(offset, shape)| self.array(offset, shape))
+    }
+
+    fn array(&self, offset: usize, shape: [usize; 2]) -> ArrayView2<'_, f64> {
+        let bytes = &self.mmap[offset..(offset + 8 * shape[0] * shape[1])];
+        // Safety: all bit patterns are valid f64, and the alignment is checked
+        // below. The offset and size were checked when opening the file.
+        let (prefix, data, _) = unsafe { bytes.align_to::<f64>() };
+        assert!(prefix.is_empty(), "misaligned array in memory-mapped descriptor");
+
+        return ArrayView2::from_shape(shape, data).expect("invalid shape for memory-mapped array");
+    }
+
+    /// Copy all the data in this memory-mapped descriptor to a new
+    /// [`Descriptor`].
+    pub fn to_descriptor(&self) -> Descriptor {
+        let mut descriptor = Descriptor::new();
+        descriptor.values = self.values().to_owned();
+        descriptor.samples = self.samples.clone();
+        descriptor.features = self.features.clone();
+        descriptor.gradients = self.gradients().map(|g| g.to_owned());
+        descriptor.gradients_samples = self.gradients_samples.clone();
+        return descriptor;
+    }
+
+    /// Create a new [`Descriptor`] containing the data in this memory-mapped
+    /// descriptor, made dense along the given `variables`.
+    ///
+    /// This function behaves like [`Descriptor::densify`], please refer to its
+    /// documentation for more information. The data is read directly from the
+    /// file, without creating an intermediary copy of the sparse descriptor.
+    #[time_graph::instrument(name="MappedDescriptor::densify")]
+    pub fn densify<'a>(
+        &self,
+        variables: &[&str],
+        requested: impl Into<Option<ArrayView2<'a, IndexValue>>>,
+    ) -> Result<Descriptor, Error> {
+        if variables.is_empty() || self.features.size() == 0 {
+            return Ok(self.to_descriptor());
+        }
+
+        let densified = densify_values_arrays(
+            self.values(), &self.samples, &self.features, variables, requested.into()
+        )?;
+
+        let mut descriptor = Descriptor::new();
+        if let Some(gradients) = self.gradients() {
+            let gradients_samples = self.gradients_samples.as_ref().expect("missing gradients samples");
+            let (new_gradients, new_gradients_samples) = densify_gradients_arrays(
+                gradients, gradients_samples, &densified.new_positions, densified.n_blocks
+            );
+
+            descriptor.gradients = Some(new_gradients);
+            descriptor.gradients_samples = Some(new_gradients_samples);
+        }
+
+        descriptor.values = densified.values;
+        descriptor.samples = densified.samples;
+        descriptor.features = densified.features;
+
+        return Ok(descriptor);
+    }
+}
+
+/// Data in the header of a descriptor file
+struct Header {
+    name: String,
+    parameters: String,
+    samples: Indexes,
+    features: Indexes,
+    gradients_samples: Option<Indexes>,
+    values: (usize, [usize; 2]),
+    gradients: Option<(usize, [usize; 2])>,
+}
+
+/// Reader for the data in a descriptor file, checking that all reads stay
+/// inside the file
+struct Reader<'a> {
+    data: &'a [u8],
+    offset: usize,
+}
+
+impl<'a> Reader<'a> {
+    fn read_header(&mut self) -> Result<Header, String> {
+        if self.bytes(MAGIC.len())? != MAGIC {
+            return Err("this is not a rascaline descriptor file".into());
+        }
+
+        let version = self.u64()?;
+        if version != VERSION as usize {
+            return Err(format!("unsupported file format version {}, expected {}", version, VERSION));
+        }
+
+        let name = self.string()?;
+        let parameters = self.string()?;
+
+        let samples = self.indexes()?;
+        let features = self.indexes()?;
+        let gradients_samples = match self.u64()? {
+            0 => None,
+            1 => Some(self.indexes()?),
+            other => return Err(format!("invalid value for gradients marker: {}", other)),
+        };
+
+        let values = self.array()?;
+        if values.1 != [samples.count(), features.count()] {
+            return Err(format!(
+                "the values array has shape {:?}, but there are {} samples and {} features",
+                values.1, samples.count(), features.count()
+            ));
+        }
+
+        let gradients = if let Some(ref gradients_samples) = gradients_samples {
+            let gradients = self.array()?;
+            if gradients.1 != [gradients_samples.count(), features.count()] {
+                return Err(format!(
+                    "the gradients array has shape {:?}, but there are {} gradients samples and {} features",
+                    gradients.1, gradients_samples.count(), features.count()
+                ));
+            }
+            Some(gradients)
+        } else {
+            None
+        };
+
+        if self.offset != self.data.len() {
+            return Err("unexpected data at the end of the file".into());
+        }
+
+        return Ok(Header {
+            name: name,
+            parameters: parameters,
+            samples: samples,
+            features: features,
+            gradients_samples: gradients_samples,
+            values: values,
+            gradients: gradients,
+        });
+    }
+
+    fn bytes(&mut self, count: usize) -> Result<&'a [u8], String> {
+        if count > self.data.len() - self.offset {
+            return Err("unexpected end of file".into());
+        }
+
+        let bytes = &self.data[self.offset..(self.offset + count)];
+        self.offset += count;
+        return Ok(bytes);
+    }
+
+    fn u64(&mut self) -> Result<usize, String> {
+        let mut buffer = [0; 8];
+        buffer.copy_from_slice(self.bytes(8)?);
+        let value = u64::from_le_bytes(buffer);
+        return usize::try_from(value).map_err(|_| format!("{} does not fit in usize", value));
+    }
+
+    fn string(&mut self) -> Result<String, String> {
+        let length = self.u64()?;
+        let bytes = self.bytes(length)?;
+        let string = std::str::from_utf8(bytes).map_err(|e| e.to_string())?;
+        return Ok(string.into());
+    }
+
+    fn indexes(&mut self) -> Result<Indexes, String> {
+        let size = self.u64()?;
+        let count = self.u64()?;
+
+        let mut names = Vec::new();
+        for _ in 0..size {
+            let name = self.string()?;
+            if !is_valid_index_name(&name) {
+                return Err(format!("'{}' is not a valid index name", name));
+            }
+            names.push(name);
+        }
+
+        if names.iter().collect::<BTreeSet<_>>().len() != names.len() {
+            return Err("the same index name is used multiple times".into());
+        }
+
+        let data_size = count.checked_mul(size)
+            .and_then(|n| n.checked_mul(4))
+            .ok_or_else(|| String::from("indexes are too large"))?;
+        let data = self.bytes(data_size)?;
+
+        let read_entry = |chunk: &[u8], entry: &mut [IndexValue]| {
+            for (value, bytes) in entry.iter_mut().zip(chunk.chunks_exact(4)) {
+                let mut buffer = [0; 4];
+                buffer.copy_from_slice(bytes);
+                *value = IndexValue::from(i32::from_le_bytes(buffer));
+            }
+        };
+
+        let mut builder = IndexesBuilder::new(names.iter().map(|s| &**s).collect());
+        let mut entry = vec![IndexValue::from(0); size];
+        let mut previous = vec![IndexValue::from(0); size];
+        let mut is_sorted = true;
+        for (i, chunk) in data.chunks_exact(4 * size.max(1)).enumerate() {
+            read_entry(chunk, &mut entry);
+            if i > 0 && previous >= entry {
+                is_sorted = false;
+            }
+            builder.add(&entry);
+            std::mem::swap(&mut previous, &mut entry);
+        }
+
+        // `IndexesBuilder::finish` panics on duplicated entries. Strictly
+        // increasing entries can not contain duplicates, so we only need to
+        // look for them in unsorted indexes.
+        if !is_sorted {
+            let mut all_entries = BTreeSet::new();
+            for chunk in data.chunks_exact(4 * size.max(1)) {
+                read_entry(chunk, &mut entry);
+                if !all_entries.insert(entry.clone()) {
+                    let entry_display = entry.iter().map(|v| v.to_string()).collect::<Vec<_>>().join(", ");
+                    return Err(format!("the index value [{}] is present multiple times", entry_display));
+                }
+            }
+        }
+
+        return Ok(builder.finish());
+    }
+
+    fn array(&mut self) -> Result<(usize, [usize; 2]), String> {
+        let padding = (8 - self.offset % 8) % 8;
+        self.bytes(padding)?;
+
+        let shape = [self.u64()?, self.u64()?];
+        let data_size = shape[0].checked_mul(shape[1])
+            .and_then(|n| n.checked_mul(8))
+            .ok_or_else(|| String::from("array is too large"))?;
+
+        let offset = self.offset;
+        self.bytes(data_size)?;
+        return Ok((offset, shape));
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use approx::assert_relative_eq;
+
+    use crate::systems::test_utils::test_systems;
+    use crate::{Calculator, Descriptor};
+
+    use super::{MappedDescriptor, Reader};
+
+    fn compute() -> (Calculator, Descriptor) {
+        let mut calculator = Calculator::new("dummy_calculator", r#"{
+            "cutoff": 1.0,
+            "delta": 9,
+            "name": "",
+            "gradients": true
+        }"#.to_owned()).unwrap();
+
+        let mut systems = test_systems(&["water", "methane"]);
+        let mut descriptor = Descriptor::new();
+        calculator.compute(&mut systems, &mut descriptor, Default::default()).unwrap();
+
+        return (calculator, descriptor);
+    }
+
+    /// Get a path in the temporary directory which is not shared with other
+    /// test processes
+    fn temporary_path(name: &str) -> std::path::PathBuf {
+        return std::env::temp_dir().join(format!("rascaline-{}-{}.desc", name, std::process::id()));
+    }
+
+    #[test]
+    fn save_and_open() {
+        let (calculator, descriptor) = compute();
+
+        let path = temporary_path("save-and-open");
+        descriptor.save(&path, &calculator).unwrap();
+
+        let mapped = MappedDescriptor::open(&path).unwrap();
+        assert_eq!(mapped.name(), calculator.name());
+        assert_eq!(mapped.parameters(), calculator.parameters());
+
+        assert_eq!(mapped.samples(), &descriptor.samples);
+        assert_eq!(mapped.features(), &descriptor.features);
+        assert_eq!(mapped.gradients_samples(), descriptor.gradients_samples.as_ref());
+
+        assert_eq!(mapped.values(), descriptor.values);
+        assert_eq!(mapped.gradients().unwrap(), descriptor.gradients.clone().unwrap());
+
+        let mut expected = descriptor.clone();
+        expected.densify(&["center"], None).unwrap();
+        let densified = mapped.densify(&["center"], None).unwrap();
+
+        assert_eq!(densified.samples, expected.samples);
+        assert_eq!(densified.features, expected.features);
+        assert_eq!(densified.gradients_samples, expected.gradients_samples);
+        assert_relative_eq!(densified.values, expected.values);
+        assert_relative_eq!(densified.gradients.unwrap(), expected.gradients.unwrap());
+
+        std::mem::drop(mapped);
+        std::fs::remove_file(&path).unwrap();
+    }
+
+    #[test]
+    fn invalid_files() {
+        let (calculator, descriptor) = compute();
+
+        let path = temporary_path("invalid-files");
+        std::fs::write(&path, b"this is not a descriptor").unwrap();
+        let error = MappedDescriptor::open(&path).unwrap_err();
+        assert_eq!(error.to_string(), format!(
+            "invalid parameter: invalid descriptor file at '{}': this is not a rascaline descriptor file",
+            path.display()
+        ));
+
+        descriptor.save(&path, &calculator).unwrap();
+        let mut data = std::fs::read(&path).unwrap();
+        data.truncate(data.len() - 3);
+        std::fs::write(&path, &data).unwrap();
+
+        let error = MappedDescriptor::open(&path).unwrap_err();
+        assert_eq!(error.to_string(), format!(
+            "invalid parameter: invalid descriptor file at '{}': unexpected end of file",
+            path.display()
+        ));
+
+        std::fs::remove_file(&path).unwrap();
+    }
+
+    #[test]
+    fn duplicated_indexes() {
+        // indexes with a single "foo" variable, containing [3], [1], [3]
+        let mut data = Vec::new();
+        data.extend_from_slice(&1_u64.to_le_bytes());
+        data.extend_from_slice(&3_u64.to_le_bytes());
+        data.extend_from_slice(&3_u64.to_le_bytes());
+        data.extend_from_slice(b"foo");
+        for value in &[3_i32, 1, 3] {
+            data.extend_from_slice(&value.to_le_bytes());
+        }
+
+        let mut reader = Reader { data: &data, offset: 0 };
+        assert_eq!(reader.indexes().unwrap_err(), "the index value [3] is present multiple times");
+
+        // same indexes without the duplicate
+        data.truncate(data.len() - 4);
+        data[8..16].copy_from_slice(&2_u64.to_le_bytes());
+        let mut reader = Reader { data: &data, offset: 0 };
+        let indexes = reader.indexes().unwrap();
+        assert_eq!(indexes.count(), 2);
+    }
+}
@@ -55,6 +55,8 @@ impl Clone for ConstCString {
 // SAFETY: Sync is ok since `ConstCString` is immutable, so sharing it between
 // threads causes no issue
 unsafe impl Sync for ConstCString {}
+// SAFETY: Send is ok since `ConstCString` owns the string, like `CString`
+unsafe impl Send for ConstCString {}
 
 
 #[derive(Clone, Copy, PartialEq, Eq, PartialOrd, Ord, Hash)]
@@ -162,21 +164,34 @@ impl IndexesBuilder {
             return Indexes {
                 names: Vec::new(),
                 values: Vec::new(),
-                positions: Default::default(),
+                positions: None,
             }
         }
 
-        let mut positions: HashMap<_, _, BuildHasherDefault<XxHash64>> = Default::default();
-        for (position, chunk) in self.values.chunks_exact(self.names.len()).enumerate() {
-            let existing = positions.insert(chunk.to_vec(), position);
-
-            if let Some(existing) = existing {
-                let chunk_display = chunk.iter().map(|v| v.to_string()).collect::<Vec<_>>().join(", ");
-                panic!(
-                    "can not have the same index value multiple time: [{}] is already present at position {}",
-                    chunk_display, existing
-                );
-            }
+        let size = self.names.len();
+        let is_sorted = self.values.chunks_exact(size)
+            .zip(self.values.chunks_exact(size).skip(1))
+            .all(|(previous, current)| previous < current);
+
+        let positions = if is_sorted {
+            // strictly increasing values can not contain duplicates, and we
+            // can use a binary search to find them: there is no need to spend
+            // memory on a hash map
+            None
+        } else {
+            let mut positions: HashMap<_, _, BuildHasherDefault<XxHash64>> = Default::default();
+            for (position, chunk) in self.values.chunks_exact(size).enumerate() {
+                let existing = positions.insert(chunk.to_vec(), position);
+
+                if let Some(existing) = existing {
+                    let chunk_display = chunk.iter().map(|v| v.to_string()).collect::<Vec<_>>().join(", ");
+                    panic!(
+                        "can not have the same index value multiple time: [{}] is already present at position {}",
+                        chunk_display, existing
+                    );
+                }
+            };
+            Some(positions)
         };
 
         let names = self.names.into_iter()
@@ -222,7 +237,10 @@ pub struct Indexes {
     /// This uses `XxHash64` instead of the default hasher in std since
     /// `XxHash64` is much faster and we don't need the cryptographic strength
     /// hash from std.
-    positions: HashMap<Vec<IndexValue>, usize, BuildHasherDefault<XxHash64>>,
+    ///
+    /// This is `None` if the values are sorted in lexicographic order, in
+    /// which case positions are found with a binary search on `values`.
+    positions: Option<HashMap<Vec<IndexValue>, usize, BuildHasherDefault<XxHash64>>>,
 }
 
 impl std::fmt::Debug for Indexes {
@@ -288,7 +306,23 @@ impl Indexes {
             panic!("invalid size of index in Indexes::position");
         }
 
-        self.positions.get(value).copied()
+        match &self.positions {
+            Some(positions) => positions.get(value).copied(),
+            None => {
+                let size = self.size();
+                let mut low = 0;
+                let mut high = self.count();
+                while low < high {
+                    let middle = low + (high - low) / 2;
+                    match self.values[middle * size..(middle + 1) * size].cmp(value) {
+                        std::cmp::Ordering::Less => low = middle + 1,
+                        std::cmp::Ordering::Greater => high = middle,
+                        std::cmp::Ordering::Equal => return Some(middle),
+                    }
+                }
+                None
+            }
+        }
     }
 }
 
@@ -396,6 +430,39 @@ mod tests {
         assert_eq!(idx[2], [IndexValue::from(-4), IndexValue::from(-2413)]);
     }
 
+    #[test]
+    fn indexes_position() {
+        // sorted indexes use a binary search
+        let mut builder = IndexesBuilder::new(vec!["foo", "bar"]);
+        builder.add(&[IndexValue::from(0), IndexValue::from(3)]);
+        builder.add(&[IndexValue::from(1), IndexValue::from(-2)]);
+        builder.add(&[IndexValue::from(1), IndexValue::from(5)]);
+        builder.add(&[IndexValue::from(4), IndexValue::from(0)]);
+
+        let idx = builder.finish();
+        assert!(idx.positions.is_none());
+        assert_eq!(idx.position(&[IndexValue::from(0), IndexValue::from(3)]), Some(0));
+        assert_eq!(idx.position(&[IndexValue::from(1), IndexValue::from(-2)]), Some(1));
+        assert_eq!(idx.position(&[IndexValue::from(1), IndexValue::from(5)]), Some(2));
+        assert_eq!(idx.position(&[IndexValue::from(4), IndexValue::from(0)]), Some(3));
+        assert_eq!(idx.position(&[IndexValue::from(1), IndexValue::from(0)]), None);
+        assert_eq!(idx.position(&[IndexValue::from(-1), IndexValue::from(0)]), None);
+        assert_eq!(idx.position(&[IndexValue::from(5), IndexValue::from(0)]), None);
+
+        // unsorted indexes use a hash map
+        let mut builder = IndexesBuilder::new(vec!["foo", "bar"]);
+        builder.add(&[IndexValue::from(1), IndexValue::from(5)]);
+        builder.add(&[IndexValue::from(0), IndexValue::from(3)]);
+        builder.add(&[IndexValue::from(4), IndexValue::from(0)]);
+
+        let idx = builder.finish();
+        assert!(idx.positions.is_some());
+        assert_eq!(idx.position(&[IndexValue::from(1), IndexValue::from(5)]), Some(0));
+        assert_eq!(idx.position(&[IndexValue::from(0), IndexValue::from(3)]), Some(1));
+        assert_eq!(idx.position(&[IndexValue::from(4), IndexValue::from(0)]), Some(2));
+        assert_eq!(idx.position(&[IndexValue::from(1), IndexValue::from(0)]), None);
+    }
+
     #[test]
     fn indexes_iter() {
         let mut builder = IndexesBuilder::new(vec!["foo", "bar"]);
@@ -0,0 +1,105 @@
+/// Dense numbering of the species in a system, used to store sets of species
+/// as bitsets instead of sorted containers when building samples.
+///
+/// Species are numbered in increasing order, so iterating over a
+/// [`SpeciesBitSet`] gives the species sorted in the same way as the samples.
+pub(super) struct SpeciesIndexes {
+    /// sorted list of all the species in the system
+    species: Vec<i32>,
+    /// index in `species` of the species of each atom
+    atoms: Vec<usize>,
+}
+
+impl SpeciesIndexes {
+    /// Create the dense numbering for the given list of atomic `species`
+    pub fn new(species: &[i32]) -> SpeciesIndexes {
+        let mut all_species = species.to_vec();
+        all_species.sort_unstable();
+        all_species.dedup();
+
+        let atoms = species.iter()
+            .map(|s| all_species.binary_search(s).expect("missing species"))
+            .collect();
+
+        return SpeciesIndexes {
+            species: all_species,
+            atoms: atoms,
+        };
+    }
+
+    /// Get the index of the species of the given `atom`
+    pub fn atom(&self, atom: usize) -> usize {
+        self.atoms[atom]
+    }
+
+    /// Get the species corresponding to the given dense `index`
+    pub fn species(&self, index: usize) -> i32 {
+        self.species[index]
+    }
+
+    /// Create an empty bitset able to contain all the species in this system
+    pub fn bitset(&self) -> SpeciesBitSet {
+        SpeciesBitSet {
+            blocks: vec![0; (self.species.len() + 63) / 64],
+        }
+    }
+}
+
+/// Set of species indexes from [`SpeciesIndexes`], stored as a bitset
+pub(super) struct SpeciesBitSet {
+    blocks: Vec<u64>,
+}
+
+impl SpeciesBitSet {
+    /// Add the species with the given dense `index` to this set
+    pub fn insert(&mut self, index: usize) {
+        self.blocks[index / 64] |= 1 << (index % 64);
+    }
+
+    /// Iterate over the species indexes in this set, in increasing order
+    pub fn iter(&self) -> impl Iterator<Item=usize> + '_ {
+        self.blocks.iter().enumerate().flat_map(|(i_block, &block)| {
+            let mut block = block;
+            std::iter::from_fn(move || {
+                if block == 0 {
+                    return None;
+                }
+                let bit = block.trailing_zeros() as usize;
+                // clear the lowest set bit
+                block &= block - 1;
+                return Some(64 * i_block + bit);
+            })
+        })
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn species_indexes() {
+        let indexes = SpeciesIndexes::new(&[8, 1, 1, 6, 123456]);
+        assert_eq!(indexes.atom(0), 2);
+        assert_eq!(indexes.atom(1), 0);
+        assert_eq!(indexes.atom(2), 0);
+        assert_eq!(indexes.atom(3), 1);
+        assert_eq!(indexes.species(3), 123456);
+    }
+
+    #[test]
+    fn bitset() {
+        let species = (0..150).collect::<Vec<_>>();
+        let indexes = SpeciesIndexes::new(&species);
+
+        let mut set = indexes.bitset();
+        assert_eq!(set.iter().count(), 0);
+
+        set.insert(130);
+        set.insert(3);
+        set.insert(64);
+        set.insert(3);
+        set.insert(63);
+        assert_eq!(set.iter().collect::<Vec<_>>(), [3, 63, 64, 130]);
+    }
+}
@@ -1,3 +1,5 @@
+mod bitset;
+
 mod structure;
 pub use self::structure::StructureSpeciesSamples;
 
@@ -1,10 +1,10 @@
 use std::collections::BTreeSet;
 
-use itertools::Itertools;
+use rayon::prelude::*;
 
 use crate::{Error, System};
-use crate::systems::Pair;
 use super::super::{SamplesBuilder, Indexes, IndexesBuilder, IndexValue};
+use super::bitset::SpeciesIndexes;
 
 /// `ThreeBodiesSpeciesSamples` is used to represents atom-centered environments
 /// representing three body atomic density correlation; where the three bodies
@@ -45,186 +45,173 @@ impl ThreeBodiesSpeciesSamples {
     }
 }
 
-/// A Set built as a sorted vector
-struct SortedVecSet<T> {
-    data: Vec<T>
-}
-
-impl<T: Ord> SortedVecSet<T> {
-    fn new() -> Self {
-        SortedVecSet {
-            data: Vec::new()
-        }
-    }
-
-    fn insert(&mut self, value: T) {
-        match self.data.binary_search(&value) {
-            Ok(_) => {},
-            Err(index) => self.data.insert(index, value),
-        }
-    }
-}
-
-impl<T> IntoIterator for SortedVecSet<T> {
-    type Item = T;
-    type IntoIter = std::vec::IntoIter<T>;
-    fn into_iter(self) -> Self::IntoIter {
-        self.data.into_iter()
-    }
-}
-
 impl SamplesBuilder for ThreeBodiesSpeciesSamples {
     fn names(&self) -> Vec<&str> {
         vec!["structure", "center", "species_center", "species_neighbor_1", "species_neighbor_2"]
     }
 
     fn samples(&self, systems: &mut [Box<dyn System>]) -> Result<Indexes, Error> {
-        // Accumulate indexes in a set first to ensure uniqueness of the indexes
-        // even if their are multiple neighbors of the same specie around a
-        // given center
-        let mut set = SortedVecSet::new();
-
-        let sort_pair = |i, j| {
-            if i < j { (i, j) } else { (j, i) }
-        };
+        let mut indexes = IndexesBuilder::new(self.names());
         for (i_system, system) in systems.iter_mut().enumerate() {
             system.compute_neighbors(self.cutoff)?;
-            let species = system.species()?;
-
-            for center in 0..system.size()? {
-                let pairs = system.pairs_containing(center)?;
-                for (i, j) in triplets_from_pairs(pairs, center) {
-                    let (species_1, species_2) = sort_pair(species[i], species[j]);
-                    set.insert((i_system, center, species[center], species_1, species_2));
-                }
-            }
+            let system = &**system;
 
-            if self.self_contribution {
-                for (center, &species_center) in species.iter().enumerate() {
-                    set.insert((i_system, center, species_center, species_center, species_center));
+            let species = system.species()?;
+            let species_indexes = SpeciesIndexes::new(species);
+            let pairs = (0..system.size()?)
+                .map(|center| system.pairs_containing(center))
+                .collect::<Result<Vec<_>, _>>()?;
+
+            // Build the set of neighbor species around each center in
+            // parallel. All the triplets i-center-j (including i == j) with
+            // species_1 <= species_2 taken from this set exist around the
+            // center, so there is no need to iterate over the triplets
+            // themselves. The self contribution makes the center its own
+            // neighbor, adding its species to the set.
+            let self_contribution = self.self_contribution;
+            let neighbor_species = crate::threads::install(|| {
+                pairs.par_iter().enumerate().map(|(center, pairs)| {
+                    let mut set = species_indexes.bitset();
+                    if self_contribution {
+                        set.insert(species_indexes.atom(center));
+                    }
 
-                    for pair in system.pairs_containing(center)? {
-                        let neighbor = if pair.first == center {
-                            pair.second
-                        } else {
-                            pair.first
-                        };
+                    for pair in pairs.iter() {
+                        let neighbor = if pair.first == center { pair.second } else { pair.first };
+                        set.insert(species_indexes.atom(neighbor));
+                    }
 
-                        let (species_1, species_2) = sort_pair(species_center, species[neighbor]);
-                        set.insert((i_system, center, species_center, species_1, species_2));
+                    return set.iter().map(|s| species_indexes.species(s)).collect::<Vec<_>>();
+                }).collect::<Vec<_>>()
+            });
+
+            for (center, neighbor_species) in neighbor_species.iter().enumerate() {
+                for (i, &species_1) in neighbor_species.iter().enumerate() {
+                    for &species_2 in &neighbor_species[i..] {
+                        indexes.add(&[
+                            IndexValue::from(i_system),
+                            IndexValue::from(center),
+                            IndexValue::from(species[center]),
+                            IndexValue::from(species_1),
+                            IndexValue::from(species_2)
+                        ]);
                     }
                 }
             }
         }
 
-        let mut indexes = IndexesBuilder::new(self.names());
-        for (structure, center, species_center, species_1, species_2) in set {
-            indexes.add(&[
-                IndexValue::from(structure),
-                IndexValue::from(center),
-                IndexValue::from(species_center),
-                IndexValue::from(species_1),
-                IndexValue::from(species_2)
-            ]);
-        }
-
         return Ok(indexes.finish());
     }
 
     fn gradients_for(&self, systems: &mut [Box<dyn System>], samples: &Indexes) ->Result<Option<Indexes>, Error> {
         assert_eq!(samples.names(), self.names());
 
-        let sort_pair = |i, j| {
-            if i < j { (i, j) } else { (j, i) }
-        };
+        let used_systems = samples.iter().map(|sample| sample[0].usize()).collect::<BTreeSet<_>>();
+        for i_system in used_systems {
+            systems[i_system].compute_neighbors(self.cutoff)?;
+        }
 
-        let mut indexes = BTreeSet::new();
-        for (i_sample, sample) in samples.iter().enumerate() {
-            let i_system = sample[0];
+        // gather the data for all samples on the calling thread, since
+        // systems can not be shared between threads
+        let mut samples_data = Vec::with_capacity(samples.count());
+        for sample in samples.iter() {
+            let system = &*systems[sample[0].usize()];
             let center = sample[1].usize();
             let species_center = sample[2].i32();
             let species_neighbor_1 = sample[3].i32();
             let species_neighbor_2 = sample[4].i32();
 
-            let system = &mut *systems[i_system.usize()];
-            system.compute_neighbors(self.cutoff)?;
-
-            let species = system.species()?;
+            samples_data.push((
+                center,
+                species_center,
+                (species_neighbor_1, species_neighbor_2),
+                system.species()?,
+                system.pairs_containing(center)?,
+            ));
+        }
 
-            if self.self_contribution {
-                let species_neighbor = if species_neighbor_1 == species_center {
-                    Some(species_neighbor_2)
-                } else if species_neighbor_2 == species_center {
-                    Some(species_neighbor_1)
-                } else {
-                    None
-                };
-
-                if let Some(species_neighbor) = species_neighbor {
-                    // include the gradient of an environnement w.r.t its center
-                    // even if there is no neighbor of the other type around.
-                    indexes.insert((i_sample, center));
-
-                    for pair in system.pairs_containing(center)? {
-                        let neighbor = if pair.first == center {
-                            pair.second
-                        } else {
-                            assert_eq!(pair.second, center);
-                            pair.first
-                        };
-
-                        if species[neighbor] != species_neighbor {
-                            continue;
+        let self_contribution = self.self_contribution;
+        let samples_atoms = crate::threads::install(|| {
+            samples_data.par_iter().map(|&(center, species_center, neighbors_species, species, pairs)| {
+                let (species_neighbor_1, species_neighbor_2) = neighbors_species;
+                let mut atoms = Vec::new();
+
+                if self_contribution {
+                    let species_neighbor = if species_neighbor_1 == species_center {
+                        Some(species_neighbor_2)
+                    } else if species_neighbor_2 == species_center {
+                        Some(species_neighbor_1)
+                    } else {
+                        None
+                    };
+
+                    if let Some(species_neighbor) = species_neighbor {
+                        // include the gradient of an environnement w.r.t its
+                        // center even if there is no neighbor of the other
+                        // type around.
+                        atoms.push(center);
+
+                        for pair in pairs {
+                            let neighbor = if pair.first == center {
+                                pair.second
+                            } else {
+                                assert_eq!(pair.second, center);
+                                pair.first
+                            };
+
+                            if species[neighbor] == species_neighbor {
+                                atoms.push(neighbor);
+                            }
                         }
-
-                        indexes.insert((i_sample, neighbor));
                     }
                 }
-            }
 
-            let pairs = system.pairs_containing(center)?;
-            for (i, j) in triplets_from_pairs(pairs, center) {
-                let (species_1, species_2) = sort_pair(species[i], species[j]);
+                // A triplet i-center-j with the requested species exists if
+                // there is at least one neighbor with each of the species, and
+                // then all neighbors with these species contribute to the
+                // sample.
+                let mut found_1 = false;
+                let mut found_2 = false;
+                let mut triplets_atoms = Vec::new();
+                for pair in pairs {
+                    let neighbor = if pair.first == center { pair.second } else { pair.first };
+
+                    let species_neighbor = species[neighbor];
+                    if species_neighbor == species_neighbor_1 {
+                        found_1 = true;
+                        triplets_atoms.push(neighbor);
+                    }
+
+                    if species_neighbor == species_neighbor_2 {
+                        found_2 = true;
+                        triplets_atoms.push(neighbor);
+                    }
+                }
 
-                if species_1 == species_neighbor_1 && species_2 == species_neighbor_2 {
-                    indexes.insert((i_sample, center));
-                    indexes.insert((i_sample, i));
-                    indexes.insert((i_sample, j));
+                if found_1 && found_2 {
+                    atoms.push(center);
+                    atoms.extend(triplets_atoms);
                 }
-            }
-        }
+
+                atoms.sort_unstable();
+                atoms.dedup();
+                return atoms;
+            }).collect::<Vec<_>>()
+        });
 
         let mut gradients = IndexesBuilder::new(vec!["sample", "atom", "spatial"]);
-        for (i_sample, atom) in indexes {
-            gradients.add(&[IndexValue::from(i_sample), IndexValue::from(atom), IndexValue::from(0)]);
-            gradients.add(&[IndexValue::from(i_sample), IndexValue::from(atom), IndexValue::from(1)]);
-            gradients.add(&[IndexValue::from(i_sample), IndexValue::from(atom), IndexValue::from(2)]);
+        for (i_sample, atoms) in samples_atoms.into_iter().enumerate() {
+            for atom in atoms {
+                gradients.add(&[IndexValue::from(i_sample), IndexValue::from(atom), IndexValue::from(0)]);
+                gradients.add(&[IndexValue::from(i_sample), IndexValue::from(atom), IndexValue::from(1)]);
+                gradients.add(&[IndexValue::from(i_sample), IndexValue::from(atom), IndexValue::from(2)]);
+            }
         }
 
         return Ok(Some(gradients.finish()));
     }
 }
 
-/// Build the list of triplet i-center-j from the given list of pairs
-fn triplets_from_pairs(pairs: &[Pair], center: usize) -> impl Iterator<Item=(usize, usize)> + '_ {
-    pairs.iter().cartesian_product(pairs).map(move |(first_pair, second_pair)| {
-        let i = if first_pair.first == center {
-            first_pair.second
-        } else {
-            first_pair.first
-        };
-
-        let j = if second_pair.first == center {
-            second_pair.second
-        } else {
-            second_pair.first
-        };
-
-        return (i, j);
-    })
-}
-
-
 #[cfg(test)]
 #[allow(clippy::identity_op)]
 mod tests {
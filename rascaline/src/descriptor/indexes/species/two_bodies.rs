@@ -1,7 +1,10 @@
 use std::collections::BTreeSet;
 
+use rayon::prelude::*;
+
 use crate::{Error, System};
 use super::super::{SamplesBuilder, Indexes, IndexesBuilder, IndexValue};
+use super::bitset::SpeciesIndexes;
 
 /// `TwoBodiesSpeciesSamples` is used to represents atom-centered environments,
 /// where each atom in a structure is described with a feature vector based on
@@ -48,34 +51,48 @@ impl SamplesBuilder for TwoBodiesSpeciesSamples {
     }
 
     fn samples(&self, systems: &mut [Box<dyn System>]) -> Result<Indexes, Error> {
-        // Accumulate indexes in a set first to ensure uniqueness of the indexes
-        // even if their are multiple neighbors of the same specie around a
-        // given center
-        let mut set = BTreeSet::new();
+        let mut indexes = IndexesBuilder::new(self.names());
         for (i_system, system) in systems.iter_mut().enumerate() {
             system.compute_neighbors(self.cutoff)?;
-            let species = system.species()?;
+            let system = &**system;
 
-            if self.self_contribution {
-                for (center, &species) in species.iter().enumerate() {
-                    set.insert((i_system, center, species, species));
+            let species = system.species()?;
+            let species_indexes = SpeciesIndexes::new(species);
+            let pairs = (0..system.size()?)
+                .map(|center| system.pairs_containing(center))
+                .collect::<Result<Vec<_>, _>>()?;
+
+            // Build the set of neighbor species around each center in
+            // parallel. Using a bitset ensures uniqueness of the samples even
+            // if their are multiple neighbors of the same specie around a
+            // given center, and gives the species in sorted order.
+            let self_contribution = self.self_contribution;
+            let neighbor_species = crate::threads::install(|| {
+                pairs.par_iter().enumerate().map(|(center, pairs)| {
+                    let mut set = species_indexes.bitset();
+                    if self_contribution {
+                        set.insert(species_indexes.atom(center));
+                    }
+
+                    for pair in pairs.iter() {
+                        let neighbor = if pair.first == center { pair.second } else { pair.first };
+                        set.insert(species_indexes.atom(neighbor));
+                    }
+
+                    return set;
+                }).collect::<Vec<_>>()
+            });
+
+            for (center, set) in neighbor_species.iter().enumerate() {
+                for species_neighbor in set.iter() {
+                    indexes.add(&[
+                        IndexValue::from(i_system),
+                        IndexValue::from(center),
+                        IndexValue::from(species[center]),
+                        IndexValue::from(species_indexes.species(species_neighbor)),
+                    ]);
                 }
             }
-
-            for pair in system.pairs()? {
-                let species_first = species[pair.first];
-                let species_second = species[pair.second];
-
-                set.insert((i_system, pair.first, species_first, species_second));
-                set.insert((i_system, pair.second, species_second, species_first));
-            };
-        }
-
-        let mut indexes = IndexesBuilder::new(self.names());
-        for (s, c, a, b) in set {
-            indexes.add(&[
-                IndexValue::from(s), IndexValue::from(c), IndexValue::from(a), IndexValue::from(b)
-            ]);
         }
 
         return Ok(indexes.finish());
@@ -84,38 +101,61 @@ impl SamplesBuilder for TwoBodiesSpeciesSamples {
     fn gradients_for(&self, systems: &mut [Box<dyn System>], samples: &Indexes) -> Result<Option<Indexes>, Error> {
         assert_eq!(samples.names(), self.names());
 
-        let mut indexes = BTreeSet::new();
-        for (i_sample, sample) in samples.iter().enumerate() {
-            let i_system = sample[0];
+        let used_systems = samples.iter().map(|sample| sample[0].usize()).collect::<BTreeSet<_>>();
+        for i_system in used_systems {
+            systems[i_system].compute_neighbors(self.cutoff)?;
+        }
+
+        // gather the data for all samples on the calling thread, since
+        // systems can not be shared between threads
+        let mut samples_data = Vec::with_capacity(samples.count());
+        for sample in samples.iter() {
+            let system = &*systems[sample[0].usize()];
             let center = sample[1].usize();
             let species_center = sample[2].i32();
             let species_neighbor = sample[3].i32();
 
-            let system = &mut *systems[i_system.usize()];
-            system.compute_neighbors(self.cutoff)?;
+            samples_data.push((
+                center,
+                species_center,
+                species_neighbor,
+                system.species()?,
+                system.pairs_containing(center)?,
+            ));
+        }
 
-            if species_neighbor == species_center && self.self_contribution {
-                indexes.insert((i_sample, center));
-            }
+        let self_contribution = self.self_contribution;
+        let samples_atoms = crate::threads::install(|| {
+            samples_data.par_iter().map(|&(center, species_center, species_neighbor, species, pairs)| {
+                let mut atoms = Vec::new();
+                if species_neighbor == species_center && self_contribution {
+                    atoms.push(center);
+                }
 
-            let species = system.species()?;
-            for pair in system.pairs_containing(center)? {
-                let neighbor = if pair.first == center { pair.second } else { pair.first };
+                for pair in pairs {
+                    let neighbor = if pair.first == center { pair.second } else { pair.first };
+
+                    if species[neighbor] != species_neighbor {
+                        continue;
+                    }
 
-                if species[neighbor] != species_neighbor {
-                    continue;
+                    atoms.push(center);
+                    atoms.push(neighbor);
                 }
 
-                indexes.insert((i_sample, center));
-                indexes.insert((i_sample, neighbor));
-            }
-        }
+                atoms.sort_unstable();
+                atoms.dedup();
+                return atoms;
+            }).collect::<Vec<_>>()
+        });
 
         let mut gradients = IndexesBuilder::new(vec!["sample", "atom", "spatial"]);
-        for (i_sample, atom) in indexes {
-            gradients.add(&[IndexValue::from(i_sample), IndexValue::from(atom), IndexValue::from(0)]);
-            gradients.add(&[IndexValue::from(i_sample), IndexValue::from(atom), IndexValue::from(1)]);
-            gradients.add(&[IndexValue::from(i_sample), IndexValue::from(atom), IndexValue::from(2)]);
+        for (i_sample, atoms) in samples_atoms.into_iter().enumerate() {
+            for atom in atoms {
+                gradients.add(&[IndexValue::from(i_sample), IndexValue::from(atom), IndexValue::from(0)]);
+                gradients.add(&[IndexValue::from(i_sample), IndexValue::from(atom), IndexValue::from(1)]);
+                gradients.add(&[IndexValue::from(i_sample), IndexValue::from(atom), IndexValue::from(2)]);
+            }
         }
         return Ok(Some(gradients.finish()));
     }
@@ -9,4 +9,10 @@ pub use self::indexes::{ThreeBodiesSpeciesSamples};
 
 #[allow(clippy::module_inception)]
 mod descriptor;
-pub use self::descriptor::Descriptor;
+pub use self::descriptor::{Descriptor, GradientsBlocks};
+
+mod file;
+pub use self::file::MappedDescriptor;
+
+mod single_precision;
+pub use self::single_precision::DescriptorF32;
@@ -0,0 +1,106 @@
+use ndarray::{Array2, Zip};
+
+use super::{Descriptor, Indexes};
+
+/// A `DescriptorF32` contains the same data as a [`Descriptor`], with the
+/// values and gradients stored in single precision (`f32`) instead of double
+/// precision.
+///
+/// Calculators always compute descriptors in double precision, which can then
+/// be converted to a `DescriptorF32` for storage or to be used in single
+/// precision models. This halves the memory used by the values and gradients.
+#[derive(Clone, Debug)]
+pub struct DescriptorF32 {
+    /// An array of size `samples.count()` by `features.count()`, containing the
+    /// representation of the atomistic systems.
+    pub values: Array2<f32>,
+    /// Metadata describing the samples (i.e. rows) in the `values` array
+    pub samples: Indexes,
+
+    /// An array of size `gradients_samples.count()` by `features.count()`,
+    /// containing the gradients of the representation with respect to the
+    /// atomic positions.
+    pub gradients: Option<Array2<f32>>,
+    /// Metadata describing the samples (i.e. rows) in the `gradients` array
+    pub gradients_samples: Option<Indexes>,
+
+    /// Metadata describing the features (i.e. columns) in both the `values` and
+    /// `gradients` array
+    pub features: Indexes,
+}
+
+impl From<Descriptor> for DescriptorF32 {
+    /// Convert a double precision `descriptor` to single precision. The double
+    /// precision values are released before the gradients are converted, to
+    /// reduce the peak memory use.
+    #[time_graph::instrument(name = "DescriptorF32::from")]
+    fn from(descriptor: Descriptor) -> DescriptorF32 {
+        let Descriptor { values, samples, gradients, gradients_samples, features, .. } = descriptor;
+
+        let values = to_single_precision(values);
+        let gradients = gradients.map(to_single_precision);
+
+        return DescriptorF32 {
+            values,
+            samples,
+            gradients,
+            gradients_samples,
+            features,
+        };
+    }
+}
+
+impl Descriptor {
+    /// Convert this descriptor to single precision, see [`DescriptorF32`].
+    pub fn into_f32(self) -> DescriptorF32 {
+        DescriptorF32::from(self)
+    }
+}
+
+/// Convert the `array` to `f32` in parallel, consuming it
+fn to_single_precision(array: Array2<f64>) -> Array2<f32> {
+    let mut output = Array2::zeros(array.raw_dim());
+    crate::threads::install(|| {
+        Zip::from(&mut output).and(&array).par_for_each(|output, &input| {
+            *output = input as f32;
+        });
+    });
+    return output;
+}
+
+#[cfg(test)]
+mod tests {
+    use crate::systems::test_utils::test_systems;
+    use crate::{Calculator, Descriptor};
+
+    #[test]
+    fn convert() {
+        let mut calculator = Calculator::new("dummy_calculator", r#"{
+            "cutoff": 1.0,
+            "delta": 9,
+            "name": "",
+            "gradients": true
+        }"#.to_owned()).unwrap();
+
+        let mut systems = test_systems(&["water", "methane"]);
+        let mut descriptor = Descriptor::new();
+        calculator.compute(&mut systems, &mut descriptor, Default::default()).unwrap();
+
+        let single = descriptor.clone().into_f32();
+        assert_eq!(single.samples, descriptor.samples);
+        assert_eq!(single.features, descriptor.features);
+        assert_eq!(single.gradients_samples, descriptor.gradients_samples);
+
+        assert_eq!(single.values.shape(), descriptor.values.shape());
+        for (&single, &double) in single.values.iter().zip(&descriptor.values) {
+            assert_eq!(single, double as f32);
+        }
+
+        let gradients = descriptor.gradients.as_ref().unwrap();
+        let single_gradients = single.gradients.as_ref().unwrap();
+        assert_eq!(single_gradients.shape(), gradients.shape());
+        for (&single, &double) in single_gradients.iter().zip(gradients) {
+            assert_eq!(single, double as f32);
+        }
+    }
+}
@@ -11,6 +11,8 @@ pub enum Error {
     Utf8(Utf8Error),
     /// Error related to reading files with chemfiles
     Chemfiles(String),
+    /// Error while reading or writing files
+    Io(std::io::Error),
     /// Errors coming from external callbacks, typically inside the System
     /// implementation
     External {
@@ -32,6 +34,7 @@ impl std::fmt::Display for Error {
             Error::Json(e) => write!(f, "json error: {}", e),
             Error::Utf8(e) => write!(f, "utf8 decoding error: {}", e),
             Error::Chemfiles(e) => write!(f, "chemfiles error: {}", e),
+            Error::Io(e) => write!(f, "io error: {}", e),
             Error::BufferSize(e) => write!(f, "buffer is not big enough: {}", e),
             Error::External{status, message} => write!(f, "error from external code (status {}): {}", status, message),
             Error::Internal(e) => write!(f, "internal error: {}", e),
@@ -49,6 +52,7 @@ impl std::error::Error for Error {
             Error::External{..} => None,
             Error::Json(e) => Some(e),
             Error::Utf8(e) => Some(e),
+            Error::Io(e) => Some(e),
         }
     }
 }
@@ -65,6 +69,12 @@ impl From<Utf8Error> for Error {
     }
 }
 
+impl From<std::io::Error> for Error {
+    fn from(error: std::io::Error) -> Error {
+        Error::Io(error)
+    }
+}
+
 
 // Box<dyn Any + Send + 'static> is the error type in std::panic::catch_unwind
 impl From<Box<dyn std::any::Any + Send + 'static>> for Error {
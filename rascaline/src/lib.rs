@@ -29,10 +29,13 @@ pub mod descriptor;
 pub use descriptor::Descriptor;
 
 mod calculator;
-pub use calculator::{Calculator, CalculationOptions, SelectedIndexes};
+pub use calculator::{Calculator, CalculatorGroup, CalculationOptions, CalculationPlan, SelectedIndexes};
 
 pub mod calculators;
 
+pub mod metrics;
+pub mod threads;
+
 
 // only try to build the tutorials in test mode
 #[cfg(test)]
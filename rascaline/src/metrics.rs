@@ -0,0 +1,255 @@
+//! Lightweight counters collected during calculations, complementing the
+//! timing information collected with `time_graph`.
+//!
+//! Metrics collection is disabled by default, and can be enabled with
+//! [`enable`]. When it is disabled, updating a counter only costs a single
+//! atomic load.
+use std::sync::atomic::{AtomicBool, AtomicU64, Ordering};
+use std::time::Instant;
+
+use serde::Serialize;
+
+/// Maximal number of rayon worker threads for which busy time is recorded
+const MAX_THREADS: usize = 256;
+
+static ENABLED: AtomicBool = AtomicBool::new(false);
+
+/// Counters updated by the calculations
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub(crate) enum Counter {
+    Pairs = 0,
+    Samples,
+    GradientSamples,
+    DescriptorBytes,
+    IndexesBytes,
+    NeighborsListBuilds,
+    NeighborsListReuses,
+    ChunksQueueHighWater,
+    EnvironmentCacheHits,
+    EnvironmentCacheMisses,
+    ParallelTime,
+}
+
+/// Number of variants in `Counter`
+const N_COUNTERS: usize = 11;
+
+struct MetricsStorage {
+    /// values for all counters, indexed by `Counter as usize`
+    counters: Vec<AtomicU64>,
+    /// time spent working on parallel tasks by each rayon worker thread, in
+    /// nanoseconds
+    threads_busy: Vec<AtomicU64>,
+}
+
+lazy_static::lazy_static!{
+    static ref STORAGE: MetricsStorage = MetricsStorage {
+        counters: (0..N_COUNTERS).map(|_| AtomicU64::new(0)).collect(),
+        threads_busy: (0..MAX_THREADS).map(|_| AtomicU64::new(0)).collect(),
+    };
+}
+
+/// Snapshot of the metrics collected since the last call to [`clear`]
+#[derive(Debug, Clone, Default, PartialEq, Eq, Serialize)]
+pub struct Metrics {
+    /// Number of pairs processed by the spherical expansion. Each pair is
+    /// counted once for each of the two atoms in the pair.
+    pub pairs: u64,
+    /// Number of samples (i.e. rows in the values array) computed by the
+    /// calculators, including intermediary calculators
+    pub samples: u64,
+    /// Number of gradients samples (i.e. rows in the gradients array) computed
+    /// by the calculators, including intermediary calculators
+    pub gradient_samples: u64,
+    /// Memory used by the values and gradients arrays of descriptors, in bytes,
+    /// summed over all calls to `Descriptor::prepare`/`prepare_gradients`
+    pub descriptor_bytes: u64,
+    /// Memory used by the values of samples, gradients samples and features
+    /// indexes, in bytes, summed over all calls to `Descriptor::prepare`/
+    /// `prepare_gradients`
+    pub indexes_bytes: u64,
+    /// Number of neighbors lists created from scratch
+    pub neighbors_list_builds: u64,
+    /// Number of times an existing neighbors list was re-used, possibly after
+    /// an update when using a Verlet skin
+    pub neighbors_list_reuses: u64,
+    /// Largest number of chunks read ahead of the calculation when streaming
+    /// trajectories with `TrajectoryChunks`
+    pub chunks_queue_high_water: u64,
+    /// Number of atomic environments for which the power spectrum was copied
+    /// from an identical environment, when deduplicating environments
+    pub environment_cache_hits: u64,
+    /// Number of atomic environments for which the power spectrum was
+    /// computed, when deduplicating environments
+    pub environment_cache_misses: u64,
+    /// Total wall time spent in the parallel sections of the calculators, in
+    /// nanoseconds
+    pub parallel_time_ns: u64,
+    /// Busy and idle time for each rayon worker thread during the parallel
+    /// sections of the calculators
+    pub threads: Vec<ThreadMetrics>,
+}
+
+/// Busy and idle time of a single worker thread
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq, Serialize)]
+pub struct ThreadMetrics {
+    /// Time spent working on parallel tasks, in nanoseconds
+    pub busy_ns: u64,
+    /// Time spent inside parallel sections without working on a task, in
+    /// nanoseconds
+    pub idle_ns: u64,
+}
+
+impl Metrics {
+    /// Get these metrics formatted as JSON
+    pub fn as_json(&self) -> String {
+        serde_json::to_string_pretty(self).expect("failed to serialize metrics")
+    }
+}
+
+/// Enable or disable metrics collection
+pub fn enable(enabled: bool) {
+    ENABLED.store(enabled, Ordering::Relaxed);
+}
+
+/// Check if metrics collection is currently enabled
+#[inline]
+pub fn is_enabled() -> bool {
+    ENABLED.load(Ordering::Relaxed)
+}
+
+/// Reset all the metrics to zero
+pub fn clear() {
+    for counter in STORAGE.counters.iter().chain(&STORAGE.threads_busy) {
+        counter.store(0, Ordering::Relaxed);
+    }
+}
+
+/// Get the current values of all metrics
+pub fn get() -> Metrics {
+    let counter = |counter: Counter| STORAGE.counters[counter as usize].load(Ordering::Relaxed);
+    let parallel_time_ns = counter(Counter::ParallelTime);
+
+    let busy = STORAGE.threads_busy.iter()
+        .map(|busy| busy.load(Ordering::Relaxed))
+        .collect::<Vec<_>>();
+    let last_busy = busy.iter().rposition(|&busy| busy != 0).map_or(0, |i| i + 1);
+    let n_threads = usize::min(usize::max(crate::threads::num_threads(), last_busy), MAX_THREADS);
+
+    let threads = busy[..n_threads].iter()
+        .map(|&busy_ns| ThreadMetrics {
+            busy_ns: busy_ns,
+            idle_ns: parallel_time_ns.saturating_sub(busy_ns),
+        })
+        .collect();
+
+    return Metrics {
+        pairs: counter(Counter::Pairs),
+        samples: counter(Counter::Samples),
+        gradient_samples: counter(Counter::GradientSamples),
+        descriptor_bytes: counter(Counter::DescriptorBytes),
+        indexes_bytes: counter(Counter::IndexesBytes),
+        neighbors_list_builds: counter(Counter::NeighborsListBuilds),
+        neighbors_list_reuses: counter(Counter::NeighborsListReuses),
+        chunks_queue_high_water: counter(Counter::ChunksQueueHighWater),
+        environment_cache_hits: counter(Counter::EnvironmentCacheHits),
+        environment_cache_misses: counter(Counter::EnvironmentCacheMisses),
+        parallel_time_ns: parallel_time_ns,
+        threads: threads,
+    };
+}
+
+/// Add `value` to the given `counter`
+#[inline]
+pub(crate) fn add(counter: Counter, value: usize) {
+    if is_enabled() {
+        STORAGE.counters[counter as usize].fetch_add(value as u64, Ordering::Relaxed);
+    }
+}
+
+/// Set the given `counter` to `value` if it is larger than the current value
+#[inline]
+pub(crate) fn record_max(counter: Counter, value: usize) {
+    if is_enabled() {
+        STORAGE.counters[counter as usize].fetch_max(value as u64, Ordering::Relaxed);
+    }
+}
+
+/// Guard recording the time spent by the current rayon worker thread in a
+/// parallel task, created with [`busy_timer`].
+pub(crate) struct BusyTimer {
+    start: Instant,
+}
+
+impl Drop for BusyTimer {
+    fn drop(&mut self) {
+        if let Some(thread) = rayon::current_thread_index() {
+            if thread < MAX_THREADS {
+                let elapsed = self.start.elapsed().as_nanos() as u64;
+                STORAGE.threads_busy[thread].fetch_add(elapsed, Ordering::Relaxed);
+            }
+        }
+    }
+}
+
+/// Start recording the time spent in a parallel task, until the returned value
+/// is dropped. This returns `None` if metrics collection is disabled.
+#[inline]
+pub(crate) fn busy_timer() -> Option<BusyTimer> {
+    if is_enabled() {
+        Some(BusyTimer { start: Instant::now() })
+    } else {
+        None
+    }
+}
+
+/// Guard recording the wall time spent in a parallel section, created with
+/// [`parallel_section`].
+pub(crate) struct ParallelSection {
+    start: Instant,
+}
+
+impl Drop for ParallelSection {
+    fn drop(&mut self) {
+        let elapsed = self.start.elapsed().as_nanos() as u64;
+        STORAGE.counters[Counter::ParallelTime as usize].fetch_add(elapsed, Ordering::Relaxed);
+    }
+}
+
+/// Start recording the wall time spent in a parallel section, until the
+/// returned value is dropped. This returns `None` if metrics collection is
+/// disabled.
+///
+/// Parallel sections should not be nested, and every task inside them should
+/// use [`busy_timer`] to allow computing the idle time of the threads.
+#[inline]
+pub(crate) fn parallel_section() -> Option<ParallelSection> {
+    if is_enabled() {
+        Some(ParallelSection { start: Instant::now() })
+    } else {
+        None
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn counters() {
+        // other tests running in parallel might update the counters, so we
+        // only check for lower bounds here
+        enable(true);
+        add(Counter::Pairs, 42);
+        record_max(Counter::ChunksQueueHighWater, 3);
+        record_max(Counter::ChunksQueueHighWater, 1);
+
+        let metrics = get();
+        assert!(metrics.pairs >= 42);
+        assert!(metrics.chunks_queue_high_water >= 3);
+        assert!(metrics.threads.len() >= 1);
+
+        let json = metrics.as_json();
+        assert!(json.contains("\"neighbors_list_builds\""));
+        assert!(json.contains("\"busy_ns\""));
+    }
+}
@@ -1,7 +1,13 @@
 use std::path::Path;
+use std::sync::Arc;
+use std::sync::atomic::{AtomicUsize, Ordering};
+use std::sync::mpsc::{sync_channel, Receiver, SyncSender};
+use std::thread::JoinHandle;
 
 use super::SimpleSystem;
 use crate::Error;
+#[cfg(feature = "chemfiles")]
+use crate::metrics::{self, Counter};
 
 #[cfg(feature = "chemfiles")]
 impl From<chemfiles::Error> for Error {
@@ -16,53 +22,9 @@ impl From<chemfiles::Error> for Error {
 /// This function can read all [formats supported by
 /// chemfiles](https://chemfiles.org/chemfiles/latest/formats.html).
 #[cfg(feature = "chemfiles")]
-#[allow(clippy::needless_range_loop)]
 pub fn read_from_file(path: impl AsRef<Path>) -> Result<Vec<SimpleSystem>, Error> {
-    use std::collections::HashMap;
-    use crate::Matrix3;
-    use crate::systems::UnitCell;
-
-    let mut systems = Vec::new();
-
-    let mut trajectory = chemfiles::Trajectory::open(path, 'r')?;
-    let mut frame = chemfiles::Frame::new();
-
-    let mut assigned_species = HashMap::new();
-    let mut get_species = |atom: chemfiles::AtomRef| {
-        let atomic_number = atom.atomic_number();
-        if atomic_number == 0 {
-            // use number assigned from the the atomic type, starting at 120
-            // since that's larger than the number of elements in the periodic
-            // table
-            let new_species = 120 + assigned_species.len() as i32;
-            *assigned_species.entry(atom.atomic_type()).or_insert(new_species)
-        } else {
-            atomic_number as i32
-        }
-    };
-
-    for _ in 0..trajectory.nsteps() {
-        trajectory.read(&mut frame)?;
-
-        let positions = frame.positions();
-
-        let cell = if frame.cell().shape() == chemfiles::CellShape::Infinite {
-            UnitCell::infinite()
-        } else {
-            // transpose since chemfiles is using columns for the cell vectors and
-            // we want rows as cell vectors
-            UnitCell::from(Matrix3::from(frame.cell().matrix()).transposed())
-        };
-        let mut system = SimpleSystem::new(cell);
-        for i in 0..frame.size() {
-            let atom = frame.atom(i);
-            system.add_atom(get_species(atom), positions[i].into());
-        }
-
-        systems.push(system);
-    }
-
-    return Ok(systems);
+    let mut reader = FramesReader::open(path.as_ref())?;
+    return reader.read(usize::MAX);
 }
 
 /// Read all structures in the file at the given `path` using
@@ -77,6 +39,202 @@ pub fn read_from_file(_: impl AsRef<Path>) -> Result<Vec<SimpleSystem>, Error> {
     ))
 }
 
+/// Sequential reader of the frames in a trajectory, converting them to
+/// `SimpleSystem`.
+#[cfg(feature = "chemfiles")]
+struct FramesReader {
+    trajectory: chemfiles::Trajectory,
+    frame: chemfiles::Frame,
+    /// Total number of steps in the trajectory
+    n_steps: usize,
+    /// Index of the next step to read
+    step: usize,
+    /// Species assigned to atomic types without atomic number
+    assigned_species: std::collections::HashMap<String, i32>,
+}
+
+#[cfg(feature = "chemfiles")]
+impl FramesReader {
+    fn open(path: &Path) -> Result<FramesReader, Error> {
+        let mut trajectory = chemfiles::Trajectory::open(path, 'r')?;
+        let n_steps = trajectory.nsteps() as usize;
+        return Ok(FramesReader {
+            trajectory: trajectory,
+            frame: chemfiles::Frame::new(),
+            n_steps: n_steps,
+            step: 0,
+            assigned_species: std::collections::HashMap::new(),
+        });
+    }
+
+    /// Read up to `count` structures from the trajectory. The returned vector
+    /// is empty once all structures have been read.
+    #[allow(clippy::needless_range_loop)]
+    fn read(&mut self, count: usize) -> Result<Vec<SimpleSystem>, Error> {
+        use crate::Matrix3;
+        use crate::systems::UnitCell;
+
+        let count = usize::min(count, self.n_steps - self.step);
+        let mut systems = Vec::with_capacity(count);
+        for _ in 0..count {
+            self.trajectory.read(&mut self.frame)?;
+            self.step += 1;
+
+            let positions = self.frame.positions();
+
+            let cell = if self.frame.cell().shape() == chemfiles::CellShape::Infinite {
+                UnitCell::infinite()
+            } else {
+                // transpose since chemfiles is using columns for the cell vectors and
+                // we want rows as cell vectors
+                UnitCell::from(Matrix3::from(self.frame.cell().matrix()).transposed())
+            };
+            let mut system = SimpleSystem::new(cell);
+            for i in 0..self.frame.size() {
+                let atom = self.frame.atom(i);
+                let atomic_number = atom.atomic_number();
+                let species = if atomic_number == 0 {
+                    // use number assigned from the the atomic type, starting at 120
+                    // since that's larger than the number of elements in the periodic
+                    // table
+                    let new_species = 120 + self.assigned_species.len() as i32;
+                    *self.assigned_species.entry(atom.atomic_type()).or_insert(new_species)
+                } else {
+                    atomic_number as i32
+                };
+                system.add_atom(species, positions[i].into());
+            }
+
+            systems.push(system);
+        }
+
+        return Ok(systems);
+    }
+}
+
+/// Iterator over the structures in a trajectory file, producing chunks of
+/// `SimpleSystem`.
+///
+/// The file is read with [chemfiles](https://chemfiles.org/) in a background
+/// thread, which reads the next chunk while the current one is being used.
+/// At most two chunks are kept in memory at the same time, making it possible
+/// to work with trajectories that would not fit in memory.
+pub struct TrajectoryChunks {
+    receiver: Option<Receiver<Result<Vec<SimpleSystem>, Error>>>,
+    thread: Option<JoinHandle<()>>,
+    /// Number of chunks read by the background thread, but not yet returned
+    /// by the iterator
+    pending: Arc<AtomicUsize>,
+}
+
+impl TrajectoryChunks {
+    /// Start reading the file at the given `path` in chunks of (at most)
+    /// `chunk_size` structures.
+    ///
+    /// Errors happening when opening or reading the file are reported by the
+    /// iterator.
+    pub fn open(path: impl AsRef<Path>, chunk_size: usize) -> Result<TrajectoryChunks, Error> {
+        if chunk_size == 0 {
+            return Err(Error::InvalidParameter(
+                "chunk size must be at least 1 to read a trajectory".into()
+            ));
+        }
+
+        if !cfg!(feature = "chemfiles") {
+            return Err(Error::Chemfiles(
+                "TrajectoryChunks is only available with the chemfiles feature enabled".into()
+            ));
+        }
+
+        let path = path.as_ref().to_owned();
+        // use a rendezvous channel, so the reader thread blocks with the next
+        // chunk until the current one is done. This bounds memory usage to
+        // two chunks: the one being used and the one waiting to be sent.
+        let (sender, receiver) = sync_channel(0);
+        let pending = Arc::new(AtomicUsize::new(0));
+        let thread = {
+            let pending = Arc::clone(&pending);
+            std::thread::spawn(move || read_chunks(&path, chunk_size, &sender, &pending))
+        };
+
+        return Ok(TrajectoryChunks {
+            receiver: Some(receiver),
+            thread: Some(thread),
+            pending: pending,
+        });
+    }
+}
+
+/// Read the file at `path` in chunks of `chunk_size` structures, sending all
+/// of them to `sender`. This stops at the first error, or when the receiving
+/// side of the channel is dropped. `pending` is incremented for every chunk
+/// read.
+#[cfg(feature = "chemfiles")]
+fn read_chunks(
+    path: &Path,
+    chunk_size: usize,
+    sender: &SyncSender<Result<Vec<SimpleSystem>, Error>>,
+    pending: &AtomicUsize,
+) {
+    let mut reader = match FramesReader::open(path) {
+        Ok(reader) => reader,
+        Err(error) => {
+            let _ = sender.send(Err(error));
+            return;
+        }
+    };
+
+    loop {
+        match reader.read(chunk_size) {
+            Ok(systems) => {
+                if systems.is_empty() {
+                    return;
+                }
+
+                let read_ahead = pending.fetch_add(1, Ordering::SeqCst) + 1;
+                metrics::record_max(Counter::ChunksQueueHighWater, read_ahead);
+
+                if sender.send(Ok(systems)).is_err() {
+                    // the receiver was dropped, stop reading
+                    return;
+                }
+            }
+            Err(error) => {
+                let _ = sender.send(Err(error));
+                return;
+            }
+        }
+    }
+}
+
+#[cfg(not(feature = "chemfiles"))]
+fn read_chunks(_: &Path, _: usize, _: &SyncSender<Result<Vec<SimpleSystem>, Error>>, _: &AtomicUsize) {
+    unreachable!("TrajectoryChunks::open checks for the chemfiles feature")
+}
+
+impl Iterator for TrajectoryChunks {
+    type Item = Result<Vec<SimpleSystem>, Error>;
+
+    fn next(&mut self) -> Option<Self::Item> {
+        let chunk = self.receiver.as_ref().and_then(|receiver| receiver.recv().ok());
+        if let Some(Ok(_)) = chunk {
+            self.pending.fetch_sub(1, Ordering::SeqCst);
+        }
+        return chunk;
+    }
+}
+
+impl Drop for TrajectoryChunks {
+    fn drop(&mut self) {
+        // dropping the receiver makes the reading thread stop at the next
+        // chunk, which allows to join it
+        std::mem::drop(self.receiver.take());
+        if let Some(thread) = self.thread.take() {
+            let _ = thread.join();
+        }
+    }
+}
+
 #[cfg(all(test, feature = "chemfiles"))]
 mod tests {
     use std::path::PathBuf;
@@ -119,4 +277,38 @@ mod tests {
 
         Ok(())
     }
+
+    #[test]
+    fn chunks() {
+        let mut path = PathBuf::from(env!("CARGO_MANIFEST_DIR"));
+        path.push("benches");
+        path.push("data");
+        path.push("silicon_bulk.xyz");
+
+        let all = read_from_file(&path).unwrap();
+
+        let chunks = TrajectoryChunks::open(&path, 7).unwrap()
+            .collect::<Result<Vec<_>, _>>()
+            .unwrap();
+
+        let sizes = chunks.iter().map(|chunk| chunk.len()).collect::<Vec<_>>();
+        assert_eq!(sizes, [7, 7, 7, 7, 2]);
+
+        let streamed = chunks.into_iter().flatten().collect::<Vec<_>>();
+        assert_eq!(streamed.len(), all.len());
+        for (system, expected) in streamed.iter().zip(&all) {
+            assert_eq!(system.species().unwrap(), expected.species().unwrap());
+            assert_eq!(system.positions().unwrap(), expected.positions().unwrap());
+        }
+
+        // dropping the iterator before the end stops the reading thread
+        let mut chunks = TrajectoryChunks::open(&path, 3).unwrap();
+        assert_eq!(chunks.next().unwrap().unwrap().len(), 3);
+        std::mem::drop(chunks);
+
+        path.set_file_name("not-there.xyz");
+        let mut chunks = TrajectoryChunks::open(&path, 3).unwrap();
+        assert!(chunks.next().unwrap().is_err());
+        assert!(chunks.next().is_none());
+    }
 }
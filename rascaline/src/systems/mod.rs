@@ -10,7 +10,7 @@ mod simple_system;
 pub use self::simple_system::SimpleSystem;
 
 mod chemfiles;
-pub use self::chemfiles::read_from_file;
+pub use self::chemfiles::{read_from_file, TrajectoryChunks};
 
 #[cfg(test)]
 pub(crate) mod test_utils;
@@ -32,6 +32,103 @@ pub struct Pair {
     pub vector: Vector3D,
 }
 
+/// Pairs containing a given center, as returned by `System::pairs_containing`.
+///
+/// The pairs can either be stored directly in a contiguous slice, or as
+/// indexes into the full list of pairs of the system (i.e. the list returned by
+/// `System::pairs`), which avoids storing each pair three times.
+#[derive(Debug, Clone, Copy)]
+pub enum CenterPairs<'a> {
+    /// The pairs containing the center
+    Pairs(&'a [Pair]),
+    /// Indexes of the pairs containing the center in `pairs`
+    Indexes {
+        /// all pairs in the system
+        pairs: &'a [Pair],
+        /// indexes in `pairs` of the pairs containing the center
+        indexes: &'a [usize],
+    },
+}
+
+impl<'a> CenterPairs<'a> {
+    /// Get the number of pairs containing the center
+    pub fn len(&self) -> usize {
+        match *self {
+            CenterPairs::Pairs(pairs) => pairs.len(),
+            CenterPairs::Indexes { indexes, .. } => indexes.len(),
+        }
+    }
+
+    /// Check if there are no pairs containing the center
+    pub fn is_empty(&self) -> bool {
+        self.len() == 0
+    }
+
+    /// Iterate over the pairs containing the center
+    pub fn iter(&self) -> CenterPairsIter<'a> {
+        match *self {
+            CenterPairs::Pairs(pairs) => CenterPairsIter::Pairs(pairs.iter()),
+            CenterPairs::Indexes { pairs, indexes } => CenterPairsIter::Indexes {
+                pairs: pairs,
+                indexes: indexes.iter(),
+            },
+        }
+    }
+}
+
+impl<'a> IntoIterator for CenterPairs<'a> {
+    type Item = &'a Pair;
+    type IntoIter = CenterPairsIter<'a>;
+
+    fn into_iter(self) -> Self::IntoIter {
+        self.iter()
+    }
+}
+
+impl<'a, 'b> IntoIterator for &'b CenterPairs<'a> {
+    type Item = &'a Pair;
+    type IntoIter = CenterPairsIter<'a>;
+
+    fn into_iter(self) -> Self::IntoIter {
+        self.iter()
+    }
+}
+
+/// Iterator over the pairs in `CenterPairs`
+#[derive(Debug, Clone)]
+pub enum CenterPairsIter<'a> {
+    #[doc(hidden)]
+    Pairs(std::slice::Iter<'a, Pair>),
+    #[doc(hidden)]
+    Indexes {
+        pairs: &'a [Pair],
+        indexes: std::slice::Iter<'a, usize>,
+    },
+}
+
+impl<'a> Iterator for CenterPairsIter<'a> {
+    type Item = &'a Pair;
+
+    fn next(&mut self) -> Option<Self::Item> {
+        match self {
+            CenterPairsIter::Pairs(iter) => iter.next(),
+            CenterPairsIter::Indexes { pairs, indexes } => {
+                let pairs: &'a [Pair] = *pairs;
+                indexes.next().map(|&index| &pairs[index])
+            }
+        }
+    }
+
+    fn size_hint(&self) -> (usize, Option<usize>) {
+        match self {
+            CenterPairsIter::Pairs(iter) => iter.size_hint(),
+            CenterPairsIter::Indexes { indexes, .. } => indexes.size_hint(),
+        }
+    }
+}
+
+impl<'a> ExactSizeIterator for CenterPairsIter<'a> {}
+
 /// A `System` deals with the storage of atoms and related information, as well
 /// as the computation of neighbor lists.
 pub trait System {
@@ -69,5 +166,8 @@ pub trait System {
     /// applies, with the additional condition that the pair `i-j` should be
     /// included both in the return of `pairs_containing(i)` and
     /// `pairs_containing(j)`.
-    fn pairs_containing(&self, center: usize) -> Result<&[Pair], Error>;
+    ///
+    /// The pairs can be returned either directly, or as indexes into the list
+    /// returned by `System::pairs`, see `CenterPairs`.
+    fn pairs_containing(&self, center: usize) -> Result<CenterPairs<'_>, Error>;
 }
@@ -1,8 +1,11 @@
 use log::warn;
 use ndarray::Array3;
+use rayon::prelude::*;
 
 use crate::{Matrix3, Vector3D};
-use super::{UnitCell, Pair};
+use crate::metrics::{self, Counter};
+use crate::threads;
+use super::{UnitCell, Pair, CenterPairs};
 
 /// `f64::clamp` backported to rust 1.45
 fn f64_clamp(mut x: f64, min: f64, max: f64) -> f64 {
@@ -189,6 +192,32 @@ impl CellList {
     /// Add a single atom to the cell list at the given `position`. The atom is
     /// uniquely identified by its `index`.
     pub fn add_atom(&mut self, index: usize, position: Vector3D) {
+        let (cell_index, shift) = self.find_cell(position);
+        self.cells[cell_index].push(AtomData {
+            index: index,
+            shift: shift,
+        });
+    }
+
+    /// Add all atoms with the given `positions` to the cell list, using the
+    /// position in the slice as the atom index. The cells containing each atom
+    /// are determined in parallel.
+    pub fn add_atoms(&mut self, positions: &[Vector3D]) {
+        let cells = positions.par_iter()
+            .map(|&position| self.find_cell(position))
+            .collect::<Vec<_>>();
+
+        for (index, (cell_index, shift)) in cells.into_iter().enumerate() {
+            self.cells[cell_index].push(AtomData {
+                index: index,
+                shift: shift,
+            });
+        }
+    }
+
+    /// Find the cell in which an atom at the given `position` should go, and
+    /// the corresponding shift when wrapping the atom inside the unit cell.
+    fn find_cell(&self, position: Vector3D) -> ([usize; 3], CellShift) {
         let fractional = if self.unit_cell.is_infinite() {
             position
         } else {
@@ -218,10 +247,7 @@ impl CellList {
             divmod_vec(cell_index, n_cells)
         };
 
-        self.cells[cell_index].push(AtomData {
-            index: index,
-            shift: CellShift(shift),
-        });
+        return (cell_index, CellShift(shift));
     }
 
     /// Get the list of candidate pair. Some pairs might be separated by more
@@ -238,7 +264,25 @@ impl CellList {
     /// distances/directions are still included. Using the example above and
     /// with a cutoff of 5 Å, we can have a pair between atoms 33-64 at 2.6 Å
     /// and another pair between atoms 33-64 at 4.8 Å.
+    ///
+    /// The pairs for different cells are generated in parallel, and the output
+    /// is in the same order as if the cells were processed one after the
+    /// other.
     pub fn pairs(&self) -> Vec<CellPair> {
+        let cells = self.cells.indexed_iter().collect::<Vec<_>>();
+
+        return cells.into_par_iter()
+            .flat_map(|(cell_index, current_cell)| self.cell_pairs(cell_index, current_cell))
+            .collect();
+    }
+
+    /// Get the list of candidate pairs where the first atom is in the cell at
+    /// `(cell_i_x, cell_i_y, cell_i_z)` containing the atoms in `current_cell`.
+    fn cell_pairs(
+        &self,
+        (cell_i_x, cell_i_y, cell_i_z): (usize, usize, usize),
+        current_cell: &[AtomData],
+    ) -> Vec<CellPair> {
         let mut pairs = Vec::new();
 
         let n_cells = self.cells.shape();
@@ -248,57 +292,52 @@ impl CellList {
         let search_y = -self.n_search[1]..=self.n_search[1];
         let search_z = -self.n_search[2]..=self.n_search[2];
 
-        // for each cell in the cell list
-        for ((cell_i_x, cell_i_y, cell_i_z), current_cell) in self.cells.indexed_iter() {
-            // look through each neighboring cell
-            for delta_x in search_x.clone() {
-                for delta_y in search_y.clone() {
-                    for delta_z in search_z.clone() {
-                        let cell_i = [
-                            cell_i_x as isize + delta_x,
-                            cell_i_y as isize + delta_y,
-                            cell_i_z as isize + delta_z,
-                        ];
-
-                        // shift vector from one cell to the other and index of
-                        // the neighboring cell
-                        let (cell_shift, neighbor_cell_i) = divmod_vec(cell_i, n_cells);
-
-                        for atom_i in current_cell {
-                            for atom_j in &self.cells[neighbor_cell_i] {
-                                // create a half neighbor list
-                                if atom_i.index > atom_j.index {
-                                    continue;
-                                }
-
-                                let shift = CellShift(cell_shift) + atom_i.shift - atom_j.shift;
-                                let shift_is_zero = shift[0] == 0 && shift[1] == 0 && shift[2] == 0;
-
-                                if atom_i.index == atom_j.index && shift_is_zero {
-                                    // only create pair with the same atom twice
-                                    // if the pair spans more than one unit cell
-                                    continue;
-                                }
-
-                                if self.unit_cell.is_infinite() && !shift_is_zero {
-                                    // do not create pairs crossing the periodic
-                                    // boundaries in an infinite cell
-                                    continue;
-                                }
-
-                                pairs.push(CellPair {
-                                    first: atom_i.index,
-                                    second: atom_j.index,
-                                    shift: shift,
-                                });
+        // look through each neighboring cell
+        for delta_x in search_x {
+            for delta_y in search_y.clone() {
+                for delta_z in search_z.clone() {
+                    let cell_i = [
+                        cell_i_x as isize + delta_x,
+                        cell_i_y as isize + delta_y,
+                        cell_i_z as isize + delta_z,
+                    ];
+
+                    // shift vector from one cell to the other and index of
+                    // the neighboring cell
+                    let (cell_shift, neighbor_cell_i) = divmod_vec(cell_i, n_cells);
+
+                    for atom_i in current_cell {
+                        for atom_j in &self.cells[neighbor_cell_i] {
+                            // create a half neighbor list
+                            if atom_i.index > atom_j.index {
+                                continue;
                             }
-                        } // loop over atoms in current neighbor cells
 
-                    }
-                }
-            } // loop over neighboring cells
+                            let shift = CellShift(cell_shift) + atom_i.shift - atom_j.shift;
+                            let shift_is_zero = shift[0] == 0 && shift[1] == 0 && shift[2] == 0;
 
-        }
+                            if atom_i.index == atom_j.index && shift_is_zero {
+                                // only create pair with the same atom twice
+                                // if the pair spans more than one unit cell
+                                continue;
+                            }
+
+                            if self.unit_cell.is_infinite() && !shift_is_zero {
+                                // do not create pairs crossing the periodic
+                                // boundaries in an infinite cell
+                                continue;
+                            }
+
+                            pairs.push(CellPair {
+                                first: atom_i.index,
+                                second: atom_j.index,
+                                shift: shift,
+                            });
+                        }
+                    } // loop over atoms in current neighbor cells
+                }
+            }
+        } // loop over neighboring cells
 
         return pairs;
     }
@@ -328,72 +367,204 @@ fn divmod_vec(a: [isize; 3], b: [usize; 3]) -> ([isize; 3], [usize; 3]) {
 }
 
 /// A neighbor list implementation usable with any system
+///
+/// The neighbor list can optionally use a Verlet skin: candidate pairs are
+/// searched up to `cutoff + skin`, and the list can then be updated for new
+/// positions of the atoms with `NeighborsList::update` by only re-computing
+/// the distances of the candidate pairs, as long as no atom moved by more than
+/// half the skin.
 #[derive(Clone, Debug)]
 pub struct NeighborsList {
     /// the cutoff used to create this neighbor list
     pub cutoff: f64,
     /// all pairs in the system
     pub pairs: Vec<Pair>,
-    /// all pairs in the system, classified by associated center
-    pub pairs_by_center: Vec<Vec<Pair>>,
+    /// indexes in `pairs` of all pairs in the system, classified by associated
+    /// center and stored in compressed sparse row format: the indexes of the
+    /// pairs containing a given `center` are
+    /// `center_pairs[center_offsets[center]..center_offsets[center + 1]]`
+    center_pairs: Vec<usize>,
+    /// offsets of the pairs associated with each center in `center_pairs`
+    center_offsets: Vec<usize>,
+    /// Verlet skin used to create the candidate pairs
+    skin: f64,
+    /// candidate pairs up to `cutoff + skin`, only stored when `skin > 0`
+    candidates: Vec<CellPair>,
+    /// positions of the atoms when creating the candidate pairs
+    reference_positions: Vec<Vector3D>,
+    /// unit cell used to create the candidate pairs
+    unit_cell: UnitCell,
 }
 
 impl NeighborsList {
-    #[time_graph::instrument(name = "NeighborsList")]
     pub fn new(positions: &[Vector3D], unit_cell: UnitCell, cutoff: f64) -> NeighborsList {
-        let mut cell_list = CellList::new(unit_cell, cutoff);
+        return NeighborsList::with_skin(positions, unit_cell, cutoff, 0.0);
+    }
+
+    /// Create a new neighbor list with the given Verlet `skin`, which can then
+    /// be cheaply updated with `NeighborsList::update` when atoms move. Using
+    /// a `skin` of 0 gives the same neighbor list as `NeighborsList::new`.
+    #[time_graph::instrument(name = "NeighborsList")]
+    pub fn with_skin(positions: &[Vector3D], unit_cell: UnitCell, cutoff: f64, skin: f64) -> NeighborsList {
+        assert!(skin >= 0.0, "the Verlet skin must be positive, got {}", skin);
+        metrics::add(Counter::NeighborsListBuilds, 1);
+
+        // this can be called outside of a calculation, so we need to make
+        // sure the parallel iterators run in rascaline's thread pool
+        return threads::install(|| {
+            let mut cell_list = CellList::new(unit_cell, cutoff + skin);
+
+            cell_list.add_atoms(positions);
+
+            let candidates = if skin > 0.0 {
+                // only keep the candidates which could get below the cutoff
+                // before the next re-build of the list
+                let cell_matrix = unit_cell.matrix();
+                let candidates_cutoff2 = (cutoff + skin) * (cutoff + skin);
+                cell_list.pairs().into_par_iter().filter(|pair| {
+                    let mut vector = positions[pair.second] - positions[pair.first];
+                    vector += pair.shift.cartesian(&cell_matrix);
+                    vector * vector < candidates_cutoff2
+                }).collect()
+            } else {
+                cell_list.pairs()
+            };
+
+            let (pairs, center_pairs, center_offsets) = filter_pairs(positions, unit_cell, cutoff, &candidates);
+
+            let (candidates, reference_positions) = if skin > 0.0 {
+                (candidates, positions.to_vec())
+            } else {
+                (Vec::new(), Vec::new())
+            };
+
+            NeighborsList {
+                cutoff: cutoff,
+                pairs: pairs,
+                center_pairs: center_pairs,
+                center_offsets: center_offsets,
+                skin: skin,
+                candidates: candidates,
+                reference_positions: reference_positions,
+                unit_cell: unit_cell,
+            }
+        });
+    }
+
+    /// Try to update this neighbor list for new `positions` of the atoms,
+    /// re-using the candidate pairs found when creating the list.
+    ///
+    /// This returns `false` and leaves the list unchanged if it needs to be
+    /// created again from scratch: when the list was created without a skin,
+    /// when the number of atoms or the unit cell changed, or when any atom
+    /// moved by more than half the skin since the list was created.
+    #[allow(clippy::float_cmp)]
+    #[time_graph::instrument(name = "NeighborsList::update")]
+    pub fn update(&mut self, positions: &[Vector3D], unit_cell: UnitCell) -> bool {
+        if self.skin == 0.0 || unit_cell != self.unit_cell || positions.len() != self.reference_positions.len() {
+            return false;
+        }
 
-        for (index, &position) in positions.iter().enumerate() {
-            cell_list.add_atom(index, position);
+        let max_displacement2 = 0.25 * self.skin * self.skin;
+        for (&position, &reference) in positions.iter().zip(&self.reference_positions) {
+            let displacement = position - reference;
+            if displacement * displacement > max_displacement2 {
+                return false;
+            }
         }
 
-        let cell_matrix = unit_cell.matrix();
-        let cutoff2 = cutoff * cutoff;
+        let cutoff = self.cutoff;
+        let candidates = &self.candidates;
+        let (pairs, center_pairs, center_offsets) = threads::install(|| {
+            filter_pairs(positions, unit_cell, cutoff, candidates)
+        });
+        self.pairs = pairs;
+        self.center_pairs = center_pairs;
+        self.center_offsets = center_offsets;
 
-        // the cell list creates too many pairs, we only need to keep the one where
-        // the distance is actually below the cutoff
-        let mut pairs = Vec::new();
-        let mut pairs_by_center = vec![Vec::new(); positions.len()];
-
-        for pair in cell_list.pairs() {
-            let mut vector = positions[pair.second] - positions[pair.first];
-            vector += pair.shift.cartesian(&cell_matrix);
-
-            let distance2 = vector * vector;
-            if distance2 < cutoff2 {
-                if distance2 < 1e-3 {
-                    warn!(
-                        "atoms {} and {} are very close to one another ({} A)",
-                        pair.first, pair.second, distance2.sqrt()
-                    );
-                }
+        return true;
+    }
 
-                let pair = Pair {
-                    first: pair.first,
-                    second: pair.second,
-                    distance: distance2.sqrt(),
-                    vector: vector,
-                };
+    /// Get the list of pairs containing the given `center`, either as the
+    /// first or second atom in the pair
+    pub fn pairs_containing(&self, center: usize) -> CenterPairs<'_> {
+        let start = self.center_offsets[center];
+        let stop = self.center_offsets[center + 1];
+        return CenterPairs::Indexes {
+            pairs: &self.pairs,
+            indexes: &self.center_pairs[start..stop],
+        };
+    }
+}
 
-                pairs.push(pair);
-                pairs_by_center[pair.first].push(pair);
-                pairs_by_center[pair.second].push(pair);
+/// Select the pairs in `candidates` with a distance below the cutoff, and
+/// return them both as a single list and as indexes in this list classified by
+/// associated center (in the compressed sparse row format used by
+/// `NeighborsList`).
+fn filter_pairs(
+    positions: &[Vector3D],
+    unit_cell: UnitCell,
+    cutoff: f64,
+    candidates: &[CellPair],
+) -> (Vec<Pair>, Vec<usize>, Vec<usize>) {
+    let cell_matrix = unit_cell.matrix();
+    let cutoff2 = cutoff * cutoff;
+
+    // the cell list creates too many pairs, we only need to keep the one where
+    // the distance is actually below the cutoff
+    let mut pairs = candidates.par_iter().filter_map(|pair| {
+        let mut vector = positions[pair.second] - positions[pair.first];
+        vector += pair.shift.cartesian(&cell_matrix);
+
+        let distance2 = vector * vector;
+        if distance2 < cutoff2 {
+            if distance2 < 1e-3 {
+                warn!(
+                    "atoms {} and {} are very close to one another ({} A)",
+                    pair.first, pair.second, distance2.sqrt()
+                );
             }
-        }
 
-        // sort the pairs to make sure the final output of rascaline is ordered
-        // naturally
-        pairs.sort_unstable_by_key(|pair| (pair.first, pair.second));
-        for pairs in &mut pairs_by_center {
-            pairs.sort_unstable_by_key(|pair| (pair.first, pair.second));
+            Some(Pair {
+                first: pair.first,
+                second: pair.second,
+                distance: distance2.sqrt(),
+                vector: vector,
+            })
+        } else {
+            None
         }
+    }).collect::<Vec<_>>();
+
+    // sort the pairs to make sure the final output of rascaline is ordered
+    // naturally. This uses a stable sort to keep the output deterministic
+    // for pairs between different periodic images of the same atoms.
+    pairs.par_sort_by_key(|pair| (pair.first, pair.second));
+
+    // count the pairs associated with each center to get the offsets, and then
+    // fill the pair indexes by center. Since `pairs` is already sorted, the
+    // pairs for each center are sorted as well.
+    let mut center_offsets = vec![0; positions.len() + 1];
+    for pair in &pairs {
+        center_offsets[pair.first + 1] += 1;
+        center_offsets[pair.second + 1] += 1;
+    }
+    for center in 0..positions.len() {
+        center_offsets[center + 1] += center_offsets[center];
+    }
 
-        return NeighborsList {
-            cutoff: cutoff,
-            pairs: pairs,
-            pairs_by_center: pairs_by_center,
-        };
+    // all entries are overwritten below, since each pair index is written once
+    // for its first and once for its second atom
+    let mut center_pairs = vec![0; 2 * pairs.len()];
+    let mut fill = center_offsets.clone();
+    for (index, pair) in pairs.iter().enumerate() {
+        center_pairs[fill[pair.first]] = index;
+        fill[pair.first] += 1;
+        center_pairs[fill[pair.second]] = index;
+        fill[pair.second] += 1;
     }
+
+    return (pairs, center_pairs, center_offsets);
 }
 
 #[cfg(test)]
@@ -500,4 +671,51 @@ mod tests {
             assert_ulps_eq!(pair.distance, 2.0);
         }
     }
+
+    #[test]
+    fn verlet_skin() {
+        let cell = UnitCell::cubic(5.0);
+        let mut positions = vec![
+            Vector3D::new(0.134, 1.282, 1.701),
+            Vector3D::new(-0.273, 1.026, -1.471),
+            Vector3D::new(1.922, -0.124, 1.900),
+            Vector3D::new(1.400, -0.464, 0.480),
+            Vector3D::new(0.149, 1.865, 0.635),
+        ];
+
+        let mut neighbors = NeighborsList::with_skin(&positions, cell, 3.0, 0.5);
+        let reference = NeighborsList::new(&positions, cell, 3.0);
+        assert_eq!(neighbors.pairs.len(), reference.pairs.len());
+
+        // small displacements only re-compute the distances
+        positions[0] += Vector3D::new(0.2, -0.1, 0.05);
+        positions[3] += Vector3D::new(-0.1, 0.2, 0.1);
+        assert!(neighbors.update(&positions, cell));
+
+        let reference = NeighborsList::new(&positions, cell, 3.0);
+        assert_eq!(neighbors.pairs.len(), reference.pairs.len());
+        for (pair, reference) in neighbors.pairs.iter().zip(&reference.pairs) {
+            assert_eq!(pair.first, reference.first);
+            assert_eq!(pair.second, reference.second);
+            assert_ulps_eq!(pair.distance, reference.distance);
+        }
+
+        for center in 0..positions.len() {
+            assert_eq!(
+                neighbors.pairs_containing(center).len(),
+                reference.pairs_containing(center).len()
+            );
+        }
+
+        // displacements larger than half the skin require a full re-build
+        positions[1] += Vector3D::new(0.3, 0.0, 0.0);
+        assert!(!neighbors.update(&positions, cell));
+
+        // so does changing the unit cell
+        assert!(!neighbors.update(&positions, UnitCell::cubic(6.0)));
+
+        // and using a neighbor list without skin
+        let mut neighbors = NeighborsList::new(&positions, cell, 3.0);
+        assert!(!neighbors.update(&positions, cell));
+    }
 }
@@ -1,6 +1,7 @@
 use crate::Error;
+use crate::metrics::{self, Counter};
 
-use super::{UnitCell, System, Vector3D, Pair};
+use super::{UnitCell, System, Vector3D, Pair, CenterPairs};
 
 use super::neighbors::NeighborsList;
 
@@ -11,6 +12,10 @@ pub struct SimpleSystem {
     species: Vec<i32>,
     positions: Vec<Vector3D>,
     neighbors: Option<NeighborsList>,
+    /// Verlet skin to use when computing the neighbor list
+    neighbors_skin: f64,
+    /// Were the positions modified since the last neighbor list update?
+    positions_changed: bool,
 }
 
 impl SimpleSystem {
@@ -21,6 +26,8 @@ impl SimpleSystem {
             species: Vec::new(),
             positions: Vec::new(),
             neighbors: None,
+            neighbors_skin: 0.0,
+            positions_changed: false,
         }
     }
 
@@ -30,12 +37,110 @@ impl SimpleSystem {
         self.positions.push(position);
     }
 
-    #[cfg(test)]
-    pub(crate) fn positions_mut(&mut self) -> &mut [Vector3D] {
-        // any position access invalidates the neighbor list
-        self.neighbors = None;
+    /// Get mutable access to the positions of the atoms in this system. The
+    /// neighbor list will be updated on the next call to `compute_neighbors`.
+    pub fn positions_mut(&mut self) -> &mut [Vector3D] {
+        self.positions_changed = true;
         return &mut self.positions;
     }
+
+    /// Re-order the atoms in this system along a Morton (Z-order) curve, so
+    /// that atoms close to one another in space are also close to one another
+    /// in memory. This can make the neighbor list and the calculations faster
+    /// for large systems, at the cost of changing the atomic indexes.
+    ///
+    /// This returns the permutation applied to the atoms, such that the atom
+    /// at index `i` after sorting was at index `permutation[i]` before.
+    pub fn sort_atoms_spatially(&mut self) -> Vec<usize> {
+        let fractional = if self.cell.is_infinite() {
+            // use the bounding box of the atoms in place of the unit cell
+            let mut min = Vector3D::new(f64::INFINITY, f64::INFINITY, f64::INFINITY);
+            let mut max = Vector3D::new(f64::NEG_INFINITY, f64::NEG_INFINITY, f64::NEG_INFINITY);
+            for position in &self.positions {
+                for spatial in 0..3 {
+                    min[spatial] = f64::min(min[spatial], position[spatial]);
+                    max[spatial] = f64::max(max[spatial], position[spatial]);
+                }
+            }
+
+            self.positions.iter().map(|position| {
+                let mut fractional = Vector3D::zero();
+                for spatial in 0..3 {
+                    let size = max[spatial] - min[spatial];
+                    if size > 0.0 {
+                        fractional[spatial] = (position[spatial] - min[spatial]) / size;
+                    }
+                }
+                fractional
+            }).collect::<Vec<_>>()
+        } else {
+            self.positions.iter().map(|&position| {
+                let mut fractional = self.cell.fractional(position);
+                for spatial in 0..3 {
+                    fractional[spatial] -= f64::floor(fractional[spatial]);
+                }
+                fractional
+            }).collect()
+        };
+
+        let codes = fractional.iter().map(|&f| morton_code(f)).collect::<Vec<_>>();
+
+        let mut permutation = (0..self.positions.len()).collect::<Vec<_>>();
+        permutation.sort_by_key(|&i| codes[i]);
+
+        self.species = permutation.iter().map(|&i| self.species[i]).collect();
+        self.positions = permutation.iter().map(|&i| self.positions[i]).collect();
+        self.neighbors = None;
+        self.positions_changed = false;
+
+        return permutation;
+    }
+
+    /// Use a Verlet `skin` when computing the neighbor list of this system.
+    ///
+    /// With a non-zero skin, candidate pairs are searched up to `cutoff +
+    /// skin`, and the neighbor list is only re-built from scratch after
+    /// modifying the positions if one atom moved by more than `skin / 2`.
+    /// Otherwise, only the distances between candidate pairs are re-computed.
+    /// This is useful when running molecular dynamics, where atoms only move
+    /// slightly between successive calculations.
+    pub fn set_neighbors_skin(&mut self, skin: f64) -> Result<(), Error> {
+        if !(skin >= 0.0 && skin.is_finite()) {
+            return Err(Error::InvalidParameter(format!(
+                "the Verlet skin must be positive, got {}", skin
+            )));
+        }
+
+        self.neighbors_skin = skin;
+        self.neighbors = None;
+        return Ok(());
+    }
+}
+
+/// Number of bits used for each spatial dimension in `morton_code`
+const MORTON_BITS: u32 = 21;
+
+/// Spread the lowest `MORTON_BITS` bits of `x` so that they are separated by
+/// two zero bits
+fn spread_bits(mut x: u64) -> u64 {
+    x &= (1 << MORTON_BITS) - 1;
+    x = (x | x << 32) & 0x001f_0000_0000_ffff;
+    x = (x | x << 16) & 0x001f_0000_ff00_00ff;
+    x = (x | x << 8) & 0x100f_00f0_0f00_f00f;
+    x = (x | x << 4) & 0x10c3_0c30_c30c_30c3;
+    x = (x | x << 2) & 0x1249_2492_4924_9249;
+    return x;
+}
+
+/// Compute the Morton code of a point given by its `fractional` coordinates,
+/// all between 0 and 1.
+fn morton_code(fractional: Vector3D) -> u64 {
+    let max = ((1_u64 << MORTON_BITS) - 1) as f64;
+    let quantize = |x: f64| (f64::min(f64::max(x, 0.0), 1.0) * max) as u64;
+
+    return spread_bits(quantize(fractional[0]))
+        | spread_bits(quantize(fractional[1])) << 1
+        | spread_bits(quantize(fractional[2])) << 2;
 }
 
 impl System for SimpleSystem {
@@ -58,13 +163,18 @@ impl System for SimpleSystem {
     #[allow(clippy::float_cmp)]
     fn compute_neighbors(&mut self, cutoff: f64) -> Result<(), Error> {
         // re-use already computed NL is possible
-        if let Some(ref nl) = self.neighbors {
+        if let Some(ref mut nl) = self.neighbors {
             if nl.cutoff == cutoff {
-                return Ok(());
+                if !self.positions_changed || nl.update(&self.positions, self.cell) {
+                    self.positions_changed = false;
+                    metrics::add(Counter::NeighborsListReuses, 1);
+                    return Ok(());
+                }
             }
         }
 
-        self.neighbors = Some(NeighborsList::new(self.positions()?, self.cell()?, cutoff));
+        self.neighbors = Some(NeighborsList::with_skin(&self.positions, self.cell, cutoff, self.neighbors_skin));
+        self.positions_changed = false;
         Ok(())
     }
 
@@ -75,11 +185,11 @@ impl System for SimpleSystem {
         Ok(&neighbors.pairs)
     }
 
-    fn pairs_containing(&self, center: usize) -> Result<&[Pair], Error> {
+    fn pairs_containing(&self, center: usize) -> Result<CenterPairs<'_>, Error> {
         let neighbors = self.neighbors.as_ref().ok_or_else(|| Error::Internal(
             "neighbor list is not initialized".into()
         ))?;
-        Ok(&neighbors.pairs_by_center[center])
+        Ok(neighbors.pairs_containing(center))
     }
 }
 
@@ -117,4 +227,54 @@ mod tests {
             Vector3D::new(5.0, 3.0, 4.0),
         ]);
     }
+
+    #[test]
+    fn sort_atoms_spatially() {
+        let mut system = SimpleSystem::new(UnitCell::cubic(10.0));
+        system.add_atom(1, Vector3D::new(0.5, 1.0, 1.0));
+        system.add_atom(2, Vector3D::new(9.0, 1.0, 1.0));
+        system.add_atom(3, Vector3D::new(1.0, 1.0, 1.0));
+        system.add_atom(4, Vector3D::new(8.0, 1.0, 1.0));
+        // this atom is outside of the unit cell, at the same place as atom 2
+        system.add_atom(5, Vector3D::new(-1.5, 1.0, 1.0));
+
+        let permutation = system.sort_atoms_spatially();
+        assert_eq!(permutation, [0, 2, 3, 4, 1]);
+        assert_eq!(system.species().unwrap(), &[1, 3, 4, 5, 2]);
+        assert_eq!(system.positions().unwrap()[3], Vector3D::new(-1.5, 1.0, 1.0));
+
+        let mut system = SimpleSystem::new(UnitCell::infinite());
+        system.add_atom(1, Vector3D::new(3.0, 0.0, 0.0));
+        system.add_atom(2, Vector3D::new(-3.0, 0.0, 0.0));
+        system.add_atom(3, Vector3D::new(0.0, 0.0, 0.0));
+
+        let permutation = system.sort_atoms_spatially();
+        assert_eq!(permutation, [1, 2, 0]);
+    }
+
+    #[test]
+    fn neighbors_skin() {
+        let mut system = SimpleSystem::new(UnitCell::cubic(10.0));
+        system.add_atom(1, Vector3D::new(2.0, 3.0, 4.0));
+        system.add_atom(1, Vector3D::new(3.0, 3.0, 4.0));
+        system.add_atom(1, Vector3D::new(5.1, 3.0, 4.0));
+        system.set_neighbors_skin(0.5).unwrap();
+
+        system.compute_neighbors(2.0).unwrap();
+        assert_eq!(system.pairs().unwrap().len(), 1);
+
+        // atom 2 gets in range of atom 1 without re-building the list
+        system.positions_mut()[2][0] -= 0.2;
+        system.compute_neighbors(2.0).unwrap();
+        let pairs = system.pairs().unwrap();
+        assert_eq!(pairs.len(), 2);
+        assert_eq!((pairs[1].first, pairs[1].second), (1, 2));
+
+        // atoms moving further than half of the skin re-build the list
+        system.positions_mut()[0][0] -= 1.5;
+        system.compute_neighbors(2.0).unwrap();
+        assert_eq!(system.pairs().unwrap().len(), 1);
+
+        assert!(system.set_neighbors_skin(-1.0).is_err());
+    }
 }
@@ -0,0 +1,252 @@
+//! Configuration of the threads used by the parallel parts of the
+//! calculations.
+//!
+//! By default, rascaline uses rayon's global thread pool, sized according to
+//! the `RAYON_NUM_THREADS` environment variable or the number of CPU cores.
+//! [`set_num_threads`] creates a persistent thread pool with a given number of
+//! threads instead, optionally pinning each thread to a single CPU. This is
+//! useful when rascaline runs inside a code which already uses threads (e.g.
+//! with MPI and OpenMP), to prevent over-subscribing the cores.
+//!
+//! The parallel sections of the calculations run inside this pool, while all
+//! the calls to [`crate::System`] functions stay on the thread which started
+//! the calculation.
+use std::sync::{Arc, RwLock};
+
+use lazy_static::lazy_static;
+use log::warn;
+
+use crate::Error;
+
+lazy_static! {
+    /// Thread pool set with `set_num_threads`, or `None` to use the global
+    /// rayon thread pool
+    static ref THREAD_POOL: RwLock<Option<Arc<rayon::ThreadPool>>> = RwLock::new(None);
+}
+
+/// Use `num_threads` threads for all the parallel calculations. The threads are
+/// created once in this function and re-used for all subsequent calculations.
+///
+/// If `num_threads` is 0, the default number of threads (from the
+/// `RAYON_NUM_THREADS` environment variable or the number of CPU cores) is
+/// used. Calling this function with `num_threads = 0` and `pin_threads = false`
+/// goes back to using rayon's global thread pool.
+///
+/// If `pin_threads` is `true`, each thread is bound to a single CPU, taken
+/// from the CPUs this process is allowed to run on (as set by `taskset`,
+/// `numactl` or the MPI launcher). CPUs are assigned to threads in order of
+/// NUMA node, so threads sharing a NUMA node are kept together. Pinning is only
+/// supported on Linux.
+///
+/// Calculations already running when this function is called continue to use
+/// the previous threads.
+pub fn set_num_threads(num_threads: usize, pin_threads: bool) -> Result<(), Error> {
+    if num_threads == 0 && !pin_threads {
+        *THREAD_POOL.write().expect("thread pool lock was poisoned") = None;
+        return Ok(());
+    }
+
+    let pool = build_thread_pool(num_threads, pin_threads)?;
+    *THREAD_POOL.write().expect("thread pool lock was poisoned") = Some(Arc::new(pool));
+    return Ok(());
+}
+
+/// Create a new thread pool with `num_threads` threads (or the default
+/// number of threads if `num_threads` is 0), optionally pinning each thread
+/// to a single CPU.
+fn build_thread_pool(num_threads: usize, pin_threads: bool) -> Result<rayon::ThreadPool, Error> {
+    let mut builder = rayon::ThreadPoolBuilder::new()
+        .num_threads(num_threads)
+        .thread_name(|index| format!("rascaline-{}", index));
+
+    if pin_threads {
+        let cpus = affinity::numa_ordered_cpus()?;
+        builder = builder.start_handler(move |index| {
+            let cpu = cpus[index % cpus.len()];
+            if let Err(e) = affinity::pin_current_thread(cpu) {
+                warn!("failed to pin thread {} to CPU {}: {}", index, cpu, e);
+            }
+        });
+    }
+
+    return builder.build().map_err(|e| Error::Internal(format!(
+        "failed to create the thread pool: {}", e
+    )));
+}
+
+/// Get the number of threads used for the parallel calculations
+pub fn num_threads() -> usize {
+    match &*THREAD_POOL.read().expect("thread pool lock was poisoned") {
+        Some(pool) => pool.current_num_threads(),
+        None => rayon::current_num_threads(),
+    }
+}
+
+/// Run `op` inside the thread pool set with [`set_num_threads`], or directly
+/// if no thread pool was set. All the parallel iterators used by `op` will run
+/// on the threads of this pool.
+///
+/// This should wrap the parallel sections of the code, which must not call
+/// [`crate::System`] functions since systems can not be sent across threads.
+pub(crate) fn install<OP, R>(op: OP) -> R where OP: FnOnce() -> R + Send, R: Send {
+    let pool = THREAD_POOL.read().expect("thread pool lock was poisoned").clone();
+    return install_in(pool.as_deref(), op);
+}
+
+/// Run `op` inside the given thread `pool`, or directly if `pool` is `None`
+fn install_in<OP, R>(pool: Option<&rayon::ThreadPool>, op: OP) -> R where OP: FnOnce() -> R + Send, R: Send {
+    match pool {
+        Some(pool) => pool.install(op),
+        None => op(),
+    }
+}
+
+/// Run `op` in the background, on one of the threads of the pool set with
+/// [`set_num_threads`] or of rayon's global thread pool. The parallel
+/// iterators used by `op` run in the same thread pool.
+pub fn spawn<OP>(op: OP) where OP: FnOnce() + Send + 'static {
+    let pool = THREAD_POOL.read().expect("thread pool lock was poisoned").clone();
+    match pool {
+        Some(pool) => pool.spawn(op),
+        None => rayon::spawn(op),
+    }
+}
+
+#[cfg(target_os = "linux")]
+mod affinity {
+    use std::collections::BTreeMap;
+
+    use crate::Error;
+
+    /// Get the list of CPUs this process is allowed to run on, sorted by NUMA
+    /// node and then by CPU index
+    pub fn numa_ordered_cpus() -> Result<Vec<usize>, Error> {
+        let mut cpus = allowed_cpus()?;
+        if cpus.is_empty() {
+            return Err(Error::Internal("this process is not allowed to run on any CPU".into()));
+        }
+
+        let numa_nodes = numa_nodes();
+        cpus.sort_by_key(|cpu| (numa_nodes.get(cpu).copied().unwrap_or(usize::MAX), *cpu));
+        return Ok(cpus);
+    }
+
+    fn allowed_cpus() -> Result<Vec<usize>, Error> {
+        unsafe {
+            let mut set: libc::cpu_set_t = std::mem::zeroed();
+            let status = libc::sched_getaffinity(0, std::mem::size_of::<libc::cpu_set_t>(), &mut set);
+            if status != 0 {
+                return Err(Error::Io(std::io::Error::last_os_error()));
+            }
+
+            let cpus = (0..libc::CPU_SETSIZE as usize)
+                .filter(|&cpu| libc::CPU_ISSET(cpu, &set))
+                .collect();
+            return Ok(cpus);
+        }
+    }
+
+    /// Bind the calling thread to the given `cpu`
+    pub fn pin_current_thread(cpu: usize) -> Result<(), Error> {
+        unsafe {
+            let mut set: libc::cpu_set_t = std::mem::zeroed();
+            libc::CPU_SET(cpu, &mut set);
+            let status = libc::sched_setaffinity(0, std::mem::size_of::<libc::cpu_set_t>(), &set);
+            if status != 0 {
+                return Err(Error::Io(std::io::Error::last_os_error()));
+            }
+        }
+        return Ok(());
+    }
+
+    /// Get the NUMA node of each CPU from sysfs. This returns an empty map if
+    /// the NUMA topology is not available.
+    fn numa_nodes() -> BTreeMap<usize, usize> {
+        let mut numa_nodes = BTreeMap::new();
+
+        let entries = match std::fs::read_dir("/sys/devices/system/node") {
+            Ok(entries) => entries,
+            Err(_) => return numa_nodes,
+        };
+
+        for entry in entries.flatten() {
+            let name = entry.file_name();
+            let node = match name.to_str().and_then(|name| name.strip_prefix("node")) {
+                Some(node) => node.parse::<usize>(),
+                None => continue,
+            };
+
+            let node = match node {
+                Ok(node) => node,
+                Err(_) => continue,
+            };
+
+            if let Ok(cpulist) = std::fs::read_to_string(entry.path().join("cpulist")) {
+                for cpu in parse_cpu_list(&cpulist) {
+                    numa_nodes.insert(cpu, node);
+                }
+            }
+        }
+
+        return numa_nodes;
+    }
+
+    /// Parse a list of CPU in the format used by the Linux kernel, e.g.
+    /// `0-3,8,10-11`. Invalid entries are ignored.
+    pub(super) fn parse_cpu_list(list: &str) -> Vec<usize> {
+        let mut cpus = Vec::new();
+        for range in list.trim().split(',') {
+            let mut bounds = range.splitn(2, '-');
+            let start = bounds.next().and_then(|start| start.parse::<usize>().ok());
+            let stop = match bounds.next() {
+                Some(stop) => stop.parse::<usize>().ok(),
+                None => start,
+            };
+
+            if let (Some(start), Some(stop)) = (start, stop) {
+                cpus.extend(start..=stop);
+            }
+        }
+        return cpus;
+    }
+}
+
+#[cfg(not(target_os = "linux"))]
+mod affinity {
+    use crate::Error;
+
+    pub fn numa_ordered_cpus() -> Result<Vec<usize>, Error> {
+        return Err(Error::InvalidParameter(
+            "pinning threads to CPUs is only supported on Linux".into()
+        ));
+    }
+
+    pub fn pin_current_thread(_: usize) -> Result<(), Error> {
+        unreachable!()
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    #[test]
+    #[cfg(target_os = "linux")]
+    fn parse_cpu_list() {
+        use super::affinity::parse_cpu_list;
+
+        assert_eq!(parse_cpu_list("0-3,8,10-11\n"), [0, 1, 2, 3, 8, 10, 11]);
+        assert_eq!(parse_cpu_list("5"), [5]);
+        assert_eq!(parse_cpu_list(""), Vec::<usize>::new());
+    }
+
+    #[test]
+    fn install() {
+        // use a local thread pool, since changing the global one would affect
+        // the other tests running in parallel
+        let pool = super::build_thread_pool(3, false).unwrap();
+        assert_eq!(pool.current_num_threads(), 3);
+        assert_eq!(super::install_in(Some(&pool), rayon::current_num_threads), 3);
+
+        let default = rayon::current_num_threads();
+        assert_eq!(super::install_in(None, rayon::current_num_threads), default);
+    }
+}